@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2016 Renat R. Dusaev <crank@qcrypt.org>
+ * Author: Renat R. Dusaev <crank@qcrypt.org>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+# ifndef H_STROMA_V_ALIGNMENT_RUNNER_APPLICATION_H
+# define H_STROMA_V_ALIGNMENT_RUNNER_APPLICATION_H
+
+# include "app/analysis.hpp"
+# include "app/mixins/alignment.hpp"
+
+namespace sV {
+
+/**@class HitsDispatcher
+ * @brief Processor routing event's displayable summaries to detectors and
+ *        triggering tracking groups reconstruction.
+ *
+ * Hits are dispatched with no drawing, so neither ROOT graphics nor TEve
+ * are involved. Events without displayable info are skipped.
+ * */
+class HitsDispatcher : public aux::iEventProcessor {
+private:
+    size_t _nDispatched,
+           _nSkipped;
+protected:
+    virtual bool _V_process_event( Event * ) override;
+    virtual void _V_print_brief_summary( std::ostream & ) const override;
+public:
+    HitsDispatcher() : aux::iEventProcessor( "alignment-hits" ),
+                       _nDispatched(0), _nSkipped(0) {}
+};  // class HitsDispatcher
+
+/**@class App
+ * @brief Headless alignment runner.
+ *
+ * Loads detector placements and tracking groups from experimental layout
+ * JSON, reads events from any registered input format (usual -i/-F
+ * options), accumulates track residuals within tracking groups (groups are
+ * reconstructed concurrently by alignment::TrackingScheduler) and, at the
+ * end, solves for placements corrections for every group of
+ * "linearAlignment" reconstruction method (see
+ * alignment::LinearAlignmentGroup). Corrections are printed and may be
+ * written into corrected copy of layout file.
+ * */
+class App : public sV::AnalysisApplication,
+            public sV::mixins::AlignmentApplication {
+private:
+    HitsDispatcher _hitsDispatcher;
+protected:
+    virtual std::vector<po::options_description> _V_get_options() const override;
+    virtual int _V_run() override;
+    /// Solves alignment of all appropriate tracking groups, prints the
+    /// results and returns shifts of aligned detectors.
+    Shifts _solve_alignment();
+public:
+    App( sV::po::variables_map * vmPtr ) :
+         AbstractApplication(vmPtr),
+         sV::AnalysisApplication(vmPtr),
+         sV::mixins::AlignmentApplication(vmPtr) {}
+    ~App(){}
+};  // class App
+
+}  // namespace sV
+
+# endif  // H_STROMA_V_ALIGNMENT_RUNNER_APPLICATION_H
+
@@ -0,0 +1,181 @@
+/*
+ * Copyright (c) 2016 Renat R. Dusaev <crank@qcrypt.org>
+ * Author: Renat R. Dusaev <crank@qcrypt.org>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+# include "align_app.hpp"
+# include "alignment/DetectorsSet.hpp"
+# include "alignment/LinearAlignment.hpp"
+
+# include <goo_exception.hpp>
+# include <goo_ansi_escseq.h>
+
+# include <algorithm>
+# include <cstdio>
+
+namespace sV {
+
+//
+// Hits dispatcher
+
+bool
+HitsDispatcher::_V_process_event( Event * uEvent ) {
+    if( !uEvent->has_displayableinfo() ) {
+        ++_nSkipped;
+        return true;
+    }
+    App & app = goo::app<App>();
+    app.detectors().reset_hits();
+    app.open_new_sets();
+    app.detectors().dispatch_hits( uEvent->displayableinfo(), false );
+    app.reconstruct_tracks();
+    ++_nDispatched;
+    return true;
+}
+
+void
+HitsDispatcher::_V_print_brief_summary( std::ostream & os ) const {
+    os << ESC_CLRGREEN "Alignment hits dispatcher" ESC_CLRCLEAR ":" << std::endl
+       << "  events dispatched ........ : " << _nDispatched << std::endl
+       << "  w/o displayable info ..... : " << _nSkipped << std::endl;
+}
+
+//
+// Application
+
+std::vector<po::options_description>
+App::_V_get_options() const {
+    std::vector<po::options_description> res = AnalysisApplication::_V_get_options();
+    po::options_description alignCfg( "Alignment" );
+    { alignCfg.add_options()
+        ("align.layout,L",
+            po::value<std::string>(),
+            "Experimental layout JSON file (detectors placements and "
+            "tracking groups).")
+        ("align.output",
+            po::value<std::string>()->default_value(""),
+            "When given, copy of layout file with corrected detectors "
+            "positions is written there.")
+        ;
+    } res.push_back(alignCfg);
+    return res;
+}
+
+App::Shifts
+App::_solve_alignment() {
+    Shifts shifts;
+    std::ostream & os = ls();
+    // Keep output order stable.
+    std::vector<std::string> groupNames;
+    for( auto it = tracking_groups().begin(); tracking_groups().end() != it; ++it ) {
+        groupNames.push_back( it->first );
+    }
+    std::sort( groupNames.begin(), groupNames.end() );
+    char bf[256];
+    for( const auto & groupName : groupNames ) {
+        auto groupPtr = dynamic_cast<alignment::LinearAlignmentGroup *>(
+                                    tracking_groups().at( groupName ) );
+        if( !groupPtr ) {
+            sV_log3( "Tracking group \"%s\" does not perform alignment "
+                     "(omitted).\n", groupName.c_str() );
+            continue;
+        }
+        auto corrections = groupPtr->solve();
+        os << ESC_CLRGREEN "Alignment of group \"" << groupName
+           << "\"" ESC_CLRCLEAR " (" << groupPtr->n_accepted() << " of "
+           << groupPtr->n_candidates() << " tracks accepted, "
+           << groupPtr->n_events() << " events):" << std::endl;
+        snprintf( bf, sizeof(bf), "  %-16s %10s %24s %24s %10s %10s",
+                  "detector", "hits", "dx", "dy", "<rx>", "<ry>" );
+        os << bf << std::endl;
+        for( const auto & corr : corrections ) {
+            const char * detName = corr.placement->detector_name();
+            if( corr.fixed ) {
+                snprintf( bf, sizeof(bf), "  %-16s %10zu %24s %24s %10.4g %10.4g",
+                          detName, corr.nHits, "(fixed)", "(fixed)",
+                          corr.meanResidual[0], corr.meanResidual[1] );
+            } else if( !corr.determined ) {
+                snprintf( bf, sizeof(bf), "  %-16s %10zu %24s %24s %10.4g %10.4g",
+                          detName, corr.nHits, "(undetermined)", "(undetermined)",
+                          corr.meanResidual[0], corr.meanResidual[1] );
+            } else {
+                snprintf( bf, sizeof(bf), "  %-16s %10zu %11.4g +/- %-8.2g %11.4g +/- %-8.2g %10.4g %10.4g",
+                          detName, corr.nHits,
+                          corr.shift[0], corr.error[0],
+                          corr.shift[1], corr.error[1],
+                          corr.meanResidual[0], corr.meanResidual[1] );
+            }
+            os << bf << std::endl;
+            if( corr.fixed || !corr.determined ) {
+                continue;
+            }
+            auto ir = shifts.emplace( detName,
+                        Shifts::mapped_type{{ corr.shift[0], corr.shift[1] }} );
+            if( !ir.second ) {
+                sV_logw( "Detector \"%s\" is aligned within more than one "
+                         "group; correction of group \"%s\" takes precedence.\n",
+                         detName, groupName.c_str() );
+                ir.first->second = Shifts::mapped_type{{ corr.shift[0], corr.shift[1] }};
+            }
+        }
+    }
+    return shifts;
+}
+
+int
+App::_V_run() {
+    if( do_immediate_exit() ) return EXIT_FAILURE;
+    if( !co().count("align.layout") ) {
+        sV_loge( "No experimental layout file given (--align.layout).\n" );
+        return EXIT_FAILURE;
+    }
+    const std::string layoutFilePath = cfg_option<std::string>("align.layout");
+    load_layout( layoutFilePath );
+    // Hits dispatching follows user processors (if any) as they may
+    // produce or select displayable info.
+    AnalysisPipeline::push_back_processor( &_hitsDispatcher );
+
+    AnalysisPipeline::iEventSequence * evseq
+        = dynamic_cast<AnalysisPipeline::iEventSequence*>(event_sequence());
+
+    int rc = this->AnalysisPipeline::process( evseq );
+
+    evseq->print_brief_summary( ls() );
+    for( auto it  = _processorsChain.begin();
+              it != _processorsChain.end(); ++it ) {
+        (**it).print_brief_summary( ls() );
+    }
+
+    Shifts shifts = _solve_alignment();
+    if( shifts.empty() ) {
+        sV_logw( "No detector was aligned. Make sure the layout has "
+                 "tracking groups of \"linearAlignment\" reconstruction "
+                 "method.\n" );
+    }
+    const std::string outputFilePath = cfg_option<std::string>("align.output");
+    if( !outputFilePath.empty() ) {
+        write_corrected_layout( layoutFilePath, outputFilePath, shifts );
+    }
+
+    return rc == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+}  // namespace sV
+
@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2016 Renat R. Dusaev <crank@qcrypt.org>
+ * Author: Renat R. Dusaev <crank@qcrypt.org>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+# ifndef H_STROMA_V_MULTICAST_BENCHMARK_APPLICATION_H
+# define H_STROMA_V_MULTICAST_BENCHMARK_APPLICATION_H
+
+# include "app/analysis.hpp"
+# include "mCastReceiver.hpp"
+
+# include <atomic>
+# include <chrono>
+# include <mutex>
+# include <vector>
+
+namespace sV {
+
+/**@class BenchReceiver
+ * @brief Multicast receiver collecting benchmark statistics.
+ *
+ * Expects events carrying blob with embedded sequence number and sending
+ * time stamp (see App::synthesize_event()). Collects end-to-end latencies
+ * and received sequence numbers to deduce the loss.
+ * */
+class BenchReceiver : public net::iMulticastEventReceiver {
+private:
+    std::mutex _statsMtx;
+    std::vector<double> _latenciesUSec;
+    std::vector<bool> _seen;
+    size_t _nReceived,
+           _nDuplicates,
+           _nMalformed;
+    std::atomic<bool> _stop;
+protected:
+    virtual bool _V_treat_event( const ::sV::events::Event & ) override;
+public:
+    BenchReceiver( boost::asio::io_service & ioService,
+                   const boost::asio::ip::address & listenAddress,
+                   const boost::asio::ip::address & multicastAddress,
+                   int portNo,
+                   size_t nExpected );
+    /// Stops renewing the subscription.
+    void stop() { _stop = true; }
+    /// Returns number of distinct events received.
+    size_t n_received();
+    /// Copies collected statistics.
+    void statistics( std::vector<double> & latenciesUSec,
+                     size_t & nDuplicates,
+                     size_t & nMalformed );
+};  // class BenchReceiver
+
+/**@class App
+ * @brief Loopback benchmark of multicasting stack.
+ *
+ * Drives the "multicast" processor (configured by usual multicast.*
+ * options) with synthetic events of given size and rate. Events are
+ * received back by BenchReceiver instance on the same host. Reports
+ * throughput, loss, sending queue drops and end-to-end latency percentiles.
+ * Payload content and sending schedule are determined by the options only,
+ * so results are reproducible on the same host.
+ * */
+class App : public sV::AnalysisApplication {
+public:
+    typedef AnalysisPipeline::Event Event;
+    typedef std::chrono::steady_clock Clock;
+protected:
+    virtual std::vector<po::options_description> _V_get_options() const override;
+    virtual int _V_run() override;
+public:
+    App( sV::po::variables_map * vmPtr ) :
+         AbstractApplication(vmPtr),
+         sV::AnalysisApplication(vmPtr) {}
+    ~App(){}
+
+    /// Fills event blob with sequence number, time stamp and padding up
+    /// to given size. Padding is generated once and reused.
+    static void synthesize_event( Event &, uint64_t seqNo,
+                                  const std::string & padding );
+    /// Extracts sequence number and time stamp from blob. Returns false on
+    /// malformed blob.
+    static bool parse_event( const ::sV::events::Event &,
+                             uint64_t & seqNo,
+                             Clock::time_point & sent );
+};  // class App
+
+}  // namespace sV
+
+# endif  // H_STROMA_V_MULTICAST_BENCHMARK_APPLICATION_H
@@ -0,0 +1,249 @@
+/*
+ * Copyright (c) 2016 Renat R. Dusaev <crank@qcrypt.org>
+ * Author: Renat R. Dusaev <crank@qcrypt.org>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+# include "mcbench_app.hpp"
+# include "analysis/processors/evMCast.hpp"
+
+# include <goo_exception.hpp>
+
+# include <algorithm>
+# include <cstring>
+# include <iomanip>
+# include <memory>
+# include <random>
+# include <thread>
+
+namespace sV {
+
+namespace {
+/// Blob header: sequence number and sending time (steady clock, nsec).
+const size_t gBlobHeaderLength = 2*sizeof(uint64_t);
+}  // anonymous namespace
+
+//
+// Receiver
+
+BenchReceiver::BenchReceiver( boost::asio::io_service & ioService,
+                              const boost::asio::ip::address & listenAddress,
+                              const boost::asio::ip::address & multicastAddress,
+                              int portNo,
+                              size_t nExpected ) :
+            net::iMulticastEventReceiver( ioService, listenAddress,
+                                          multicastAddress, portNo ),
+            _seen( nExpected, false ),
+            _nReceived(0), _nDuplicates(0), _nMalformed(0),
+            _stop(false) {
+    _latenciesUSec.reserve( nExpected );
+}
+
+bool
+BenchReceiver::_V_treat_event( const ::sV::events::Event & event ) {
+    auto now = App::Clock::now();
+    uint64_t seqNo;
+    App::Clock::time_point sent;
+    std::lock_guard<std::mutex> l(_statsMtx);
+    if( !App::parse_event( event, seqNo, sent ) || seqNo >= _seen.size() ) {
+        ++_nMalformed;
+    } else if( _seen[seqNo] ) {
+        ++_nDuplicates;
+    } else {
+        _seen[seqNo] = true;
+        ++_nReceived;
+        _latenciesUSec.push_back(
+            std::chrono::duration<double, std::micro>( now - sent ).count() );
+    }
+    return !_stop;
+}
+
+size_t
+BenchReceiver::n_received() {
+    std::lock_guard<std::mutex> l(_statsMtx);
+    return _nReceived;
+}
+
+void
+BenchReceiver::statistics( std::vector<double> & latenciesUSec,
+                           size_t & nDuplicates,
+                           size_t & nMalformed ) {
+    std::lock_guard<std::mutex> l(_statsMtx);
+    latenciesUSec = _latenciesUSec;
+    nDuplicates = _nDuplicates;
+    nMalformed = _nMalformed;
+}
+
+//
+// Application
+
+void
+App::synthesize_event( Event & event, uint64_t seqNo,
+                       const std::string & padding ) {
+    std::string * blob = event.mutable_blob();
+    blob->assign( padding );
+    uint64_t t = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        Clock::now().time_since_epoch() ).count();
+    memcpy( &((*blob)[0]), &seqNo, sizeof(uint64_t) );
+    memcpy( &((*blob)[sizeof(uint64_t)]), &t, sizeof(uint64_t) );
+}
+
+bool
+App::parse_event( const ::sV::events::Event & event,
+                  uint64_t & seqNo,
+                  Clock::time_point & sent ) {
+    if( ::sV::events::Event::kBlob != event.uevent_case()
+     || event.blob().size() < gBlobHeaderLength ) {
+        return false;
+    }
+    const std::string & blob = event.blob();
+    uint64_t t;
+    memcpy( &seqNo, blob.data(), sizeof(uint64_t) );
+    memcpy( &t, blob.data() + sizeof(uint64_t), sizeof(uint64_t) );
+    sent = Clock::time_point( std::chrono::duration_cast<Clock::duration>(
+                                            std::chrono::nanoseconds(t) ) );
+    return true;
+}
+
+std::vector<po::options_description>
+App::_V_get_options() const {
+    std::vector<po::options_description> res = AnalysisApplication::_V_get_options();
+    po::options_description benchCfg( "Multicast benchmark" );
+    { benchCfg.add_options()
+        ("bench.n-events",
+            po::value<size_t>()->default_value(100000),
+            "Number of synthetic events to send.")
+        ("bench.event-size",
+            po::value<size_t>()->default_value(1024),
+            "Size of synthetic event payload, bytes (at least 16).")
+        ("bench.rate",
+            po::value<double>()->default_value(0),
+            "Sending rate, events per second (zero means as fast as "
+            "possible).")
+        ("bench.seed",
+            po::value<unsigned int>()->default_value(1337),
+            "Seed for payload content generation.")
+        ("bench.listen-address",
+            po::value<std::string>()->default_value("0.0.0.0"),
+            "Address for receiver to listen at.")
+        ("bench.drain-time.ms",
+            po::value<size_t>()->default_value(1000),
+            "Time to wait for late events after sending finished.")
+        ;
+    } res.push_back(benchCfg);
+    return res;
+}
+
+int
+App::_V_run() {
+    if( do_immediate_exit() ) return EXIT_FAILURE;
+    const size_t nEvents = cfg_option<size_t>("bench.n-events"),
+                 eventSize = std::max( cfg_option<size_t>("bench.event-size"),
+                                       gBlobHeaderLength );
+    const double rate = cfg_option<double>("bench.rate");
+
+    // Payload padding is random (to not to favor compression) but
+    // reproducible.
+    std::string padding( eventSize, '\0' );
+    {
+        std::mt19937 gen( cfg_option<unsigned int>("bench.seed") );
+        std::uniform_int_distribution<int> dist( 0, 255 );
+        for( auto & c : padding ) {
+            c = (char) dist(gen);
+        }
+    }
+
+    // Receiver has to be subscribed before sending starts.
+    BenchReceiver receiver( *boost_io_service_ptr(),
+            boost::asio::ip::address::from_string(
+                            cfg_option<std::string>("bench.listen-address") ),
+            boost::asio::ip::address::from_string(
+                            cfg_option<std::string>("multicast.address") ),
+            cfg_option<int>("multicast.port"),
+            nEvents );
+    std::unique_ptr<aux::iEventProcessor> processor( find_processor( "multicast" )() );
+    dprocessors::EventMulticaster * mc
+                = dynamic_cast<dprocessors::EventMulticaster *>( processor.get() );
+    if( !mc ) {
+        emraise( badCast, "\"multicast\" processor is not an "
+                 "EventMulticaster instance." );
+    }
+
+    sV_log1( "Sending %zu events of %zu bytes at %s.\n", nEvents, eventSize,
+             rate > 0 ? (std::to_string(rate) + " events/sec").c_str()
+                      : "max rate" );
+    Event event;
+    const auto started = Clock::now();
+    for( size_t i = 0; i < nEvents; ++i ) {
+        if( rate > 0 ) {
+            // Absolute schedule: no drift accumulation.
+            std::this_thread::sleep_until( started
+                    + std::chrono::duration_cast<Clock::duration>(
+                        std::chrono::duration<double>( i/rate ) ) );
+        }
+        synthesize_event( event, i, padding );
+        mc->process_event( &event );
+    }
+    const auto sendingDone = Clock::now();
+
+    // Wait for stragglers.
+    const auto drainDeadline = sendingDone
+            + std::chrono::milliseconds( cfg_option<size_t>("bench.drain-time.ms") );
+    while( receiver.n_received() < nEvents && Clock::now() < drainDeadline ) {
+        std::this_thread::sleep_for( std::chrono::milliseconds(1) );
+    }
+    receiver.stop();
+    // Sender's thread keeps running the I/O service; stop it so no handler
+    // will refer to receiver once it goes out of scope.
+    boost_io_service_ptr()->stop();
+
+    std::vector<double> lat;
+    size_t nDuplicates, nMalformed;
+    receiver.statistics( lat, nDuplicates, nMalformed );
+    const size_t nReceived = lat.size();
+    const double sendingTime = std::chrono::duration<double>( sendingDone - started ).count();
+
+    std::ostream & os = ls();
+    os << std::fixed << std::setprecision(3)
+       << "Multicast loopback benchmark:" << std::endl
+       << "  events sent ................ : " << nEvents << std::endl
+       << "  events received ............ : " << nReceived << std::endl
+       << "  events lost ................ : " << nEvents - nReceived
+            << " (" << 100.*(nEvents - nReceived)/(nEvents ? nEvents : 1) << "%)" << std::endl
+       << "  sending queue drops ........ : " << mc->n_dropped() << std::endl
+       << "  duplicates/malformed ....... : " << nDuplicates << "/" << nMalformed << std::endl
+       << "  sending time, sec .......... : " << sendingTime << std::endl
+       << "  throughput, events/sec ..... : " << nReceived/sendingTime << std::endl
+       << "  throughput, MB/sec ......... : " << nReceived*eventSize/sendingTime/(1024*1024) << std::endl;
+    if( !lat.empty() ) {
+        std::sort( lat.begin(), lat.end() );
+        auto pct = [&lat]( double p ) {
+            return lat[ std::min( lat.size() - 1, (size_t) (p*lat.size()) ) ]; };
+        os << "  latency, usec: min ......... : " << lat.front() << std::endl
+           << "                 p50 ......... : " << pct(.5) << std::endl
+           << "                 p90 ......... : " << pct(.9) << std::endl
+           << "                 p99 ......... : " << pct(.99) << std::endl
+           << "                 p99.9 ....... : " << pct(.999) << std::endl
+           << "                 max ......... : " << lat.back() << std::endl;
+    }
+    mc->print_brief_summary( os );
+    return nReceived ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+}  // namespace sV
@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) 2016 Renat R. Dusaev <crank@qcrypt.org>
+ * Author: Renat R. Dusaev <crank@qcrypt.org>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+# include "sV_config.h"
+
+# ifdef ALIGNMENT_ROUTINES
+
+# define BOOST_TEST_NO_MAIN
+# include <boost/test/unit_test.hpp>
+
+# include "alignment/TrackingVolume.tcc"
+
+# include <deque>
+# include <random>
+
+namespace sV {
+namespace alignTest1 {
+
+typedef alignment::TrackReceptiveVolume<2> Volume;
+typedef Volume::LocalCoordinates Point;
+typedef std::deque< std::vector<Point> > Reference;
+
+// Removal updater counting points of evicted sets and their checksum.
+struct RemovalLog {
+    size_t nRemoved;
+    double sum;
+};
+
+static bool
+count_removed( alignment::AbstractTrackReceptiveVolume *, void * pPtr, void * logPtr ) {
+    const Point & p = *static_cast<const Point *>(pPtr);
+    RemovalLog & log = *static_cast<RemovalLog *>(logPtr);
+    ++log.nRemoved;
+    log.sum += p.amplitude;
+    return true;
+}
+
+// Checks that volume keeps the same sets as reference (front is the most
+// recent one).
+static void
+compare( const Volume & v, const Reference & ref ) {
+    auto sets = v.sets();
+    BOOST_REQUIRE( ref.size() == sets.size() );
+    size_t k = 0;
+    for( auto it = sets.begin(); it != sets.end(); ++it, ++k ) {
+        const std::vector<Point> & rs = ref[k];
+        const Volume::PointSet ps = *it;
+        BOOST_REQUIRE( rs.size() == ps.size() );
+        auto amps = ps.amplitudes();
+        auto xs = ps.coordinates(0),
+             ys = ps.coordinates(1);
+        for( size_t i = 0; i < rs.size(); ++i ) {
+            BOOST_REQUIRE( rs[i].amplitude == amps[i] );
+            BOOST_REQUIRE( rs[i].r[0] == xs[i] );
+            BOOST_REQUIRE( rs[i].r[1] == ys[i] );
+        }
+        // Iteration yields the most recent point first.
+        size_t i = rs.size();
+        for( const auto & p : ps ) {
+            BOOST_REQUIRE( i );
+            --i;
+            BOOST_REQUIRE( rs[i].amplitude == p.amplitude );
+        }
+        BOOST_REQUIRE( !i );
+    }
+    if( !ref.empty() ) {
+        BOOST_REQUIRE( ref.front().size() == v.most_recent_set().size() );
+        BOOST_REQUIRE( ref.front().empty() == v.most_recent_set_is_empty() );
+    }
+}
+
+}  // namespace alignTest1
+}  // namespace sV
+
+BOOST_AUTO_TEST_SUITE( Alignment_suite )
+
+// Random sequences of sets opening, points insertion and ring resizing are
+// applied to both the volume and reference deque of sets. Small initial
+// storage makes volume to wrap, grow and compact its storage often.
+BOOST_AUTO_TEST_CASE( TrackReceptiveVolume_vs_deque ) {
+    using namespace sV::alignTest1;
+    std::mt19937 gen(1337);
+    for( size_t nRun = 0; nRun < 20; ++nRun ) {
+        size_t nSets = 1 + gen()%8;
+        Volume v( 16, nSets );
+        Reference ref;
+        RemovalLog log{ 0, 0. },
+                   refLog{ 0, 0. },
+                   detachedLog{ 0, 0. };
+        v.add_updater_on_remove( count_removed, &log );
+        // Removed updater must not be notified.
+        v.add_updater_on_remove( count_removed, &detachedLog );
+        v.remove_updater_on_remove( count_removed, &detachedLog );
+        auto forget = [&]() {
+            for( const auto & p : ref.back() ) {
+                ++refLog.nRemoved;
+                refLog.sum += p.amplitude;
+            }
+            ref.pop_back();
+        };
+        const size_t initialCapacity = v.points_capacity();
+        float counter = 0;
+        for( size_t nOp = 0; nOp < 2000; ++nOp ) {
+            const unsigned r = gen()%100;
+            if( r < 20 ) {
+                v.open_new_set();
+                if( ref.size() == nSets ) {
+                    forget();
+                }
+                ref.push_front( std::vector<Point>() );
+            } else if( r < 97 ) {
+                // Occasional large sets enforce storage growth.
+                const size_t n = (r < 22) ? 1 + gen()%40 : 1;
+                for( size_t i = 0; i < n; ++i ) {
+                    Point p{ ++counter, { float(gen()%1000), -counter } };
+                    if( ref.empty() ) {
+                        ref.push_front( std::vector<Point>() );
+                    }
+                    const Point * pPtr = v.update_point( p );
+                    BOOST_REQUIRE( pPtr->amplitude == p.amplitude );
+                    ref.front().push_back( p );
+                }
+            } else {
+                nSets = 1 + gen()%8;
+                v.n_sets( nSets );
+                while( ref.size() > nSets ) {
+                    forget();
+                }
+                BOOST_REQUIRE( nSets == v.n_sets() );
+            }
+            compare( v, ref );
+            BOOST_REQUIRE( refLog.nRemoved == log.nRemoved );
+            BOOST_REQUIRE( refLog.sum == log.sum );
+        }
+        BOOST_CHECK( v.points_capacity() > initialCapacity );
+        BOOST_CHECK( !detachedLog.nRemoved );
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+# endif  // ALIGNMENT_ROUTINES
@@ -0,0 +1,189 @@
+/*
+ * Copyright (c) 2016 Renat R. Dusaev <crank@qcrypt.org>
+ * Author: Renat R. Dusaev <crank@qcrypt.org>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+# include "sV_config.h"
+
+# ifdef ALIGNMENT_ROUTINES
+
+# define BOOST_TEST_NO_MAIN
+# include <boost/test/unit_test.hpp>
+
+# include "alignment/TrackingGroup.hpp"
+# include "alignment/TrackingScheduler.hpp"
+
+# include <goo_exception.hpp>
+
+# include <mutex>
+# include <vector>
+# include <string>
+
+namespace sV {
+namespace alignTest2 {
+
+// Shared log of reconstructed groups (in order of completion).
+struct ExecutionLog {
+    std::mutex mtx;
+    std::vector<const alignment::TrackingGroup *> order;
+
+    size_t position( const alignment::TrackingGroup * g ) const {
+        for( size_t i = 0; i < order.size(); ++i ) {
+            if( order[i] == g ) return i;
+        }
+        return order.size();
+    }
+    bool has( const alignment::TrackingGroup * g ) const {
+        return position( g ) != order.size();
+    }
+};
+
+// Tracking group stub recording its reconstruction and, optionally,
+// failing.
+class RecordingGroup : public alignment::TrackingGroup {
+protected:
+    ExecutionLog & _log;
+    virtual void _V_reconstruct_event() override {
+        if( fail ) {
+            emraise( badState, "Reconstruction of \"%s\" failed on purpose.",
+                     name() );
+        }
+        std::lock_guard<std::mutex> l( _log.mtx );
+        _log.order.push_back( this );
+    }
+public:
+    bool fail;
+    RecordingGroup( const std::string & name_, ExecutionLog & log_ ) :
+            TrackingGroup( name_ ), _log( log_ ), fail( false ) {}
+};
+
+}  // namespace alignTest2
+}  // namespace sV
+
+BOOST_AUTO_TEST_SUITE( Alignment_suite )
+
+BOOST_AUTO_TEST_CASE( TrackingScheduler_ordering ) {
+    using namespace sV;
+    using alignTest2::RecordingGroup;
+    // Diamond-shaped graph with independent tail:
+    //      a   b   e
+    //       \ /
+    //        c
+    //        |
+    //        d
+    for( size_t nWorkers : {0, 1, 3} ) {
+        alignTest2::ExecutionLog log;
+        RecordingGroup a("a", log), b("b", log), c("c", log),
+                       d("d", log), e("e", log);
+        alignment::TrackingScheduler sch( nWorkers );
+        for( auto g : {&a, &b, &c, &d, &e} ) {
+            sch.add_group( g );
+        }
+        BOOST_REQUIRE( 5 == sch.n_groups() );
+        BOOST_REQUIRE( nWorkers == sch.n_workers() );
+        sch.add_dependency( &c, &a );
+        sch.add_dependency( &c, &b );
+        sch.add_dependency( &d, &c );
+        for( int nEvent = 0; nEvent < 200; ++nEvent ) {
+            log.order.clear();
+            sch.reconstruct_event();
+            BOOST_REQUIRE( 5 == log.order.size() );
+            BOOST_REQUIRE( log.position(&a) < log.position(&c) );
+            BOOST_REQUIRE( log.position(&b) < log.position(&c) );
+            BOOST_REQUIRE( log.position(&c) < log.position(&d) );
+            BOOST_REQUIRE( log.has(&e) );
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE( TrackingScheduler_cycle_rejection ) {
+    using namespace sV;
+    using alignTest2::RecordingGroup;
+    alignTest2::ExecutionLog log;
+    RecordingGroup a("a", log), b("b", log), c("c", log), u("u", log);
+    alignment::TrackingScheduler sch( 2 );
+    for( auto g : {&a, &b, &c} ) {
+        sch.add_group( g );
+    }
+    // Repeatative insertion and unknown groups are rejected.
+    BOOST_CHECK_THROW( sch.add_group( &a ), goo::Exception );
+    BOOST_CHECK_THROW( sch.add_dependency( &u, &a ), goo::Exception );
+    BOOST_CHECK_THROW( sch.add_dependency( &a, &u ), goo::Exception );
+
+    sch.add_dependency( &b, &a );
+    sch.add_dependency( &c, &b );
+    // Self-dependency and closing loops.
+    BOOST_CHECK_THROW( sch.add_dependency( &a, &a ), goo::Exception );
+    BOOST_CHECK_THROW( sch.add_dependency( &a, &b ), goo::Exception );
+    BOOST_CHECK_THROW( sch.add_dependency( &a, &c ), goo::Exception );
+    // Rejected dependencies must not stay in graph: otherwise, the groups
+    // would never be released.
+    for( int nEvent = 0; nEvent < 10; ++nEvent ) {
+        log.order.clear();
+        sch.reconstruct_event();
+        BOOST_REQUIRE( 3 == log.order.size() );
+        BOOST_REQUIRE( log.position(&a) < log.position(&b) );
+        BOOST_REQUIRE( log.position(&b) < log.position(&c) );
+    }
+}
+
+BOOST_AUTO_TEST_CASE( TrackingScheduler_exception_cancellation ) {
+    using namespace sV;
+    using alignTest2::RecordingGroup;
+    for( size_t nWorkers : {0, 2} ) {
+        alignTest2::ExecutionLog log;
+        //  a -> b -> c,  a -> d,  e (independent)
+        RecordingGroup a("a", log), b("b", log), c("c", log),
+                       d("d", log), e("e", log);
+        alignment::TrackingScheduler sch( nWorkers );
+        for( auto g : {&a, &b, &c, &d, &e} ) {
+            sch.add_group( g );
+        }
+        sch.add_dependency( &b, &a );
+        sch.add_dependency( &c, &b );
+        sch.add_dependency( &d, &a );
+
+        // Failure of a cancels its whole dependent subgraph, while the
+        // independent group is still reconstructed.
+        a.fail = true;
+        BOOST_CHECK_THROW( sch.reconstruct_event(), goo::Exception );
+        BOOST_CHECK( 1 == log.order.size() );
+        BOOST_CHECK( log.has(&e) );
+
+        // Failure in the middle of chain.
+        a.fail = false;
+        b.fail = true;
+        log.order.clear();
+        BOOST_CHECK_THROW( sch.reconstruct_event(), goo::Exception );
+        BOOST_CHECK( 3 == log.order.size() );
+        BOOST_CHECK( log.has(&a) && log.has(&d) && log.has(&e) );
+        BOOST_CHECK( !log.has(&c) );
+
+        // Scheduler recovers on next event.
+        b.fail = false;
+        log.order.clear();
+        sch.reconstruct_event();
+        BOOST_CHECK( 5 == log.order.size() );
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+# endif  // ALIGNMENT_ROUTINES
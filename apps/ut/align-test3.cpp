@@ -0,0 +1,241 @@
+/*
+ * Copyright (c) 2016 Renat R. Dusaev <crank@qcrypt.org>
+ * Author: Renat R. Dusaev <crank@qcrypt.org>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+# include "sV_config.h"
+
+# ifdef ALIGNMENT_ROUTINES
+
+# define BOOST_TEST_NO_MAIN
+# include <boost/test/unit_test.hpp>
+
+# include "alignment/TrackFitter.hpp"
+
+# include <cmath>
+# include <random>
+
+namespace sV {
+namespace alignTest3 {
+
+typedef alignment::LinearTrackFitter Fitter;
+
+// Adds candidate of n hits lying on polynomial track (coefficients are
+// given w.r.t. z = 0), with optional Gaussian smearing.
+template<typename RngT> static void
+add_candidate( Fitter::HitsBatch & b, size_t n,
+               const double * px, const double * py, unsigned np,
+               float sigma, RngT * rng ) {
+    std::normal_distribution<double> smear( 0, sigma );
+    for( size_t i = 0; i < n; ++i ) {
+        const double z = 10.*i - 3.;
+        double x = 0, y = 0, zk = 1;
+        for( unsigned k = 0; k < np; ++k, zk *= z ) {
+            x += px[k]*zk;
+            y += py[k]*zk;
+        }
+        if( rng ) {
+            x += smear(*rng);
+            y += smear(*rng);
+        }
+        b.add_hit( x, y, z, 1./(sigma*sigma), 1./(sigma*sigma), i );
+    }
+    b.close_candidate();
+}
+
+// Evaluates fitted polynomial of candidate projection at given z.
+static double
+evaluate( const Fitter::Results & r, size_t c, uint8_t proj, double z ) {
+    const float * p = r.parameters_of( c, proj );
+    const double dz = z - r.zRef[c];
+    double f = 0, dzk = 1;
+    for( uint8_t k = 0; k < r.nParameters; ++k, dzk *= dz ) {
+        f += p[k]*dzk;
+    }
+    return f;
+}
+
+}  // namespace alignTest3
+}  // namespace sV
+
+BOOST_AUTO_TEST_SUITE( Alignment_suite )
+
+BOOST_AUTO_TEST_CASE( TrackFitter_exact_tracks ) {
+    using namespace sV::alignTest3;
+    const double lx[] = { 1.5, 0.25 },
+                 ly[] = { -2., -0.1 },
+                 qx[] = { 0.5, -0.2, 3e-3 },
+                 qy[] = { 4., 0.1, -2e-3 };
+    // Numbers of hits below and above the lanes number, to cover both
+    // vectorized and remainder loops.
+    for( size_t n : {5, 8, 13} ) {
+        Fitter::HitsBatch b;
+        std::mt19937 * noRng = nullptr;
+        add_candidate( b, n, lx, ly, 2, 0.1, noRng );
+        add_candidate( b, n, qx, qy, 3, 0.1, noRng );
+        BOOST_REQUIRE( 2 == b.n_candidates() );
+        BOOST_REQUIRE( 2*n == b.n_hits() );
+
+        Fitter::Results r;
+        Fitter( Fitter::straight ).fit( b, r );
+        BOOST_REQUIRE( 2 == r.nParameters );
+        BOOST_REQUIRE( r.valid[0] && r.valid[1] );
+        // Straight line is reproduced exactly.
+        BOOST_CHECK( r.chi2[0] < 1e-3 );
+        BOOST_CHECK( 2*(n - 2) == r.ndf[0] );
+        BOOST_CHECK_CLOSE( r.parameters_of(0, 0)[1], lx[1], 1e-3 );
+        BOOST_CHECK_CLOSE( r.parameters_of(0, 1)[1], ly[1], 1e-3 );
+        for( size_t i = 0; i < n; ++i ) {
+            BOOST_CHECK( std::fabs( r.residuals[2*i] ) < 1e-3 );
+            BOOST_CHECK( std::fabs( r.residuals[2*i + 1] ) < 1e-3 );
+        }
+        BOOST_CHECK_SMALL( evaluate( r, 0, 0, 0. ) - lx[0], 1e-3 );
+        BOOST_CHECK_SMALL( evaluate( r, 0, 1, 0. ) - ly[0], 1e-3 );
+        // ...while parabola is not.
+        BOOST_CHECK( r.chi2[1] > 100. );
+
+        Fitter( Fitter::parabolic ).fit( b, r );
+        BOOST_REQUIRE( 3 == r.nParameters );
+        BOOST_REQUIRE( r.valid[0] && r.valid[1] );
+        BOOST_CHECK( 2*(n - 3) == r.ndf[1] );
+        for( size_t c = 0; c < 2; ++c ) {
+            BOOST_CHECK( r.chi2[c] < 1e-2 );
+        }
+        // Curvature does not depend on reference point.
+        BOOST_CHECK_SMALL( r.parameters_of(0, 0)[2], 1e-5f );
+        BOOST_CHECK_CLOSE( r.parameters_of(1, 0)[2], qx[2], 1e-2 );
+        BOOST_CHECK_CLOSE( r.parameters_of(1, 1)[2], qy[2], 1e-2 );
+        for( double z : {-3., 20., 57.} ) {
+            BOOST_CHECK_SMALL( evaluate( r, 1, 0, z )
+                             - (qx[0] + qx[1]*z + qx[2]*z*z), 1e-3 );
+            BOOST_CHECK_SMALL( evaluate( r, 1, 1, z )
+                             - (qy[0] + qy[1]*z + qy[2]*z*z), 1e-3 );
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE( TrackFitter_chi2_distribution ) {
+    using namespace sV::alignTest3;
+    // For Gaussian errors with correctly given weights, chi^2 has to follow
+    // the chi^2 distribution with ndf degrees of freedom and parameters'
+    // pulls have to be of unit variance.
+    const size_t nCandidates = 20000,
+                 nHits = 10;
+    const float sigma = 0.05;
+    const double px[] = { 1., 0.02, 1e-4 },
+                 py[] = { -1., -0.03, 5e-5 };
+    std::mt19937 rng( 1337 );
+    for( Fitter::Model m : {Fitter::straight, Fitter::parabolic} ) {
+        const unsigned np = m;
+        Fitter::HitsBatch b;
+        for( size_t c = 0; c < nCandidates; ++c ) {
+            add_candidate( b, nHits, px, py, np, sigma, &rng );
+        }
+        Fitter::Results r;
+        Fitter( m ).fit( b, r );
+        const unsigned ndf = 2*(nHits - np);
+        double sumChi2 = 0, sumChi2Sq = 0,
+               sumPull = 0, sumPullSq = 0;
+        for( size_t c = 0; c < nCandidates; ++c ) {
+            BOOST_REQUIRE( r.valid[c] );
+            BOOST_REQUIRE( ndf == r.ndf[c] );
+            sumChi2 += r.chi2[c];
+            sumChi2Sq += r.chi2[c]*r.chi2[c];
+            // Pull of slope at reference point.
+            const double zRef = r.zRef[c],
+                         slope = px[1] + (3 == np ? 2*px[2]*zRef : 0.),
+                         err = std::sqrt( r.covariance_of(c, 0)[1*np + 1] ),
+                         pull = (r.parameters_of(c, 0)[1] - slope)/err;
+            sumPull += pull;
+            sumPullSq += pull*pull;
+        }
+        const double meanChi2 = sumChi2/nCandidates,
+                     varChi2 = sumChi2Sq/nCandidates - meanChi2*meanChi2,
+                     meanPull = sumPull/nCandidates,
+                     varPull = sumPullSq/nCandidates - meanPull*meanPull;
+        // Expected: mean = ndf, variance = 2*ndf, with statistical
+        // tolerance of few standard errors.
+        BOOST_CHECK_CLOSE( meanChi2, ndf, 3. );
+        BOOST_CHECK_CLOSE( varChi2, 2.*ndf, 10. );
+        BOOST_CHECK_SMALL( meanPull, 0.05 );
+        BOOST_CHECK_CLOSE( varPull, 1., 5. );
+    }
+}
+
+BOOST_AUTO_TEST_CASE( TrackFitter_invalid_candidates ) {
+    using namespace sV::alignTest3;
+    const double lx[] = { 1., 0.5 },
+                 ly[] = { 2., -0.5 };
+    std::mt19937 * noRng = nullptr;
+    Fitter::HitsBatch b;
+    // #0: single hit (too few for any model).
+    add_candidate( b, 1, lx, ly, 2, 1., noRng );
+    // #1: two hits (enough for straight line only).
+    add_candidate( b, 2, lx, ly, 2, 1., noRng );
+    // #2: degenerate -- all hits at the same z.
+    for( int i = 0; i < 6; ++i ) {
+        b.add_hit( i, -i, 5., 1., 1. );
+    }
+    b.close_candidate();
+    // #3: empty candidate.
+    b.close_candidate();
+    // #4: zero weights make system degenerate as well.
+    for( int i = 0; i < 6; ++i ) {
+        b.add_hit( i, -i, i, 0., 0. );
+    }
+    b.close_candidate();
+    // #5: regular one, must not be affected by its neighbours.
+    add_candidate( b, 6, lx, ly, 2, 1., noRng );
+    BOOST_REQUIRE( 6 == b.n_candidates() );
+
+    Fitter::Results r;
+    Fitter( Fitter::straight ).fit( b, r );
+    BOOST_CHECK( !r.valid[0] );
+    BOOST_CHECK( r.valid[1] );
+    BOOST_CHECK( 0 == r.ndf[1] );
+    BOOST_CHECK( !r.valid[2] );
+    BOOST_CHECK( !r.valid[3] );
+    BOOST_CHECK( !r.valid[4] );
+    BOOST_CHECK( r.valid[5] );
+    for( size_t c : {0, 2, 3, 4} ) {
+        BOOST_CHECK( std::isnan( r.chi2[c] ) );
+        BOOST_CHECK( 0 == r.ndf[c] );
+        BOOST_CHECK( std::isnan( r.parameters_of(c, 0)[0] ) );
+    }
+    BOOST_CHECK( r.chi2[5] < 1e-6 );
+
+    Fitter( Fitter::parabolic ).fit( b, r );
+    BOOST_CHECK( !r.valid[0] );
+    BOOST_CHECK( !r.valid[1] );
+    BOOST_CHECK( !r.valid[2] );
+    BOOST_CHECK( r.valid[5] );
+    BOOST_CHECK( 6 == r.ndf[5] );
+
+    // Empty batch.
+    b.clear();
+    BOOST_CHECK( 0 == b.n_candidates() );
+    Fitter( Fitter::straight ).fit( b, r );
+    BOOST_CHECK( r.valid.empty() );
+    BOOST_CHECK( r.residuals.empty() );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+# endif  // ALIGNMENT_ROUTINES
@@ -0,0 +1,320 @@
+/*
+ * Copyright (c) 2016 Renat R. Dusaev <crank@qcrypt.org>
+ * Author: Renat R. Dusaev <crank@qcrypt.org>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+# include "sV_config.h"
+
+# ifdef ALIGNMENT_ROUTINES
+
+# define BOOST_TEST_NO_MAIN
+# include <boost/test/unit_test.hpp>
+
+# include "alignment/LinearAlignment.hpp"
+# include "app/mixins/alignment.hpp"
+
+# include <boost/property_tree/ptree.hpp>
+# include <boost/property_tree/json_parser.hpp>
+
+# include <cmath>
+# include <cstdio>
+# include <cstring>
+# include <fstream>
+# include <memory>
+# include <random>
+# include <sstream>
+# include <vector>
+# include <unistd.h>
+
+namespace sV {
+namespace alignTest4 {
+
+typedef alignment::TrackReceptiveVolume<2> Volume;
+typedef alignment::DetectorPlacement Placement;
+typedef alignment::LinearAlignmentGroup::PTree PTree;
+
+// Alignment group with members included by placements not bound to
+// constructed detectors (TrackingGroup::include() requires ones).
+class TestAlignmentGroup : public alignment::LinearAlignmentGroup {
+public:
+    TestAlignmentGroup( const PTree & pt ) :
+            alignment::LinearAlignmentGroup( "test", pt ) {}
+    void add_member( const Volume * v, const Placement * pl ) {
+        _volumes.push_back( v );
+        _pl2vol.emplace( pl, v );
+        _vol2pl.emplace( v, pl );
+    }
+};
+
+// Set of parallel planes placed along z at nominal positions, while the
+// true ones are transversally shifted.
+struct Telescope {
+    static constexpr size_t nPlanes = 6;
+    static constexpr float sigma = 0.1,
+                           halfSize = 100.;
+    std::unique_ptr<Volume> volumes[nPlanes];
+    std::unique_ptr<Placement> placements[nPlanes];
+    double trueShift[nPlanes][2];
+
+    Telescope( std::mt19937 & rng ) {
+        std::uniform_real_distribution<double> shiftDst( -1., 1. );
+        const float mins[2] = { -halfSize, -halfSize },
+                    maxs[2] = {  halfSize,  halfSize };
+        char bf[32];
+        for( size_t k = 0; k < nPlanes; ++k ) {
+            snprintf( bf, sizeof(bf), "PL%02zu", k );
+            placements[k].reset( new Placement( "plane", bf ) );
+            Placement::Position pos;
+            pos.r[0] = pos.r[1] = 0.;
+            pos.r[2] = 100.*k + 15.*k*k;
+            placements[k]->position( pos );
+            volumes[k].reset( new Volume( 64, 1 ) );
+            volumes[k]->set_ranges( mins, maxs );
+            // First two planes are the reference ones (fixed by default).
+            for( uint8_t proj = 0; proj < 2; ++proj ) {
+                trueShift[k][proj] = k < 2 ? 0. : shiftDst(rng);
+            }
+        }
+    }
+
+    // Registers measured (local) point at plane.
+    void hit( size_t k, float x, float y ) {
+        Volume::LocalCoordinates lc;
+        lc.amplitude = 1.;
+        lc.r[0] = x;
+        lc.r[1] = y;
+        volumes[k]->norm( lc.r );
+        volumes[k]->update_point( lc );
+    }
+
+    // Simulates straight track crossing all the planes, with efficiency
+    // and noise hits (the latter produce fake candidates). Noise hit comes
+    // only along with the true one, so each event has a true candidate.
+    void event( std::mt19937 & rng ) {
+        std::uniform_real_distribution<double> uni( 0., 1. ),
+                                               offset( -20., 20. ),
+                                               slope( -0.02, 0.02 ),
+                                               noise( -halfSize, halfSize );
+        std::normal_distribution<double> smear( 0., sigma );
+        const double x0 = offset(rng), tx = slope(rng),
+                     y0 = offset(rng), ty = slope(rng);
+        for( size_t k = 0; k < nPlanes; ++k ) {
+            volumes[k]->open_new_set();
+            const double z = placements[k]->position().r[2];
+            if( uni(rng) > 0.9 ) {
+                continue;
+            }
+            hit( k, x0 + tx*z - trueShift[k][0] + smear(rng),
+                    y0 + ty*z - trueShift[k][1] + smear(rng) );
+            if( uni(rng) < 0.2 ) {
+                hit( k, noise(rng), noise(rng) );
+            }
+        }
+    }
+};
+
+constexpr size_t Telescope::nPlanes;
+constexpr float Telescope::sigma;
+constexpr float Telescope::halfSize;
+
+}  // namespace alignTest4
+}  // namespace sV
+
+BOOST_AUTO_TEST_SUITE( Alignment_suite )
+
+BOOST_AUTO_TEST_CASE( LinearAlignment_stale_sets ) {
+    using namespace sV::alignTest4;
+    std::mt19937 rng( 42 );
+    Telescope t( rng );
+    PTree pt;
+    TestAlignmentGroup g( pt );
+    for( size_t k = 0; k < Telescope::nPlanes; ++k ) {
+        g.add_member( t.volumes[k].get(), t.placements[k].get() );
+    }
+    sV::alignment::LinearTrackFitter::HitsBatch b;
+    // First event hits all the planes.
+    for( size_t k = 0; k < Telescope::nPlanes; ++k ) {
+        t.volumes[k]->open_new_set();
+        t.hit( k, 1., 2. );
+    }
+    BOOST_REQUIRE( 1 == sV::alignment::LinearTrackFitter
+                                ::add_group_combinations( g, b, 1. ) );
+    BOOST_REQUIRE( Telescope::nPlanes == b.n_hits() );
+    for( size_t k = 0; k < Telescope::nPlanes; ++k ) {
+        BOOST_CHECK_CLOSE( b.x[k], 1., 1e-3 );
+        BOOST_CHECK_CLOSE( b.y[k], 2., 1e-3 );
+        BOOST_CHECK_CLOSE( b.z[k], t.placements[k]->position().r[2], 1e-3 );
+    }
+    // Second event hits only even planes: odd ones must not provide the
+    // points of previous event.
+    b.clear();
+    for( size_t k = 0; k < Telescope::nPlanes; ++k ) {
+        t.volumes[k]->open_new_set();
+        if( !(k%2) ) {
+            t.hit( k, -1., -2. );
+        }
+    }
+    BOOST_REQUIRE( 1 == sV::alignment::LinearTrackFitter
+                                ::add_group_combinations( g, b, 1. ) );
+    BOOST_REQUIRE( Telescope::nPlanes/2 == b.n_hits() );
+    for( size_t i = 0; i < b.n_hits(); ++i ) {
+        BOOST_CHECK( !(b.sources[i]%2) );
+        BOOST_CHECK_CLOSE( b.x[i], -1., 1e-3 );
+    }
+    // No hits at all.
+    b.clear();
+    for( size_t k = 0; k < Telescope::nPlanes; ++k ) {
+        t.volumes[k]->open_new_set();
+    }
+    BOOST_CHECK( 0 == sV::alignment::LinearTrackFitter
+                                ::add_group_combinations( g, b, 1. ) );
+}
+
+BOOST_AUTO_TEST_CASE( LinearAlignment_recovers_shifts ) {
+    using namespace sV::alignTest4;
+    const size_t nEvents = 20000;
+    for( const char * selection : {"best", "all"} ) {
+        std::mt19937 rng( 1337 );
+        Telescope t( rng );
+        PTree pt;
+        pt.put( "resolution", Telescope::sigma );
+        pt.put( "batchSize", 1000 );
+        pt.put( "candidates", selection );
+        const bool bestOnly = !strcmp( "best", selection );
+        if( !bestOnly ) {
+            // Fakes have to be rejected by chi^2 cut then. It is loose as
+            // the true candidates are biased by misalignment yet.
+            pt.put( "maxChi2NDF", 1e3 );
+        }
+        TestAlignmentGroup g( pt );
+        for( size_t k = 0; k < Telescope::nPlanes; ++k ) {
+            g.add_member( t.volumes[k].get(), t.placements[k].get() );
+        }
+        for( size_t n = 0; n < nEvents; ++n ) {
+            t.event( rng );
+            g.reconstruct_event();
+        }
+        auto corrections = g.solve();
+        BOOST_CHECK( nEvents == g.n_events() );
+        BOOST_CHECK( g.n_candidates() > nEvents );
+        BOOST_CHECK( g.n_accepted() < g.n_candidates() );
+        if( bestOnly ) {
+            BOOST_CHECK( g.n_accepted() <= nEvents );
+        }
+        BOOST_CHECK( g.n_accepted() > nEvents/2 );
+        BOOST_REQUIRE( Telescope::nPlanes == corrections.size() );
+        for( size_t k = 0; k < Telescope::nPlanes; ++k ) {
+            const auto & corr = corrections[k];
+            BOOST_CHECK( t.placements[k].get() == corr.placement );
+            BOOST_CHECK( corr.nHits > nEvents/2 );
+            BOOST_REQUIRE( corr.determined );
+            BOOST_CHECK( (k < 2) == corr.fixed );
+            for( uint8_t proj = 0; proj < 2; ++proj ) {
+                if( corr.fixed ) {
+                    BOOST_CHECK( 0. == corr.shift[proj] );
+                    continue;
+                }
+                // Shifts are recovered within reported errors, which are
+                // of expected magnitude. Few fakes passing the loose cut
+                // bias the "all" selection, so it is checked coarser.
+                BOOST_CHECK( corr.error[proj] > 0.
+                          && corr.error[proj] < Telescope::sigma/10 );
+                BOOST_CHECK( std::fabs( corr.shift[proj]
+                                      - t.trueShift[k][proj] )
+                                < ( bestOnly ? 4*corr.error[proj]
+                                             : Telescope::sigma/2 ) );
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE( LinearAlignment_corrected_layout ) {
+    using sV::mixins::AlignmentApplication;
+    char inPath[] = "/tmp/sV-ut-layout-XXXXXX";
+    int fd = mkstemp( inPath );
+    BOOST_REQUIRE( fd >= 0 );
+    close( fd );
+    const std::string outPath = std::string(inPath) + ".corrected";
+    {
+        std::ofstream ofs( inPath );
+        ofs << "{ \"trackingThreads\" : 4,"
+               "  \"detectors\" : {"
+               "    \"MM01\" : { \"family\" : \"MuMega\","
+               "                 \"position\" : [1, 2, 3],"
+               "                 \"rotation\" : [0, 0, 90] },"
+               "    \"MM02\" : { \"family\" : \"MuMega\","
+               "                 \"position\" : [-1.5, 0, 100],"
+               "                 \"rotation\" : [0, 0, 0] },"
+               "    \"MM03\" : { \"family\" : \"MuMega\","
+               "                 \"position\" : [1.5,2,300],"
+               "                 \"rotation\" : [0, 0, 0] } },"
+               "  \"trackingGroups\" : {"
+               "    \"upstream\" : { \"reconstructionMethod\" : \"linearAlignment\","
+               "                     \"members\" : [\"MM01\", \"MM02\"] } } }";
+    }
+    AlignmentApplication::Shifts shifts;
+    shifts["MM02"] = {{ 0.25, -0.5 }};
+    // Unknown detectors are ignored.
+    shifts["GEM01"] = {{ 1., 1. }};
+    AlignmentApplication::write_corrected_layout( inPath, outPath, shifts );
+
+    boost::property_tree::ptree pt;
+    boost::property_tree::read_json( outPath, pt );
+    auto position = [&pt]( const char * detName ) {
+        std::vector<double> r;
+        for( const auto & e : pt.get_child( std::string("detectors.")
+                                          + detName + ".position" ) ) {
+            r.push_back( e.second.get_value<double>() );
+        }
+        return r;
+    };
+    const std::vector<double> r1 = position( "MM01" ),
+                              r2 = position( "MM02" );
+    BOOST_REQUIRE( 3 == r1.size() && 3 == r2.size() );
+    BOOST_CHECK( 1. == r1[0] && 2. == r1[1] && 3. == r1[2] );
+    BOOST_CHECK_CLOSE( r2[0], -1.25, 1e-6 );
+    BOOST_CHECK_CLOSE( r2[1], -0.5, 1e-6 );
+    BOOST_CHECK_CLOSE( r2[2], 100., 1e-6 );
+    BOOST_CHECK( !pt.get_child_optional( "detectors.GEM01" ) );
+    // The rest of layout is kept.
+    BOOST_CHECK( 90. == pt.get_child( "detectors.MM01.rotation" )
+                          .back().second.get_value<double>() );
+    BOOST_CHECK( "MuMega" == pt.get<std::string>( "detectors.MM02.family" ) );
+    BOOST_CHECK( 2 == pt.get_child( "trackingGroups.upstream.members" ).size() );
+    // Numeric values are not converted to strings.
+    std::string outText;
+    {
+        std::ifstream ifs( outPath );
+        std::stringstream ss;
+        ss << ifs.rdbuf();
+        outText = ss.str();
+    }
+    BOOST_CHECK( std::string::npos != outText.find( "\"trackingThreads\" : 4," ) );
+    BOOST_CHECK( std::string::npos != outText.find( "[1.5,2,300]" ) );
+    BOOST_CHECK( std::string::npos != outText.find( "[0, 0, 90]" ) );
+    BOOST_CHECK( std::string::npos != outText.find( "[-1.25, -0.5, 100]" ) );
+    BOOST_CHECK( std::string::npos == outText.find( "\"4\"" ) );
+    unlink( inPath );
+    unlink( outPath.c_str() );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+# endif  // ALIGNMENT_ROUTINES
@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) 2016 Renat R. Dusaev <crank@qcrypt.org>
+ * Author: Renat R. Dusaev <crank@qcrypt.org>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+# include "sV_config.h"
+
+# ifdef ALIGNMENT_ROUTINES
+
+# define BOOST_TEST_NO_MAIN
+# include <boost/test/unit_test.hpp>
+
+# include "alignment/HitsIndex.tcc"
+
+# include <algorithm>
+# include <random>
+
+namespace sV {
+namespace alignTest5 {
+
+typedef alignment::TrackReceptiveVolume<2> Volume;
+typedef alignment::HitsGridIndex<2> Index;
+typedef Volume::LocalCoordinates Point;
+
+static float
+distance2( const Point & p, const float * c ) {
+    return (p.r[0] - c[0])*(p.r[0] - c[0]) + (p.r[1] - c[1])*(p.r[1] - c[1]);
+}
+
+// Returns points of all the sets kept by volume.
+static std::vector<Point>
+all_points( const Volume & v ) {
+    std::vector<Point> pts;
+    auto sets = v.sets();
+    for( auto it = sets.begin(); it != sets.end(); ++it ) {
+        for( const auto & p : *it ) {
+            pts.push_back( p );
+        }
+    }
+    return pts;
+}
+
+// Amplitudes are unique, so they identify the points.
+static std::vector<float>
+amplitudes_of( const std::vector<Point> & pts ) {
+    std::vector<float> amps;
+    for( const auto & p : pts ) {
+        amps.push_back( p.amplitude );
+    }
+    std::sort( amps.begin(), amps.end() );
+    return amps;
+}
+
+// Compares index queries against brute force search over points kept.
+static void
+check_queries( const Index & idx, const Volume & v, std::mt19937 & gen ) {
+    const std::vector<Point> pts = all_points( v );
+    BOOST_REQUIRE( pts.size() == idx.size() );
+    // Centers are sampled out of normalized range as well.
+    std::uniform_real_distribution<float> cDst( -0.5, 1.5 ),
+                                          rDst( 0., 0.3 );
+    for( int n = 0; n < 10; ++n ) {
+        const float c[2] = { cDst(gen), cDst(gen) },
+                    radius = rDst(gen);
+        std::vector<Point> found, expected;
+        BOOST_REQUIRE( idx.in_radius( c, radius, found ) == found.size() );
+        for( const auto & p : pts ) {
+            if( distance2( p, c ) <= radius*radius ) {
+                expected.push_back( p );
+            }
+        }
+        BOOST_REQUIRE( amplitudes_of( expected ) == amplitudes_of( found ) );
+
+        const size_t k = 1 + gen()%8;
+        idx.nearest( c, k, found );
+        std::vector<float> d2s;
+        for( const auto & p : pts ) {
+            d2s.push_back( distance2( p, c ) );
+        }
+        std::sort( d2s.begin(), d2s.end() );
+        BOOST_REQUIRE( std::min( k, pts.size() ) == found.size() );
+        for( size_t i = 0; i < found.size(); ++i ) {
+            BOOST_REQUIRE( d2s[i] == distance2( found[i], c ) );
+        }
+    }
+}
+
+}  // namespace alignTest5
+}  // namespace sV
+
+BOOST_AUTO_TEST_SUITE( Alignment_suite )
+
+// Sets are opened and filled with points (some of them out of normalized
+// range) while the ring evicts the old ones; index attached to the volume
+// has to follow it.
+BOOST_AUTO_TEST_CASE( HitsGridIndex_vs_brute_force ) {
+    using namespace sV::alignTest5;
+    std::mt19937 gen(1337);
+    std::uniform_real_distribution<float> rDst( -0.2, 1.2 );
+    for( size_t nCells : { 1, 4, 16 } ) {
+        Volume v( 16, 4 );
+        float counter = 0;
+        // Points kept before index is attached are indexed as well.
+        for( int i = 0; i < 5; ++i ) {
+            v.update_point( Point{ ++counter, { rDst(gen), rDst(gen) } } );
+        }
+        Index idx( v, nCells );
+        BOOST_REQUIRE( 5 == idx.size() );
+        for( size_t nEvent = 0; nEvent < 50; ++nEvent ) {
+            v.open_new_set();
+            const size_t n = gen()%30;
+            for( size_t i = 0; i < n; ++i ) {
+                v.update_point( Point{ ++counter, { rDst(gen), rDst(gen) } } );
+            }
+            check_queries( idx, v, gen );
+        }
+        // Shrinking the ring evicts sets as well.
+        v.n_sets( 2 );
+        check_queries( idx, v, gen );
+    }
+    {
+        // Detached index is not updated anymore.
+        Volume v( 16, 2 );
+        {
+            Index idx( v );
+            v.update_point( Point{ 1., { 0.5, 0.5 } } );
+            BOOST_CHECK( 1 == idx.size() );
+        }
+        v.open_new_set();
+        v.open_new_set();
+        BOOST_CHECK( v.most_recent_set_is_empty() );
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+# endif  // ALIGNMENT_ROUTINES
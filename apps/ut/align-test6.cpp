@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) 2016 Renat R. Dusaev <crank@qcrypt.org>
+ * Author: Renat R. Dusaev <crank@qcrypt.org>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+# include "sV_config.h"
+
+# ifdef ALIGNMENT_ROUTINES
+
+# define BOOST_TEST_NO_MAIN
+# include <boost/test/unit_test.hpp>
+
+# include "analysis/xform.tcc"
+
+# include <random>
+# include <sstream>
+# include <vector>
+
+namespace sV {
+namespace alignTest6 {
+
+typedef aux::XForm<3, float> XForm;
+
+// Points in structure-of-arrays form, as batched methods expect them.
+struct Points {
+    std::vector<float> coordinates[3];
+    float * ptrs[3];
+
+    Points( size_t n, std::mt19937 & gen, float lo, float hi ) {
+        std::uniform_real_distribution<float> dst( lo, hi );
+        for( uint8_t d = 0; d < 3; ++d ) {
+            coordinates[d].resize( n );
+            for( auto & x : coordinates[d] ) {
+                x = dst(gen);
+            }
+            ptrs[d] = coordinates[d].data();
+        }
+    }
+    Points( const Points & o ) {
+        for( uint8_t d = 0; d < 3; ++d ) {
+            coordinates[d] = o.coordinates[d];
+            ptrs[d] = coordinates[d].data();
+        }
+    }
+    void point( size_t i, float * x ) const {
+        for( uint8_t d = 0; d < 3; ++d ) {
+            x[d] = coordinates[d][i];
+        }
+    }
+};
+
+}  // namespace alignTest6
+}  // namespace sV
+
+BOOST_AUTO_TEST_SUITE( Alignment_suite )
+
+// Batched methods have to give the same results as per-point ones (up to
+// rounding, as the affine coefficients are precomputed).
+BOOST_AUTO_TEST_CASE( XForm_batched ) {
+    using namespace sV::alignTest6;
+    std::mt19937 gen(1337);
+    const float mins[3] = { -10., 0., 100. },
+                maxs[3] = { 10., 0.5, 300. };
+    XForm xf;
+    xf.set_ranges( mins, maxs );
+    // Odd number of points, so vectorized loops have remainders.
+    for( size_t n : { 0, 1, 7, 1001 } ) {
+        Points pts( n, gen, -50., 350. ),
+               orig( pts );
+        xf.norm_n( pts.ptrs, n );
+        for( size_t i = 0; i < n; ++i ) {
+            float x[3], y[3];
+            orig.point( i, x );
+            pts.point( i, y );
+            xf.norm( x );
+            for( uint8_t d = 0; d < 3; ++d ) {
+                BOOST_REQUIRE_SMALL( x[d] - y[d], 1e-5f );
+            }
+        }
+        // Denormalization restores the points.
+        xf.denorm_n( pts.ptrs, n );
+        for( size_t i = 0; i < n; ++i ) {
+            float x[3], y[3];
+            orig.point( i, x );
+            pts.point( i, y );
+            for( uint8_t d = 0; d < 3; ++d ) {
+                BOOST_REQUIRE_SMALL( x[d] - y[d], 1e-3f );
+            }
+            // ...as the per-point method does.
+            xf.norm( x );
+            xf.denorm( x );
+            for( uint8_t d = 0; d < 3; ++d ) {
+                BOOST_REQUIRE_SMALL( x[d] - y[d], 1e-3f );
+            }
+        }
+    }
+    // Ranges extended to cover points set at once are the same as extended
+    // point by point.
+    for( size_t n : { 1, 2, 1001 } ) {
+        const Points pts( n, gen, -50., 350. );
+        XForm batched, single;
+        batched.set_ranges( mins, maxs );
+        single.set_ranges( mins, maxs );
+        batched.extend_to_n( pts.ptrs, n );
+        for( size_t i = 0; i < n; ++i ) {
+            float x[3];
+            pts.point( i, x );
+            single.extend_to( x );
+        }
+        for( uint8_t d = 0; d < 3; ++d ) {
+            BOOST_CHECK( single.get_limit( XForm::min, d )
+                      == batched.get_limit( XForm::min, d ) );
+            BOOST_CHECK( single.get_limit( XForm::max, d )
+                      == batched.get_limit( XForm::max, d ) );
+        }
+    }
+    // Empty set does not change the ranges.
+    xf.extend_to_n( nullptr, 0 );
+    BOOST_CHECK( mins[1] == xf.get_limit( XForm::min, 1 )
+              && maxs[1] == xf.get_limit( XForm::max, 1 ) );
+}
+
+BOOST_AUTO_TEST_CASE( XForm_printing ) {
+    using namespace sV::alignTest6;
+    const float mins[3] = { -10., 0., 100. },
+                maxs[3] = { 10., 0.5, 300. };
+    XForm xf;
+    xf.set_ranges( mins, maxs );
+    std::ostringstream ss;
+    ss << xf;
+    const std::string s = ss.str();
+    BOOST_CHECK( std::string::npos != s.find( "\"XForm<3>\"" ) );
+    BOOST_CHECK( std::string::npos != s.find( "[-10, 10]" ) );
+    BOOST_CHECK( std::string::npos != s.find( "[0, 0.5]" ) );
+    BOOST_CHECK( std::string::npos != s.find( "[100, 300]" ) );
+    BOOST_CHECK( '{' == s.front() && '}' == s.back() );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+# endif  // ALIGNMENT_ROUTINES
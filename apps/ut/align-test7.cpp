@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) 2016 Renat R. Dusaev <crank@qcrypt.org>
+ * Author: Renat R. Dusaev <crank@qcrypt.org>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+# include "sV_config.h"
+
+# ifdef ALIGNMENT_ROUTINES
+
+# define BOOST_TEST_NO_MAIN
+# include <boost/test/unit_test.hpp>
+
+# include "alignment/DisplayScheduler.hpp"
+# include "alignment/DetectorsSet.hpp"
+
+# include <thread>
+
+namespace sV {
+namespace alignTest7 {
+
+typedef alignment::DisplayScheduler Scheduler;
+
+// Provides access to merged state without dispatching it (summaries of
+// unknown detectors can not be dispatched).
+class TestScheduler : public Scheduler {
+public:
+    TestScheduler( alignment::DetectorsSet & ds,
+                   Policy policy,
+                   size_t maxMerged ) :
+                Scheduler( ds, 25., policy, maxMerged ) {}
+    bool take() { return _take_pending(); }
+};
+
+// Event hitting single detector with given ID.
+static Scheduler::Displayable
+event( uint32_t id ) {
+    Scheduler::Displayable msg;
+    msg.add_summaries()->set_detectorid( id );
+    return msg;
+}
+
+}  // namespace alignTest7
+}  // namespace sV
+
+BOOST_AUTO_TEST_SUITE( Alignment_suite )
+
+BOOST_AUTO_TEST_CASE( DisplayScheduler_policies ) {
+    using namespace sV::alignTest7;
+    sV::alignment::DetectorsSet ds;
+    {
+        // Only the most recent event is kept.
+        TestScheduler s( ds, Scheduler::latest, 4 );
+        BOOST_CHECK( !s.take() );
+        for( uint32_t id = 1; id <= 5; ++id ) {
+            s.submit( event(id) );
+        }
+        BOOST_REQUIRE( s.take() );
+        BOOST_REQUIRE( 1 == s.current().summaries_size() );
+        BOOST_CHECK( 5 == s.current().summaries(0).detectorid() );
+        BOOST_CHECK( 5 == s.n_submitted() );
+        BOOST_CHECK( 4 == s.n_coalesced() );
+        BOOST_CHECK( 0 == s.n_dropped() );
+        BOOST_CHECK( !s.take() );
+    }
+    {
+        // The most recent events are merged in order of their arrival,
+        // eldest ones beyond the limit are dropped.
+        TestScheduler s( ds, Scheduler::merge, 4 );
+        for( uint32_t id = 1; id <= 10; ++id ) {
+            s.submit( event(id) );
+        }
+        BOOST_REQUIRE( s.take() );
+        BOOST_REQUIRE( 4 == s.current().summaries_size() );
+        for( int i = 0; i < 4; ++i ) {
+            BOOST_CHECK( uint32_t(7 + i) == s.current().summaries(i).detectorid() );
+        }
+        BOOST_CHECK( 10 == s.n_submitted() );
+        BOOST_CHECK( 9 == s.n_coalesced() );
+        BOOST_CHECK( 6 == s.n_dropped() );
+        BOOST_CHECK( !s.take() );
+        // Fewer events than the limit are all merged (rings are re-used).
+        s.submit( event(11) );
+        s.submit( event(12) );
+        BOOST_REQUIRE( s.take() );
+        BOOST_REQUIRE( 2 == s.current().summaries_size() );
+        BOOST_CHECK( 11 == s.current().summaries(0).detectorid() );
+        BOOST_CHECK( 12 == s.current().summaries(1).detectorid() );
+        BOOST_CHECK( 6 == s.n_dropped() );
+    }
+    BOOST_CHECK_THROW( Scheduler( ds, 0. ), goo::Exception );
+}
+
+// Events with no summaries are dispatched through empty detectors set.
+BOOST_AUTO_TEST_CASE( DisplayScheduler_pacing ) {
+    using namespace sV::alignTest7;
+    sV::alignment::DetectorsSet ds;
+    for( auto policy : { Scheduler::latest, Scheduler::merge } ) {
+        Scheduler s( ds, 50., policy, 8 );
+        BOOST_CHECK_CLOSE( s.frame_rate(), 50., 1e-3 );
+        const Scheduler::Displayable empty;
+        // Nothing is rendered until submitted.
+        s.render_if_due();
+        BOOST_CHECK( 0 == s.n_frames() );
+        // Next frame is due a period after the previous one.
+        while( Scheduler::Clock::now() < s.next_frame_time() ) {
+            std::this_thread::sleep_for( std::chrono::milliseconds(1) );
+        }
+        s.submit( empty );
+        s.render_if_due();
+        BOOST_CHECK( 1 == s.n_frames() );
+        s.submit( empty );
+        s.render_if_due();
+        BOOST_CHECK( 1 == s.n_frames() );
+        // Submission rate much higher than the frame rate does not
+        // increase the latter.
+        const auto start = Scheduler::Clock::now(),
+                   until = start + std::chrono::milliseconds( 300 );
+        while( Scheduler::Clock::now() < until ) {
+            for( int i = 0; i < 10; ++i ) {
+                s.submit( empty );
+            }
+            s.render_if_due();
+            std::this_thread::sleep_for( std::chrono::microseconds(500) );
+        }
+        // 15 frames are expected within 300 ms.
+        BOOST_CHECK( s.n_frames() >= 8 && s.n_frames() <= 20 );
+        BOOST_CHECK( s.n_submitted() > 10*s.n_frames() );
+        BOOST_CHECK( s.n_coalesced() + 1 >= s.n_submitted() - s.n_frames() );
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+# endif  // ALIGNMENT_ROUTINES
@@ -300,19 +300,15 @@ protected:
                                         new test::ExtractedWords( words ));
     }
     virtual std::unique_ptr<aux::iEventSequence> _V_md_event_read_list(
-                            const Test2Metadata & /*md*/,
-                            const std::list<EventID> & /*eidsList*/ ) override {
-        # if 1
-        _TODO_  // TODO
-        # else
+                            const Test2Metadata & md,
+                            const std::list<EventID> & eidsList ) override {
         std::list<std::string> words;
-        for( const auto & nw : eidsList ) {
-            auto wp = md.find(nw)->second;
-            words.push_back( std::string(_content + wp.first, wp.second) );
+        for( const auto & eid : eidsList ) {
+            auto mde = md.query_word_loc( eid );
+            words.push_back( std::string( _content + mde.offset, mde.length ) );
         }
         return std::unique_ptr<sV::aux::iEventSequence>(
                                         new test::ExtractedWords( words ));
-        # endif
     }
 
     virtual std::string _V_textual_id(const SourceID *sidPtr) const override {
@@ -581,6 +577,10 @@ BOOST_AUTO_TEST_CASE( SectionalSource,
     _static_MTDPtr = &dict;
     MetadataType mdt;
     dict.register_metadata_type( mdt );
+    // Type index is persistent: derived from type name at compile time.
+    static_assert( sV::aux::metadata_type_id( "Testing2" ), "Zero type ID." );
+    BOOST_CHECK( sV::aux::metadata_type_id( "Testing2" )
+                    == mdt.type_index() );
 
     Store store;
     mdt.add_store( store );
@@ -641,19 +641,22 @@ BOOST_AUTO_TEST_CASE( SectionalSource,
                                     dict.metadata_type( "Testing2" ));
     BOOST_REQUIRE( &mdt == &mdt2 );
     auto & batchHandle = mdt2.batch_handle();
+    // Keep sources alive between queries.
+    batchHandle.sources_pool().capacity( 2 );
 
     // Try to obtain a word using this batch abstraction:
     BOOST_REQUIRE( get_word_from_event(
                 *batchHandle.event_read_single({3, 1, 6}) ) == "Tal" );
 
     // Let's check that acquizition may be performed as if it is a continious
-    // array.
-    {
+    // array (with and without preparing next source in background).
+    for( size_t depth = 0; depth < 2; ++depth ) {
         const std::string & expectedSequence = "die Pflaumen aus dem Baum"
                                             " Ob die andre Stadt mich lieb hat"
                                             " In der Enklave meiner Wahl"
                                             " in der "
                                             ;
+        batchHandle.read_ahead_depth( depth );
         auto src = batchHandle.event_read_range( {4, 1, 2}, {5, 1, 2} );
         std::stringstream ss;
         for( auto eventPtr = src->initialize_reading();
@@ -664,8 +667,52 @@ BOOST_AUTO_TEST_CASE( SectionalSource,
         //          << "'" << ss.str() << "'" << std::endl;
         BOOST_REQUIRE( ss.str() == expectedSequence );
     }
+    // Second source of range was prepared in background.
+    BOOST_REQUIRE( 1 == batchHandle.n_read_ahead_hits()
+                      + batchHandle.n_read_ahead_misses() );
+    batchHandle.read_ahead_depth( 0 );
     //std::cout << ">>>" << std::endl;
 
+    // Reading by list of IDs: events are grouped by sources unless requested
+    // order restoration is demanded.
+    {
+        const std::list<EventID> eids = { {3, 1, 6}, {5, 0, 1}, {4, 1, 6} };
+        const char expectedGrouped[] = "Tal Baum In ",
+                   expectedRestored[] = "Tal In Baum ";
+        for( int restore = 0; restore < 2; ++restore ) {
+            batchHandle.restore_list_order( restore );
+            auto src = batchHandle.event_read_list( eids );
+            std::stringstream ss;
+            for( auto eventPtr = src->initialize_reading();
+                 src->is_good(); src->next_event(eventPtr) ) {
+                ss << get_word_from_event(*eventPtr) << " ";
+            }
+            src->finalize_reading();
+            BOOST_REQUIRE( ss.str() == (restore ? expectedRestored
+                                                : expectedGrouped) );
+        }
+        batchHandle.restore_list_order( false );
+    }
+    // Sources acquired by previous queries has to be re-used.
+    BOOST_REQUIRE( batchHandle.sources_pool().n_hits() );
+    BOOST_REQUIRE( batchHandle.sources_pool().size() <= 2 );
+
+    // Extract metadata for the remaining (first) fragment in advance.
+    {
+        size_t nReported = 0;
+        BOOST_REQUIRE( !store.get_metadata_for( 1 ) );
+        BOOST_REQUIRE( 1 == mdt.prewarm( {1, 2, 3}, store, 2,
+                        [&nReported]( size_t done, size_t total ) {
+                            nReported = done;
+                            BOOST_REQUIRE( 1 == total );
+                        } ) );
+        BOOST_REQUIRE( 1 == nReported );
+        BOOST_REQUIRE( store.get_metadata_for( 1 ) );
+        BOOST_REQUIRE( get_word_from_event(
+                *batchHandle.event_read_single({1, 0, 3}) ) == "liegt" );
+    }
+    batchHandle.sources_pool().clear();
+
     // Finaly, we make the first fragment's metadata to be cached by explicit
     // acquizition of the words:
     // TODO
@@ -0,0 +1,235 @@
+/*
+ * Copyright (c) 2016 Renat R. Dusaev <crank@qcrypt.org>
+ * Author: Renat R. Dusaev <crank@qcrypt.org>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+# include "metadata/store_mmap.tcc"
+
+# include <atomic>
+# include <cstdio>
+# include <fstream>
+# include <thread>
+
+namespace sV {
+namespace mdTest3 {
+
+// Event ID is just a global event number, source ID is a number of file.
+// Metadata is a list of (event number, offset) pairs.
+typedef uint32_t EventID;
+typedef uint16_t SourceID;
+typedef std::vector< std::pair<EventID, uint64_t> > Metadata;
+
+typedef MMapMetadataStore<EventID, Metadata, SourceID> Store;
+
+class Serializer : public Store::Serializer {
+public:
+    std::string dir;
+
+    virtual void serialize( const Metadata & md,
+                            std::vector<uint8_t> & buf ) const override {
+        const uint8_t * p = reinterpret_cast<const uint8_t *>(md.data());
+        buf.insert( buf.end(), p, p + md.size()*sizeof(Metadata::value_type) );
+    }
+    virtual Metadata * deserialize( const uint8_t * p,
+                                    size_t len ) const override {
+        const Metadata::value_type * b
+                        = reinterpret_cast<const Metadata::value_type *>(p);
+        return new Metadata( b, b + len/sizeof(Metadata::value_type) );
+    }
+    virtual void locate_events( const Metadata & md,
+                                EventsLocations & locs ) const override {
+        locs.assign( md.begin(), md.end() );
+    }
+    virtual std::string source_path( const SourceID & sid ) const override {
+        return dir + "/src-" + std::to_string(sid) + ".dat";
+    }
+};
+
+// Source #n keeps events [n*100, n*100 + 10) at offsets multiple to 16.
+Metadata
+source_metadata( SourceID sid ) {
+    Metadata md;
+    for( EventID i = 0; i < 10; ++i ) {
+        md.push_back( std::make_pair( sid*100 + i, (uint64_t) i*16 ) );
+    }
+    return md;
+}
+
+void
+write_source( const Serializer & s, SourceID sid ) {
+    std::ofstream( s.source_path(sid) ) << std::string( 160, 'a' + sid );
+}
+
+}  // namespace mdTest3
+}  // namespace sV
+
+//
+// Test suite
+
+# define BOOST_TEST_NO_MAIN
+# include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE( Metadata_suite )
+
+BOOST_AUTO_TEST_CASE( MMapStore ) {
+    using namespace sV::mdTest3;
+    char dirTemplate[] = "/tmp/sV-ut-mdstore-XXXXXX";
+    BOOST_REQUIRE( mkdtemp( dirTemplate ) );
+    Serializer s;
+    s.dir = dirTemplate;
+    const std::string prefix = s.dir + "/md";
+
+    {
+        Store store( prefix, s );
+        for( SourceID sid = 1; sid <= 3; ++sid ) {
+            write_source( s, sid );
+            store.put_metadata( sid, source_metadata( sid ) );
+        }
+        SourceID sid = 0;
+        uint64_t offset = 0;
+        BOOST_REQUIRE( store.source_location_for( 205, sid, offset ) );
+        BOOST_CHECK( 2 == sid && 80 == offset );
+        BOOST_CHECK( !store.source_id_for( 150, sid ) );
+    }
+    BOOST_TEST_MESSAGE( "[==] Metadata store written." );
+    {
+        // Re-opened store has to provide persistent entries.
+        Store store( prefix, s );
+        BOOST_CHECK( 3 == store.n_sources() );
+        Metadata * md = store.get_metadata_for( 3 );
+        BOOST_REQUIRE( md );
+        BOOST_CHECK( source_metadata( 3 ) == *md );
+        std::list<Store::SubrangeMarkup> markup;
+        store.collect_source_ids_for_range( 105, 302, markup );
+        BOOST_REQUIRE( 3 == markup.size() );
+        auto it = markup.begin();
+        BOOST_CHECK( 1 == it->sid && 105 == it->from && 109 == it->to );
+        ++it;
+        BOOST_CHECK( 2 == it->sid && 200 == it->from && 209 == it->to );
+        ++it;
+        BOOST_CHECK( 3 == it->sid && 300 == it->from && 302 == it->to );
+        // Indexing cursor of source #3 persists.
+        Store::IndexingCursor cursor;
+        BOOST_CHECK( !store.get_cursor_for( 3, cursor ) );
+        store.put_cursor( 3, Store::IndexingCursor{ 160, 309 } );
+    }
+    {
+        // Modified source file invalidates its entries unless it has an
+        // indexing cursor and just grew.
+        std::ofstream( s.source_path(2), std::ios::app ) << "modified";
+        std::ofstream( s.source_path(3), std::ios::app ) << "appended";
+        Store store( prefix, s );
+        SourceID sid;
+        // Instance of invalidated entry remains valid until released.
+        Metadata * md1 = store.get_metadata_for( 1 );
+        BOOST_REQUIRE( md1 );
+        store.erase_metadata_for( 1 );
+        BOOST_CHECK( source_metadata( 1 ) == *md1 );
+        BOOST_CHECK( 1 == store.release_invalidated() );
+        BOOST_CHECK( !store.source_id_for( 205, sid ) );
+        BOOST_CHECK( !store.get_metadata_for( 2 ) );
+        BOOST_CHECK( store.source_id_for( 305, sid ) && 3 == sid );
+        Store::IndexingCursor cursor;
+        BOOST_REQUIRE( store.get_cursor_for( 3, cursor ) );
+        BOOST_CHECK( 160 == cursor.offset && 309 == cursor.lastEventID );
+        BOOST_CHECK( 1 == store.n_sources() );
+    }
+    for( SourceID sid = 1; sid <= 3; ++sid ) {
+        remove( s.source_path(sid).c_str() );
+    }
+    remove( (prefix + ".idx").c_str() );
+    remove( (prefix + ".mdat").c_str() );
+    rmdir( dirTemplate );
+}
+
+BOOST_AUTO_TEST_CASE( MMapStoreConcurrency ) {
+    using namespace sV::mdTest3;
+    char dirTemplate[] = "/tmp/sV-ut-mdstore-XXXXXX";
+    BOOST_REQUIRE( mkdtemp( dirTemplate ) );
+    Serializer s;
+    s.dir = dirTemplate;
+    const std::string prefix = s.dir + "/md";
+    const SourceID nStable = 8, nAdded = 24;
+    {
+        Store store( prefix, s );
+        for( SourceID sid = 1; sid <= nStable; ++sid ) {
+            write_source( s, sid );
+            store.put_metadata( sid, source_metadata( sid ) );
+        }
+    }
+    {
+        // Freshly opened store validates and deserializes entries on first
+        // queries, while other sources are being added and erased.
+        Store store( prefix, s );
+        std::atomic<bool> stop( false );
+        std::atomic<size_t> nFailures( 0 );
+        std::vector<std::thread> readers;
+        for( int n = 0; n < 4; ++n ) {
+            readers.emplace_back( [&, n]{
+                for( unsigned int k = n; !stop; ++k ) {
+                    const SourceID sid = 1 + k%nStable;
+                    const EventID eid = sid*100 + k%10;
+                    SourceID foundSID = 0;
+                    uint64_t offset = 0;
+                    if( !store.source_location_for( eid, foundSID, offset )
+                     || sid != foundSID || (k%10)*16 != offset ) {
+                        ++nFailures;
+                    }
+                    Metadata * md = store.get_metadata_for( sid );
+                    if( !md || source_metadata( sid ) != *md ) {
+                        ++nFailures;
+                    }
+                    std::list<Store::SubrangeMarkup> markup;
+                    store.collect_source_ids_for_range( sid*100 + 5,
+                                                        sid*100 + 105,
+                                                        markup );
+                    if( markup.empty() || sid != markup.front().sid
+                     || EventID( sid*100 + 9 ) != markup.front().to ) {
+                        ++nFailures;
+                    }
+                }
+            } );
+        }
+        for( SourceID sid = nStable + 1; sid <= nStable + nAdded; ++sid ) {
+            write_source( s, sid );
+            store.put_metadata( sid, source_metadata( sid ) );
+            SourceID foundSID;
+            BOOST_CHECK( store.source_id_for( sid*100 + 1, foundSID )
+                      && sid == foundSID );
+            if( sid%2 ) {
+                store.erase_metadata_for( sid );
+            }
+        }
+        stop = true;
+        for( auto & t : readers ) {
+            t.join();
+        }
+        BOOST_CHECK( !nFailures );
+        BOOST_CHECK( nStable + nAdded/2 == store.n_sources() );
+    }
+    for( SourceID sid = 1; sid <= nStable + nAdded; ++sid ) {
+        remove( s.source_path(sid).c_str() );
+    }
+    remove( (prefix + ".idx").c_str() );
+    remove( (prefix + ".mdat").c_str() );
+    rmdir( dirTemplate );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,347 @@
+/*
+ * Copyright (c) 2016 Renat R. Dusaev <crank@qcrypt.org>
+ * Author: Renat R. Dusaev <crank@qcrypt.org>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+# include "metadata/store_interval.tcc"
+# include "metadata/sources_pool.tcc"
+
+# include <algorithm>
+# include <atomic>
+# include <cstdio>
+# include <random>
+# include <thread>
+
+# include <unistd.h>
+
+namespace sV {
+namespace mdTest4 {
+
+// Event ID is a global event number, metadata is a sorted list of events
+// available in the source.
+typedef uint32_t EventID;
+typedef uint16_t SourceID;
+typedef std::vector<EventID> Metadata;
+
+class Store : public iTIntervalIndexedStore<EventID, Metadata, SourceID> {
+protected:
+    virtual bool _V_events_range( const Metadata & md,
+                                  EventID & first,
+                                  EventID & last ) const override {
+        if( md.empty() ) return false;
+        first = md.front();
+        last = md.back();
+        return true;
+    }
+    virtual bool _V_locate_event( const Metadata & md,
+                                  const EventID & eid,
+                                  uint64_t & position ) const override {
+        auto it = std::lower_bound( md.begin(), md.end(), eid );
+        if( md.end() == it || *it != eid ) return false;
+        position = it - md.begin();
+        return true;
+    }
+    virtual bool _V_collect_events( const Metadata & md,
+                                    std::vector<EventID> & eids
+                                    ) const override {
+        eids = md;
+        return true;
+    }
+public:
+    Store() : iTIntervalIndexedStore<EventID, Metadata, SourceID>(true) {}
+};
+
+// Manager providing fake sources (pool never dereferences them) and
+// counting the alive ones.
+class SourcesManager : public ITDisposableSourceManager<EventID,
+                                                        Metadata,
+                                                        SourceID> {
+private:
+    char _slots[16];
+    size_t _nAcquired;
+public:
+    std::atomic<int> nAlive;
+
+    SourcesManager() : _nAcquired(0), nAlive(0) {}
+
+    virtual Metadata * get_metadata_for( const SourceID & ) const override {
+        return nullptr;
+    }
+    virtual void put_metadata( const SourceID &, const Metadata & ) override {}
+    virtual void erase_metadata_for( const SourceID & ) override {}
+
+    virtual iEventSource * source( const SourceID & ) override {
+        ++nAlive;
+        return reinterpret_cast<iEventSource *>(
+                                    _slots + (_nAcquired++)%sizeof(_slots) );
+    }
+    virtual void free_source( iEventSource * ) override {
+        --nAlive;
+    }
+};
+
+}  // namespace mdTest4
+}  // namespace sV
+
+//
+// Test suite
+
+# define BOOST_TEST_NO_MAIN
+# include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE( Metadata_suite )
+
+BOOST_AUTO_TEST_CASE( IntervalIndexedStore ) {
+    using namespace sV::mdTest4;
+    Store store;
+    // Sources 1..3 are consequent, source #4 has only even events and
+    // overlaps with 2 and 3.
+    std::map<SourceID, Metadata> mds;
+    mds[3] = {300, 301, 302, 303};
+    mds[1] = {100, 101, 102};
+    mds[2] = {200, 201, 202};
+    mds[4] = {150, 250, 350};
+    std::map<SourceID, Metadata *> ptrs;
+    for( auto & p : mds ) {
+        ptrs[p.first] = &p.second;
+    }
+    store.bulk_load( ptrs.begin(), ptrs.end() );
+    BOOST_CHECK( 4 == store.n_sources() );
+
+    SourceID sid = 0;
+    uint64_t position = 0;
+    BOOST_REQUIRE( store.source_location_for( 302, sid, position ) );
+    BOOST_CHECK( 3 == sid && 2 == position );
+    BOOST_REQUIRE( store.source_id_for( 250, sid ) );
+    BOOST_CHECK( 4 == sid );
+    BOOST_CHECK( !store.source_id_for( 251, sid ) );
+    BOOST_CHECK( !store.source_id_for( 99, sid ) );
+
+    std::list<Store::SubrangeMarkup> markup;
+    store.collect_source_ids_for_range( 101, 201, markup );
+    BOOST_REQUIRE( 3 == markup.size() );
+    auto it = markup.begin();
+    BOOST_CHECK( 1 == it->sid && 101 == it->from && 102 == it->to );
+    ++it;
+    BOOST_CHECK( 4 == it->sid && 150 == it->from && 201 == it->to );
+    ++it;
+    BOOST_CHECK( 2 == it->sid && 200 == it->from && 201 == it->to );
+    BOOST_CHECK( it->mdPtr && *(it->mdPtr) == mds[2] );
+
+    // Removed source is not indexed anymore.
+    store.erase_metadata_for( 4 );
+    markup.clear();
+    store.collect_source_ids_for_range( 101, 201, markup );
+    BOOST_CHECK( 2 == markup.size() );
+    BOOST_CHECK( !store.source_id_for( 250, sid ) );
+
+    // Concurrent look-ups while store is being modified.
+    std::atomic<size_t> nFound(0);
+    std::vector<std::thread> readers;
+    for( int n = 0; n < 4; ++n ) {
+        readers.emplace_back( [&store, &nFound]() {
+            for( int i = 0; i < 1000; ++i ) {
+                SourceID s;
+                if( store.source_id_for( 101, s ) && 1 == s ) {
+                    ++nFound;
+                }
+            }
+        } );
+    }
+    for( SourceID n = 10; n < 100; ++n ) {
+        store.put_metadata( n, Metadata{ EventID(n*1000) } );
+    }
+    for( auto & t : readers ) {
+        t.join();
+    }
+    BOOST_CHECK( 4000 == nFound );
+    BOOST_CHECK( 93 == store.n_sources() );
+}
+
+BOOST_AUTO_TEST_CASE( IntervalIndexedStoreSpanning ) {
+    using namespace sV::mdTest4;
+    Store store;
+    // Source #0 spans over all the others (like growing source with open
+    // range), few more long sources overlap with many short ones.
+    std::mt19937 rng( 17 );
+    std::uniform_int_distribution<EventID> eidDst( 0, 100000 );
+    std::map<SourceID, Metadata> mds;
+    mds[0] = {0, 100000};
+    for( SourceID sid = 1; sid < 5000; ++sid ) {
+        mds[sid] = { (EventID) 20*sid, (EventID) 20*sid + 5 };
+    }
+    for( SourceID sid = 5000; sid < 5010; ++sid ) {
+        EventID a = eidDst(rng), b = eidDst(rng);
+        mds[sid] = { std::min(a, b), std::max(a, b) };
+    }
+    std::map<SourceID, Metadata *> ptrs;
+    for( auto & p : mds ) {
+        ptrs[p.first] = &p.second;
+    }
+    store.bulk_load( ptrs.begin(), ptrs.end() );
+    // Results are compared against linear scan.
+    std::vector< std::pair<EventID, SourceID> > sorted;
+    for( const auto & p : mds ) {
+        sorted.emplace_back( p.second.front(), p.first );
+    }
+    std::sort( sorted.begin(), sorted.end() );
+    for( int n = 0; n < 2000; ++n ) {
+        EventID from = eidDst(rng), to = from + eidDst(rng)%(n%2 ? 100 : 3);
+        std::vector<SourceID> expected;
+        for( const auto & p : sorted ) {
+            if( !(to < p.first || mds[p.second].back() < from) ) {
+                expected.push_back( p.second );
+            }
+        }
+        std::list<Store::SubrangeMarkup> markup;
+        store.collect_source_ids_for_range( from, to, markup );
+        BOOST_REQUIRE( expected.size() == markup.size() );
+        auto eit = expected.begin();
+        for( const auto & m : markup ) {
+            BOOST_CHECK( *(eit++) == m.sid );
+        }
+        // Spanning source contains only its boundaries.
+        SourceID sid;
+        const bool found = store.source_id_for( from, sid );
+        BOOST_CHECK( found == std::any_of( mds.begin(), mds.end(),
+                [from]( const std::pair<const SourceID, Metadata> & p ) {
+                    return std::binary_search( p.second.begin(),
+                                               p.second.end(), from ); } ) );
+        if( found ) {
+            BOOST_CHECK( std::binary_search( mds[sid].begin(),
+                                             mds[sid].end(), from ) );
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE( IntervalIndexedStoreFilters ) {
+    using namespace sV::mdTest4;
+    char path[] = "/tmp/sV-ut-mdfilters-XXXXXX";
+    int fd = mkstemp( path );
+    BOOST_REQUIRE( fd >= 0 );
+    close( fd );
+    // Sparse sources covering same range.
+    std::map<SourceID, Metadata> mds;
+    for( SourceID sid = 1; sid <= 10; ++sid ) {
+        for( EventID eid = sid; eid < 1000; eid += 10 ) {
+            mds[sid].push_back( eid );
+        }
+    }
+    std::map<SourceID, Metadata *> ptrs;
+    for( auto & p : mds ) {
+        ptrs[p.first] = &p.second;
+    }
+    {
+        Store store;
+        store.enable_filters( 0.01 );
+        store.bulk_load( ptrs.begin(), ptrs.end() );
+        SourceID sid;
+        BOOST_REQUIRE( store.source_id_for( 501, sid ) );
+        BOOST_CHECK( 1 == sid );
+        // Sources are checked in reverse order, most of them were skipped by
+        // their filters.
+        BOOST_CHECK( store.n_filtered_out() >= 8 );
+        store.save_filters( path );
+    }
+    {
+        // Filters are mapped from file and used for newly put metadata.
+        Store store;
+        BOOST_CHECK( 10 == store.map_filters( path ) );
+        store.bulk_load( ptrs.begin(), ptrs.end() );
+        SourceID sid;
+        BOOST_REQUIRE( store.source_id_for( 501, sid ) );
+        BOOST_CHECK( 1 == sid );
+        BOOST_CHECK( store.n_filtered_out() >= 8 );
+        BOOST_CHECK( !store.source_id_for( 1000, sid ) );
+        // Re-saving to mapped file must keep mapped filters intact.
+        store.save_filters( path );
+        BOOST_REQUIRE( store.source_id_for( 502, sid ) );
+        BOOST_CHECK( 2 == sid );
+    }
+    {
+        Store store;
+        BOOST_CHECK( 10 == store.map_filters( path ) );
+    }
+    {
+        // Filters file is stale: source #1 grew and source #2 was
+        // re-indexed with other events since filters were saved. Their
+        // filters have to be rebuilt, not to reject present events.
+        std::map<SourceID, Metadata> changed( mds );
+        changed[1].push_back( 1001 );
+        changed[2] = { 2, 7, 503, 992 };
+        std::map<SourceID, Metadata *> changedPtrs;
+        for( auto & p : changed ) {
+            changedPtrs[p.first] = &p.second;
+        }
+        Store store;
+        store.enable_filters( 0.01 );
+        BOOST_CHECK( 10 == store.map_filters( path ) );
+        store.bulk_load( changedPtrs.begin(), changedPtrs.end() );
+        SourceID sid;
+        BOOST_REQUIRE( store.source_id_for( 1001, sid ) );
+        BOOST_CHECK( 1 == sid );
+        BOOST_REQUIRE( store.source_id_for( 503, sid ) );
+        BOOST_CHECK( 2 == sid || 3 == sid );
+        BOOST_REQUIRE( store.source_id_for( 7, sid ) );
+        BOOST_CHECK( 7 == sid || 2 == sid );
+        // Rebuilt filters are saved with new ranges, while the rest are
+        // kept intact.
+        store.save_filters( path );
+        Store reloaded;
+        BOOST_CHECK( 10 == reloaded.map_filters( path ) );
+        reloaded.bulk_load( changedPtrs.begin(), changedPtrs.end() );
+        BOOST_REQUIRE( reloaded.source_id_for( 1001, sid ) );
+        BOOST_CHECK( 1 == sid );
+        BOOST_REQUIRE( reloaded.source_id_for( 992, sid ) );
+        BOOST_CHECK( 2 == sid );
+    }
+    remove( path );
+}
+
+BOOST_AUTO_TEST_CASE( SourcesPoolForget ) {
+    using namespace sV::mdTest4;
+    typedef sV::aux::DisposableSourcesPool<EventID, Metadata, SourceID> Pool;
+    SourcesManager mngr;
+    Pool::Managers mngrs = { &mngr };
+    Pool pool( mngrs, 4 );
+    auto * cachedPtr = pool.acquire( 1 );
+    pool.release( cachedPtr );
+    auto * heldPtr = pool.acquire( 2 );
+    BOOST_REQUIRE( 2 == mngr.nAlive );
+    // Forgetting the manager frees cached source at once, but waits for the
+    // held one to be released.
+    std::atomic<bool> forgotten( false );
+    std::thread t( [&]{ pool.forget( &mngr ); forgotten = true; } );
+    for( int n = 0; n < 100 && 2 == mngr.nAlive; ++n ) {
+        usleep( 1000 );
+    }
+    BOOST_CHECK( 1 == mngr.nAlive );
+    usleep( 10000 );
+    BOOST_CHECK( !forgotten );
+    BOOST_CHECK_NO_THROW( pool.release( heldPtr ) );
+    t.join();
+    BOOST_CHECK( forgotten );
+    BOOST_CHECK( 0 == mngr.nAlive );
+    BOOST_CHECK( 0 == pool.size() );
+    // Released orphan is not cached anymore.
+    BOOST_CHECK_THROW( pool.release( heldPtr ), goo::Exception );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2016 Renat R. Dusaev <crank@qcrypt.org>
+ * Author: Renat R. Dusaev <crank@qcrypt.org>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+# include "metadata/files_watcher.hpp"
+
+# include <atomic>
+# include <chrono>
+# include <cstdio>
+# include <thread>
+
+# include <unistd.h>
+
+//
+// Test suite
+
+# define BOOST_TEST_NO_MAIN
+# include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE( Metadata_suite )
+
+BOOST_AUTO_TEST_CASE( FilesWatcherThrottling ) {
+    char path[] = "/tmp/sV-ut-watched-XXXXXX";
+    int fd = mkstemp( path );
+    BOOST_REQUIRE( fd >= 0 );
+    std::atomic<int> nReported( 0 );
+    sV::aux::FilesWatcher watcher(
+            [&]( const std::string & p ) {
+                BOOST_CHECK( p == path );
+                ++nReported;
+            }, 50 );
+    watcher.watch( path );
+    watcher.start();
+    // File is appended much more often than the interval: it still has to
+    // be reported periodically while being written.
+    const auto until = std::chrono::steady_clock::now()
+                     + std::chrono::milliseconds( 600 );
+    while( std::chrono::steady_clock::now() < until ) {
+        BOOST_REQUIRE( 1 == write( fd, "x", 1 ) );
+        std::this_thread::sleep_for( std::chrono::milliseconds( 5 ) );
+    }
+    const int nWhileWriting = nReported;
+    BOOST_CHECK( nWhileWriting >= 3 );
+    BOOST_CHECK( nWhileWriting <= 12 );
+    // The last modifications are reported once, after writing stopped.
+    std::this_thread::sleep_for( std::chrono::milliseconds( 200 ) );
+    BOOST_CHECK( nReported - nWhileWriting <= 1 );
+    const int nAfter = nReported;
+    std::this_thread::sleep_for( std::chrono::milliseconds( 100 ) );
+    BOOST_CHECK( nAfter == nReported );
+    watcher.stop();
+    close( fd );
+    remove( path );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,192 @@
+/*
+ * Copyright (c) 2016 Renat R. Dusaev <crank@qcrypt.org>
+ * Author: Renat R. Dusaev <crank@qcrypt.org>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+# include "sV_config.h"
+
+# if defined(RPC_PROTOCOLS) && defined(ANALYSIS_ROUTINES)
+
+# define BOOST_TEST_NO_MAIN
+# include <boost/test/unit_test.hpp>
+
+# include "mCastReceiver.hpp"
+# include "analysis/processors/evMCast.hpp"
+# include "compr/DummyCompressor.hpp"
+
+# include <goo_exception.hpp>
+
+# include <atomic>
+# include <chrono>
+# include <cstring>
+# include <thread>
+
+namespace sV {
+namespace netTest1 {
+
+typedef ::sV::events::Event Event;
+typedef ::sV::events::MulticastMessage Message;
+
+// Unpacker collecting lengths of received events' blobs.
+class BlobCollector : public net::iMessageUnpacker {
+public:
+    std::vector<size_t> blobLengths;
+    BlobCollector() : net::iMessageUnpacker( 1024, 64*1024 ) {}
+protected:
+    virtual bool _V_treat_event( const Event & e ) override {
+        blobLengths.push_back( e.blob().size() );
+        return true;
+    }
+};
+
+// Pass-through decompressor occupying another compression method.
+class PassThroughDecompressor : public iDecompressor {
+public:
+    PassThroughDecompressor() :
+        iDecompressor(events::DeflatedBucketMetaInfo_CompressionMethod_ZLIB) {}
+protected:
+    virtual size_t _V_decompress_series( uint8_t * dst, size_t dstLen,
+                                         uint8_t * src, size_t srcLen ) const override {
+        if( srcLen > dstLen ) {
+            emraise( overflow, "Pass-through: %zu > %zu.", srcLen, dstLen );
+        }
+        memcpy( dst, src, srcLen );
+        return srcLen;
+    }
+};
+
+static void
+fill_event( Event & e, size_t blobLength, char c ) {
+    e.Clear();
+    e.set_blob( std::string( blobLength, c ) );
+}
+
+// Builds serialized message with bucket of given events declaring given
+// uncompressed length.
+static std::string
+bucket_message( const std::vector<size_t> & blobLengths,
+                events::CompressionMethod m,
+                uint32_t declaredLength ) {
+    events::Bucket b;
+    for( size_t l : blobLengths ) {
+        fill_event( *b.add_events(), l, 'x' );
+    }
+    Message msg;
+    auto db = msg.mutable_deflatedbucket();
+    db->mutable_metainfo()->set_comprmethod( m );
+    db->mutable_metainfo()->set_uncompressedlength( declaredLength );
+    db->set_deflatedcontent( b.SerializeAsString() );
+    return msg.SerializeAsString();
+}
+
+// Receiver collecting blobs of events in its own thread.
+class MulticastCollector : public net::iMulticastEventReceiver {
+public:
+    std::atomic<size_t> nEvents, nBytes;
+    MulticastCollector( boost::asio::io_service & ios, int portNo ) :
+            net::iMulticastEventReceiver( ios,
+                boost::asio::ip::address::from_string("0.0.0.0"),
+                boost::asio::ip::address::from_string("239.255.0.1"),
+                portNo ),
+            nEvents(0), nBytes(0) {}
+protected:
+    virtual bool _V_treat_event( const Event & e ) override {
+        nBytes += e.blob().size();
+        ++nEvents;
+        return true;
+    }
+};
+
+}  // namespace netTest1
+}  // namespace sV
+
+BOOST_AUTO_TEST_SUITE( Network_suite )
+
+BOOST_AUTO_TEST_CASE( Unpacker_bounds_case ) {
+    using namespace sV::netTest1;
+    BlobCollector c;
+    // Declared length is ignored for uncompressed buckets: content larger
+    // than both declared and default lengths is delivered entirely.
+    std::string s = bucket_message( {2000, 3000, 10},
+            sV::events::DeflatedBucketMetaInfo_CompressionMethod_UNCOMPRESSED, 16 );
+    BOOST_REQUIRE( c.unpack_message( (const unsigned char *) s.data(), s.size() ) );
+    BOOST_REQUIRE( 3 == c.blobLengths.size() );
+    BOOST_REQUIRE( 3000 == c.blobLengths[1] );
+
+    c.add_decompressor( new PassThroughDecompressor() );
+    c.blobLengths.clear();
+    // Declared length exceeding the limit => bucket dropped.
+    s = bucket_message( {100},
+            sV::events::DeflatedBucketMetaInfo_CompressionMethod_ZLIB, 1024*1024 );
+    BOOST_REQUIRE( c.unpack_message( (const unsigned char *) s.data(), s.size() ) );
+    BOOST_REQUIRE( c.blobLengths.empty() );
+    // Declared length (and buffer left from previous buckets) is
+    // insufficient => decompressor fails, bucket dropped.
+    s = bucket_message( {20000},
+            sV::events::DeflatedBucketMetaInfo_CompressionMethod_ZLIB, 64 );
+    BOOST_REQUIRE( c.unpack_message( (const unsigned char *) s.data(), s.size() ) );
+    BOOST_REQUIRE( c.blobLengths.empty() );
+    // Correct declaration => delivered.
+    s = bucket_message( {5000},
+            sV::events::DeflatedBucketMetaInfo_CompressionMethod_ZLIB, 6000 );
+    BOOST_REQUIRE( c.unpack_message( (const unsigned char *) s.data(), s.size() ) );
+    BOOST_REQUIRE( 1 == c.blobLengths.size() );
+}
+
+BOOST_AUTO_TEST_CASE( Multicast_bucketing_roundtrip_case ) {
+    using namespace sV::netTest1;
+    const int portNo = 30117;
+    const size_t nEvents = 64;
+    boost::asio::io_service recvIOS;
+    MulticastCollector receiver( recvIOS, portNo );
+    std::thread recvThread( [&recvIOS]{ recvIOS.run(); } );
+
+    size_t nBytesSent = 0,
+           nBucketsSent;
+    {
+        sV::dprocessors::EventMulticaster mc( "mcast-ut",
+                boost::asio::ip::address::from_string("239.255.0.1"),
+                nEvents, portNo, nullptr, 1024,
+                new sV::DummyCompressor(), 8 );
+        Event e;
+        for( size_t i = 0; i < nEvents; ++i ) {
+            // Few large events make bucket to be flushed by its size.
+            size_t l = (i % 16 == 5) ? 20000 : 100;
+            fill_event( e, l, 'a' + i%26 );
+            nBytesSent += l;
+            BOOST_REQUIRE( mc.process_event( &e ) );
+        }
+        // Destruction flushes the rest.
+        nBucketsSent = mc.n_buckets_sent();
+    }
+    for( int i = 0; i < 500 && receiver.nEvents < nEvents; ++i ) {
+        std::this_thread::sleep_for( std::chrono::milliseconds(10) );
+    }
+    recvIOS.stop();
+    recvThread.join();
+
+    BOOST_REQUIRE( nBucketsSent > 0 );
+    BOOST_REQUIRE( nEvents == receiver.nEvents );
+    BOOST_REQUIRE( nBytesSent == receiver.nBytes );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+# endif  // defined(RPC_PROTOCOLS) && defined(ANALYSIS_ROUTINES)
@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2016 Renat R. Dusaev <crank@qcrypt.org>
+ * Author: Renat R. Dusaev <crank@qcrypt.org>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+# include "sV_config.h"
+
+# if defined(RPC_PROTOCOLS)
+
+# define BOOST_TEST_NO_MAIN
+# include <boost/test/unit_test.hpp>
+
+# include "streamSender.tcc"
+# include "streamReceiver.tcc"
+
+# include <atomic>
+# include <chrono>
+# include <thread>
+
+namespace sV {
+namespace netTest2 {
+
+typedef ::sV::events::MulticastMessage Message;
+typedef ::sV::events::MulticastMessage_SenderStatusMessage_SenderStatus SenderStatus;
+
+template<typename ProtocolT>
+class TestSender : public net::iTStreamEventSender<ProtocolT> {
+public:
+    TestSender( boost::asio::io_service & ios,
+                const typename ProtocolT::endpoint & ep,
+                size_t clientQueueLength ) :
+            net::iTStreamEventSender<ProtocolT>( ios, ep, clientQueueLength ) {}
+};
+
+template<typename ProtocolT>
+class TestReceiver : public net::iTStreamEventReceiver<ProtocolT> {
+public:
+    std::atomic<size_t> nEvents;
+    SenderStatus lastStatus;
+    TestReceiver( boost::asio::io_service & ios,
+                  const typename ProtocolT::endpoint & ep ) :
+            net::iTStreamEventReceiver<ProtocolT>( ios, ep ),
+            nEvents(0),
+            lastStatus( ::sV::events::MulticastMessage_SenderStatusMessage_SenderStatus_UNKNOWN ) {}
+protected:
+    virtual bool _V_treat_event( const ::sV::events::Event & ) override {
+        ++nEvents;
+        return true;
+    }
+    virtual bool _V_treat_sender_status(
+                    const Message::SenderStatusMessage & st ) override {
+        lastStatus = st.senderstatus();
+        return true;
+    }
+};
+
+template<typename PredicateT> static bool
+wait_for( PredicateT p, size_t ms=5000 ) {
+    for( size_t i = 0; i < ms/10 && !p(); ++i ) {
+        std::this_thread::sleep_for( std::chrono::milliseconds(10) );
+    }
+    return p();
+}
+
+// Streams large frames to two subscribers: one keeps up with sender while
+// another does not read at all and thus has to be disconnected once its
+// socket buffers and queue are exhausted. Fast one has to receive every
+// event followed by quenching status.
+template<typename ProtocolT> static void
+run_roundtrip( const typename ProtocolT::endpoint & ep ) {
+    const size_t nFrames = 512,
+                 frameLength = 64*1024;
+    boost::asio::io_service senderIOS, receiversIOS;
+    std::unique_ptr<TestSender<ProtocolT> > sender(
+                        new TestSender<ProtocolT>( senderIOS, ep, 4 ) );
+    TestReceiver<ProtocolT> fast( receiversIOS, ep ),
+                            slow( receiversIOS, ep );
+    BOOST_REQUIRE( wait_for( [&]{ return 2 == sender->n_clients(); } ) );
+
+    std::thread fastThread( [&fast]{ while( fast.receive_message() ); } );
+
+    Message msg;
+    msg.mutable_event()->set_blob( std::string( frameLength, 's' ) );
+    for( size_t i = 0; i < nFrames; ++i ) {
+        sender->send_message( msg );
+        BOOST_REQUIRE( wait_for( [&]{ return fast.nEvents > i; } ) );
+    }
+    BOOST_REQUIRE( wait_for( [&]{ return 1 == sender->n_slow_dropped(); } ) );
+    BOOST_REQUIRE( 1 == sender->n_clients() );
+
+    // Quenches remaining subscriber.
+    sender.reset();
+    fastThread.join();
+    BOOST_REQUIRE( nFrames == fast.nEvents );
+    BOOST_REQUIRE( ::sV::events::MulticastMessage_SenderStatusMessage_SenderStatus_QUENCHING
+                   == fast.lastStatus );
+    // Slow one got only the beginning of stream, followed by disconnection.
+    while( slow.receive_message() );
+    BOOST_REQUIRE( slow.nEvents < nFrames );
+}
+
+}  // namespace netTest2
+}  // namespace sV
+
+BOOST_AUTO_TEST_SUITE( Stream_suite )
+
+BOOST_AUTO_TEST_CASE( TCP_roundtrip_case ) {
+    sV::netTest2::run_roundtrip<boost::asio::ip::tcp>(
+        boost::asio::ip::tcp::endpoint(
+            boost::asio::ip::address::from_string("127.0.0.1"), 30119 ) );
+}
+
+# ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+BOOST_AUTO_TEST_CASE( UDS_roundtrip_case ) {
+    sV::netTest2::run_roundtrip<boost::asio::local::stream_protocol>(
+        boost::asio::local::stream_protocol::endpoint( "/tmp/sV-ut-stream.sock" ) );
+    ::unlink( "/tmp/sV-ut-stream.sock" );
+}
+# endif  // BOOST_ASIO_HAS_LOCAL_SOCKETS
+
+BOOST_AUTO_TEST_SUITE_END()
+
+# endif  // defined(RPC_PROTOCOLS)
@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2016 Renat R. Dusaev <crank@qcrypt.org>
+ * Author: Renat R. Dusaev <crank@qcrypt.org>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+# include "sV_config.h"
+
+# if defined(RPC_PROTOCOLS)
+
+# define BOOST_TEST_NO_MAIN
+# include <boost/test/unit_test.hpp>
+
+# include "shmRing.hpp"
+
+# include <memory>
+
+namespace sV {
+namespace netTest3 {
+
+const char gSegmentName[] = "sV-ut-ring";
+
+static void
+fill_event( ::sV::events::Event & e, uint64_t n ) {
+    e.Clear();
+    e.set_blob( std::to_string( n ) + std::string( 80, '.' ) );
+}
+
+static uint64_t
+event_number( const ::sV::events::Event & e ) {
+    return std::stoull( e.blob() );
+}
+
+}  // namespace netTest3
+}  // namespace sV
+
+BOOST_AUTO_TEST_SUITE( ShmRing_suite )
+
+BOOST_AUTO_TEST_CASE( Overrun_case ) {
+    using namespace sV::netTest3;
+    using sV::net::ShmEventRingConsumer;
+    sV::net::ShmEventRingProducer producer( gSegmentName, 4096 );
+    ShmEventRingConsumer consumer( gSegmentName );
+    ::sV::events::Event e;
+    uint64_t n = 0;
+
+    // In-order reading.
+    for( ; n < 10; ++n ) {
+        fill_event( e, n );
+        BOOST_REQUIRE( producer.push_event( e ) );
+    }
+    for( uint64_t i = 0; i < 10; ++i ) {
+        BOOST_REQUIRE( ShmEventRingConsumer::ok == consumer.read_event( e ) );
+        BOOST_REQUIRE( i == event_number( e ) );
+    }
+    BOOST_REQUIRE( ShmEventRingConsumer::empty == consumer.read_event( e ) );
+
+    // Producer outruns consumer by far more than capacity: consumer skips
+    // ahead and the lost events are counted.
+    const uint64_t nLost = 1000;
+    for( uint64_t i = 0; i < nLost; ++i, ++n ) {
+        fill_event( e, n );
+        BOOST_REQUIRE( producer.push_event( e ) );
+    }
+    BOOST_REQUIRE( ShmEventRingConsumer::empty == consumer.read_event( e ) );
+    BOOST_REQUIRE( 1 == consumer.n_overruns() );
+    for( uint64_t i = 0; i < 5; ++i, ++n ) {
+        fill_event( e, n );
+        BOOST_REQUIRE( producer.push_event( e ) );
+    }
+    for( uint64_t i = 0; i < 5; ++i ) {
+        BOOST_REQUIRE( ShmEventRingConsumer::ok == consumer.read_event( e ) );
+        BOOST_REQUIRE( n - 5 + i == event_number( e ) );
+    }
+    BOOST_REQUIRE( nLost == consumer.n_skipped() );
+    BOOST_REQUIRE( 15 == consumer.n_read() );
+    BOOST_REQUIRE( 0 == consumer.n_corrupted() );
+}
+
+BOOST_AUTO_TEST_CASE( Producer_restart_case ) {
+    using namespace sV::netTest3;
+    using sV::net::ShmEventRingConsumer;
+    ::sV::events::Event e;
+    std::unique_ptr<sV::net::ShmEventRingProducer> first(
+            new sV::net::ShmEventRingProducer( gSegmentName, 4096 ) );
+    ShmEventRingConsumer oldConsumer( gSegmentName );
+    fill_event( e, 1 );
+    first->push_event( e );
+    // Restarted producer must not invalidate mapping of attached consumer.
+    sV::net::ShmEventRingProducer second( gSegmentName, 8192 );
+    BOOST_REQUIRE( ShmEventRingConsumer::ok == oldConsumer.read_event( e ) );
+    BOOST_REQUIRE( 1 == event_number( e ) );
+    BOOST_REQUIRE( oldConsumer.producer_quenched() );
+    BOOST_REQUIRE( ShmEventRingConsumer::quenched == oldConsumer.read_event( e ) );
+    // Old producer must not remove segment of new one.
+    first.reset();
+    ShmEventRingConsumer newConsumer( gSegmentName );
+    BOOST_REQUIRE( !newConsumer.producer_quenched() );
+    fill_event( e, 2 );
+    second.push_event( e );
+    BOOST_REQUIRE( ShmEventRingConsumer::ok == newConsumer.read_event( e ) );
+    BOOST_REQUIRE( 2 == event_number( e ) );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+# endif  // defined(RPC_PROTOCOLS)
@@ -34,6 +34,7 @@
 # include <unordered_map>
 # include <map>
 # include <list>
+# include <vector>
 
 class TEveManager;
 
@@ -42,6 +43,8 @@ namespace alignment {
 
 class Application;
 class CompoundDetector;
+class ReceptiveDetector;
+class DrawableDetector;
 
 /**@class DetectorsSet
  * @brief Class managing detectors representations for alignment tasks.
@@ -77,6 +80,23 @@ protected:
 
     /// Reverse index of detectors (placement ptr -> major):
     std::unordered_map<const DetectorPlacement *, AFR_DetMjNo> _majorIds;
+
+    /// Hits dispatching entry with pre-casted detector interfaces.
+    struct DispatchEntry {
+        DetectorPlacement * placement;
+        /// Null for detectors that are not (yet) constructed or not
+        /// receptive.
+        ReceptiveDetector * receptive;
+        /// Null for non-drawable detectors.
+        DrawableDetector * drawable;
+    };
+    /// Dense table indexed by detector major number.
+    std::vector<DispatchEntry> _dispatchTable;
+    /// Whether _dispatchTable reflects current state of indexes.
+    bool _dispatchTableValid;
+
+    /// (Re-)builds dense dispatching table from _byUniqueID index.
+    void _build_dispatch_table();
 private:
     /// Lowest level inserter --- operates with all the maps.
     void _emplace( const std::string & famName,
@@ -87,11 +107,15 @@ private:
                                             const std::string & detName,
                                             const DetectorPlacement & uninitPlacement );
 public:
+    DetectorsSet() : _dispatchTableValid(false) {}
+
     /// Should be called inside of application instance --- draws detector geometry.
     virtual void draw_detectors( TEveManager * );
     /// Should be called inside of application instance --- draws hits. Returns true,
-    /// if setup accepted the hits to draw.
-    bool dispatch_hits( const ::sV::events::Displayable & );
+    /// if setup accepted the hits to draw. When drawHits is false, hits are
+    /// only set to receptive detectors (headless applications, e.g. for
+    /// alignment, that have no graphical context).
+    bool dispatch_hits( const ::sV::events::Displayable &, bool drawHits=true );
     /// Reset hits. Returns true when at least one detector needs to be redrawn.
     bool reset_hits();
 
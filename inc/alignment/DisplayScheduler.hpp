@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2016 Renat R. Dusaev <crank@qcrypt.org>
+ * Author: Renat R. Dusaev <crank@qcrypt.org>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+# ifndef H_STROMA_V_ALIGNMENT_DISPLAY_SCHEDULER_H
+# define H_STROMA_V_ALIGNMENT_DISPLAY_SCHEDULER_H
+
+# include "sV_config.h"
+
+# ifdef ALIGNMENT_ROUTINES
+
+# include "../uevent.hpp"
+
+# include <mutex>
+# include <atomic>
+# include <chrono>
+# include <vector>
+
+namespace sV {
+namespace alignment {
+
+class DetectorsSet;
+
+/**@class DisplayScheduler
+ * @brief Decouples events receiving rate from event display frame rate.
+ *
+ * Events are submitted with submit() from arbitrary (e.g. receiving)
+ * thread. It never waits for drawing: the event is only copied into the
+ * ring of pending slots (messages are re-used, so no allocation happens
+ * in steady state). Events arriving between two frames are coalesced with
+ * respect to policy:
+ *  - latest: only the most recent event is kept (sampling);
+ *  - merge: summaries are accumulated, so detectors hit in any of
+ *    coalesced events are displayed, each with its latest summary (the
+ *    most recent maxMerged events per frame are kept; eldest ones are
+ *    dropped).
+ * Pending events are merged by GUI thread upon rendering.
+ *
+ * GUI thread periodically invokes render_if_due() (e.g. from ROOT's
+ * TTimer). At most once per frame period it takes the pending state,
+ * dispatches it among detectors set and returns true if scene has to be
+ * redrawn.
+ *
+ * @ingroup alignment
+ */
+class DisplayScheduler {
+public:
+    typedef ::sV::events::Displayable Displayable;
+    typedef std::chrono::steady_clock Clock;
+    enum Policy {
+        latest,
+        merge,
+    };
+private:
+    DetectorsSet & _detectors;
+    const Policy _policy;
+    Clock::duration _framePeriod;
+    Clock::time_point _nextFrame;
+    size_t _maxMerged;
+
+    /// Guards pending ring.
+    std::mutex _mtx;
+    /// Ring of pending events, index of the eldest one and their number.
+    std::vector<Displayable> _pending;
+    size_t _pendingHead,
+           _nPending;
+    /// Ring taken by GUI thread on rendering (swapped with pending one).
+    std::vector<Displayable> _taken;
+    /// State being currently rendered (accessed by GUI thread only).
+    Displayable _current;
+
+    std::atomic<size_t> _nSubmitted,
+                        _nCoalesced,
+                        _nDropped,
+                        _nFrames;
+protected:
+    /// Takes pending events merging them (in order of arrival) into current
+    /// state. Returns false if there are none.
+    bool _take_pending();
+public:
+    /// Ctr. Frame rate is given in frames per second.
+    DisplayScheduler( DetectorsSet &,
+                      double frameRate=25.,
+                      Policy policy=latest,
+                      size_t maxMerged=64 );
+
+    /// Changes frame rate (frames per second).
+    void frame_rate( double );
+    /// Returns frame rate (frames per second).
+    double frame_rate() const;
+
+    /// Accepts the event to be displayed (thread-safe, never blocks for
+    /// rendering).
+    void submit( const Displayable & );
+
+    /// Renders pending state, if any. Returns true when scene has to be
+    /// redrawn.
+    bool render();
+    /// Invokes render() if frame period elapsed since the last frame.
+    bool render_if_due();
+    /// Returns time point of next frame.
+    Clock::time_point next_frame_time() const { return _nextFrame; }
+    /// Returns state rendered last (for GUI thread).
+    const Displayable & current() const { return _current; }
+
+    /// Number of submitted events.
+    size_t n_submitted() const { return _nSubmitted; }
+    /// Number of events that were coalesced with subsequent ones instead of
+    /// being rendered on its own.
+    size_t n_coalesced() const { return _nCoalesced; }
+    /// Number of events dropped due to merging limit (the eldest pending
+    /// ones).
+    size_t n_dropped() const { return _nDropped; }
+    /// Number of rendered frames.
+    size_t n_frames() const { return _nFrames; }
+};  // class DisplayScheduler
+
+}  // namespace alignment
+}  // namespace sV
+
+# endif  // ALIGNMENT_ROUTINES
+
+# endif  // H_STROMA_V_ALIGNMENT_DISPLAY_SCHEDULER_H
+
@@ -23,8 +23,9 @@
 # ifndef H_STROMA_V_ALIGNMENT_HIT_GRAPHICS_H
 # define H_STROMA_V_ALIGNMENT_HIT_GRAPHICS_H
 
-# include <list>
-# include <unordered_map>
+# include <vector>
+# include <cstdint>
+# include <cstddef>
 
 namespace sV {
 namespace aux {
@@ -49,28 +50,87 @@ struct HitGraphicsTraits {
         float positions[2][3];
     };
 
-    typedef std::list<IsotropicPointMarkerParameters *> IsotropicMarkers;
-    typedef std::list<AnisotropicPointMarkerParameters *> AnisotropicMarkers;
-    typedef std::list<LineMarkerParameters *> LineMarkers;
+    /// Contiguous pooled storage of markers. Clearing keeps allocated
+    /// memory, so markers of subsequent events re-use it.
+    template<typename MarkerT>
+    class MarkersBuffer {
+    private:
+        std::vector<MarkerT> _markers;
+    public:
+        typedef MarkerT Marker;
+        typedef typename std::vector<MarkerT>::const_iterator const_iterator;
+
+        /// Appends new (uninitialized) marker returning reference to it.
+        MarkerT & emplace() { _markers.emplace_back(); return _markers.back(); }
+        /// Appends copy of marker.
+        void push_back( const MarkerT & m ) { _markers.push_back( m ); }
+        /// Drops all the markers keeping memory allocated.
+        void clear() { _markers.clear(); }
+        /// Reserves memory for given number of markers.
+        void reserve( size_t n ) { _markers.reserve( n ); }
+
+        size_t size() const { return _markers.size(); }
+        bool empty() const { return _markers.empty(); }
+        const MarkerT * data() const { return _markers.data(); }
+        const_iterator begin() const { return _markers.begin(); }
+        const_iterator end() const { return _markers.end(); }
+        const MarkerT & operator[]( size_t n ) const { return _markers[n]; }
+    };
+
+    typedef MarkersBuffer<IsotropicPointMarkerParameters> IsotropicMarkers;
+    typedef MarkersBuffer<AnisotropicPointMarkerParameters> AnisotropicMarkers;
+    typedef MarkersBuffer<LineMarkerParameters> LineMarkers;
 
     struct HitMarkers {
         IsotropicMarkers    isotropicMarkers;
         AnisotropicMarkers  anisotropicMarkers;
         LineMarkers         lineMarkers;
+
+        /// Drops all the markers keeping memory allocated.
+        void clear() {
+            isotropicMarkers.clear();
+            anisotropicMarkers.clear();
+            lineMarkers.clear();
+        }
     };
 
     typedef void (*IsotropicPointPainter)( const IsotropicPointMarkerParameters & );
 };  // struct HitGraphicsTraits
 
+/**@brief Interface of painter drawing markers in bulk.
+ *
+ * Markers of each kind are given as contiguous arrays, so implementation
+ * may pass them to graphics backend at once (e.g. to fill single TEve
+ * point set) instead of drawing them one by one.
+ */
 struct iHitsPainter : public HitGraphicsTraits {
     using HitGraphicsTraits::IsotropicMarkers;
     using HitGraphicsTraits::AnisotropicMarkers;
     using HitGraphicsTraits::LineMarkers;
 
-    virtual void   draw_isotropic_points_markers( const HitGraphicsTraits::IsotropicMarkers &,
-                                                        IsotropicPointMarkerType ) = 0;
-    virtual void draw_anisotropic_points_markers( const HitGraphicsTraits::AnisotropicMarkers & ) = 0;
-    virtual void draw_line_markers( const HitGraphicsTraits::LineMarkers & ) = 0;
+    virtual ~iHitsPainter() {}
+
+    virtual void   draw_isotropic_points_markers( const IsotropicPointMarkerParameters *,
+                                                  size_t n,
+                                                  IsotropicPointMarkerType ) = 0;
+    virtual void draw_anisotropic_points_markers( const AnisotropicPointMarkerParameters *,
+                                                  size_t n ) = 0;
+    virtual void draw_line_markers( const LineMarkerParameters *, size_t n ) = 0;
+
+    /// Draws all the non-empty markers buffers.
+    void draw( const HitMarkers & m, IsotropicPointMarkerType t=dots ) {
+        if( !m.isotropicMarkers.empty() ) {
+            draw_isotropic_points_markers( m.isotropicMarkers.data(),
+                                           m.isotropicMarkers.size(), t );
+        }
+        if( !m.anisotropicMarkers.empty() ) {
+            draw_anisotropic_points_markers( m.anisotropicMarkers.data(),
+                                             m.anisotropicMarkers.size() );
+        }
+        if( !m.lineMarkers.empty() ) {
+            draw_line_markers( m.lineMarkers.data(), m.lineMarkers.size() );
+        }
+    }
 };  // struct iHitsPainter
 
 }  // namespace aux
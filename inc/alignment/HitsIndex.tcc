@@ -0,0 +1,286 @@
+/*
+ * Copyright (c) 2016 Renat R. Dusaev <crank@qcrypt.org>
+ * Author: Renat R. Dusaev <crank@qcrypt.org>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+# ifndef H_STROMA_V_ALIGNMENT_HITS_INDEX_H
+# define H_STROMA_V_ALIGNMENT_HITS_INDEX_H
+
+# include "TrackingVolume.tcc"
+
+# ifdef ALIGNMENT_ROUTINES
+
+# include <vector>
+# include <queue>
+# include <algorithm>
+
+namespace sV {
+namespace alignment {
+
+/**@class HitsGridIndex
+ * @brief Uniform grid spatial index of points kept by TrackReceptiveVolume.
+ *
+ * Splits normalized (XForm) volume space [0, 1]^D into equal cells and
+ * keeps copies of points in cells they fall into (points out of range are
+ * attributed to the boundary cells). Index is maintained incrementally
+ * by cache updaters of the volume it is attached to, so it always refers
+ * to points of the sets being currently kept.
+ *
+ * Provides radius and k-nearest neighbours queries in normalized
+ * coordinates. With cell size being comparable to typical query radius,
+ * query costs are proportional to local points density instead of total
+ * number of points.
+ *
+ * Index has to be destroyed before the volume, or volume has to be
+ * destroyed first with no further updates to index expected.
+ *
+ * @ingroup alignment
+ */
+template<uint8_t D>
+class HitsGridIndex {
+public:
+    typedef TrackReceptiveVolume<D> Volume;
+    typedef typename Volume::LocalCoordinates LocalCoordinates;
+private:
+    Volume & _volume;
+    /// Number of cells along each dimension.
+    const size_t _nCells;
+    /// Cell edge length in normalized units.
+    const float _cellSize;
+    /// Points by cell (row-major cells numbering).
+    std::vector< std::vector<LocalCoordinates> > _cells;
+    /// Total number of points indexed.
+    size_t _nPoints;
+
+    /// Returns cell number along dimension for coordinate value.
+    size_t _cell_coordinate( float x ) const {
+        if( !(x > 0) ) return 0;  // also catches NaN
+        size_t n = (size_t) (x/_cellSize);
+        return n < _nCells ? n : _nCells - 1;
+    }
+
+    /// Returns linear cell index for grid coordinates.
+    size_t _cell_index( const size_t * g ) const {
+        size_t idx = 0;
+        for( uint8_t d = 0; d < D; ++d ) {
+            idx = idx*_nCells + g[d];
+        }
+        return idx;
+    }
+
+    /// Returns cell containing the point.
+    std::vector<LocalCoordinates> & _cell_of( const float * r ) {
+        size_t g[D];
+        for( uint8_t d = 0; d < D; ++d ) {
+            g[d] = _cell_coordinate( r[d] );
+        }
+        return _cells[_cell_index(g)];
+    }
+
+    static float _distance2( const float * a, const float * b ) {
+        float s = 0;
+        for( uint8_t d = 0; d < D; ++d ) {
+            s += (a[d] - b[d])*(a[d] - b[d]);
+        }
+        return s;
+    }
+
+    /// Invokes callback for each cell within given grid coordinates box.
+    template<typename CallableT> void
+    _for_cells_in_box( const ptrdiff_t * lo, const ptrdiff_t * hi,
+                       CallableT && f ) const {
+        size_t g[D], clo[D], chi[D];
+        for( uint8_t d = 0; d < D; ++d ) {
+            const ptrdiff_t l = std::max( lo[d], ptrdiff_t(0) ),
+                            h = std::min( hi[d], ptrdiff_t(_nCells) - 1 );
+            if( l > h ) return;  // box does not intersect the grid
+            g[d] = clo[d] = l;
+            chi[d] = h;
+        }
+        for(;;) {
+            f( g, _cells[_cell_index(g)] );
+            uint8_t d = 0;
+            for( ; d < D; ++d ) {
+                if( ++g[d] <= chi[d] ) break;
+                g[d] = clo[d];
+            }
+            if( D == d ) break;
+        }
+    }
+
+    static bool _on_insert( AbstractTrackReceptiveVolume *, void * pt, void * self ) {
+        static_cast<HitsGridIndex*>(self)->insert(
+                        *static_cast<const LocalCoordinates *>(pt) );
+        return true;
+    }
+
+    static bool _on_remove( AbstractTrackReceptiveVolume *, void * pt, void * self ) {
+        static_cast<HitsGridIndex*>(self)->remove(
+                        *static_cast<const LocalCoordinates *>(pt) );
+        return true;
+    }
+public:
+    /// Attaches index to the volume, indexing points it already keeps.
+    HitsGridIndex( Volume & v, size_t nCellsPerDimension=16 ) :
+                _volume(v),
+                _nCells( nCellsPerDimension ? nCellsPerDimension : 1 ),
+                _cellSize( 1.f/_nCells ),
+                _nPoints(0) {
+        size_t nTotal = 1;
+        for( uint8_t d = 0; d < D; ++d ) {
+            nTotal *= _nCells;
+        }
+        _cells.resize( nTotal );
+        const auto sets = _volume.sets();
+        for( auto it = sets.begin(); sets.end() != it; ++it ) {
+            const auto ps = *it;
+            for( size_t i = 0; i < ps.size(); ++i ) {
+                insert( ps[i] );
+            }
+        }
+        _volume.add_updater_on_insert( _on_insert, this );
+        _volume.add_updater_on_remove( _on_remove, this );
+    }
+
+    /// Detaches index from the volume.
+    ~HitsGridIndex() {
+        _volume.remove_updater_on_insert( _on_insert, this );
+        _volume.remove_updater_on_remove( _on_remove, this );
+    }
+
+    HitsGridIndex( const HitsGridIndex & ) = delete;
+    HitsGridIndex & operator=( const HitsGridIndex & ) = delete;
+
+    /// Adds point to index (normally invoked by volume's updater).
+    void insert( const LocalCoordinates & c ) {
+        _cell_of( c.r ).push_back( c );
+        ++_nPoints;
+    }
+
+    /// Removes point from index (normally invoked by volume's updater).
+    /// Returns false if no such point was indexed.
+    bool remove( const LocalCoordinates & c ) {
+        auto & cell = _cell_of( c.r );
+        for( auto it = cell.begin(); cell.end() != it; ++it ) {
+            if( it->amplitude == c.amplitude
+             && std::equal( c.r, c.r + D, it->r ) ) {
+                *it = cell.back();
+                cell.pop_back();
+                --_nPoints;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /// Returns number of points indexed.
+    size_t size() const { return _nPoints; }
+
+    /// Appends points within given radius from the center (in normalized
+    /// coordinates) to the output container. Returns number of points found.
+    size_t in_radius( const float * center, float radius,
+                      std::vector<LocalCoordinates> & out ) const {
+        ptrdiff_t lo[D], hi[D];
+        for( uint8_t d = 0; d < D; ++d ) {
+            lo[d] = (ptrdiff_t) _cell_coordinate( center[d] - radius );
+            hi[d] = (ptrdiff_t) _cell_coordinate( center[d] + radius );
+        }
+        const float r2 = radius*radius;
+        const size_t nBefore = out.size();
+        _for_cells_in_box( lo, hi,
+            [&]( const size_t *, const std::vector<LocalCoordinates> & cell ) {
+                for( const auto & p : cell ) {
+                    if( _distance2( p.r, center ) <= r2 ) {
+                        out.push_back( p );
+                    }
+                }
+            } );
+        return out.size() - nBefore;
+    }
+
+    /// Fills output container with (up to) k nearest points to the center,
+    /// sorted by distance. Cells are visited in expanding shells around the
+    /// center's cell until no closer point can be found.
+    void nearest( const float * center, size_t k,
+                  std::vector<LocalCoordinates> & out ) const {
+        out.clear();
+        if( !k || !_nPoints ) return;
+        typedef std::pair<float, const LocalCoordinates *> Candidate;
+        // Max-heap of k best candidates.
+        std::priority_queue<Candidate> best;
+        // Center cell is clamped to the grid as points are, so that shells
+        // distance does not exceed actual one.
+        ptrdiff_t cg[D];
+        for( uint8_t d = 0; d < D; ++d ) {
+            cg[d] = (ptrdiff_t) _cell_coordinate( center[d] );
+        }
+        for( ptrdiff_t shell = 0; ; ++shell ) {
+            ptrdiff_t lo[D], hi[D];
+            bool coversGrid = true;
+            for( uint8_t d = 0; d < D; ++d ) {
+                lo[d] = cg[d] - shell;
+                hi[d] = cg[d] + shell;
+                if( lo[d] > 0 || hi[d] < ptrdiff_t(_nCells) - 1 ) {
+                    coversGrid = false;
+                }
+            }
+            _for_cells_in_box( lo, hi,
+                [&]( const size_t * g, const std::vector<LocalCoordinates> & cell ) {
+                    // Consider only cells of current shell surface.
+                    bool onSurface = false;
+                    for( uint8_t d = 0; d < D; ++d ) {
+                        if( ptrdiff_t(g[d]) == lo[d] || ptrdiff_t(g[d]) == hi[d] ) {
+                            onSurface = true;
+                            break;
+                        }
+                    }
+                    if( !onSurface ) return;
+                    for( const auto & p : cell ) {
+                        float d2 = _distance2( p.r, center );
+                        if( best.size() < k ) {
+                            best.push( Candidate( d2, &p ) );
+                        } else if( d2 < best.top().first ) {
+                            best.pop();
+                            best.push( Candidate( d2, &p ) );
+                        }
+                    }
+                } );
+            if( coversGrid ) break;
+            // Points in further shells are at least `shell` cells away.
+            if( best.size() == k ) {
+                const float bound = shell*_cellSize;
+                if( best.top().first <= bound*bound ) break;
+            }
+        }
+        out.resize( best.size() );
+        for( size_t i = best.size(); i > 0; --i ) {
+            out[i - 1] = *best.top().second;
+            best.pop();
+        }
+    }
+};  // class HitsGridIndex
+
+}  // namespace alignment
+}  // namespace sV
+
+# endif  // ALIGNMENT_ROUTINES
+
+# endif  // H_STROMA_V_ALIGNMENT_HITS_INDEX_H
+
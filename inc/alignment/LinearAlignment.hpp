@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) 2016 Renat R. Dusaev <crank@qcrypt.org>
+ * Author: Renat R. Dusaev <crank@qcrypt.org>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+# ifndef H_STROMA_V_ALIGNMENT_LINEAR_ALIGNMENT_H
+# define H_STROMA_V_ALIGNMENT_LINEAR_ALIGNMENT_H
+
+# include "sV_config.h"
+
+# ifdef ALIGNMENT_ROUTINES
+
+# include "alignment/TrackingGroup.hpp"
+# include "alignment/TrackFitter.hpp"
+
+# include <vector>
+# include <list>
+# include <string>
+
+namespace sV {
+namespace alignment {
+
+/**@class LinearAlignmentGroup
+ * @brief Tracking group accumulating residuals of straight (parabolic)
+ *        tracks for global least-squares alignment of its members.
+ *
+ * Each event, track candidates are formed from the most recent point sets
+ * of the group volumes (see LinearTrackFitter::add_group_combinations()).
+ * Candidates are collected into batch of configurable size and then fitted
+ * altogether. Combinations of hits in an event are mostly fakes, so by
+ * default only the best (by chi^2/NDF) candidate of each event is
+ * accepted. Accepted tracks contribute to normal equations for unknown
+ * members' transversal shifts. Assuming that measured position of hit i
+ * on member k(i) is biased by d_k, i.e. m_i = f(z_i) + d_k(i), the track
+ * parameters are eliminated analytically (per projection):
+ *
+ *      C += B^T W B - B^T W A V A^T W B,     b += B^T W r,
+ *
+ * where A is the track model design matrix, V = (A^T W A)^-1 is the fitted
+ * parameters covariance, r are residuals of the fit and B selects the
+ * member of each hit. Solving C d = b for free members yields the shifts
+ * (Millepede-like approach with no local parameters kept).
+ *
+ * Global shift, tilt (and bend, for parabolic model) of all the members are
+ * not determined by tracks, so at least nParameters members have to be
+ * fixed. By default, the first ones of the group are fixed.
+ *
+ * Parameters are taken from layout JSON group description:
+ *  - "model" --- "straight" (default) or "parabolic";
+ *  - "resolution" --- hits resolution, in global units (1 by default);
+ *  - "maxCombinations" --- maximum number of candidates per event (64);
+ *  - "batchSize" --- number of candidates to fit at once (4096);
+ *  - "maxChi2NDF" --- candidates with chi^2/NDF above are rejected (zero,
+ *    default, disables the cut);
+ *  - "candidates" --- "best" (default) to accept only the best candidate
+ *    of each event, or "all" to accept every candidate passing the cut;
+ *  - "fixed" --- list of members' names to be kept as reference.
+ *
+ * Accumulation state belongs only to the group, so groups may be
+ * reconstructed concurrently by TrackingScheduler. Members must not be
+ * included after the first event was reconstructed.
+ *
+ * @ingroup alignment
+ */
+class LinearAlignmentGroup : public TrackingGroup {
+public:
+    typedef TrackingGroupFactory::PTree PTree;
+
+    /// Alignment result for a group member.
+    struct Correction {
+        const Placement * placement;
+        /// Whether member was a reference one.
+        bool fixed;
+        /// Whether shifts were determined (false for members without
+        /// hits or for degenerate system).
+        bool determined;
+        /// Number of hits of accepted tracks.
+        size_t nHits;
+        /// Shifts to be added to placement position (x, y), and their
+        /// errors.
+        double shift[2], error[2];
+        /// Mean residuals (measured minus fitted), before alignment.
+        double meanResidual[2];
+    };
+protected:
+    const LinearTrackFitter _fitter;
+    float _resolution,
+          _maxChi2NDF;
+    size_t _maxCombinations,
+           _batchSize;
+    /// Whether only the best candidate of each event is accepted.
+    bool _bestOnly;
+    /// Names of reference members.
+    std::list<std::string> _fixedNames;
+
+    LinearTrackFitter::HitsBatch _batch;
+    LinearTrackFitter::Results _results;
+    /// Candidates of batch belonging to each event: event #e candidates are
+    /// [_eventOffsets[e], _eventOffsets[e+1]).
+    std::vector<size_t> _eventOffsets;
+
+    /// Normal equations (dense nVolumes x nVolumes matrix and r.h.s.), one
+    /// per projection.
+    std::vector<double> _C[2], _b[2];
+    /// Per-member hits counter and residuals sums (for reference).
+    std::vector<size_t> _nHits;
+    std::vector<double> _sumResiduals[2];
+    /// Per-candidate scratch: design matrix rows and their products with
+    /// covariance matrix.
+    std::vector<double> _a, _va;
+
+    size_t _nEvents,
+           _nCandidates,
+           _nAccepted;
+protected:
+    /// Appends track candidates of current event; fits the batch when it
+    /// is full.
+    virtual void _V_reconstruct_event() override;
+    /// Fits collected candidates and accumulates normal equations.
+    void _flush();
+    /// Returns true if fitted candidate passes the selection.
+    bool _is_acceptable( size_t c ) const;
+    /// Accumulates contribution of single fitted candidate.
+    void _accumulate( size_t c );
+public:
+    LinearAlignmentGroup( const std::string & name_, const PTree & );
+
+    /// Processes collected candidates and solves for members' shifts.
+    /// Accumulated statistics is kept, so it may be called more than once.
+    std::vector<Correction> solve();
+
+    /// Number of events considered.
+    size_t n_events() const { return _nEvents; }
+    /// Number of fitted track candidates.
+    size_t n_candidates() const { return _nCandidates; }
+    /// Number of candidates that passed the selection.
+    size_t n_accepted() const { return _nAccepted; }
+};  // class LinearAlignmentGroup
+
+}  // namespace alignment
+}  // namespace sV
+
+# endif  // ALIGNMENT_ROUTINES
+
+# endif  // H_STROMA_V_ALIGNMENT_LINEAR_ALIGNMENT_H
+
@@ -62,9 +62,13 @@ public:
         char * constructorName,
              * detectorName;
     };
+    /// Affine transformation [R|t] of local coordinates to global frame.
+    typedef float AffineMatrix[3][4];
 private:
     Position _position;
     Rotation _rotation;
+    /// Cached local-to-global transformation.
+    AffineMatrix _affine;
     union {
         ConstructorInfo * constructorInfo;
         iDetector * instancePtr;
@@ -75,6 +79,8 @@ protected:
     const char * constructor_name() const {
             return _detector.constructorInfo->constructorName; }
     void _free_constructorInfo();
+    /// Re-computes cached affine transformation from position and rotation.
+    void _update_affine();
     DetectorPlacement() = delete;
 public:
     //DetectorPlacement() : _position{0,0,0}, _rotation{0,0,0},
@@ -95,6 +101,26 @@ public:
 
     bool is_detector_constructed() const { return _isConstructed; }
 
+    /// Returns cached local-to-global transformation. Rotation is
+    /// R = Rz*Ry*Rx with angles given in degrees (the same convention as
+    /// used for drawing), translation is the position.
+    const AffineMatrix & local_to_global() const { return _affine; }
+
+    /// Transforms single point from local to global frame.
+    void to_global( const float * local, float * global ) const {
+        for( uint8_t i = 0; i < 3; ++i ) {
+            global[i] = _affine[i][0]*local[0] + _affine[i][1]*local[1]
+                      + _affine[i][2]*local[2] + _affine[i][3];
+        }
+    }
+
+    /// Transforms n points given by arrays of local coordinates into
+    /// arrays of global ones. Local z may be null for planar (2D) detectors
+    /// implying zero. Output arrays must not overlap the input ones.
+    void to_global_n( const float * lx, const float * ly, const float * lz,
+                      size_t n,
+                      float * gx, float * gy, float * gz ) const;
+
     iDetector * detector() {
             assert(is_detector_constructed());
             return _detector.instancePtr; }
@@ -34,7 +34,6 @@
 # include "alignment/TrackingVolume.tcc"
 
 # include <unordered_map>
-# include <unordered_set>
 
 namespace sV {
 namespace alignment {
@@ -54,6 +53,9 @@ public:
 protected:
     /// Ptr to current (packed) summary data.
     const PackedSummary * _summary;
+    /// Whether payload has to be unpacked upon recaching rather than on
+    /// first access.
+    bool _unpackEagerly;
     /// Has to unpack particular summary.
     virtual bool _V_recache_summary( const PackedSummary & ) = 0;
     /// Causes resetting of current cached instance.
@@ -73,26 +75,56 @@ public:
     /// Returns true if current (packed) summary instance is set.
     virtual bool has_common_summary() const { return _summary; }
     bool reset_summary() { return _V_reset_summary(); }
+    /// Forces unpacking upon recaching. Set for tracking group members,
+    /// since concurrently reconstructed groups may share detectors.
+    void unpack_eagerly( bool v ) { _unpackEagerly = v; }
+    /// Returns true if payload is unpacked upon recaching.
+    bool unpacks_eagerly() const { return _unpackEagerly; }
 };  // class ReceptiveDetector
 
+template<typename ConcreteHitT> class ReceptiveAssembly;
+
 /**@brief Aux receptive detector instance performing unpacking routines for
  * certain summary payload.
+ *
+ * Unpacking is deferred: recaching only checks the payload type and keeps
+ * pointer to packed data, while actual unpacking is performed upon first
+ * summary() access. Thus, detectors that are neither drawn nor consumed
+ * within an event do not pay for unpacking. Packed summary must outlive
+ * the current hit (what is implied by common_summary() anyway).
+ *
+ * Lazy unpacking is not thread-safe. Detectors included in tracking groups
+ * are therefore set to unpack eagerly (see unpack_eagerly()), so that their
+ * summaries are only read during concurrent reconstruction.
  */
 template<typename SummaryT>
 class CachedPayloadReceptiveDetector : public ReceptiveDetector {
 protected:
     bool _empty;
-    SummaryT _unpackedSummary;
+    /// Ptr to packed payload of current summary (null, if not set).
+    const ::google::protobuf::Any * _packedSummary;
+    /// Whether _unpackedSummary corresponds to _packedSummary.
+    mutable bool _unpacked;
+    mutable SummaryT _unpackedSummary;
+private:
+    /// Generation of assembly summary that has set this part last time.
+    size_t _assemblyGeneration;
 protected:
     virtual bool _V_recache_summary( const PackedSummary & summary_ ) override {
+        _unpacked = false;
         if( !summary_.has_summarydata() ) {
+            _packedSummary = nullptr;
             _empty = true;
             return false;
         }
         if( summary_.summarydata().Is<SummaryT>() ) {
-            summary_.summarydata().UnpackTo( &_unpackedSummary );
+            _packedSummary = &(summary_.summarydata());
             _empty = false;
+            if( _unpackEagerly ) {
+                summary();
+            }
         } else {
+            _packedSummary = nullptr;
             _empty = true;
             emraise( badParameter, "CachedPayloadReceptiveDetector instance "
                 "%p got wrong summary type to unpack.", this );
@@ -101,7 +133,11 @@ protected:
     }
     virtual bool _V_reset_summary() override {
         if( ReceptiveDetector::_V_reset_summary() ) {
-            _unpackedSummary.Clear();
+            _packedSummary = nullptr;
+            if( _unpacked ) {
+                _unpackedSummary.Clear();
+                _unpacked = false;
+            }
             return true;
         }
         return false;
@@ -110,16 +146,29 @@ public:
     CachedPayloadReceptiveDetector( const std::string & fn,
                                     const std::string & dn ) :
             iDetector( fn, dn, false, true, false ),
-            ReceptiveDetector(fn, dn), _empty(false) {}
-    const SummaryT & summary() const { return _unpackedSummary; }
+            ReceptiveDetector(fn, dn), _empty(false),
+            _packedSummary(nullptr), _unpacked(false),
+            _assemblyGeneration(0) {}
+    /// Returns summary, unpacking it on first access.
+    const SummaryT & summary() const {
+        if( !_unpacked && _packedSummary ) {
+            _packedSummary->UnpackTo( &_unpackedSummary );
+            _unpacked = true;
+        }
+        return _unpackedSummary;
+    }
     virtual bool has_summary() const { return !_empty; }
+
+    template<typename ConcreteHitT> friend class ReceptiveAssembly;
 };  // class CachedPayloadReceptiveDetector
 
 /**@brief Aux receptive detector assembly instance performing unpacking
  *        routines for certain summary payloads.
  *
  * The assemblies of detectors are usually present within set of multiple
- * similar parts with one particular summary.
+ * similar parts with one particular summary. Parts that were not mentioned
+ * in current assembly summary are reset; they are distinguished by
+ * generation number stamped on each part being set.
  */
 template<typename ConcreteHitT>
 class ReceptiveAssembly : public
@@ -131,21 +180,24 @@ public:
 protected:
     /// Child class has to fill this map by its own.
     PartsMap _parts;
+    /// Incremented on each assembly summary.
+    size_t _generation;
 protected:
     virtual bool _V_recache_summary( const PackedSummary & ps ) final {
         if(!Parent::_V_recache_summary(ps)){
             return false;
         }
-        std::unordered_set<AFR_DetSignature> met;
+        ++_generation;
         bool set = false;
         for( const auto & pSummary
                 : summary()
                 .partialsummaries() ) {
-            met.insert( pSummary.detectorid() );
-            set |= _parts[pSummary.detectorid()]->common_summary(pSummary);
+            ReceptivePart * part = _parts[pSummary.detectorid()];
+            part->_assemblyGeneration = _generation;
+            set |= part->common_summary(pSummary);
         }
         for( const auto & pEntryPair : _parts ) {
-            if( met.end() == met.find( pEntryPair.first ) ) {
+            if( pEntryPair.second->_assemblyGeneration != _generation ) {
                 pEntryPair.second->reset_summary();
             }
         }
@@ -155,7 +207,7 @@ public:
     ReceptiveAssembly( const std::string & fn,
                        const std::string & dn ) :
                 iDetector(fn, dn, false, true, false),
-                Parent( fn, dn ) {}
+                Parent( fn, dn ), _generation(0) {}
     const PartsMap & parts() const { return _parts; }
     PartsMap & mutable_parts() { return _parts; }
 };  // class CachedPayloadReceptiveDetector
@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) 2016 Renat R. Dusaev <crank@qcrypt.org>
+ * Author: Renat R. Dusaev <crank@qcrypt.org>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+# ifndef H_STROMA_V_ALIGNMENT_TRACK_FITTER_H
+# define H_STROMA_V_ALIGNMENT_TRACK_FITTER_H
+
+# include "sV_config.h"
+
+# ifdef ALIGNMENT_ROUTINES
+
+# include <vector>
+# include <cstdint>
+# include <cstddef>
+
+namespace sV {
+namespace alignment {
+
+class TrackingGroup;
+
+/**@class LinearTrackFitter
+ * @brief Batched weighted least-squares fitter of straight or parabolic
+ *        tracks.
+ *
+ * Fits both projections of track, x(z) and y(z), as polynomials of first
+ * (straight line) or second (parabola) order in global frame:
+ *
+ *      x(z) = p0 + p1*(z - zRef) [+ p2*(z - zRef)^2]
+ *
+ * where zRef is the mean z of candidate's hits (centering keeps normal
+ * equations well-conditioned and parameters' errors less correlated).
+ *
+ * Many candidates (hit combinations, events) are processed per fit() call.
+ * Hits are given in structure-of-arrays HitsBatch, moments are accumulated
+ * in independent lanes of LinearTrackFitter::nLanes values, so inner loops
+ * are vectorized by compiler with respect to target instruction set. With
+ * TRACK_FITTER_CLONES build option (GCC, x86_64) the batch routine is
+ * compiled for AVX-512, AVX2 and generic targets, chosen at load time;
+ * otherwise the instruction set is defined by compiler flags (e.g.
+ * -march=native).
+ *
+ * Hits may be obtained from tracking group volumes with
+ * add_group_combinations() which converts normalized local coordinates of
+ * the most recent point sets into global frame by volumes' ranges and
+ * placements.
+ *
+ * @ingroup alignment
+ */
+class LinearTrackFitter {
+public:
+    /// Number of parameters per projection.
+    enum Model : uint8_t {
+        straight  = 2,
+        parabolic = 3,
+    };
+    /// Number of independent accumulation lanes.
+    static constexpr size_t nLanes = 8;
+
+    /// Hits of fit candidates in structure-of-arrays form. Hits of
+    /// candidate #c are [offsets[c], offsets[c+1]).
+    struct HitsBatch {
+        /// Global coordinates.
+        std::vector<float> x, y, z;
+        /// Weights, 1/sigma^2 for x and y correspondingly.
+        std::vector<float> wx, wy;
+        /// Source tags of hits (e.g. index of volume within tracking group).
+        std::vector<uint32_t> sources;
+        /// Candidate boundaries.
+        std::vector<size_t> offsets;
+
+        HitsBatch() : offsets(1, 0) {}
+        /// Appends hit to currently filled candidate.
+        void add_hit( float x_, float y_, float z_, float wx_, float wy_,
+                      uint32_t source=0 ) {
+            x.push_back(x_); y.push_back(y_); z.push_back(z_);
+            wx.push_back(wx_); wy.push_back(wy_);
+            sources.push_back(source);
+        }
+        /// Finalizes currently filled candidate.
+        void close_candidate() { offsets.push_back( x.size() ); }
+        /// Returns number of (closed) candidates.
+        size_t n_candidates() const { return offsets.size() - 1; }
+        /// Returns number of hits.
+        size_t n_hits() const { return x.size(); }
+        /// Drops all the hits and candidates.
+        void clear();
+    };
+
+    /// Fitting results in structure-of-arrays form. Per-candidate arrays are
+    /// indexed by c*2 + projection (0 for x, 1 for y) for parameters and
+    /// covariances (np and np*np values of each, correspondingly).
+    struct Results {
+        uint8_t nParameters;
+        std::vector<float> zRef;
+        std::vector<float> parameters;
+        std::vector<float> covariances;
+        /// Total chi^2 of candidate (both projections).
+        std::vector<float> chi2;
+        /// Number of degrees of freedom (both projections).
+        std::vector<uint32_t> ndf;
+        /// Per-hit residuals (measured minus fitted), two values for hit.
+        std::vector<float> residuals;
+        /// Whether fit of candidate succeeded (enough hits, non-degenerate
+        /// normal equations).
+        std::vector<uint8_t> valid;
+
+        /// Returns pointer to np parameters of candidate projection.
+        const float * parameters_of( size_t c, uint8_t proj ) const
+            { return parameters.data() + (2*c + proj)*nParameters; }
+        /// Returns pointer to np*np covariance matrix of candidate projection.
+        const float * covariance_of( size_t c, uint8_t proj ) const
+            { return covariances.data() + (2*c + proj)*nParameters*nParameters; }
+    };
+private:
+    Model _model;
+public:
+    LinearTrackFitter( Model m=straight ) : _model(m) {}
+
+    /// Returns polynomial model in use.
+    Model model() const { return _model; }
+
+    /// Fits all the candidates of batch, (re-)filling results.
+    void fit( const HitsBatch &, Results & ) const;
+
+    /// Appends candidates formed by all combinations of points of the most
+    /// recent sets, one point per volume, of the tracking group. Volumes
+    /// with empty sets are omitted; new sets have to be opened on each event
+    /// (see mixins::AlignmentApplication::open_new_sets()), so volumes that
+    /// got no hits do not contribute points of previous events. Hits are
+    /// weighted by given resolution (in global units) and tagged by index
+    /// of their volume in TrackingGroup::volumes() order. Returns number of
+    /// candidates added (not more than maxCombinations).
+    static size_t add_group_combinations( const TrackingGroup &,
+                                          HitsBatch &,
+                                          float resolution,
+                                          size_t maxCombinations=1024 );
+};  // class LinearTrackFitter
+
+}  // namespace alignment
+}  // namespace sV
+
+# endif  // ALIGNMENT_ROUTINES
+
+# endif  // H_STROMA_V_ALIGNMENT_TRACK_FITTER_H
+
@@ -64,8 +64,17 @@ protected:
     std::unordered_map<const Volume *, const Placement *> _vol2pl;
     /// Stores order of insertion.
     std::list<const Volume *> _volumes;
+    /// Names of groups which reconstruction has to precede this one's.
+    std::list<std::string> _prerequisites;
 
     const std::string _name;
+protected:
+    /// Has to perform per-event reconstruction (e.g. track lines fitting)
+    /// once the hits are dispatched. Groups may be reconstructed
+    /// concurrently (see TrackingScheduler), so implementation must not
+    /// modify any state shared with other groups, except for ones declared
+    /// as its prerequisites.
+    virtual void _V_reconstruct_event() {}
 public:
     TrackingGroup( const std::string & name_ );
     virtual ~TrackingGroup() {}
@@ -88,6 +97,18 @@ public:
 
     /// Returns columes container.
     const DECLTYPE(_volumes) & volumes() const { return _volumes; }
+
+    /// Declares that group with given name has to be reconstructed before
+    /// this one.
+    void add_prerequisite( const std::string & groupName )
+        { _prerequisites.push_back( groupName ); }
+
+    /// Returns names of groups that has to be reconstructed before this one.
+    const std::list<std::string> & prerequisites() const
+        { return _prerequisites; }
+
+    /// Performs per-event reconstruction.
+    void reconstruct_event() { _V_reconstruct_event(); }
 };  // class TrackingGroup
 
 /**@brief Constructors dictionary for tracking groups.
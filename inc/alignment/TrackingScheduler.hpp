@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2016 Renat R. Dusaev <crank@qcrypt.org>
+ * Author: Renat R. Dusaev <crank@qcrypt.org>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+# ifndef H_STROMA_V_ALIGNMENT_TRACKING_SCHEDULER_H
+# define H_STROMA_V_ALIGNMENT_TRACKING_SCHEDULER_H
+
+# include "sV_config.h"
+
+# ifdef ALIGNMENT_ROUTINES
+
+# include <vector>
+# include <deque>
+# include <unordered_map>
+# include <thread>
+# include <mutex>
+# include <condition_variable>
+# include <exception>
+
+namespace sV {
+namespace alignment {
+
+class TrackingGroup;
+
+/**@class TrackingScheduler
+ * @brief Runs per-event reconstruction of tracking groups concurrently.
+ *
+ * Tracking groups are mutually independent unless dependency is declared
+ * explicitly with add_dependency() (usually, from "after" list of
+ * tracking group description in placements JSON). Scheduler keeps pool of
+ * worker threads and, on reconstruct_event(), executes each group's
+ * TrackingGroup::reconstruct_event() as soon as all its prerequisites are
+ * done. Calling thread participates in execution as well, so scheduler
+ * with zero workers reconstructs groups sequentially in topological order.
+ *
+ * Exception thrown by group reconstruction is re-thrown from
+ * reconstruct_event() after all the groups not depending on failed one
+ * are done.
+ *
+ * @ingroup alignment
+ */
+class TrackingScheduler {
+private:
+    struct Node {
+        TrackingGroup * group;
+        /// Indexes of nodes depending on this one.
+        std::vector<size_t> dependents;
+        /// Number of prerequisites.
+        size_t nPrerequisites;
+        /// Number of prerequisites not yet done in current event.
+        size_t nPending;
+        /// Set when some prerequisite failed in current event.
+        bool cancelled;
+    };
+
+    std::vector<Node> _nodes;
+    std::unordered_map<const TrackingGroup *, size_t> _indexes;
+
+    std::vector<std::thread> _workers;
+    std::mutex _mtx;
+    std::condition_variable _cv;
+    /// Nodes ready to be executed.
+    std::deque<size_t> _ready;
+    /// Number of nodes not done in current event.
+    size_t _nRemaining;
+    bool _stop;
+    /// First exception occured in current event.
+    std::exception_ptr _error;
+
+    /// Returns node index for group, raising notFound if group unknown.
+    size_t _index_of( const TrackingGroup * ) const;
+    /// Raises badArchitect if dependency graph contains cycles.
+    void _check_acyclic() const;
+    /// Reconstructs group of the node (lock must not be held).
+    void _execute( size_t );
+    /// Marks node done and enqueues dependents that became ready (lock
+    /// must be held).
+    void _complete( size_t, bool failed );
+    /// Worker thread routine.
+    void _worker_loop();
+public:
+    /// Ctr spawns given number of worker threads.
+    TrackingScheduler( size_t nWorkers );
+    /// Stops and joins worker threads.
+    ~TrackingScheduler();
+
+    TrackingScheduler( const TrackingScheduler & ) = delete;
+    TrackingScheduler & operator=( const TrackingScheduler & ) = delete;
+
+    /// Adds group to be scheduled.
+    void add_group( TrackingGroup * );
+    /// Declares that dependent group has to be reconstructed after the
+    /// prerequisite one. Both has to be added before. Raises badArchitect
+    /// (leaving the graph intact) if new dependency introduces a cycle.
+    void add_dependency( const TrackingGroup * dependent,
+                         const TrackingGroup * prerequisite );
+
+    /// Reconstructs all the groups for current event, blocking until all
+    /// are done.
+    void reconstruct_event();
+
+    /// Returns number of scheduled groups.
+    size_t n_groups() const { return _nodes.size(); }
+    /// Returns number of worker threads.
+    size_t n_workers() const { return _workers.size(); }
+};  // class TrackingScheduler
+
+}  // namespace alignment
+}  // namespace sV
+
+# endif  // ALIGNMENT_ROUTINES
+
+# endif  // H_STROMA_V_ALIGNMENT_TRACKING_SCHEDULER_H
+
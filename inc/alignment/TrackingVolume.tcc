@@ -33,6 +33,10 @@
 
 # include <unordered_map>
 # include <list>
+# include <vector>
+# include <algorithm>
+# include <cassert>
+# include <cstdlib>
 # include <cstring>
 # include <goo_types.h>
 # include <goo_exception.hpp>
@@ -75,6 +79,14 @@ public:
     virtual void add_updater_on_remove( CacheUpdater updater, void * userdata=nullptr )
             { _pointRecachingFunctionsRemoval.push_back( {updater, userdata} ); }
 
+    /// Removes cache updater previously added by add_updater_on_insert().
+    virtual void remove_updater_on_insert( CacheUpdater updater, void * userdata=nullptr )
+            { _pointRecachingFunctionsInsertion.remove( {updater, userdata} ); }
+
+    /// Removes cache updater previously added by add_updater_on_remove().
+    virtual void remove_updater_on_remove( CacheUpdater updater, void * userdata=nullptr )
+            { _pointRecachingFunctionsRemoval.remove( {updater, userdata} ); }
+
     template<uint8_t D> TrackReceptiveVolume<D> & as()
             { (void)(_2DCastCache); static_assert(2 == D || 3 == D, "Bad dimensions number"); }
     template<uint8_t D> const TrackReceptiveVolume<D> & as() const
@@ -99,14 +111,19 @@ public:
  *  3. On reconstruction done by user code it calls update_point() method
  *     each time it finds a hit or track point.
  * - Track line reconstruction procedures:
- *     Set filled by last event is available by most_recent_set(). Track
- *  line reconstruction code should use its track points (or, by choosing
- *  best hit) for further reconstruction.
+ *     Set filled by last event is available by most_recent_set(); all the
+ *  kept sets are available by sets(), starting from the most recent one.
+ *  Track line reconstruction code should use its track points (or, by
+ *  choosing best hit) for further reconstruction.
  *
- *  The point of this container is to minimize heap operation procedures
- *  with small object and reduce segmentation lacks (as possible) by
- *  introducing reentrant objects. Considering this points it is desirable
- *  to provide sufficient reserved capacity.
+ *  Points are kept in structure-of-arrays storage: amplitudes and each of
+ *  coordinates are stored in separate contiguous (cache line-aligned)
+ *  arrays, points of each set occupy contiguous range of these arrays, so
+ *  PointSet::amplitudes() and PointSet::coordinates() provide spans
+ *  suitable for vectorized processing. Sets ring has fixed capacity given
+ *  by n_sets(); points storage grows (preserving stored sets) only when
+ *  sets of one ring turn do not fit it anymore, so it is desirable to
+ *  provide sufficient reserved capacity upon construction.
  * */
 template<uint8_t D>
 class TrackReceptiveVolume : public AbstractTrackReceptiveVolume,
@@ -117,134 +134,289 @@ public:
         float amplitude, r[D];
     };
 
-    /// Set of points.
-    typedef std::list<LocalCoordinates *> PointSet;
+    /// Contiguous read-only array of floats.
+    struct Span {
+        const float * data;
+        size_t size;
 
-    /// Array of sets type.
-    typedef std::list<PointSet *> SetsStack;
-private:
-    /// Storage of free allocated point sets.
-    std::list<PointSet *> _freeSets;
+        const float * begin() const { return data; }
+        const float * end() const { return data + size; }
+        float operator[]( size_t n ) const { return data[n]; }
+    };
 
-    /// Storage of free reentrant coordinates.
-    std::list<LocalCoordinates *> _freePoints;
+    /// Set of points (view over the storage, valid until next modification
+    /// of the volume). Iterated from the most recent point; index-based
+    /// access and spans follow insertion order.
+    class PointSet {
+    private:
+        const TrackReceptiveVolume * _v;
+        size_t _offset, _n;
+    public:
+        class const_iterator : public std::iterator<
+                                            std::bidirectional_iterator_tag,
+                                            LocalCoordinates> {
+        private:
+            const PointSet * _s;
+            ptrdiff_t _i;
+            int _step;
+            mutable LocalCoordinates _c;
+        public:
+            const_iterator( const PointSet * s, ptrdiff_t i, int step ) :
+                                            _s(s), _i(i), _step(step) {}
+            LocalCoordinates operator*() const { return (*_s)[_i]; }
+            const LocalCoordinates * operator->() const
+                                            { _c = (*_s)[_i]; return &_c; }
+            const_iterator & operator++() { _i += _step; return *this; }
+            const_iterator & operator--() { _i -= _step; return *this; }
+            const_iterator operator++(int)
+                            { const_iterator r(*this); _i += _step; return r; }
+            const_iterator operator--(int)
+                            { const_iterator r(*this); _i -= _step; return r; }
+            bool operator==( const const_iterator & o ) const
+                                            { return _i == o._i; }
+            bool operator!=( const const_iterator & o ) const
+                                            { return _i != o._i; }
+        };
+
+        PointSet( const TrackReceptiveVolume * v, size_t offset, size_t n ) :
+                                            _v(v), _offset(offset), _n(n) {}
+
+        size_t size() const { return _n; }
+        bool empty() const { return !_n; }
+
+        /// Returns n-th point in insertion order.
+        LocalCoordinates operator[]( size_t n ) const {
+            LocalCoordinates c;
+            c.amplitude = _v->_amplitudes[_offset + n];
+            for( uint8_t d = 0; d < D; ++d ) {
+                c.r[d] = _v->_coordinates[d][_offset + n];
+            }
+            return c;
+        }
 
-    /// Ordered list of point sets (unordered). Front - recent.
-    SetsStack _pointSets;
+        /// Amplitudes of points in insertion order.
+        Span amplitudes() const { return Span{ _v->_amplitudes + _offset, _n }; }
+        /// Values of d-th coordinate of points in insertion order.
+        Span coordinates( uint8_t d ) const
+                        { return Span{ _v->_coordinates[d] + _offset, _n }; }
+
+        /// Most recent point first.
+        const_iterator begin() const { return const_iterator( this, ptrdiff_t(_n) - 1, -1 ); }
+        const_iterator end() const { return const_iterator( this, -1, -1 ); }
+        /// Insertion order.
+        const_iterator rbegin() const { return const_iterator( this, 0, 1 ); }
+        const_iterator rend() const { return const_iterator( this, _n, 1 ); }
+    };  // class PointSet
+
+    /// Sets ring view: iterated from the most recent set.
+    class SetsStack {
+    private:
+        const TrackReceptiveVolume * _v;
+    public:
+        class const_iterator : public std::iterator<
+                                            std::forward_iterator_tag,
+                                            PointSet> {
+        private:
+            const TrackReceptiveVolume * _v;
+            size_t _k;
+            mutable PointSet _s;
+        public:
+            const_iterator( const TrackReceptiveVolume * v, size_t k ) :
+                                _v(v), _k(k), _s(v, 0, 0) {}
+            PointSet operator*() const { return _v->_set(_k); }
+            const PointSet * operator->() const
+                                { _s = _v->_set(_k); return &_s; }
+            const_iterator & operator++() { ++_k; return *this; }
+            const_iterator operator++(int)
+                                { const_iterator r(*this); ++_k; return r; }
+            bool operator==( const const_iterator & o ) const
+                                { return _k == o._k; }
+            bool operator!=( const const_iterator & o ) const
+                                { return _k != o._k; }
+        };
+
+        SetsStack( const TrackReceptiveVolume * v ) : _v(v) {}
+
+        size_t size() const { return _v->_nUsed; }
+        bool empty() const { return !_v->_nUsed; }
+        /// Most recent set.
+        PointSet front() const { return _v->_set(0); }
+        const_iterator begin() const { return const_iterator( _v, 0 ); }
+        const_iterator end() const { return const_iterator( _v, _v->_nUsed ); }
+    };  // class SetsStack
+private:
+    /// Location of set within points storage.
+    struct SetSlot {
+        size_t offset, n;
+    };
+    /// Floats per cache line; arrays are padded to it.
+    static constexpr size_t _floatsAlignment = 16;
+
+    /// Ring of sets; its size is n_sets().
+    std::vector<SetSlot> _slots;
+    /// Ring index of most recent set and number of sets being kept.
+    size_t _head, _nUsed;
+
+    /// Single aligned buffer keeping all the arrays.
+    float * _buffer;
+    /// Points capacity of each array.
+    size_t _capacity;
+    float * _amplitudes,
+          * _coordinates[D];
+    /// Points of current set may be written up to this position without
+    /// overwriting other sets.
+    size_t _writeLimit;
+    /// Copy of last updated point.
+    LocalCoordinates _lastPoint;
+
+    /// Returns k-th set starting from the most recent one.
+    PointSet _set( size_t k ) const {
+        const SetSlot & sl = _slots[(_head + _slots.size() - k) % _slots.size()];
+        return PointSet( this, sl.offset, sl.n );
+    }
 
-    typename PointSet::iterator _cPoint;
+    /// Returns ring index of the oldest set being kept.
+    size_t _oldest() const {
+        return (_head + _slots.size() + 1 - _nUsed) % _slots.size();
+    }
 protected:
-    /// Shifts internal circular buffer by 1 or allocates new set.
-    /// When there are free sets "rotation" will acquire one from
-    /// free sets pool. Otherwise the elder one (from back) will
-    /// be taken from occupied.
-    void _rotate_sets() {
-        PointSet * newPsPtr;
-        if( !_freeSets.empty() ) {
-            newPsPtr = _freeSets.back();
-            _freeSets.pop_back();
-            assert( newPsPtr );
-        } else {
-            assert( !_pointSets.empty() );  // n_sets() needed to be called.
-            newPsPtr = _pointSets.back();
-            _pointSets.pop_back();
-            _clear_set( newPsPtr );
-            assert( newPsPtr );
+    /// (Re-)allocates storage of given capacity, copying kept sets into
+    /// the beginning of new arrays in their order.
+    void _reallocate( size_t capacity ) {
+        capacity = ((capacity + _floatsAlignment - 1)/_floatsAlignment)
+                 * _floatsAlignment;
+        void * newBuffer = nullptr;
+        if( posix_memalign( &newBuffer, _floatsAlignment*sizeof(float),
+                            capacity*(D + 1)*sizeof(float) ) ) {
+            emraise( memAllocError, "Unable to allocate points storage of "
+                     "%zu points for track receptive volume %p.",
+                     capacity, this );
         }
-        _pointSets.push_front( newPsPtr );
-    }
-
-    /// Sets up spare (or newly allocated) point.
-    void _next_point() {
-        LocalCoordinates * newPointPtr;
-        if( _freePoints.empty() ) {
-            newPointPtr = new LocalCoordinates;
-        } else {
-            newPointPtr = _freePoints.back();
-            _freePoints.pop_back();
+        float * amplitudes = static_cast<float*>(newBuffer),
+              * coordinates[D];
+        for( uint8_t d = 0; d < D; ++d ) {
+            coordinates[d] = amplitudes + (d + 1)*capacity;
         }
-        if( _pointSets.empty() ) {
-            emraise( badState, "Points storage with point sets number "
-                     "uninitialized up to point updating." );
+        size_t pos = 0;
+        for( size_t k = 0; k < _nUsed; ++k ) {
+            SetSlot & sl = _slots[(_oldest() + k) % _slots.size()];
+            memcpy( amplitudes + pos, _amplitudes + sl.offset,
+                    sl.n*sizeof(float) );
+            for( uint8_t d = 0; d < D; ++d ) {
+                memcpy( coordinates[d] + pos, _coordinates[d] + sl.offset,
+                        sl.n*sizeof(float) );
+            }
+            sl.offset = pos;
+            pos += sl.n;
         }
-        _pointSets.front()->push_front( newPointPtr );
-        _cPoint = _pointSets.front()->begin();
+        free( _buffer );
+        _buffer = static_cast<float*>(newBuffer);
+        _capacity = capacity;
+        _amplitudes = amplitudes;
+        memcpy( _coordinates, coordinates, sizeof(coordinates) );
+        _writeLimit = _capacity;
     }
 
-    /// Returns spare (or newly allocates) point set ptr.
-    /// Barely allocates new set.
-    PointSet * _new_point_set() {
-        return new PointSet;
-    }
-
-    /// Physically deletes set instance by ptr.
-    void _delete_set( PointSet * s ) {
-        delete s;
+    /// Returns nearest offset of the set (other than current) starting at or
+    /// after given position, or capacity if there are none.
+    size_t _next_occupied( size_t from ) const {
+        size_t limit = _capacity;
+        for( size_t k = 1; k < _nUsed; ++k ) {
+            const SetSlot & sl = _slots[(_head + _slots.size() - k) % _slots.size()];
+            if( sl.n && sl.offset >= from && sl.offset < limit ) {
+                limit = sl.offset;
+            }
+        }
+        return limit;
     }
 
-    /// Erases all points in a set; does not insert it to free sets pool.
-    void _clear_set( PointSet * ps ) {
-        if( ps->empty() ) { return; }
-        for( auto it = ps->begin(); ps->end() != it; ++it ) {
-            //sV_loge("=== WWW === XXX XXX XXX XXX %p\n", this); // XXX
-            _freePoints.push_back( *it );
-            _update_caches_on_removing( *it );
+    /// Makes room for one more point in current set, moving it to the
+    /// beginning of storage or growing storage if needed.
+    void _reserve_point() {
+        SetSlot & cur = _slots[_head];
+        const size_t pos = cur.offset + cur.n;
+        if( pos < _writeLimit ) {
+            return;
         }
-        ps->clear();
+        // Other sets could be evicted since limit was computed:
+        _writeLimit = _next_occupied( cur.offset );
+        if( pos < _writeLimit ) {
+            return;
+        }
+        if( _writeLimit == _capacity && cur.n + 1 <= _next_occupied(0)
+                                     && cur.n + 1 <= cur.offset ) {
+            // Wrap current set to the beginning of storage.
+            memmove( _amplitudes, _amplitudes + cur.offset,
+                     cur.n*sizeof(float) );
+            for( uint8_t d = 0; d < D; ++d ) {
+                memmove( _coordinates[d], _coordinates[d] + cur.offset,
+                         cur.n*sizeof(float) );
+            }
+            cur.offset = 0;
+            _writeLimit = _next_occupied( 1 );
+            return;
+        }
+        size_t nKept = 0;
+        for( size_t k = 0; k < _nUsed; ++k ) {
+            nKept += _slots[(_oldest() + k) % _slots.size()].n;
+        }
+        _reallocate( std::max( 2*_capacity, 2*(nKept + 1) ) );
     }
 
-    /// Actually deletes all spare points (from heap).
-    void _delete_free_points() {
-        for( auto * p : _freePoints ) {
-            delete p;
+    /// Forgets the oldest set, notifying cache updaters about its points.
+    void _evict_oldest() {
+        SetSlot & sl = _slots[_oldest()];
+        for( size_t i = 0; i < sl.n; ++i ) {
+            LocalCoordinates c = PointSet( this, sl.offset, sl.n )[i];
+            _update_caches_on_removing( &c );
         }
-        _freePoints.clear();
+        sl.n = 0;
+        --_nUsed;
     }
 
-    /// Actually deletes all spare sets (from heap).
-    void _delete_free_sets() {
-        for( auto * s : _freeSets ) {
-            _delete_set( s );
+    /// Shifts internal circular buffer by 1: the oldest set is forgotten
+    /// when ring is full.
+    void _rotate_sets() {
+        assert( !_slots.empty() );  // n_sets() needed to be called.
+        const size_t start = _nUsed ? _slots[_head].offset + _slots[_head].n
+                                    : 0;
+        if( _nUsed == _slots.size() ) {
+            _evict_oldest();
         }
-        _freeSets.clear();
+        _head = (_head + 1) % _slots.size();
+        _slots[_head] = SetSlot{ start, 0 };
+        ++_nUsed;
+        _writeLimit = _next_occupied( start );
     }
 public:
     /// Overrides ancestor interface's number-of-dimensions method.
     virtual uint8_t n_dimensions() const override { return D; }
 
-    /// Ctr allocates internal storage of given length. Note, that
-    /// nSets could be, in principle, set to 0, but it will lead to
+    /// Ctr allocates internal storage for given number of points. Note,
+    /// that nSets could be, in principle, set to 0, but it will lead to
     /// unpredicted behaviour other than n_sets(...) methods will be
     /// invoked.
-    TrackReceptiveVolume(size_t poolLength=1024, size_t nSets=1) {
-        for( size_t i = 0; i < poolLength; ++i ) {
-            _freePoints.push_back( new LocalCoordinates );
-        }
+    TrackReceptiveVolume(size_t poolLength=1024, size_t nSets=1) :
+                        _head(0), _nUsed(0),
+                        _buffer(nullptr), _capacity(0),
+                        _amplitudes(nullptr),
+                        _writeLimit(0) {
+        _reallocate( poolLength ? poolLength : _floatsAlignment );
         n_sets(nSets);
     }
 
-    /// Frees all dynamically-allocated objects.
+    TrackReceptiveVolume( const TrackReceptiveVolume & ) = delete;
+    TrackReceptiveVolume & operator=( const TrackReceptiveVolume & ) = delete;
+
+    /// Frees points storage.
     ~TrackReceptiveVolume() {
-        _delete_free_points();
-        _delete_free_sets();
-        for( auto * s : _pointSets ) {
-            PointSet & ps = *s;
-            for( auto * p : ps ) {
-                delete p;
-            }
-            ps.clear();
-            delete s;
-        }
-        _pointSets.clear();
+        free( _buffer );
     }
 
-    /// Changes number of point sets to be stored. On expansion
-    /// new sets will be added to free sets pool. On truncation,
-    /// the free sets pool will be truncated first; then the elder
-    /// ones will be removed from occupied sets if needed. If
-    /// required capacity is the same, nothing will be performed.
+    /// Changes number of point sets to be stored. On truncation, the elder
+    /// sets will be forgotten if needed. If required capacity is the same,
+    /// nothing will be performed.
     virtual void n_sets( size_t n ) override {
-        size_t oldSize = n_sets();
         # ifndef NDEBUG
         if( !n ) {
             sV_loge( "(Debug) Zero capacity for TrackReceptiveVolume cache required. "
@@ -252,88 +424,46 @@ public:
             n = 1;
         }
         # endif
-        if( oldSize == n ) {
+        if( n_sets() == n ) {
             return;  // keep capacity, do nothing
-        } else if( oldSize > n ) {  // reduce list capacity (truncate)
-            # if 1
-            size_t remCntr = oldSize - n;
-            //sV_log3( "#0 : remCntr = %zu; n = %zu; "
-            //             "_freeSets.size() = %zu "
-            //             "_pointSets.size() = %zu\n",
-            //             remCntr, n, _freeSets.size(),
-            //             _pointSets.size() );  // XXX
-            for( auto it  = _freeSets.begin();
-                      it != _freeSets.end() && remCntr; remCntr--, ++it ) {
-                //sV_loge("=== 1 === XXX XXX XXX XXX %p\n", this); // XXX
-                //_clear_set( *it );
-                _delete_set( *it );
-            }
-            //sV_log3( "#1 : remCntr = %zu; n = %zu; "
-            //             "_freeSets.size() = %zu "
-            //             "_pointSets.size() = %zu\n",
-            //             remCntr, n, _freeSets.size(),
-            //             _pointSets.size() );  // XXX
-            if( !remCntr ) {  // if there are still some to be left in free sets pool:
-                auto it = _freeSets.begin();
-                std::advance( it, n );
-                _freeSets.erase( _freeSets.begin(), it );
-                // sV_log3( "#2 : remCntr = %zu; n = %zu; "
-                //          "_freeSets.size() = %zu "
-                //          "_pointSets.size() = %zu\n",
-                //          remCntr, n, _freeSets.size(),
-                //          _pointSets.size() );  // XXX
-            } else {
-                _freeSets.clear();
-                for( auto it = _pointSets.rbegin();
-                     _pointSets.rend() != it && remCntr; remCntr--, ++it ) {
-                    //sV_loge("=== === XXX XXX 2 XXX XXX\n"); // XXX
-                    _clear_set( *it );
-                    _delete_set( *it );
-                }
-                _pointSets.resize( n );
-                // sV_log3( "#3 : remCntr = %zu; n = %zu; "
-                //          "_freeSets.size() = %zu "
-                //          "_pointSets.size() = %zu\n",
-                //          remCntr, n, _freeSets.size(),
-                //          _pointSets.size() );  // XXX
-            }
-            # else
-            auto it = _pointSets.begin();
-            std::advance( it, n );
-            auto fromIt = it;
-            for( ; it != _pointSets.end(); ++it ) {
-                _clear_set( *it );
-                _freeSets.push_back( *it );
-            }
-            _pointSets.erase( fromIt, _pointSets.end() );
-            # endif
-        } else {  // increase list capacity
-            const size_t toAllocate = n - oldSize;
-            for( size_t i = 0; i < toAllocate; ++i ) {
-                _freeSets.push_back( _new_point_set() );
-            }
         }
-        // XXX:
-        //sV_log3( "Changing point set capacity for track receptive volume %p "
-        //                "from %zu to %zu.\n", this, oldSize, n );
+        while( _nUsed > n ) {
+            _evict_oldest();
+        }
+        std::vector<SetSlot> slots( n, SetSlot{0, 0} );
+        for( size_t k = 0; k < _nUsed; ++k ) {
+            slots[k] = _slots[(_oldest() + k) % _slots.size()];
+        }
+        _slots.swap( slots );
+        _head = _nUsed ? _nUsed - 1 : n - 1;
     }
 
-    /// Returns number of  to be stored in container.
+    /// Returns number of sets to be stored in container.
     virtual size_t n_sets() const override
-        { return _pointSets.size() + _freeSets.size(); }
+        { return _slots.size(); }
+
+    /// Returns number of points that may be kept without reallocation.
+    size_t points_capacity() const { return _capacity; }
 
-    /// Fills new point in current set. Returns pointer to internal
-    /// local coordinates instance that can be further used for caching.
+    /// Fills new point in current set. Returns pointer to the copy of
+    /// point that remains valid until next invokation (the point itself
+    /// is kept in structure-of-arrays storage). Cache updaters are given
+    /// pointer to similar copy.
     const LocalCoordinates * update_point( const LocalCoordinates & cs ) {
-        if( _pointSets.empty() ) {
+        if( !_nUsed ) {
             open_new_set();
-            assert( !_pointSets.empty() );
+            assert( _nUsed );
         }
-        _next_point();
-        LocalCoordinates & c = **_cPoint;
-        memcpy( &c, &cs, sizeof(LocalCoordinates) );
-        _update_caches_on_insertion(&c);
-        return &c;
+        _reserve_point();
+        SetSlot & cur = _slots[_head];
+        const size_t pos = cur.offset + cur.n++;
+        _amplitudes[pos] = cs.amplitude;
+        for( uint8_t d = 0; d < D; ++d ) {
+            _coordinates[d][pos] = cs.r[d];
+        }
+        _lastPoint = cs;
+        _update_caches_on_insertion(&_lastPoint);
+        return &_lastPoint;
     }
 
     /// Shifts sets buffer.
@@ -342,11 +472,14 @@ public:
     }
 
     bool most_recent_set_is_empty() const {
-        return _pointSets.empty() || _pointSets.front()->empty();
+        return !_nUsed || !_slots[_head].n;
     }
 
-    /// Getter for all point sets:
-    const SetsStack & sets() const { return _pointSets; }
+    /// Returns set filled by last event.
+    PointSet most_recent_set() const { return sets().front(); }
+
+    /// Getter for all point sets (most recent first).
+    SetsStack sets() const { return SetsStack(this); }
 };  // class TrackReceptiveVolume
 
 template<> TrackReceptiveVolume<2> & AbstractTrackReceptiveVolume::as<2>();
@@ -76,26 +76,24 @@ protected:
         return &( mdt.acquire_metadata_for( *this ) );
     }
 
-    # if 0  // see notes at BulkEventHandle::event_read_*
     /// Protected accessor method used by proxy event source class.
     /// @see BatchEventsHandle
     Event * _md_event_read_single( const SpecificMetadata & md,
                                            const EventIDT & eid ) {
-        return _V_md_event_read_single(md, eid); }
+        return this->_V_md_event_read_single(md, eid); }
     /// Protected accessor method used by proxy event source class.
     /// @see BatchEventsHandle
     std::unique_ptr<aux::iEventSequence> _md_event_read_range(
                                         const SpecificMetadata & md,
                                         const EventIDT & eidFrom,
                                         const EventIDT & eidTo ) {
-        return _V_md_event_read_range(md, eidFrom, eidTo); }
+        return this->_V_md_event_read_range(md, eidFrom, eidTo); }
     /// Protected accessor method used by proxy event source class.
     /// @see BatchEventsHandle
     std::unique_ptr<aux::iEventSequence> _md_event_read_list(
                                     const SpecificMetadata & md,
                                     const std::list<EventID> & eidsList ) {
-        return _V_md_event_read_list(md, eidsList); }
-    # endif
+        return this->_V_md_event_read_list(md, eidsList); }
 public:
     iSectionalEventSource( const SourceIDT & id,
                            aux::iEventSequence::Features_t fts=0x0 ) :
@@ -28,12 +28,17 @@
 # if defined(RPC_PROTOCOLS) && defined(ANALYSIS_ROUTINES)
 
 # include <boost/asio.hpp>
+# include <list>
 # include <mutex>
+# include <unordered_set>
+# include <vector>
 # include <boost/circular_buffer.hpp>
 # include <boost/thread.hpp>
 # include "app/analysis.hpp"
 # include "uevent.hpp"
+# include "detector_ids.h"
 # include "mCastSender.hpp"
+# include "compr/iCompressor.hpp"
 
 namespace sV {
 namespace dprocessors {
@@ -54,12 +59,17 @@ class EventPipelineStorage : public AnalysisPipeline::iEventProcessor {
 public:
     typedef ::sV::events::Event Event;
 private:
-    size_t _nProcessed;
+    size_t _nProcessed,
+           _nDropped;
     boost::circular_buffer<Event> _queue;
 protected:
     std::mutex _queueMutex;
 
     virtual bool _push_event_to_queue( const Event & );
+    /// Called under queue lock before new event is pushed; overwritten is
+    /// the oldest event to be lost (null if queue is not full).
+    virtual void _V_on_push( const Event & /*newEvent*/,
+                             const Event * /*overwritten*/ ) {}
     virtual bool _V_process_event( Event * ) override;
 public:
     EventPipelineStorage( const std::string & pName, size_t queueLength );
@@ -69,8 +79,42 @@ public:
     boost::circular_buffer<Event> & events_queue() { return _queue; }
 
     size_t n_processed() const { return _nProcessed; }
+    /// Number of events overwritten in queue before they were consumed.
+    size_t n_dropped() const { return _nDropped; }
     bool is_empty() const { return _queue.empty(); }
 };  // class EventPipeline
+
+/**@class DetectorSummarySelector
+ * @brief Predicate selecting DetectorSummary entries of event.
+ *
+ * Matches summary by detector major number and/or by type of summary
+ * payload (full protobuf message name of packed google.protobuf.Any
+ * message). Empty criterion matches everything.
+ *
+ * Textual form is a semicolon-separated list of criteria:
+ *      detectors=<name>[,<name>...];payload=<type>[,<type>...]
+ * where detector names are resolved with iDetectorIndex.
+ * */
+class DetectorSummarySelector {
+public:
+    typedef ::sV::events::Event Event;
+private:
+    std::unordered_set<AFR_DetMjNo> _majors;
+    std::unordered_set<std::string> _payloadTypes;
+public:
+    void add_major( AFR_DetMjNo mj ) { _majors.insert( mj ); }
+    void add_payload_type( const std::string & t ) { _payloadTypes.insert( t ); }
+
+    /// Returns true if summary matches the criteria.
+    bool matches( const ::sV::events::DetectorSummary & ) const;
+
+    /// Copies matching detector summaries of displayable info from src to
+    /// dst (the rest of event is omitted). Returns number of copied entries.
+    size_t select( const Event & src, Event & dst ) const;
+
+    /// Parses textual selector form.
+    static DetectorSummarySelector parse( const std::string & );
+};  // class DetectorSummarySelector
 }  // namespace aux
 
 
@@ -79,6 +123,21 @@ public:
  *
  * This class implements storaging and sending interfaces of event
  * multicasting API.
+ *
+ * When compressor is given and bucket size is non-zero, events will be
+ * accumulated in queue until the requested number is reached or until
+ * their serialized size approaches the datagram limit. Then they are packed
+ * into Bucket message, compressed and sent as a DeflatedBucket payload
+ * (compression method is written in its meta-info and advertised in sender
+ * status messages). Bucket never exceeds maxBucketLength bytes
+ * (uncompressed) unless it consists of single oversized event. Remaining
+ * events are flushed on destruction, after pending sending is done.
+ *
+ * Additional channels (each being another multicaster bound to its own
+ * group or port) may be attached with add_channel(). Every channel receives
+ * only the detector summaries matching its selector, so subscribers may join
+ * only the groups they need. Sending of the full stream to the main group
+ * can then be disabled.
  */
 class EventMulticaster : public net::iMulticastEventSender,
                          public aux::EventPipelineStorage {
@@ -87,22 +146,66 @@ public:
     typedef ::sV::events::MulticastMessage Message;
 private:
     boost::asio::io_service * _ioServicePtr;
-    bool _ownIOService;
     Message _reentrantMessageKeeper;
+
+    iCompressor * _compressor;
+    size_t _bucketNEvents;
+    /// Serialized length of queued events as bucket entries.
+    size_t _queuedBytes;
+    events::Bucket _reentrantBucket;
+    std::vector<uint8_t> _uncomprBuffer,
+                         _comprBuffer;
+    size_t _nBucketsSent;
+
+    /// Per-selection channel.
+    struct Channel {
+        aux::DetectorSummarySelector selector;
+        EventMulticaster * multicaster;
+    };
+    std::list<Channel> _channels;
+    Event _reentrantChannelEvent;
+    bool _sendFullStream;
 protected:
+    /// Packs at most n events from queue tail (oldest ones) into deflated
+    /// bucket message. Queue mutex has to be locked by invoker.
+    void _pack_bucket( size_t n );
+    /// Returns true if events have to be packed into buckets.
+    bool _do_bucketing() const { return _compressor && _bucketNEvents; }
+    /// Returns true if queued events make up a bucket to be sent.
+    bool _bucket_is_due() const;
+    /// Returns length of event serialized as bucket entry.
+    static size_t _bucket_entry_length( const Event & );
+
+    virtual void _V_on_push( const Event &, const Event * ) override;
+
     virtual bool _V_do_continue_transmission() const override;
     virtual void _V_send_next_message() override;
     virtual bool _V_process_event( Event * eventPtr ) override;
     virtual void _V_print_brief_summary( std::ostream & os ) const override;
 public:
+    /// Maximal length of uncompressed bucket; reserves room for message
+    /// envelope within datagram.
+    static constexpr size_t maxBucketLength = maxDatagramLength - 128;
+
     EventMulticaster( const std::string & pn,
                       const boost::asio::ip::address & multicastAddress,
                       size_t queueLength,
                       int portNo=30001,
                       boost::asio::io_service * ioServicePtr=nullptr,
-                      size_t sendingBufferSize=1024*1024 );
+                      size_t sendingBufferSize=1024*1024,
+                      iCompressor * compressor=nullptr,
+                      size_t bucketNEvents=0 );
     ~EventMulticaster();
 
+    /// Number of compressed buckets sent.
+    size_t n_buckets_sent() const { return _nBucketsSent; }
+
+    /// Adds channel publishing selected summaries. Takes ownership over
+    /// the channel multicaster.
+    void add_channel( const aux::DetectorSummarySelector &, EventMulticaster * );
+    /// Enables/disables sending of entire events to the main group.
+    void send_full_stream( bool v ) { _sendFullStream = v; }
+
     boost::asio::io_service & ioservice() { return *_ioServicePtr; }
     const boost::asio::io_service & ioservice() const { return *_ioServicePtr; }
 };  // class EventMulticaster
@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2016 Renat R. Dusaev <crank@qcrypt.org>
+ * Author: Renat R. Dusaev <crank@qcrypt.org>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+# ifndef H_STROMA_V_SHM_RING_DATA_PROCESSOR_H
+# define H_STROMA_V_SHM_RING_DATA_PROCESSOR_H
+
+# include "sV_config.h"
+
+# if defined(RPC_PROTOCOLS) && defined(ANALYSIS_ROUTINES)
+
+# include "app/analysis.hpp"
+# include "uevent.hpp"
+# include "shmRing.hpp"
+
+namespace sV {
+namespace dprocessors {
+
+/**@class ShmRingWriter
+ * @brief Processor publishing events into shared memory ring.
+ *
+ * Same-host counterpart of EventMulticaster: events are serialized
+ * directly into the `/dev/shm` segment and may be read by arbitrary number
+ * of ShmRingEventSource instances with no cost to this pipeline.
+ */
+class ShmRingWriter : public AnalysisPipeline::iEventProcessor,
+                      public net::ShmEventRingProducer {
+public:
+    typedef AnalysisPipeline::Event Event;
+protected:
+    virtual bool _V_process_event( Event * eventPtr ) override;
+    virtual void _V_print_brief_summary( std::ostream & os ) const override;
+public:
+    ShmRingWriter( const std::string & pn,
+                   const std::string & segmentName,
+                   size_t capacity );
+};  // class ShmRingWriter
+
+/**@class ShmRingEventSource
+ * @brief Event sequence reading events from shared memory ring.
+ *
+ * Events are parsed in place from the read-only mapping. When no events
+ * are available the source polls the ring with given interval. Reading
+ * ends when producer quenches or when nothing was written within idle
+ * timeout (if set).
+ */
+class ShmRingEventSource : public AnalysisPipeline::iEventSequence,
+                           public net::ShmEventRingConsumer {
+public:
+    typedef AnalysisPipeline::Event Event;
+private:
+    Event _reentrantEvent;
+    bool _isGood;
+    const size_t _pollIntervalUSec,
+                 _idleTimeoutMSec;
+
+    void _fetch();
+protected:
+    virtual bool _V_is_good() override { return _isGood; }
+    virtual void _V_next_event( Event *& ) override;
+    virtual Event * _V_initialize_reading() override;
+    virtual void _V_finalize_reading() override {}
+    virtual void _V_print_brief_summary( std::ostream & os ) const override;
+public:
+    /**@brief Attaches to existing ring.
+     *
+     * @param segmentName name of the segment within `/dev/shm`;
+     * @param pollIntervalUSec sleeping interval when ring is empty;
+     * @param idleTimeoutMSec max waiting time for new events (0 to wait
+     * infinitely).
+     * */
+    ShmRingEventSource( const std::string & segmentName,
+                        size_t pollIntervalUSec=100,
+                        size_t idleTimeoutMSec=0 );
+};  // class ShmRingEventSource
+
+}  // namespace dprocessors
+}  // namespace sV
+
+# endif  // defined(RPC_PROTOCOLS) && defined(ANALYSIS_ROUTINES)
+# endif  // H_STROMA_V_SHM_RING_DATA_PROCESSOR_H
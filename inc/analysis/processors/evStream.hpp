@@ -0,0 +1,167 @@
+/*
+ * Copyright (c) 2016 Renat R. Dusaev <crank@qcrypt.org>
+ * Author: Renat R. Dusaev <crank@qcrypt.org>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+# ifndef H_STROMA_V_STREAMING_DATA_PROCESSOR_H
+# define H_STROMA_V_STREAMING_DATA_PROCESSOR_H
+
+# include "sV_config.h"
+
+# if defined(RPC_PROTOCOLS) && defined(ANALYSIS_ROUTINES)
+
+# include <deque>
+# include <goo_ansi_escseq.h>
+# include "app/analysis.hpp"
+# include "uevent.hpp"
+# include "streamSender.tcc"
+# include "streamReceiver.tcc"
+
+namespace sV {
+namespace dprocessors {
+
+/**@class EventStreamer
+ * @brief Processor sending events to stream (TCP or Unix socket)
+ * subscribers.
+ *
+ * Reliable counterpart of EventMulticaster: each event is serialized once
+ * and written to all connected subscribers. Subscribers that are not able
+ * to keep up with the pipeline are disconnected (see iTStreamEventSender).
+ */
+template<typename ProtocolT>
+class EventStreamer : public net::iTStreamEventSender<ProtocolT>,
+                      public AnalysisPipeline::iEventProcessor {
+public:
+    typedef AnalysisPipeline::Event Event;
+    typedef net::iTStreamEventSender<ProtocolT> Sender;
+    typedef typename Sender::Message Message;
+private:
+    Message _reentrantMessageKeeper;
+    size_t _nProcessed;
+protected:
+    virtual bool _V_process_event( Event * eventPtr ) override {
+        _reentrantMessageKeeper.Clear();
+        _reentrantMessageKeeper.mutable_event()->CopyFrom( *eventPtr );
+        Sender::send_message( _reentrantMessageKeeper );
+        ++_nProcessed;
+        return true;
+    }
+    virtual void _V_print_brief_summary( std::ostream & os ) const override {
+        os << ESC_CLRGREEN "Event streaming processor" ESC_CLRCLEAR ":" << std::endl
+           << "  number of events processed . : " << _nProcessed << std::endl
+           << "  subscribers connected ...... : " << Sender::n_clients() << std::endl
+           << "  subscribers accepted ....... : " << Sender::n_accepted() << std::endl
+           << "  slow subscribers dropped ... : " << Sender::n_slow_dropped() << std::endl;
+    }
+public:
+    EventStreamer( const std::string & pn,
+                   boost::asio::io_service & ioService,
+                   const typename Sender::Endpoint & ep,
+                   size_t clientQueueLength=1024 ) :
+                Sender( ioService, ep, clientQueueLength ),
+                AnalysisPipeline::iEventProcessor( pn ),
+                _nProcessed(0) {}
+
+    size_t n_processed() const { return _nProcessed; }
+};  // class EventStreamer
+
+
+/**@class StreamEventSource
+ * @brief Event sequence reading events from stream sender.
+ *
+ * Connects to iTStreamEventSender (e.g. EventStreamer processor of another
+ * pipeline) and reads the events synchroneously until sender quenches or
+ * closes connection.
+ */
+template<typename ProtocolT>
+class StreamEventSource : public net::iTStreamEventReceiver<ProtocolT>,
+                          public AnalysisPipeline::iEventSequence {
+public:
+    typedef AnalysisPipeline::Event Event;
+    typedef net::iTStreamEventReceiver<ProtocolT> Receiver;
+    typedef typename Receiver::Message Message;
+private:
+    /// Events unpacked from last message(s) (bucket may carry many).
+    std::deque<Event> _received;
+    Event _reentrantEvent;
+    bool _isGood;
+    size_t _nRead;
+
+    /// Takes next event from queue, receiving new messages if needed.
+    void _fetch() {
+        while( _received.empty() && Receiver::receive_message() ) {}
+        if( (_isGood = !_received.empty()) ) {
+            _reentrantEvent.Swap( &(_received.front()) );
+            _received.pop_front();
+            ++_nRead;
+        }
+    }
+protected:
+    virtual bool _V_treat_event( const ::sV::events::Event & e ) override {
+        _received.emplace_back();
+        _received.back().CopyFrom( e );
+        return true;
+    }
+    virtual bool _V_treat_sender_status(
+                    const typename Message::SenderStatusMessage & st ) override {
+        if( ::sV::events::MulticastMessage_SenderStatusMessage_SenderStatus::
+                MulticastMessage_SenderStatusMessage_SenderStatus_QUENCHING
+                == st.senderstatus() ) {
+            sV_log2( "Stream source: sender quenches.\n" );
+            Receiver::disconnect();
+            return false;
+        }
+        return true;
+    }
+    virtual bool _V_is_good() override { return _isGood; }
+    virtual void _V_next_event( Event *& ePtr ) override {
+        _fetch();
+        ePtr = &_reentrantEvent;
+    }
+    virtual Event * _V_initialize_reading() override {
+        _fetch();
+        return &_reentrantEvent;
+    }
+    virtual void _V_finalize_reading() override {
+        Receiver::disconnect();
+    }
+    virtual void _V_print_brief_summary( std::ostream & os ) const override {
+        os << ESC_CLRGREEN "Stream event source" ESC_CLRCLEAR ":" << std::endl
+           << "  events read ................ : " << _nRead << std::endl
+           << "  messages accepted .......... : " << Receiver::n_accepted_messages() << std::endl
+           << "  messages declined .......... : " << Receiver::n_declined_messages() << std::endl;
+    }
+public:
+    StreamEventSource( boost::asio::io_service & ioService,
+                       const typename Receiver::Endpoint & ep,
+                       size_t maxFrameLength=64*1024*1024 ) :
+                Receiver( ioService, ep, maxFrameLength ),
+                AnalysisPipeline::iEventSequence( 0x0 ),
+                _isGood(false),
+                _nRead(0) {}
+
+    size_t n_read() const { return _nRead; }
+};  // class StreamEventSource
+
+}  // namespace sV
+}  // namespace dprocessors
+
+# endif  // defined(RPC_PROTOCOLS) && defined(ANALYSIS_ROUTINES)
+# endif  // H_STROMA_V_STREAMING_DATA_PROCESSOR_H
@@ -24,9 +24,9 @@
 # define H_STROMA_V_XFORM_H
 
 # include <cstdint>
+# include <cstddef>
 # include <cmath>
 # include <ostream>
-# include <cmath>
 # include <goo_xform.tcc>
 
 /**@file xform.tcc
@@ -200,23 +200,67 @@ std::ostream & operator<<( std::ostream & os, const XForm<TD, FloatT> & xf ) {
 
 // TODO: rename it to avoid misunderstanding as this IS NOT an
 // X-Form actually.
+/**@class XForm
+ * @brief D-dimensional scaler based on goo's normed multivariate range.
+ *
+ * Ranges are kept inline. Besides of per-point (virtual) methods, batched
+ * norm_n(), denorm_n() and extend_to_n() are provided for arrays of
+ * coordinates given in structure-of-arrays form (one array per dimension,
+ * e.g. TrackReceptiveVolume::PointSet::coordinates()). Since normalization
+ * is affine, batched methods obtain its coefficients once per call and then
+ * run plain loops that are vectorized by compiler.
+ * */
 template<uint8_t TD,
          typename FloatT=double>
 class XForm : public ::goo::aux::NormedMultivariateRange<goo::aux::Range<FloatT>, TD> {
 public:
     //using ::goo::aux::NormedMultivariateRange<FloatT, TD>::AbstractRange::LimitIndex;
     enum RangeIdx { min = 0, max = 1 };
-public:
-    XForm() {
-        for( uint8_t i = 0; i < TD; ++i ) {
-            this->set_range_instance( i, *(new goo::aux::Range<FloatT>()) );
+private:
+    /// Ranges storage referred by parent.
+    goo::aux::Range<FloatT> _rangesStorage[TD];
+
+    /// Computes coefficients of forward (norm) or backward (denorm) mapping
+    /// y = a + b*x for each dimension.
+    void _affine_coefficients( bool forward, FloatT * a, FloatT * b ) const {
+        FloatT p0[TD], p1[TD];
+        for( uint8_t d = 0; d < TD; ++d ) {
+            p0[d] = 0;
+            p1[d] = 1;
+        }
+        if( forward ) {
+            this->norm( p0 );
+            this->norm( p1 );
+        } else {
+            this->denorm( p0 );
+            this->denorm( p1 );
+        }
+        for( uint8_t d = 0; d < TD; ++d ) {
+            a[d] = p0[d];
+            b[d] = p1[d] - p0[d];
         }
     }
-    ~XForm() {
+
+    /// Applies affine mapping to coordinates arrays.
+    static void _apply_n( FloatT * const * x, size_t n,
+                          const FloatT * a, const FloatT * b ) {
+        for( uint8_t d = 0; d < TD; ++d ) {
+            FloatT * __restrict__ xd = x[d];
+            const FloatT ad = a[d], bd = b[d];
+            for( size_t i = 0; i < n; ++i ) {
+                xd[i] = ad + bd*xd[i];
+            }
+        }
+    }
+public:
+    XForm() {
         for( uint8_t i = 0; i < TD; ++i ) {
-            delete &(this->range(i));
+            this->set_range_instance( i, _rangesStorage[i] );
         }
     }
+    XForm( const XForm & ) = delete;
+    XForm & operator=( const XForm & ) = delete;
+
     // This methods are added to provide backward compatibility:
     void recalculate_scales() const { /* dop nothing */ }
     virtual void renorm( FloatT * x ) const { this->denorm( x ); }
@@ -232,11 +276,56 @@ public:
     virtual void set_ranges( const FloatT * xMins, const FloatT * xMaxs ) {
         this->set_limits( xMins, xMaxs );
     }
+
+    /// Normalizes n points given by TD arrays of coordinates, in place.
+    void norm_n( FloatT * const * x, size_t n ) const {
+        if( !n ) return;
+        FloatT a[TD], b[TD];
+        _affine_coefficients( true, a, b );
+        _apply_n( x, n, a, b );
+    }
+
+    /// Denormalizes n points given by TD arrays of coordinates, in place.
+    void denorm_n( FloatT * const * x, size_t n ) const {
+        if( !n ) return;
+        FloatT a[TD], b[TD];
+        _affine_coefficients( false, a, b );
+        _apply_n( x, n, a, b );
+    }
+
+    /// Extends ranges to cover n points given by TD arrays of coordinates.
+    void extend_to_n( const FloatT * const * x, size_t n ) {
+        if( !n ) return;
+        FloatT lo[TD], hi[TD];
+        for( uint8_t d = 0; d < TD; ++d ) {
+            const FloatT * __restrict__ xd = x[d];
+            FloatT l = xd[0], h = xd[0];
+            for( size_t i = 1; i < n; ++i ) {
+                l = xd[i] < l ? xd[i] : l;
+                h = xd[i] > h ? xd[i] : h;
+            }
+            lo[d] = l;
+            hi[d] = h;
+        }
+        this->extend_to( lo );
+        this->extend_to( hi );
+    }
 };
 
 template<uint8_t TD, typename FloatT>
-std::ostream & operator<<( std::ostream & /*os*/, const XForm<TD, FloatT> & /*xf*/ ) {
-    _TODO_
+std::ostream & operator<<( std::ostream & os, const XForm<TD, FloatT> & xf ) {
+    typedef XForm<TD, FloatT> XF;
+    os << "{" << std::endl
+       << "   type : " << "\"XForm<" << (int) TD << ">\"," << std::endl
+       << "    ptr : " << &xf << "," << std::endl
+       << " ranges : [" << std::endl;
+    for( uint8_t d = 0; d < TD; ++d ) {
+        os << "  [" << xf.get_limit(XF::min, d) << ", "
+                    << xf.get_limit(XF::max, d) << "]" << "," << std::endl;
+    }
+    os << "]," << std::endl;
+    os << "}";
+    return os;
 }
 # endif
 
@@ -32,6 +32,7 @@
 # include <boost/property_tree/ptree_fwd.hpp>
 
 # include <unordered_map>
+# include <array>
 
 namespace sV {
 
@@ -39,6 +40,7 @@ namespace alignment {
 class DetectorConstructorsDict;
 class DetectorsSet;
 class TrackingGroup;
+class TrackingScheduler;
 class DetectorPlacement;
 }  // namespace alignment
 
@@ -53,10 +55,18 @@ namespace mixins {
  * @ingroup alignment
  */
 class AlignmentApplication : public virtual AbstractApplication {
+public:
+    /// Placement shifts (x, y) indexed by detector name.
+    typedef std::unordered_map<std::string, std::array<double, 2> > Shifts;
 private:
     static alignment::DetectorConstructorsDict * _detCtrsDict;
     alignment::DetectorsSet * _detectorsSet;
     std::unordered_map<std::string, alignment::TrackingGroup *> _trackingGroups;
+    /// Concurrent tracking groups reconstruction scheduler (lazily built).
+    alignment::TrackingScheduler * _trackingScheduler;
+    /// Number of tracking worker threads; when negative, it is chosen
+    /// by hardware concurrency.
+    int _nTrackingThreads;
 protected:
     typedef std::unordered_map<alignment::TrackingGroup *, std::list<std::string> >
             TrackingMembersNames;
@@ -77,11 +87,35 @@ public:
     /// Returns registered detectors list.
     alignment::DetectorsSet & detectors();
 
+    /// Reads experimental layout JSON file: constructs detectors by their
+    /// placements and includes them into tracking groups. Involves no
+    /// graphics, so may be used by headless applications.
+    void load_layout( const std::string & layoutFilePath );
+
+    /// Writes copy of layout file with detectors positions shifted.
+    static void write_corrected_layout( const std::string & layoutFilePath,
+                                        const std::string & outputFilePath,
+                                        const Shifts & );
+
     /// Prints parameters tree (useful for JSON-parsing debug).
     void print_ptree( boost::property_tree::ptree const &, std::ostream & );
 
     const std::unordered_map<std::string, alignment::TrackingGroup *> & tracking_groups() const
         { return _trackingGroups; }
+
+    /// Returns tracking groups scheduler, building it upon first call.
+    alignment::TrackingScheduler & tracking_scheduler();
+
+    /// Opens new (empty) point set on every volume of tracking groups (once
+    /// for volume shared by several groups). Has to be invoked before
+    /// hits of new event are dispatched, so volumes not hit in the event
+    /// provide no points of previous ones.
+    void open_new_sets();
+
+    /// Performs per-event reconstruction of all tracking groups,
+    /// concurrently where their dependencies allow it. Has to be invoked
+    /// after hits are dispatched.
+    void reconstruct_tracks();
 };
 
 }  // namespace mixins
@@ -38,6 +38,7 @@ namespace events {
 }
 class iCompressor {
     public :
+        virtual ~iCompressor();
         events::CompressionMethod compr_method() const {return _comprMethod;}
         size_t compress_series( uint8_t * uncomprBuf, size_t lenUncomprBuf,
                                 uint8_t * comprBuf, size_t lenComprBuf )
@@ -46,7 +47,6 @@ class iCompressor {
         virtual size_t _V_compress_series( uint8_t *, size_t,
                                            uint8_t *, size_t ) const = 0;
         iCompressor( events::CompressionMethod comprMethod );
-        virtual ~iCompressor();
     private :
         const events::CompressionMethod _comprMethod;
 
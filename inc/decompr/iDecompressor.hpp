@@ -21,6 +21,7 @@
  * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  */
 # ifndef H_STROMA_V_IDECOMPRESSOR_H
+# define H_STROMA_V_IDECOMPRESSOR_H
 
 # include "sV_config.h"
 
@@ -38,7 +39,12 @@ namespace events {
 
 class iDecompressor {
     public:
+        virtual ~iDecompressor();
         events::CompressionMethod compr_method() const {return _comprMethod;}
+        /// Decompresses series into buffer of lenUncomprBuf bytes, returns
+        /// real length of decompressed data. Implementations must not write
+        /// beyond the buffer and have to raise an overflow exception
+        /// instead.
         size_t decompress_series( uint8_t * uncomprBuf, size_t lenUncomprBuf,
                                   uint8_t * comprBuf, size_t lenComprBuf )
                                   const;
@@ -46,7 +52,6 @@ class iDecompressor {
         virtual size_t _V_decompress_series( uint8_t *, size_t,
                                              uint8_t *, size_t) const = 0;
         iDecompressor( events::CompressionMethod comprMethod);
-        virtual ~iDecompressor();
     private:
         const events::CompressionMethod _comprMethod;
 };  // class iDecompressor
@@ -30,6 +30,7 @@
 # include <boost/asio.hpp>
 
 # include "uevent.hpp"
+# include "msgUnpacker.hpp"
 
 namespace sV {
 namespace net {
@@ -39,10 +40,13 @@ namespace net {
  * MulticastMessage objects.
  *
  * Intended to be complementary with iMulticastEventSender class.
+ *
+ * Default implementation of _V_treat_incoming_message() forwards the
+ * message to iMessageUnpacker::unpack_message().
  * */
-class iMulticastEventReceiver {
+class iMulticastEventReceiver : public iMessageUnpacker {
 public:
-    typedef ::sV::events::MulticastMessage Message;
+    typedef iMessageUnpacker::Message Message;
 private:
     boost::asio::ip::udp::socket _udpSocket;
     boost::asio::ip::udp::endpoint _udpSenderEndpoint;
@@ -50,7 +54,6 @@ private:
     size_t _dataReentrantBufferLength,
            _acceptedMessages,
            _declinedMessages;
-    //Message _reentrantMessageInstance;
 
     /**@brief Receiver handling method.
      *
@@ -86,9 +89,10 @@ protected:
 
     /**@brief Interface function that is called on event received.
      *
-     * Should return false, when receiving should be interrupt.
+     * Should return false, when receiving should be interrupt. Default
+     * implementation unpacks the message (see class description).
      * */
-    virtual bool _V_treat_incoming_message( const unsigned char *, size_t ) = 0;
+    virtual bool _V_treat_incoming_message( const unsigned char *, size_t );
 public:
     virtual ~iMulticastEventReceiver();
 
@@ -28,6 +28,8 @@
 # if defined(RPC_PROTOCOLS)
 
 # include <mutex>
+# include <condition_variable>
+# include <memory>
 # include <boost/asio.hpp>
 # include <boost/atomic.hpp>
 # include <boost/thread.hpp>
@@ -50,11 +52,19 @@ namespace net {
  * via aggregation instead of inheritance, but it will violate
  * integrity of some architectural patterns, so additional initialization
  * function was introduced.
+ *
+ * Messages longer than maxDatagramLength can not be sent as single UDP
+ * datagram, so they are dropped (with error logged).
  * */
 class iMulticastEventSender {
 public:
     typedef ::sV::events::MulticastMessage Message;
+    typedef ::sV::events::DeflatedBucketMetaInfo_CompressionMethod CompressionMethod;
+    /// Maximal UDP payload length (IPv4).
+    static constexpr size_t maxDatagramLength = 65507;
 private:
+    /// Set if sender owns the I/O service (destroyed after the socket).
+    std::unique_ptr<boost::asio::io_service> _ownedIOService;
     boost::asio::ip::udp::endpoint _udpEndpoint;
     boost::asio::ip::udp::socket _socket;
 
@@ -62,22 +72,32 @@ private:
     size_t _serializedMessageLength;
 
     Message _reentrantStatusMessage;
+    CompressionMethod _comprMethod;
     boost::atomic<bool> _isOperating;
     std::mutex _sendingMutex;
+    /// Notified when asynchroneous sending is done.
+    std::condition_variable _sendingDone;
     boost::asio::io_service::work * _sendingWorkPtr;
     boost::thread * _thread;
 
     boost::asio::io_service & _ioServiceRef;
 protected:
     /**@brief Event sender interface constructor.
+     *
+     * When ownIOService is set, sender takes ownership over I/O service
+     * and joins its sending thread upon destruction (so the service must
+     * not be shared with other workers).
      * */
     iMulticastEventSender(boost::asio::io_service & ioService,
                  const boost::asio::ip::address& multicastAddress,
                  int portNo=30001,
-                 size_t sendingBufferSize=1024*1024 /*1 kb default*/);
+                 size_t sendingBufferSize=1024*1024 /*1 kb default*/,
+                 bool ownIOService=false);
 
     virtual void _resize_sending_buffer( size_t newSize );
-    void _serialize_message_to_send( const Message & );
+    /// Serializes message of given (cached) size, growing the buffer if
+    /// need.
+    void _serialize_message_to_send( const Message &, size_t serializedLength );
 
     // Handlers:
     /// Invoked after sending done (succeed or not); unlocks sending mutex.
@@ -91,6 +111,18 @@ protected:
 
     /// One could call it from child constructor. See notes.
     void _setup_transmission();
+
+    /// Blocks until asynchroneous sending (including the chained ones) is
+    /// done. Lock has to own the sending mutex.
+    void _wait_for_pending_send( std::unique_lock<std::mutex> & );
+
+    /// Waits for pending sending, sends quenching status and releases the
+    /// I/O service work. Sending thread is joined for owned I/O service.
+    /// Does nothing if transmission was not started or already finished.
+    void _finish_transmission();
+
+    /// Fills reentrant status message with given status and current codec.
+    Message & _status_message( ::sV::events::MulticastMessage_SenderStatusMessage_SenderStatus );
 public:
     /// Child class should call this method at the end.
     void constructor_done();
@@ -109,6 +141,12 @@ public:
     /// state of sending process (wether it runs or not).
     std::mutex & sending_mutex() { return _sendingMutex; }
     bool is_operating() const { return _isOperating; }
+
+    /// Codec advertised to subscribers within status messages.
+    CompressionMethod compression_method() const { return _comprMethod; }
+    /// Sets the codec to be advertised. Has to be set before transmission
+    /// starts since status message is sent only on (de)initialization.
+    void compression_method( CompressionMethod m ) { _comprMethod = m; }
 };  // class iMulticastEventSender
 
 }  // namespace net
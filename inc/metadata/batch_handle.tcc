@@ -23,11 +23,21 @@
 # ifndef H_STROMA_V_METADATA_BATCH_HANDLE_H
 # define H_STROMA_V_METADATA_BATCH_HANDLE_H
 
-namespace sV {
-
 # include "store.tcc"
+# include "sources_pool.tcc"
+# include "shared_mutex.hpp"
 # include "analysis/evSource_RA.tcc"
+
+# include <algorithm>
+# include <atomic>
+# include <chrono>
 # include <cstdint>
+# include <deque>
+# include <future>
+# include <map>
+# include <vector>
+
+namespace sV {
 
 namespace aux {
 
@@ -63,46 +73,138 @@ public:
 
     typedef BatchEventsHandle<EventID, Metadata, SourceID> Self;
 protected:
-    /// Internal helper class routing events iteration in range.
+    /// Read-ahead settings and statistics shared by range proxies.
+    struct ReadAhead {
+        /// Number of markup entries prepared in background (0 disables
+        /// read-ahead).
+        size_t depth;
+        /// Number of sources that were ready by the time they were needed
+        /// or still had to be waited for.
+        std::atomic<size_t> nHits, nMisses;
+
+        ReadAhead() : depth(0), nHits(0), nMisses(0) {}
+    };
+
+    /// Internal helper class routing events iteration in range. If
+    /// read-ahead is enabled, next markup entries are prepared (source
+    /// opened, metadata acquired and reading positioned at range start) by
+    /// background threads while current range is being read.
     class ProxyRangeSequence : aux::iEventSequence {
     public:
         typedef std::list<SubrangeMarkup> ReadingMarkup;
-        typedef typename Traits::iDisposableSourceManager Manager;
-        typedef std::list<Manager *> Managers;
+        typedef DisposableSourcesPool<EventID, Metadata, SourceID> Pool;
+        /// Source prepared for reading of markup entry.
+        struct Prepared {
+            iEventSource * srcPtr;
+            /// Whether source was taken from pool (otherwise it was
+            /// provided by mark-up entry and is not owned).
+            bool isPooled;
+            std::unique_ptr<iEventSequence> seq;
+            Event * first;
+        };
     private:
         iEventSource * _cEvSrc;
+        /// Whether current source was taken from pool.
+        bool _isPooled;
         std::unique_ptr<iEventSequence> _rangeReadingSrc;
-        Managers & _mngrs;
-        typename Managers::iterator _evSrcOwnerIt;
+        Pool & _pool;
+        ReadAhead & _readAhead;
 
         ReadingMarkup * _markup;
-        typename ReadingMarkup::iterator _rmuIt;
+        typename ReadingMarkup::iterator _rmuIt,
+        /// Next markup entry to be scheduled for read-ahead.
+                                         _aheadIt;
+        std::deque< std::future<Prepared> > _ahead;
     protected:
+        /// Acquires the source and starts reading of markup entry. May be
+        /// invoked from read-ahead thread.
+        static Prepared _prepare( Pool & pool, const SubrangeMarkup & rmu ) {
+            Prepared p{ rmu.srcPtr, false, nullptr, nullptr };
+            if( !p.srcPtr ) {
+                p.srcPtr = pool.acquire( rmu.sid );
+                p.isPooled = true;
+            }
+            try {
+                if( rmu.mdPtr ) {
+                    p.seq = p.srcPtr->_md_event_read_range(
+                                            *(rmu.mdPtr), rmu.from, rmu.to );
+                } else {
+                    p.seq = p.srcPtr->event_read_range( rmu.from, rmu.to );
+                }
+                p.first = p.seq->initialize_reading();
+            } catch( ... ) {
+                p.seq.reset();
+                if( p.isPooled ) {
+                    pool.release( p.srcPtr );
+                }
+                throw;
+            }
+            return p;
+        }
+
+        void _release_source() {
+            _rangeReadingSrc.reset();
+            if( _cEvSrc && _isPooled ) {
+                _pool.release(_cEvSrc);
+            }
+            _cEvSrc = nullptr;
+        }
+
+        /// Schedules preparation of next markup entries up to read-ahead
+        /// depth.
+        void _schedule() {
+            while( _ahead.size() < _readAhead.depth
+                && _aheadIt != _markup->end() ) {
+                _ahead.push_back( std::async( std::launch::async,
+                                    &ProxyRangeSequence::_prepare,
+                                    std::ref(_pool), std::cref(*_aheadIt) ) );
+                ++_aheadIt;
+            }
+        }
+
+        /// Waits for scheduled entries and releases their sources.
+        void _drop_ahead() {
+            for( auto & f : _ahead ) {
+                try {
+                    Prepared p = f.get();
+                    p.seq.reset();
+                    if( p.isPooled ) {
+                        _pool.release( p.srcPtr );
+                    }
+                } catch( std::exception & e ) {
+                    sV_logw( "Dropped read-ahead entry failed: %s\n",
+                             e.what() );
+                }
+            }
+            _ahead.clear();
+        }
+
         Event * _dispose_source() {
-            _evSrcOwnerIt = _mngrs.end();
-            // TODO: use existing source if available in _rmuIt
-            for( auto mngrIt = _mngrs.begin();
-                 _mngrs.end() != mngrIt; ++mngrIt ) {
-                if( (_cEvSrc = (*mngrIt)->source(_rmuIt->sid) ) ) {
-                    _evSrcOwnerIt = mngrIt;
-                    // TODO: use acquired MD instance if available in _rmuIt
-                    _rangeReadingSrc = _cEvSrc->event_read_range(
-                                                    _rmuIt->from, _rmuIt->to );
-                    return _rangeReadingSrc->initialize_reading();
+            Prepared p;
+            if( !_ahead.empty() ) {
+                if( std::future_status::ready
+                        == _ahead.front().wait_for( std::chrono::seconds(0) ) ) {
+                    ++_readAhead.nHits;
+                } else {
+                    ++_readAhead.nMisses;
                 }
+                std::future<Prepared> f( std::move(_ahead.front()) );
+                _ahead.pop_front();
+                _schedule();
+                p = f.get();
+            } else {
+                _aheadIt = std::next(_rmuIt);
+                _schedule();
+                p = _prepare( _pool, *_rmuIt );
             }
-            emraise( badState, "Proxy event source instance could not "
-                "acquire disposable event source among %zu stores.",
-                _mngrs.size() );
+            _cEvSrc = p.srcPtr;
+            _isPooled = p.isPooled;
+            _rangeReadingSrc = std::move(p.seq);
+            return p.first;
         }
 
         Event * _dispose_next_source() {
-            if( _cEvSrc ) {
-                // Free current source.
-                (*_evSrcOwnerIt)->free_source(_cEvSrc);
-                _cEvSrc = nullptr;
-                _evSrcOwnerIt = _mngrs.end();
-            }
+            _release_source();
             ++_rmuIt;
             if( _rmuIt != _markup->end() ) {
                 return _dispose_source();
@@ -111,16 +213,20 @@ protected:
             }
         }
 
-        ProxyRangeSequence( Event & /*evRef*/,
-                            Managers & mngrs,
+        ProxyRangeSequence( Pool & pool,
+                            ReadAhead & readAhead,
                             ReadingMarkup * markupPtr ) :
                     aux::iEventSequence( 0x0 ),
                     _cEvSrc(nullptr),
-                    _mngrs(mngrs),
-                    _evSrcOwnerIt(mngrs.end()),
+                    _isPooled(false),
+                    _pool(pool),
+                    _readAhead(readAhead),
                     _markup(markupPtr),
-                    _rmuIt(markupPtr->end()) {}
+                    _rmuIt(markupPtr->end()),
+                    _aheadIt(markupPtr->end()) {}
         ~ProxyRangeSequence() {
+            _drop_ahead();
+            _release_source();
             delete _markup;
         }
 
@@ -137,32 +243,201 @@ protected:
         }
 
         virtual Event * _V_initialize_reading() override {
+            _drop_ahead();
+            _release_source();
             _rmuIt = _markup->begin();
+            if( _rmuIt == _markup->end() ) {
+                return nullptr;
+            }
             return _dispose_source();
         }
 
         virtual void _V_finalize_reading() override {
+            _drop_ahead();
+            _release_source();
+        }
+        friend class BatchEventsHandle<EventIDT, MetadataT, SourceIDT>;
+    };
+
+    /// Internal helper class routing reading of events by list of IDs. Events
+    /// are grouped by sources, each source is acquired once and asked for
+    /// its events sorted by their positions inside the source. When original
+    /// order has to be restored, events that came ahead of their turn are
+    /// buffered.
+    class ProxyListSequence : public aux::iEventSequence {
+    public:
+        typedef DisposableSourcesPool<EventID, Metadata, SourceID> Pool;
+        /// Requested event: its ID, position within source and index in
+        /// request.
+        struct Entry {
+            EventID eid;
+            uint64_t position;
+            size_t nRequested;
+        };
+        /// Events to be read from particular source.
+        struct Group {
+            SourceID sid;
+            std::vector<Entry> entries;
+        };
+    private:
+        Pool & _pool;
+        std::vector<Group> _groups;
+        const size_t _nEvents;
+        const bool _restoreOrder;
+
+        iEventSource * _cEvSrc;
+        std::unique_ptr<iEventSequence> _listReadingSrc;
+        size_t _cGroup,
+               _cEntry;
+        /// Current event in grouped order.
+        Event * _cEvent;
+        /// Current event in requested order.
+        Event * _emitted;
+
+        std::map<size_t, Event> _buffered;
+        size_t _nextRequested;
+        Event _reentrantEvent;
+    protected:
+        void _free_source() {
+            _listReadingSrc.reset();
             if( _cEvSrc ) {
-                // Free current source.
-                (*_evSrcOwnerIt)->free_source(_cEvSrc);
+                _pool.release(_cEvSrc);
                 _cEvSrc = nullptr;
-                _evSrcOwnerIt = _mngrs.end();
             }
         }
+
+        /// Starts reading of current group, skipping the ones that provided
+        /// no events. Returns false when groups are exhausted.
+        bool _open_group() {
+            for( ; _cGroup < _groups.size(); ++_cGroup ) {
+                _free_source();
+                const Group & g = _groups[_cGroup];
+                _cEvSrc = _pool.acquire( g.sid );
+                std::list<EventID> eids;
+                for( const auto & e : g.entries ) {
+                    eids.push_back( e.eid );
+                }
+                _listReadingSrc = _cEvSrc->event_read_list( eids );
+                _cEvent = _listReadingSrc->initialize_reading();
+                _cEntry = 0;
+                if( _listReadingSrc->is_good() ) {
+                    return true;
+                }
+                _listReadingSrc->finalize_reading();
+            }
+            _free_source();
+            return false;
+        }
+
+        /// Moves to next event in grouped order.
+        bool _advance() {
+            _listReadingSrc->next_event( _cEvent );
+            if( _listReadingSrc->is_good()
+             && ++_cEntry < _groups[_cGroup].entries.size() ) {
+                return true;
+            }
+            _listReadingSrc->finalize_reading();
+            ++_cGroup;
+            return _open_group();
+        }
+
+        /// Returns next event in requested order.
+        Event * _next_requested() {
+            if( _nextRequested == _nEvents ) {
+                return nullptr;
+            }
+            for(;;) {
+                auto bIt = _buffered.find( _nextRequested );
+                if( _buffered.end() != bIt ) {
+                    _reentrantEvent.Swap( &(bIt->second) );
+                    _buffered.erase( bIt );
+                    break;
+                }
+                if( _cGroup >= _groups.size() ) {
+                    emraise( badState, "Event #%zu of requested list was not "
+                        "provided by its source.", _nextRequested );
+                }
+                size_t n = _groups[_cGroup].entries[_cEntry].nRequested;
+                if( n == _nextRequested ) {
+                    _reentrantEvent.CopyFrom( *_cEvent );
+                    _advance();
+                    break;
+                }
+                _buffered[n].CopyFrom( *_cEvent );
+                _advance();
+            }
+            ++_nextRequested;
+            return &_reentrantEvent;
+        }
+
+        ProxyListSequence( Pool & pool,
+                           std::vector<Group> && groups,
+                           size_t nEvents,
+                           bool restoreOrder ) :
+                    aux::iEventSequence( 0x0 ),
+                    _pool(pool),
+                    _groups(std::move(groups)),
+                    _nEvents(nEvents),
+                    _restoreOrder(restoreOrder),
+                    _cEvSrc(nullptr),
+                    _cGroup(0), _cEntry(0),
+                    _cEvent(nullptr),
+                    _emitted(nullptr),
+                    _nextRequested(nEvents) {}
+
+        virtual bool _V_is_good() override {
+            return _restoreOrder ? nullptr != _emitted
+                                 : _cGroup < _groups.size();
+        }
+
+        virtual void _V_next_event( Event *& evPtrRef ) override {
+            if( _restoreOrder ) {
+                _emitted = evPtrRef = _next_requested();
+            } else {
+                evPtrRef = _advance() ? _cEvent : nullptr;
+            }
+        }
+
+        virtual Event * _V_initialize_reading() override {
+            _cGroup = 0;
+            _buffered.clear();
+            _nextRequested = 0;
+            if( !_open_group() ) {
+                _cEvent = nullptr;
+            }
+            if( _restoreOrder ) {
+                return _emitted = _next_requested();
+            }
+            return _cEvent;
+        }
+
+        virtual void _V_finalize_reading() override {
+            if( _listReadingSrc && _cGroup < _groups.size() ) {
+                _listReadingSrc->finalize_reading();
+            }
+            _free_source();
+            _buffered.clear();
+        }
+    public:
+        ~ProxyListSequence() { _free_source(); }
         friend class BatchEventsHandle<EventIDT, MetadataT, SourceIDT>;
     };
 private:
     iMetadataType & _mdt;
-    Event _reentrantSingleEvent;
+    bool _restoreListOrder;
+    DisposableSourcesPool<EventID, Metadata, SourceID> _srcPool;
+    ReadAhead _readAhead;
 public:
-    BatchEventsHandle( iMetadataType & mdt ) : _mdt(mdt) {}
+    BatchEventsHandle( iMetadataType & mdt ) : _mdt(mdt),
+                                               _restoreListOrder(false),
+                                               _srcPool(mdt._dspSrcMngrs, 0,
+                                                        &mdt._storesMtx) {}
     virtual ~BatchEventsHandle() {}
 
-    /// Note that returned event ptr refers to internal reentrant instance and
-    /// will be re-written on next invokation of this method. Lifetime of
-    /// this instance is restricted by lifetime of owning iCachedMetadataType
-    /// instance.
-    virtual Event * event_read_single( const EventID & eid ) override {
+protected:
+    /// Looks up for the source containing event.
+    SourceID _source_id_for( const EventID & eid ) const {
+        aux::SharedLock l(_mdt._storesMtx);
         if( _mdt._singleEventQueryables.empty() ) {
             emraise( badState, "No stores associated with cached metadata "
                      "type \"%s\" (id:%#x, ptr:%p) which could perform single "
@@ -178,43 +453,40 @@ public:
                      _mdt.name().c_str(),
                      _mdt.type_index(), &_mdt );
         }
-
         SourceID sid;
-        bool found = false;
         for( auto storePtr : _mdt._singleEventQueryables ) {
-            if( (found = storePtr->source_id_for( eid, sid )) ) {
-                break;
+            if( storePtr->source_id_for( eid, sid ) ) {
+                return sid;
             }
         }
-        if( !found ) {
-            emraise( noSuchKey, "Unable to find source containing event "
-                                "with specified ID." );
-        }
-        iEventSource * evSourcePtr = nullptr;
-        typename Traits::iDisposableSourceManager * owningStore = nullptr;
-        for( auto storePtr : _mdt._dspSrcMngrs ) {
-            if( nullptr != (evSourcePtr = storePtr->source(sid)) ) {
-                owningStore = storePtr;
-                break;
-            }
-        }
-        if( !owningStore ) {
-            emraise( badState, "Event with specified ID located, but none of "
-                "available metadata caching store instances were able to "
-                " provide disposable streaming instance." );
+        emraise( noSuchKey, "Unable to find source containing event "
+                            "with specified ID." );
+    }
+public:
+    /// Note that returned event ptr refers to internal reentrant instance
+    /// (one per thread) and will be re-written on next invokation of this
+    /// method in the same thread. The method may be invoked concurrently:
+    /// concurrent readers are given distinct source instances by the pool.
+    virtual Event * event_read_single( const EventID & eid ) override {
+        static thread_local Event reentrantEvent;
+        iEventSource * evSourcePtr = _srcPool.acquire( _source_id_for( eid ) );
+        try {
+            // todo: may optimize it a little by using direct querying of
+            // metadata here:
+            //Event * eventReadPtr = evSourcePtr->_md_event_read_single( eid );
+            reentrantEvent.CopyFrom( *evSourcePtr->event_read_single( eid ) );
+        } catch( ... ) {
+            _srcPool.release( evSourcePtr );
+            throw;
         }
-        // todo: may optimize it a little by using direct querying of metadata
-        // here:
-        //Event * eventReadPtr = evSourcePtr->_md_event_read_single( eid );
-        Event * eventReadPtr = evSourcePtr->event_read_single( eid );
-        _reentrantSingleEvent.CopyFrom( *eventReadPtr );
-        owningStore->free_source(evSourcePtr);
-        return &_reentrantSingleEvent;
+        _srcPool.release( evSourcePtr );
+        return &reentrantEvent;
     }
 
     virtual std::unique_ptr<aux::iEventSequence> event_read_range(
                                 const EventID & lower,
                                 const EventID & upper ) override {
+        aux::SharedLock l(_mdt._storesMtx);
         if( _mdt._rangeQueryables.empty() ) {
             emraise( badState, "No stores associated with cached metadata "
                      "type \"%s\" (id:%#x, ptr:%p) which could perform "
@@ -240,16 +512,93 @@ public:
         }
 
         return std::unique_ptr<aux::iEventSequence>(
-                new ProxyRangeSequence( _reentrantSingleEvent,
-                                        _mdt._dspSrcMngrs,
+                new ProxyRangeSequence( _srcPool,
+                                        _readAhead,
                                         rmuPtr ));
     }
 
+    /// Returns pool of sources acquired by this handle. Its capacity
+    /// determines how many sources are kept alive between queries.
+    DisposableSourcesPool<EventID, Metadata, SourceID> & sources_pool()
+                                                    { return _srcPool; }
+
+    /// Sets number of range markup entries (sources) to be prepared in
+    /// background while current one is being read. Zero (default) disables
+    /// read-ahead. Note, that sources, their managers and metadata stores
+    /// are then accessed from multiple threads (pool access is serialized).
+    void read_ahead_depth( size_t n ) { _readAhead.depth = n; }
+    size_t read_ahead_depth() const { return _readAhead.depth; }
+
+    /// Number of range entries that were prepared in background by the
+    /// time they were needed.
+    size_t n_read_ahead_hits() const { return _readAhead.nHits; }
+    /// Number of range entries that were not ready yet when needed.
+    size_t n_read_ahead_misses() const { return _readAhead.nMisses; }
+
+    /// Whether events requested by list have to be provided in requested
+    /// order. Otherwise they come grouped by sources (in order of first
+    /// appearance) and sorted by position within source.
+    void restore_list_order( bool v ) { _restoreListOrder = v; }
+    bool restore_list_order() const { return _restoreListOrder; }
+
+    /// Locates events by event-queryable stores, groups them by sources and
+    /// reads each source once. Note, that restoring of requested order
+    /// (see restore_list_order()) implies buffering of events read ahead
+    /// of their turn.
     virtual std::unique_ptr<aux::iEventSequence> event_read_list(
-                                const std::list<EventID> & /*list*/ ) override { 
-        _TODO_  // TODO
+                                const std::list<EventID> & eids ) override {
+        aux::SharedLock l(_mdt._storesMtx);
+        if( _mdt._singleEventQueryables.empty() ) {
+            emraise( badState, "No stores associated with cached metadata "
+                     "type \"%s\" (id:%#x, ptr:%p) which could perform single "
+                     "event look-up. Unable to retreive source IDs.",
+                     _mdt.name().c_str(),
+                     _mdt.type_index(), &_mdt );
+        }
+        if( _mdt._dspSrcMngrs.empty() ) {
+            emraise( badState, "No stores associated with cached metadata "
+                     "type \"%s\" (id:%#x, ptr:%p) which could perform "
+                     "proxying of events reading (creation of disposable event "
+                     "source). Unable to retreive events by IDs list.",
+                     _mdt.name().c_str(),
+                     _mdt.type_index(), &_mdt );
+        }
+        typedef typename ProxyListSequence::Group Group;
+        std::vector<Group> groups;
+        std::map<SourceID, size_t> groupsIdxs;
+        size_t nRequested = 0;
+        for( const auto & eid : eids ) {
+            SourceID sid;
+            uint64_t position;
+            bool found = false;
+            for( auto storePtr : _mdt._singleEventQueryables ) {
+                if( (found = storePtr->source_location_for( eid, sid, position )) ) {
+                    break;
+                }
+            }
+            if( !found ) {
+                emraise( noSuchKey, "Unable to find source containing event "
+                                    "#%zu of requested list.", nRequested );
+            }
+            auto ir = groupsIdxs.emplace( sid, groups.size() );
+            if( ir.second ) {
+                groups.push_back( Group{ sid, {} } );
+            }
+            groups[ir.first->second].entries.push_back(
+                    typename ProxyListSequence::Entry{ eid, position, nRequested++ } );
+        }
+        for( auto & g : groups ) {
+            std::stable_sort( g.entries.begin(), g.entries.end(),
+                []( const typename ProxyListSequence::Entry & a,
+                    const typename ProxyListSequence::Entry & b ) {
+                    return a.position < b.position; } );
+        }
+        return std::unique_ptr<aux::iEventSequence>(
+                new ProxyListSequence( _srcPool,
+                                       std::move(groups),
+                                       nRequested,
+                                       _restoreListOrder ));
     }
-    
 };  // class BatchEventsHandle
 
 }  // namespace aux
@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) 2016 Renat R. Dusaev <crank@qcrypt.org>
+ * Author: Renat R. Dusaev <crank@qcrypt.org>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+# ifndef H_STROMA_V_METADATA_BLOOM_FILTER_H
+# define H_STROMA_V_METADATA_BLOOM_FILTER_H
+
+# include <algorithm>
+# include <cmath>
+# include <cstdint>
+# include <cstring>
+# include <type_traits>
+# include <vector>
+
+namespace sV {
+namespace aux {
+
+/**@class BloomFilter
+ * @brief Bloom filter over plain (trivially copyable) keys, e.g. event IDs.
+ *
+ * Answers whether key may be present in the set (false positives are
+ * possible with configured rate) or definitely is not. Bits are either owned
+ * by the filter or refer to external memory (e.g. memory-mapped file), see
+ * view(). Keys are hashed by their bytes, so key type shall have no padding.
+ * */
+class BloomFilter {
+private:
+    std::vector<uint64_t> _own;
+    const uint64_t * _words;
+    uint64_t _nBits;
+    uint32_t _nHashes;
+
+    static uint64_t _fnv1a_64( const void * data, size_t len ) {
+        const uint8_t * p = static_cast<const uint8_t *>(data);
+        uint64_t h = 14695981039346656037ULL;
+        for( size_t i = 0; i < len; ++i ) {
+            h = (h ^ p[i])*1099511628211ULL;
+        }
+        return h;
+    }
+    /// Finalizer of splitmix64, used to obtain second hash.
+    static uint64_t _mix( uint64_t h ) {
+        h = (h ^ (h >> 30))*0xbf58476d1ce4e5b9ULL;
+        h = (h ^ (h >> 27))*0x94d049bb133111ebULL;
+        return h ^ (h >> 31);
+    }
+public:
+    /// Creates an empty filter that considers any key as present.
+    BloomFilter() : _words(nullptr), _nBits(0), _nHashes(0) {}
+
+    /// Creates filter sized for expected number of keys and desired false
+    /// positives rate.
+    BloomFilter( size_t nKeys, double fpRate ) {
+        if( !nKeys ) nKeys = 1;
+        if( !(fpRate > 0 && fpRate < 1) ) fpRate = 0.01;
+        const double ln2 = std::log(2.);
+        uint64_t nBits = std::ceil( -double(nKeys)*std::log(fpRate)/(ln2*ln2) );
+        _nBits = ((nBits + 63)/64)*64;
+        _nHashes = std::max( 1., std::round( double(_nBits)/nKeys*ln2 ) );
+        _own.assign( _nBits/64, 0 );
+        _words = _own.data();
+    }
+
+    /// Creates filter referring to external bits (not copied, has to
+    /// outlive the filter).
+    static BloomFilter view( const uint64_t * words,
+                             uint64_t nBits, uint32_t nHashes ) {
+        BloomFilter f;
+        f._words = words;
+        f._nBits = nBits;
+        f._nHashes = nHashes;
+        return f;
+    }
+
+    BloomFilter( const BloomFilter & o ) : _own(o._own),
+                                           _words(o._own.empty() ? o._words
+                                                                 : _own.data()),
+                                           _nBits(o._nBits),
+                                           _nHashes(o._nHashes) {}
+    BloomFilter & operator=( const BloomFilter & o ) {
+        _own = o._own;
+        _words = o._own.empty() ? o._words : _own.data();
+        _nBits = o._nBits;
+        _nHashes = o._nHashes;
+        return *this;
+    }
+
+    void insert( const void * key, size_t len ) {
+        if( _own.empty() ) return;  // views are read-only
+        const uint64_t h1 = _fnv1a_64( key, len ),
+                       h2 = _mix( h1 ) | 1;
+        for( uint32_t i = 0; i < _nHashes; ++i ) {
+            const uint64_t n = (h1 + i*h2) % _nBits;
+            _own[n/64] |= uint64_t(1) << (n%64);
+        }
+    }
+
+    bool may_contain( const void * key, size_t len ) const {
+        if( !_nBits ) return true;
+        const uint64_t h1 = _fnv1a_64( key, len ),
+                       h2 = _mix( h1 ) | 1;
+        for( uint32_t i = 0; i < _nHashes; ++i ) {
+            const uint64_t n = (h1 + i*h2) % _nBits;
+            if( !(_words[n/64] & (uint64_t(1) << (n%64))) ) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    template<typename T> void insert( const T & key ) {
+        static_assert( std::is_trivially_copyable<T>::value,
+                       "Key has to be trivially copyable." );
+        insert( &key, sizeof(T) );
+    }
+
+    template<typename T> bool may_contain( const T & key ) const {
+        static_assert( std::is_trivially_copyable<T>::value,
+                       "Key has to be trivially copyable." );
+        return may_contain( &key, sizeof(T) );
+    }
+
+    /// Whether the filter has any bits (empty one passes every key).
+    bool is_set() const { return _nBits; }
+    const uint64_t * words() const { return _words; }
+    uint64_t n_bits() const { return _nBits; }
+    uint32_t n_hashes() const { return _nHashes; }
+};  // class BloomFilter
+
+}  // namespace aux
+}  // namespace sV
+
+# endif  // H_STROMA_V_METADATA_BLOOM_FILTER_H
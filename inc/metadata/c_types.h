@@ -35,13 +35,15 @@ typedef uint16_t sV_MetadataTypeIndex;
  * matching certain type.
  * */
 typedef struct sV_Metadata {
-    /** Type indexes is dynamic. Do not store them in files! */
+    /** Type index is derived from the type name and is stable across runs,
+     * so it may be stored in files. */
     sV_MetadataTypeIndex typeIndex;
     void * payload;
 } sV_Metadata;
 
-/** For metadata type provided by ptr, generates its unique ID. */
-sV_MetadataTypeIndex sV_generate_metadata_type_id( void * );
+/** For metadata type name, returns its stable ID (16-bit folded FNV-1a hash
+ * of name; zero is reserved for unregistered types). */
+sV_MetadataTypeIndex sV_metadata_type_id_for_name( const char * );
 
 # endif  /* H_STROMA_V_METADATA_BASE_STRUCTURES_H */
 
@@ -26,6 +26,8 @@
 # include "type_base.hpp"
 # include "type.tcc"
 
+# include <memory>
+
 namespace sV {
 
 /**@class MetadataDictionary
@@ -43,6 +45,11 @@ namespace sV {
  *
  * This class also provides a special template method for querying the metadata
  * type instances by their C++ type.
+ *
+ * Type indexes are computed from type names (see aux::metadata_type_id()), so
+ * they are the same across runs and may be persisted. Collision of indexes
+ * is detected upon registration. Lookup by index is performed within dense
+ * two-level table of 256x256 pointers allocating pages on demand.
  * */
 template<typename EventIDT>
 class MetadataDictionary {
@@ -54,14 +61,18 @@ public:
 private:
     void _cast_typecheck( const C_Metadata & md,
                           MetadataTypeIndex toTypeIdx ) const;
+    /// Returns metadata type by its index or nullptr.
+    iSpecificEventIDMetdataType * _type_by_index( MetadataTypeIndex idx ) const {
+        const auto & page = _encodedIndex[idx >> 8];
+        return page ? page[idx & 0xff] : nullptr;
+    }
 public:
     /// Container for all known metadata types (composition).
     std::unordered_set<iSpecificEventIDMetdataType *> _types;
     /// Metadata types indexed by name.
     std::unordered_map<std::string, iSpecificEventIDMetdataType *> _namedIndex;
-    /// Metadata types indexed by id.
-    std::unordered_map<MetadataTypeIndex, iSpecificEventIDMetdataType *>
-                                                                _encodedIndex;
+    /// Metadata types indexed by id (pages of dense dispatch table).
+    std::unique_ptr<iSpecificEventIDMetdataType *[]> _encodedIndex[256];
 public:
     MetadataDictionary() {}
 
@@ -109,15 +120,15 @@ public:
         // corresponding iTMetadataType --- just found instance of the
         // iTMetadataType<EventID, SpecificMetadataT>. Here we involve a
         // idiomatic "virtual static method".
-        auto it = _encodedIndex.find(
+        iSpecificEventIDMetdataType * mdt = _type_by_index(
                     iTMetadataType<EventID, SpecificMetadataT>::type_index() );
-        if( _encodedIndex.end() == it ) {
+        if( !mdt ) {
             emraise( notFound, "Metadata types dictionary %p has no "
                      " type registered with ID %#x.", this,
                      iTMetadataType<EventID, SpecificMetadataT>::type_index() );
         }
         return static_cast<const iTMetadataType<EventID, SpecificMetadataT> &>(
-                                                                *(it->second));
+                                                                        *mdt);
     }
 
     template<typename SpecificMetadataT>
@@ -163,10 +174,22 @@ MetadataDictionary<EventIDT>::register_metadata_type(
                      insertionResult.first->second );
         }
     } else {
+        MetadataTypeIndex newIdx = aux::metadata_type_id( mdt.name().c_str() );
+        auto & page = _encodedIndex[newIdx >> 8];
+        if( !page ) {
+            page.reset( new iSpecificEventIDMetdataType * [256]() );
+        }
+        if( page[newIdx & 0xff] ) {
+            _namedIndex.erase( insertionResult.first );
+            emraise( badState, "Metadata type \"%s\" (%p) can not be inserted "
+                     "to types dictionary %p: its index %#x collides with "
+                     "type \"%s\". Consider renaming one of them.",
+                     mdt.name().c_str(), &mdt, this, (int) newIdx,
+                     page[newIdx & 0xff]->name().c_str() );
+        }
         _types.insert( &mdt );
-        MetadataTypeIndex newIdx = sV_generate_metadata_type_id( &mdt );
         mdt._set_type_index( newIdx );
-        _encodedIndex.emplace( newIdx, &mdt );
+        page[newIdx & 0xff] = &mdt;
         sV_log2( "Metadata type %s (%p) registered at dictionary %p "
                  "with index %#x.\n",
                  mdt.name().c_str(), &mdt, this, (int) newIdx );
@@ -183,7 +206,10 @@ MetadataDictionary<EventIDT>::remove_metadata_type(const std::string & tName) {
         return;
     } else {
         _types.erase( it->second );
-        _encodedIndex.erase( it->second->get_index() );
+        const MetadataTypeIndex idx = it->second->get_index();
+        if( _encodedIndex[idx >> 8] ) {
+            _encodedIndex[idx >> 8][idx & 0xff] = nullptr;
+        }
         static_cast<iSpecificEventIDMetdataType*>(it->second)
                                                 ->_remove_dict_backref( *this );
         // has to be invoked last:
@@ -193,12 +219,12 @@ MetadataDictionary<EventIDT>::remove_metadata_type(const std::string & tName) {
 
 template<typename EventIDT> const std::string & 
 MetadataDictionary<EventIDT>::metadata_type_name( MetadataTypeIndex idx ) const {
-    auto it = _encodedIndex.find( idx );
-    if( _encodedIndex.end() == it ) {
+    iSpecificEventIDMetdataType * mdt = _type_by_index( idx );
+    if( !mdt ) {
         emraise( noSuchKey, "Metadata dictionary %p: unknown metadata "
             "type index %zu", this, (size_t) idx );
     }
-    return it->second->name();
+    return mdt->name();
 }
 
 }  // namespace sV
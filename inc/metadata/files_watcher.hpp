@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2016 Renat R. Dusaev <crank@qcrypt.org>
+ * Author: Renat R. Dusaev <crank@qcrypt.org>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+# ifndef H_STROMA_V_METADATA_FILES_WATCHER_H
+# define H_STROMA_V_METADATA_FILES_WATCHER_H
+
+# include <atomic>
+# include <functional>
+# include <mutex>
+# include <string>
+# include <thread>
+# include <unordered_map>
+
+namespace sV {
+namespace aux {
+
+/**@class FilesWatcher
+ * @brief Background watcher of files being modified (inotify-based).
+ *
+ * Invokes the callback with path of each watched file that was modified.
+ * Subsequent modifications are coalesced: the callback is invoked once the
+ * given interval has passed since the first unreported modification, so
+ * file being continuously written by DAQ is reported periodically, at most
+ * once per interval.
+ *
+ * Intended to keep indexes of growing files current (see
+ * iTCachedMetadataType::update_metadata_for()). Note, that the callback is
+ * invoked from the watcher's thread.
+ * */
+class FilesWatcher {
+public:
+    typedef std::function<void(const std::string &)> Callback;
+private:
+    Callback _callback;
+    unsigned int _quietIntervalMs;
+    int _inotifyFD,
+        _wakeFDs[2];
+    std::mutex _mtx;
+    std::unordered_map<int, std::string> _paths;
+    std::atomic<bool> _stop;
+    std::thread * _thread;
+protected:
+    void _loop();
+public:
+    FilesWatcher( Callback cb, unsigned int quietIntervalMs=500 );
+    ~FilesWatcher();
+
+    /// Starts watching for modifications of file.
+    void watch( const std::string & path );
+    /// Stops watching for file.
+    void unwatch( const std::string & path );
+
+    /// Starts background thread.
+    void start();
+    /// Stops background thread (pending notifications are dropped).
+    void stop();
+};  // class FilesWatcher
+
+}  // namespace aux
+}  // namespace sV
+
+# endif  // H_STROMA_V_METADATA_FILES_WATCHER_H
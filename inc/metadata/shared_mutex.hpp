@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2016 Renat R. Dusaev <crank@qcrypt.org>
+ * Author: Renat R. Dusaev <crank@qcrypt.org>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+# ifndef H_STROMA_V_METADATA_SHARED_MUTEX_H
+# define H_STROMA_V_METADATA_SHARED_MUTEX_H
+
+# include <pthread.h>
+
+# include <goo_exception.hpp>
+
+namespace sV {
+namespace aux {
+
+/**@class SharedMutex
+ * @brief Readers-writer lock for read-mostly metadata structures.
+ *
+ * Thin wrapper around POSIX rwlock (std::shared_mutex is not available in
+ * C++11). Use SharedLock for reading and ExclusiveLock for modification.
+ * Recursive locking has to be avoided.
+ * */
+class SharedMutex {
+private:
+    pthread_rwlock_t _rwl;
+public:
+    SharedMutex() {
+        if( pthread_rwlock_init( &_rwl, nullptr ) ) {
+            emraise( thirdParty, "Unable to initialize rwlock %p.", &_rwl );
+        }
+    }
+    ~SharedMutex() { pthread_rwlock_destroy( &_rwl ); }
+    SharedMutex( const SharedMutex & ) = delete;
+    SharedMutex & operator=( const SharedMutex & ) = delete;
+
+    void lock_shared() { pthread_rwlock_rdlock( &_rwl ); }
+    void unlock_shared() { pthread_rwlock_unlock( &_rwl ); }
+    void lock() { pthread_rwlock_wrlock( &_rwl ); }
+    void unlock() { pthread_rwlock_unlock( &_rwl ); }
+};  // class SharedMutex
+
+/// Scoped shared (reader) lock.
+class SharedLock {
+private:
+    SharedMutex & _m;
+public:
+    explicit SharedLock( SharedMutex & m ) : _m(m) { _m.lock_shared(); }
+    ~SharedLock() { _m.unlock_shared(); }
+    SharedLock( const SharedLock & ) = delete;
+    SharedLock & operator=( const SharedLock & ) = delete;
+};  // class SharedLock
+
+/// Scoped exclusive (writer) lock.
+class ExclusiveLock {
+private:
+    SharedMutex & _m;
+public:
+    explicit ExclusiveLock( SharedMutex & m ) : _m(m) { _m.lock(); }
+    ~ExclusiveLock() { _m.unlock(); }
+    ExclusiveLock( const ExclusiveLock & ) = delete;
+    ExclusiveLock & operator=( const ExclusiveLock & ) = delete;
+};  // class ExclusiveLock
+
+}  // namespace aux
+}  // namespace sV
+
+# endif  // H_STROMA_V_METADATA_SHARED_MUTEX_H
@@ -0,0 +1,318 @@
+/*
+ * Copyright (c) 2017 Renat R. Dusaev <crank@qcrypt.org>
+ * Author: Renat R. Dusaev <crank@qcrypt.org>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+# ifndef H_STROMA_V_METADATA_SOURCES_POOL_H
+# define H_STROMA_V_METADATA_SOURCES_POOL_H
+
+# include "store.tcc"
+# include "shared_mutex.hpp"
+
+# include <cassert>
+# include <condition_variable>
+# include <list>
+# include <map>
+# include <memory>
+# include <mutex>
+# include <ostream>
+# include <unordered_map>
+
+namespace sV {
+namespace aux {
+
+/**@class DisposableSourcesPool
+ * @brief Bounded LRU cache of event sources acquired from disposable source
+ *        managers.
+ *
+ * Sources are acquired by source ID and have to be given back with
+ * `release()`. Released sources are not freed immediately but kept alive
+ * until number of cached sources exceeds the pool capacity, so repeating
+ * queries to the same source do not re-open it (and do not re-acquire its
+ * metadata). Sources being in use are never evicted.
+ *
+ * Zero capacity (default) disables caching: every source is freed once
+ * released. Note, that cached sources are freed by their managers, so the
+ * pool has to be cleared before managers are destroyed (metadata type does
+ * it upon store removal).
+ *
+ * Acquisition and releasing are serialized with internal mutex. Source is
+ * given to a single user at a time: if all the sources with requested ID
+ * are in use, another one is acquired from managers. Thus, sources may be
+ * read concurrently by multiple threads (or prepared by read-ahead threads,
+ * see BatchEventsHandle). Opening the source may be slow, so the mutex is
+ * not held meanwhile: pool keeps an "opening" entry for it instead, that is
+ * neither given to other users nor evicted. `forget()` waits for pending
+ * openings to finish and for the sources of forgotten manager to be
+ * released by their users (these are not given to anyone else meanwhile),
+ * so it must not be invoked by the thread holding such a source. If
+ * managers list may change concurrently, corresponding lock has to be
+ * provided on construction.
+ * */
+template<typename EventIDT,
+         typename MetadataT,
+         typename SourceIDT>
+class DisposableSourcesPool {
+public:
+    sV_METADATA_IMPORT_SECT_TRAITS(EventIDT, MetadataT, SourceIDT);
+    typedef typename Traits::iDisposableSourceManager Manager;
+    typedef std::list<Manager *> Managers;
+private:
+    struct Entry {
+        SourceID sid;
+        /// Null while source is being opened.
+        iEventSource * srcPtr;
+        Manager * owner;
+        bool inUse;
+        /// Set for sources of forgotten manager, that are freed upon
+        /// release.
+        bool orphaned;
+    };
+    /// Most recently used entries are at front.
+    typedef std::list<Entry> Entries;
+
+    const Managers & _mngrs;
+    SharedMutex * _mngrsMtx;
+    size_t _capacity;
+    Entries _lru;
+    std::multimap<SourceID, typename Entries::iterator> _bySID;
+    std::unordered_map<iEventSource *, typename Entries::iterator> _byPtr;
+    size_t _nHits,
+           _nMisses,
+           _nEvicted,
+           _nOpening;
+    std::mutex _mtx;
+    /// Notified when pending opening is finished.
+    std::condition_variable _openedCV;
+    /// Notified when orphaned source is released (and freed).
+    std::condition_variable _releasedCV;
+protected:
+    /// Removes entry from all the indexes.
+    void _erase( typename Entries::iterator it ) {
+        auto range = _bySID.equal_range( it->sid );
+        for( auto sit = range.first; sit != range.second; ++sit ) {
+            if( sit->second == it ) {
+                _bySID.erase( sit );
+                break;
+            }
+        }
+        if( it->srcPtr ) {
+            _byPtr.erase( it->srcPtr );
+        }
+        _lru.erase( it );
+    }
+    void _free( typename Entries::iterator it ) {
+        it->owner->free_source( it->srcPtr );
+        _erase( it );
+    }
+    /// Frees least recently used sources that are not in use until the
+    /// capacity is respected.
+    void _evict() {
+        for( auto it = _lru.end(); _lru.size() > _capacity
+                                && it != _lru.begin(); ) {
+            --it;
+            if( !it->inUse ) {
+                _free( it++ );
+                ++_nEvicted;
+            }
+        }
+    }
+    /// Acquires new source from managers, setting its owner. Returns null
+    /// if none of managers provides the source. Managers list is locked only
+    /// to be copied as managers may lock it by themselves (e.g. acquiring
+    /// metadata for the new source).
+    iEventSource * _open( const SourceID & sid, Manager *& owner ) {
+        Managers mngrs;
+        {
+            std::unique_ptr<SharedLock> l( _mngrsMtx ? new SharedLock(*_mngrsMtx)
+                                                     : nullptr );
+            mngrs = _mngrs;
+        }
+        for( auto mngrPtr : mngrs ) {
+            iEventSource * srcPtr = mngrPtr->source( sid );
+            if( srcPtr ) {
+                owner = mngrPtr;
+                return srcPtr;
+            }
+        }
+        return nullptr;
+    }
+public:
+    DisposableSourcesPool( const Managers & mngrs,
+                           size_t capacity=0,
+                           SharedMutex * mngrsMtx=nullptr ) :
+                _mngrs(mngrs), _mngrsMtx(mngrsMtx), _capacity(capacity),
+                _nHits(0), _nMisses(0), _nEvicted(0), _nOpening(0) {}
+    ~DisposableSourcesPool() {
+        if( !_lru.empty() ) {
+            sV_logw( "Sources pool %p is destroyed with %zu sources alive.\n",
+                     this, _lru.size() );
+        }
+    }
+
+    /// Returns source with given ID, either cached or newly acquired from
+    /// managers. Raises badState if no manager provides the source.
+    iEventSource * acquire( const SourceID & sid ) {
+        std::unique_lock<std::mutex> l(_mtx);
+        auto range = _bySID.equal_range( sid );
+        for( auto sit = range.first; sit != range.second; ++sit ) {
+            if( !sit->second->inUse ) {
+                ++_nHits;
+                sit->second->inUse = true;
+                _lru.splice( _lru.begin(), _lru, sit->second );
+                return sit->second->srcPtr;
+            }
+        }
+        ++_nMisses;
+        // Placeholder entry is in use, so it is neither acquired by others
+        // nor evicted while the source is being opened without lock.
+        _lru.push_front( Entry{ sid, nullptr, nullptr, true, false } );
+        auto it = _lru.begin();
+        _bySID.emplace( sid, it );
+        ++_nOpening;
+        Manager * owner = nullptr;
+        iEventSource * srcPtr = nullptr;
+        l.unlock();
+        try {
+            srcPtr = _open( sid, owner );
+        } catch( ... ) {
+            l.lock();
+            _erase( it );
+            --_nOpening;
+            _openedCV.notify_all();
+            throw;
+        }
+        l.lock();
+        --_nOpening;
+        _openedCV.notify_all();
+        if( !srcPtr ) {
+            _erase( it );
+            emraise( badState, "Sources pool %p could not acquire disposable "
+                "event source among %zu stores.", this, _mngrs.size() );
+        }
+        it->srcPtr = srcPtr;
+        it->owner = owner;
+        _byPtr.emplace( srcPtr, it );
+        _evict();
+        return srcPtr;
+    }
+
+    /// Gives back the source acquired with `acquire()`.
+    void release( iEventSource * srcPtr ) {
+        std::lock_guard<std::mutex> l(_mtx);
+        auto pit = _byPtr.find( srcPtr );
+        if( _byPtr.end() == pit ) {
+            emraise( notFound, "Source %p does not belong to pool %p.",
+                     srcPtr, this );
+        }
+        assert( pit->second->inUse );
+        if( pit->second->orphaned ) {
+            _free( pit->second );
+            _releasedCV.notify_all();
+            return;
+        }
+        pit->second->inUse = false;
+        _evict();
+    }
+
+    /// Frees all the cached sources not being in use (and not being
+    /// opened).
+    void clear() {
+        std::lock_guard<std::mutex> l(_mtx);
+        for( auto it = _lru.begin(); it != _lru.end(); ) {
+            if( !it->inUse ) {
+                _free( it++ );
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    /// Frees all the sources provided by given manager. Waits for pending
+    /// openings first, since they may refer to this manager. Sources being
+    /// in use are orphaned: they are not given to anyone anymore and are
+    /// freed once released; method returns after all of them are freed.
+    void forget( Manager * mngrPtr ) {
+        std::unique_lock<std::mutex> l(_mtx);
+        _openedCV.wait( l, [this]{ return !_nOpening; } );
+        size_t nOrphaned = 0;
+        for( auto it = _lru.begin(); it != _lru.end(); ++it ) {
+            if( mngrPtr != it->owner || it->orphaned ) {
+                continue;
+            }
+            // Exclude from look-up by ID, so it is not acquired again.
+            auto range = _bySID.equal_range( it->sid );
+            for( auto sit = range.first; sit != range.second; ++sit ) {
+                if( sit->second == it ) {
+                    _bySID.erase( sit );
+                    break;
+                }
+            }
+            it->orphaned = true;
+            if( it->inUse ) {
+                ++nOrphaned;
+            }
+        }
+        for( auto it = _lru.begin(); it != _lru.end(); ) {
+            if( it->orphaned && !it->inUse ) {
+                _free( it++ );
+            } else {
+                ++it;
+            }
+        }
+        if( nOrphaned ) {
+            sV_log3( "Sources pool %p waits for %zu source(s) of forgotten "
+                     "store to be released.\n", this, nOrphaned );
+        }
+        _releasedCV.wait( l, [this, mngrPtr]{
+                for( const auto & e : _lru ) {
+                    if( mngrPtr == e.owner ) return false;
+                }
+                return true;
+            } );
+    }
+
+    /// Sets maximum number of cached sources.
+    void capacity( size_t n ) {
+        std::lock_guard<std::mutex> l(_mtx);
+        _capacity = n;
+        _evict();
+    }
+    /// Returns maximum number of cached sources.
+    size_t capacity() const { return _capacity; }
+    /// Returns number of alive sources.
+    size_t size() const { return _lru.size(); }
+
+    size_t n_hits() const { return _nHits; }
+    size_t n_misses() const { return _nMisses; }
+    size_t n_evicted() const { return _nEvicted; }
+
+    /// Prints out cache statistics.
+    void print_brief_summary( std::ostream & os ) const {
+        os << "Sources pool: " << _nHits << " hits, " << _nMisses
+           << " misses, " << _nEvicted << " evicted, " << _lru.size()
+           << "/" << _capacity << " alive." << std::endl;
+    }
+};  // class DisposableSourcesPool
+
+}  // namespace aux
+}  // namespace sV
+
+# endif  // H_STROMA_V_METADATA_SOURCES_POOL_H
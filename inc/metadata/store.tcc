@@ -25,6 +25,8 @@
 
 # include "traits.tcc"
 
+# include <cstdint>
+
 namespace sV {
 
 template<typename EventIDT,
@@ -51,6 +53,15 @@ struct RangeReadingMarkupEntry {
     iSectionalEventSource<EventIDT, MetadataT, SourceIDT> * srcPtr;
 };
 
+/// Position where previous indexing of (growing) source stopped.
+template<typename EventIDT>
+struct IndexingCursor {
+    /// Offset inside the source; zero means "from the beginning".
+    uint64_t offset;
+    /// Last indexed event.
+    EventIDT lastEventID;
+};
+
 }  // namespace aux
 
 /**@class ITMetadataStore
@@ -121,6 +132,16 @@ struct ITEventQueryableStore : virtual public ITMetadataStore<EventIDT,
     /// (IF) Has to return an identifier of sectional source containing the
     /// event with specific ID.
     virtual bool source_id_for( const EventID &, SourceID & ) const = 0;
+
+    /// Has to return an identifier of sectional source containing the event
+    /// with specific ID and position of this event within the source (used
+    /// to order batched reading). Default implementation sets zero position.
+    virtual bool source_location_for( const EventID & eid,
+                                      SourceID & sid,
+                                      uint64_t & position ) const {
+        position = 0;
+        return source_id_for( eid, sid );
+    }
 };
 
 template<typename EventIDT,
@@ -154,6 +175,23 @@ struct ITSetQueryableStore : virtual public ITMetadataStore<EventIDT,
                                 std::list<SubrangeMarkup> & ) const = 0;
 };  // class iRangeQueryableStore
 
+template<typename EventIDT,
+         typename MetadataT,
+         typename SourceIDT>
+struct ITResumableStore : virtual public ITMetadataStore<EventIDT,
+                                                      MetadataT,
+                                                      SourceIDT> {
+    sV_METADATA_IMPORT_SECT_TRAITS(EventIDT, MetadataT, SourceIDT);
+
+    /// (IF) Has to retrieve indexing cursor saved for source. Returns false
+    /// if there is no cursor for the source.
+    virtual bool get_cursor_for( const SourceID &,
+                                 IndexingCursor & ) const = 0;
+
+    /// (IF) Has to save indexing cursor for source.
+    virtual void put_cursor( const SourceID &, const IndexingCursor & ) = 0;
+};  // class ITResumableStore
+
 }  // namespace sV
 
 # endif  // H_STROMA_V_METADATA_STORE_H
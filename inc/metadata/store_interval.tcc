@@ -0,0 +1,640 @@
+/*
+ * Copyright (c) 2016 Renat R. Dusaev <crank@qcrypt.org>
+ * Author: Renat R. Dusaev <crank@qcrypt.org>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+# ifndef H_STROMA_V_METADATA_INTERVAL_STORE_H
+# define H_STROMA_V_METADATA_INTERVAL_STORE_H
+
+# include "store.tcc"
+# include "shared_mutex.hpp"
+# include "bloom_filter.hpp"
+
+# include <algorithm>
+# include <atomic>
+# include <cerrno>
+# include <cstdio>
+# include <cstring>
+# include <fstream>
+# include <map>
+# include <type_traits>
+# include <vector>
+
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <unistd.h>
+
+namespace sV {
+
+namespace aux {
+
+/// Entry of interval index: events range [from, to] covered by the source.
+template<typename EventIDT, typename SourceIDT>
+struct SourceInterval {
+    EventIDT from, to;
+    SourceIDT sid;
+};
+
+/// Header of file with persisted event ID filters.
+struct EventFiltersFileHeader {
+    char magic[4];  // "sVBF"
+    uint32_t formatVersion;
+    uint64_t nFilters;
+};
+
+/// Header of particular source filter record (followed by source ID, first
+/// and last event IDs of the source, each padded to 8 bytes, and filter
+/// bits). Events range is used to validate the filter.
+struct EventFilterRecordHeader {
+    uint64_t nBits;
+    uint32_t nHashes;
+    uint32_t sourceIDSize;
+    uint32_t eventIDSize;
+    uint32_t hasRange;
+};
+
+}  // namespace aux
+
+/**@class iTIntervalIndexedStore
+ * @brief In-memory store performing range and event look-up with sorted
+ *        intervals index.
+ *
+ * Keeps the range of events [first, last] for each source in a vector sorted
+ * by first event ID. The vector is considered as implicit balanced binary
+ * tree (each interval is the root of the subtree of its neighbours within
+ * halved subrange), augmented with maximum of last event ID over the
+ * subtree, so the overlapping intervals are supported. Range query then
+ * costs O((k + 1) log n) for k found sources (but no more than O(n)) instead
+ * of linear scan over all the metadata instances, even if some intervals
+ * span over many others (e.g. growing source with open range).
+ *
+ * Descendants have to provide the events range covered by metadata
+ * instance. Optionally, they may check that event is actually present in
+ * the source (i.e. source range has gaps) and provide event position within
+ * the source, and adjust range boundaries to existing events.
+ *
+ * The index is rebuilt lazily on first query after modification, so bulk
+ * loading with `put_metadata()` (or `bulk_load()`) costs a single sort.
+ * Markup entries are returned in order of their first event ID, with
+ * metadata pointers set.
+ *
+ * Store does not own metadata instances unless `ownsMetadata` is set on
+ * construction. Event ID type has to be comparable with `operator<`.
+ *
+ * Store is thread-safe: queries are performed under shared lock, while
+ * modifications and index re-building take exclusive one. Hooks are
+ * invoked under the shared lock and have to be re-entrant.
+ *
+ * For sparse or overlapping sources, per-source Bloom filters over event IDs
+ * may be enabled with `enable_filters()` (descendant has then to enumerate
+ * events of metadata instance). Single event look-up then skips the
+ * sources that can not contain the event without invoking
+ * `_V_locate_event()`. Filters may be saved to file and memory-mapped on
+ * next run. Mapped filter is used for the source whose metadata is put for
+ * the first time only if the source covers the same events range as when
+ * the filter was saved (so the filters of grown or re-indexed sources are
+ * rebuilt); re-putting metadata always rebuilds the filter.
+ * */
+template<typename EventIDT,
+         typename MetadataT,
+         typename SourceIDT>
+class iTIntervalIndexedStore :
+            public ITEventQueryableStore<EventIDT, MetadataT, SourceIDT>,
+            public ITRangeQueryableStore<EventIDT, MetadataT, SourceIDT> {
+public:
+    sV_METADATA_IMPORT_SECT_TRAITS(EventIDT, MetadataT, SourceIDT);
+    typedef aux::SourceInterval<EventID, SourceID> Interval;
+    typedef iTIntervalIndexedStore<EventID, Metadata, SourceID> Self;
+private:
+    const bool _ownsMetadata;
+    /// Metadata instances by source ID.
+    std::map<SourceID, Metadata *> _metadata;
+    /// Intervals sorted by first event ID.
+    std::vector<Interval> _intervals;
+    /// Maximum of last event ID over implicit subtree rooted at interval
+    /// with same index.
+    std::vector<EventID> _maxTo;
+    std::atomic<bool> _isDirty;
+    mutable aux::SharedMutex _mtx;
+    /// Desired false positives rate of filters (zero if disabled).
+    double _fpRate;
+    /// Per-source event ID filters.
+    std::map<SourceID, aux::BloomFilter> _filters;
+    /// Events ranges the mapped filters were built for.
+    std::map<SourceID, std::pair<EventID, EventID> > _mappedRanges;
+    /// Mapped filters file.
+    void * _filtersMap;
+    size_t _filtersMapLength;
+    /// Number of sources skipped due to filters.
+    mutable std::atomic<size_t> _nFilteredOut;
+
+    /// Index is rebuilt from const query methods.
+    Self & _lazy() const { return const_cast<Self &>(*this); }
+protected:
+    /// (IF) Has to set first and last events described by metadata
+    /// instance. Shall return false if metadata describes no events.
+    virtual bool _V_events_range( const Metadata &,
+                                  EventID & first,
+                                  EventID & last ) const = 0;
+
+    /// Has to return true if event within source range is actually present
+    /// in source, setting its position. Default implementation considers
+    /// source range as continuous and sets zero position.
+    virtual bool _V_locate_event( const Metadata &,
+                                  const EventID &,
+                                  uint64_t & position ) const {
+        position = 0;
+        return true;
+    }
+
+    /// May narrow the markup range [from, to] (already clipped to source
+    /// range) to events actually present in the source. Default does
+    /// nothing.
+    virtual void _V_adjust_subrange( const Metadata &,
+                                     SubrangeMarkup & ) const {}
+
+    /// Has to fill the list with all events described by metadata instance
+    /// in order to build the events filter. Default implementation returns
+    /// false meaning that no filter is built for source.
+    virtual bool _V_collect_events( const Metadata &,
+                                    std::vector<EventID> & ) const {
+        return false;
+    }
+
+    /// Builds filter for source (invoked under exclusive lock).
+    void _build_filter( const SourceID &, const Metadata & );
+    /// Returns true if mapped filter of the source was built for the same
+    /// events range as given metadata covers.
+    bool _is_mapped_filter_valid( const SourceID &, const Metadata & ) const;
+    /// Unmaps filters file, dropping the filters referring to it.
+    void _unmap_filters();
+
+    /// Re-builds sorted intervals index.
+    void _rebuild_index();
+    /// Fills maximum of last event ID for subtree of intervals [lo, hi),
+    /// returning it.
+    EventID _build_max_to( size_t lo, size_t hi );
+
+    /// Re-builds the index if needed. Has to be invoked without lock held.
+    void _ensure_index() const {
+        if( _isDirty ) {
+            aux::ExclusiveLock l(_mtx);
+            if( _isDirty ) _lazy()._rebuild_index();
+        }
+    }
+
+    /// Iterates over intervals overlapping with [from, to] in reverse order,
+    /// invoking callback for each one with its metadata. Has to be invoked
+    /// with (shared) lock held, after _ensure_index(). Sources erased since
+    /// index was built are skipped.
+    template<typename CallableT> void
+    _for_overlapping( const EventID & from, const EventID & to,
+                      CallableT f ) const {
+        _for_overlapping_in( 0, _intervals.size(), from, to, f );
+    }
+    /// Recursive implementation of _for_overlapping() for subtree of
+    /// intervals [lo, hi).
+    template<typename CallableT> void
+    _for_overlapping_in( size_t lo, size_t hi,
+                         const EventID & from, const EventID & to,
+                         CallableT & f ) const;
+public:
+    iTIntervalIndexedStore( bool ownsMetadata=false ) :
+                _ownsMetadata(ownsMetadata), _isDirty(false),
+                _fpRate(0), _filtersMap(nullptr), _filtersMapLength(0),
+                _nFilteredOut(0) {}
+
+    virtual ~iTIntervalIndexedStore();
+
+    /// Puts multiple metadata instances at once.
+    template<typename IteratorT> void
+    bulk_load( IteratorT begin, IteratorT end ) {
+        for( ; begin != end; ++begin ) {
+            put_metadata( begin->first, *(begin->second) );
+        }
+    }
+
+    /// Enables building of event ID filters for sources put afterwards with
+    /// given false positives rate. Zero rate disables filters building.
+    void enable_filters( double fpRate ) {
+        aux::ExclusiveLock l(_mtx);
+        _fpRate = fpRate;
+    }
+
+    /// Writes event ID filters of all sources to file. File is written under
+    /// temporary name and then renamed, so the path may refer to filters
+    /// currently mapped by this (or another) store.
+    void save_filters( const std::string & path ) const;
+
+    /// Memory-maps filters previously written with save_filters(). Returns
+    /// number of loaded filters.
+    size_t map_filters( const std::string & path );
+
+    /// Number of sources skipped by single event look-ups due to filters.
+    size_t n_filtered_out() const { return _nFilteredOut; }
+
+    /// Number of indexed sources.
+    size_t n_sources() const {
+        aux::SharedLock l(_mtx);
+        return _metadata.size();
+    }
+
+    virtual Metadata * get_metadata_for( const SourceID & ) const override;
+    virtual void put_metadata( const SourceID &, const Metadata & ) override;
+    virtual void erase_metadata_for( const SourceID & ) override;
+    virtual bool source_id_for( const EventID & eid,
+                                SourceID & sid ) const override {
+        uint64_t position;
+        return source_location_for( eid, sid, position );
+    }
+    virtual bool source_location_for( const EventID &,
+                                      SourceID &,
+                                      uint64_t & position ) const override;
+    virtual void collect_source_ids_for_range(
+                                const EventID & from,
+                                const EventID & to,
+                                std::list<SubrangeMarkup> & ) const override;
+};  // class iTIntervalIndexedStore
+
+template<typename EventIDT, typename MetadataT, typename SourceIDT>
+iTIntervalIndexedStore<EventIDT, MetadataT, SourceIDT>
+                                            ::~iTIntervalIndexedStore() {
+    if( _ownsMetadata ) {
+        for( auto & p : _metadata ) {
+            delete p.second;
+        }
+    }
+    _unmap_filters();
+}
+
+template<typename EventIDT, typename MetadataT, typename SourceIDT> void
+iTIntervalIndexedStore<EventIDT, MetadataT, SourceIDT>::_build_filter(
+                                        const SourceID & sid,
+                                        const Metadata & md ) {
+    _mappedRanges.erase( sid );
+    std::vector<EventID> eids;
+    if( !_fpRate || !_V_collect_events( md, eids ) ) {
+        _filters.erase( sid );
+        return;
+    }
+    aux::BloomFilter f( eids.size(), _fpRate );
+    for( const auto & eid : eids ) {
+        f.insert( eid );
+    }
+    _filters[sid] = f;
+}
+
+template<typename EventIDT, typename MetadataT, typename SourceIDT> bool
+iTIntervalIndexedStore<EventIDT, MetadataT, SourceIDT>::_is_mapped_filter_valid(
+                                        const SourceID & sid,
+                                        const Metadata & md ) const {
+    auto it = _mappedRanges.find( sid );
+    EventID first, last;
+    if( _mappedRanges.end() == it || !_filters.count( sid )
+     || !_V_events_range( md, first, last ) ) {
+        return false;
+    }
+    return !(first < it->second.first) && !(it->second.first < first)
+        && !(last < it->second.second) && !(it->second.second < last);
+}
+
+template<typename EventIDT, typename MetadataT, typename SourceIDT> void
+iTIntervalIndexedStore<EventIDT, MetadataT, SourceIDT>::_unmap_filters() {
+    if( !_filtersMap ) {
+        return;
+    }
+    const uint8_t * b = static_cast<const uint8_t *>(_filtersMap),
+                  * e = b + _filtersMapLength;
+    for( auto it = _filters.begin(); it != _filters.end(); ) {
+        const uint8_t * w = reinterpret_cast<const uint8_t *>(it->second.words());
+        if( w >= b && w < e ) {
+            it = _filters.erase( it );
+        } else {
+            ++it;
+        }
+    }
+    _mappedRanges.clear();
+    munmap( _filtersMap, _filtersMapLength );
+    _filtersMap = nullptr;
+    _filtersMapLength = 0;
+}
+
+template<typename EventIDT, typename MetadataT, typename SourceIDT> void
+iTIntervalIndexedStore<EventIDT, MetadataT, SourceIDT>::save_filters(
+                                        const std::string & path ) const {
+    static_assert( std::is_trivially_copyable<SourceID>::value
+                && std::is_trivially_copyable<EventID>::value,
+                   "Source and event IDs have to be trivially copyable." );
+    aux::SharedLock l(_mtx);
+    // Truncating the file in place would invalidate its existing mappings
+    // (including ones filters of this store may refer to).
+    const std::string tmpPath = path + ".tmp." + std::to_string( getpid() );
+    std::ofstream os( tmpPath, std::ios::binary | std::ios::trunc );
+    if( !os ) {
+        emraise( thirdParty, "Unable to open file \"%s\" for writing: %s.",
+                 tmpPath.c_str(), strerror(errno) );
+    }
+    aux::EventFiltersFileHeader h = { {'s', 'V', 'B', 'F'}, 2,
+                                      (uint64_t) _filters.size() };
+    os.write( reinterpret_cast<const char *>(&h), sizeof(h) );
+    const size_t sidPadded = ((sizeof(SourceID) + 7)/8)*8,
+                 eidPadded = ((sizeof(EventID) + 7)/8)*8;
+    std::vector<char> buf( sidPadded + 2*eidPadded, 0 );
+    for( const auto & p : _filters ) {
+        // Range of the source put within this session, or the one filter
+        // was mapped with.
+        std::pair<EventID, EventID> range;
+        bool hasRange = false;
+        auto mit = _metadata.find( p.first );
+        if( _metadata.end() != mit ) {
+            hasRange = _V_events_range( *(mit->second),
+                                        range.first, range.second );
+        } else {
+            auto rit = _mappedRanges.find( p.first );
+            if( _mappedRanges.end() != rit ) {
+                range = rit->second;
+                hasRange = true;
+            }
+        }
+        aux::EventFilterRecordHeader rh = { p.second.n_bits(),
+                                            p.second.n_hashes(),
+                                            (uint32_t) sizeof(SourceID),
+                                            (uint32_t) sizeof(EventID),
+                                            hasRange };
+        os.write( reinterpret_cast<const char *>(&rh), sizeof(rh) );
+        std::fill( buf.begin(), buf.end(), 0 );
+        memcpy( buf.data(), &(p.first), sizeof(SourceID) );
+        if( hasRange ) {
+            memcpy( buf.data() + sidPadded, &(range.first), sizeof(EventID) );
+            memcpy( buf.data() + sidPadded + eidPadded, &(range.second),
+                    sizeof(EventID) );
+        }
+        os.write( buf.data(), buf.size() );
+        os.write( reinterpret_cast<const char *>(p.second.words()),
+                  p.second.n_bits()/8 );
+    }
+    os.close();
+    if( !os ) {
+        remove( tmpPath.c_str() );
+        emraise( thirdParty, "Failed to write filters file \"%s\".",
+                 tmpPath.c_str() );
+    }
+    if( rename( tmpPath.c_str(), path.c_str() ) ) {
+        int err = errno;
+        remove( tmpPath.c_str() );
+        emraise( thirdParty, "Unable to replace filters file \"%s\": %s.",
+                 path.c_str(), strerror(err) );
+    }
+}
+
+template<typename EventIDT, typename MetadataT, typename SourceIDT> size_t
+iTIntervalIndexedStore<EventIDT, MetadataT, SourceIDT>::map_filters(
+                                        const std::string & path ) {
+    aux::ExclusiveLock l(_mtx);
+    _unmap_filters();
+    int fd = open( path.c_str(), O_RDONLY );
+    if( fd < 0 ) {
+        emraise( thirdParty, "Unable to open filters file \"%s\": %s.",
+                 path.c_str(), strerror(errno) );
+    }
+    struct stat st;
+    if( fstat( fd, &st ) || (size_t) st.st_size < sizeof(aux::EventFiltersFileHeader) ) {
+        close( fd );
+        emraise( badState, "Filters file \"%s\" is corrupted.", path.c_str() );
+    }
+    void * m = mmap( nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+    close( fd );
+    if( MAP_FAILED == m ) {
+        emraise( thirdParty, "Unable to map filters file \"%s\": %s.",
+                 path.c_str(), strerror(errno) );
+    }
+    _filtersMap = m;
+    _filtersMapLength = st.st_size;
+    const uint8_t * c = static_cast<const uint8_t *>(m),
+                  * e = c + st.st_size;
+    const aux::EventFiltersFileHeader & h
+                    = *reinterpret_cast<const aux::EventFiltersFileHeader *>(c);
+    if( memcmp( h.magic, "sVBF", 4 ) || 2 != h.formatVersion ) {
+        _unmap_filters();
+        emraise( badState, "File \"%s\" is not an events filters file of "
+                 "supported version.", path.c_str() );
+    }
+    c += sizeof(h);
+    const size_t sidPadded = ((sizeof(SourceID) + 7)/8)*8,
+                 eidPadded = ((sizeof(EventID) + 7)/8)*8;
+    size_t nLoaded = 0;
+    for( uint64_t n = 0; n < h.nFilters; ++n ) {
+        const aux::EventFilterRecordHeader & rh
+                    = *reinterpret_cast<const aux::EventFilterRecordHeader *>(c);
+        if( c + sizeof(rh) > e || sizeof(SourceID) != rh.sourceIDSize
+         || sizeof(EventID) != rh.eventIDSize
+         || c + sizeof(rh) + sidPadded + 2*eidPadded + rh.nBits/8 > e ) {
+            _unmap_filters();
+            emraise( badState, "Filters file \"%s\" is corrupted.",
+                     path.c_str() );
+        }
+        SourceID sid;
+        std::pair<EventID, EventID> range;
+        c += sizeof(rh);
+        memcpy( &sid, c, sizeof(SourceID) );
+        memcpy( &(range.first), c + sidPadded, sizeof(EventID) );
+        memcpy( &(range.second), c + sidPadded + eidPadded, sizeof(EventID) );
+        c += sidPadded + 2*eidPadded;
+        // Filters built within this session are not replaced; filters with
+        // no range are never valid.
+        if( rh.hasRange && _filters.emplace( sid, aux::BloomFilter::view(
+                        reinterpret_cast<const uint64_t *>(c),
+                        rh.nBits, rh.nHashes ) ).second ) {
+            _mappedRanges[sid] = range;
+            ++nLoaded;
+        }
+        c += rh.nBits/8;
+    }
+    return nLoaded;
+}
+
+template<typename EventIDT, typename MetadataT, typename SourceIDT> void
+iTIntervalIndexedStore<EventIDT, MetadataT, SourceIDT>::_rebuild_index() {
+    _intervals.clear();
+    _maxTo.clear();
+    _intervals.reserve( _metadata.size() );
+    for( const auto & p : _metadata ) {
+        Interval i;
+        if( _V_events_range( *(p.second), i.from, i.to ) ) {
+            i.sid = p.first;
+            _intervals.push_back( i );
+        }
+    }
+    std::sort( _intervals.begin(), _intervals.end(),
+               []( const Interval & a, const Interval & b ) {
+                    return a.from < b.from
+                        || ( !(b.from < a.from) && a.sid < b.sid ); } );
+    _maxTo.resize( _intervals.size() );
+    if( !_intervals.empty() ) {
+        _build_max_to( 0, _intervals.size() );
+    }
+    _isDirty = false;
+}
+
+template<typename EventIDT, typename MetadataT, typename SourceIDT> EventIDT
+iTIntervalIndexedStore<EventIDT, MetadataT, SourceIDT>::_build_max_to(
+                                        size_t lo, size_t hi ) {
+    const size_t mid = lo + (hi - lo)/2;
+    EventID m = _intervals[mid].to;
+    if( lo < mid ) {
+        EventID l = _build_max_to( lo, mid );
+        if( m < l ) m = l;
+    }
+    if( mid + 1 < hi ) {
+        EventID r = _build_max_to( mid + 1, hi );
+        if( m < r ) m = r;
+    }
+    return _maxTo[mid] = m;
+}
+
+template<typename EventIDT, typename MetadataT, typename SourceIDT>
+template<typename CallableT> void
+iTIntervalIndexedStore<EventIDT, MetadataT, SourceIDT>::_for_overlapping_in(
+                                        size_t lo, size_t hi,
+                                        const EventID & from,
+                                        const EventID & to,
+                                        CallableT & f ) const {
+    // Right subtree, root and then left subtree (the latter iteratively):
+    while( lo < hi ) {
+        const size_t mid = lo + (hi - lo)/2;
+        // None of subtree intervals reaches `from`:
+        if( _maxTo[mid] < from ) {
+            return;
+        }
+        // Root and right subtree start after `to` otherwise:
+        if( !(to < _intervals[mid].from) ) {
+            _for_overlapping_in( mid + 1, hi, from, to, f );
+            if( !(_intervals[mid].to < from) ) {
+                auto it = _metadata.find( _intervals[mid].sid );
+                if( _metadata.end() != it ) {
+                    f( _intervals[mid], *(it->second) );
+                }
+            }
+        }
+        hi = mid;
+    }
+}
+
+template<typename EventIDT, typename MetadataT, typename SourceIDT> MetadataT *
+iTIntervalIndexedStore<EventIDT, MetadataT, SourceIDT>::get_metadata_for(
+                                        const SourceID & sid ) const {
+    aux::SharedLock l(_mtx);
+    auto it = _metadata.find( sid );
+    if( _metadata.end() == it ) {
+        return nullptr;
+    }
+    return it->second;
+}
+
+template<typename EventIDT, typename MetadataT, typename SourceIDT> void
+iTIntervalIndexedStore<EventIDT, MetadataT, SourceIDT>::put_metadata(
+                                        const SourceID & sid,
+                                        const Metadata & md ) {
+    aux::ExclusiveLock l(_mtx);
+    auto ir = _metadata.emplace( sid, nullptr );
+    Metadata *& mdPtr = ir.first->second;
+    // Mapped filter is used for newly put metadata of same events range.
+    if( !ir.second || !_is_mapped_filter_valid( sid, md ) ) {
+        _build_filter( sid, md );
+    }
+    if( mdPtr != &md ) {
+        if( _ownsMetadata ) {
+            delete mdPtr;
+            mdPtr = new Metadata( md );
+        } else {
+            mdPtr = const_cast<Metadata *>( &md );
+        }
+    }
+    // Metadata could be appended, so its range has to be re-read anyway.
+    _isDirty = true;
+}
+
+template<typename EventIDT, typename MetadataT, typename SourceIDT> void
+iTIntervalIndexedStore<EventIDT, MetadataT, SourceIDT>::erase_metadata_for(
+                                        const SourceID & sid ) {
+    aux::ExclusiveLock l(_mtx);
+    auto it = _metadata.find( sid );
+    if( _metadata.end() == it ) {
+        return;
+    }
+    if( _ownsMetadata ) {
+        delete it->second;
+    }
+    _metadata.erase( it );
+    _filters.erase( sid );
+    _mappedRanges.erase( sid );
+    _isDirty = true;
+}
+
+template<typename EventIDT, typename MetadataT, typename SourceIDT> bool
+iTIntervalIndexedStore<EventIDT, MetadataT, SourceIDT>::source_location_for(
+                                        const EventID & eid,
+                                        SourceID & sid,
+                                        uint64_t & position ) const {
+    _ensure_index();
+    aux::SharedLock l(_mtx);
+    bool found = false;
+    _for_overlapping( eid, eid, [&]( const Interval & i, Metadata & md ) {
+            if( found ) {
+                return;
+            }
+            auto fit = _filters.find( i.sid );
+            if( _filters.end() != fit && !fit->second.may_contain( eid ) ) {
+                ++_nFilteredOut;
+                return;
+            }
+            if( _V_locate_event( md, eid, position ) ) {
+                sid = i.sid;
+                found = true;
+            }
+        } );
+    return found;
+}
+
+template<typename EventIDT, typename MetadataT, typename SourceIDT> void
+iTIntervalIndexedStore<EventIDT, MetadataT, SourceIDT>
+                                        ::collect_source_ids_for_range(
+                                        const EventID & from,
+                                        const EventID & to,
+                                        std::list<SubrangeMarkup> & output
+                                        ) const {
+    _ensure_index();
+    aux::SharedLock l(_mtx);
+    // Intervals are visited in reverse order, so markup is prepended.
+    std::list<SubrangeMarkup> found;
+    _for_overlapping( from, to, [&]( const Interval & i, Metadata & md ) {
+            found.push_front( SubrangeMarkup{
+                                    i.from < from ? from : i.from,
+                                    to < i.to ? to : i.to,
+                                    i.sid, &md, nullptr } );
+            _V_adjust_subrange( md, found.front() );
+        } );
+    output.splice( output.end(), found );
+}
+
+}  // namespace sV
+
+# endif  // H_STROMA_V_METADATA_INTERVAL_STORE_H
@@ -0,0 +1,779 @@
+/*
+ * Copyright (c) 2016 Renat R. Dusaev <crank@qcrypt.org>
+ * Author: Renat R. Dusaev <crank@qcrypt.org>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+# ifndef H_STROMA_V_METADATA_MMAP_STORE_H
+# define H_STROMA_V_METADATA_MMAP_STORE_H
+
+# include "store.tcc"
+# include "shared_mutex.hpp"
+
+# include <algorithm>
+# include <cerrno>
+# include <cstring>
+# include <list>
+# include <map>
+# include <set>
+# include <type_traits>
+# include <vector>
+
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <unistd.h>
+
+namespace sV {
+
+/**@class iTMetadataSerializer
+ * @brief User-defined serialization routines for persistent metadata stores.
+ *
+ * Persistent stores (see MMapMetadataStore) know nothing about the layout of
+ * particular metadata type. This interface provides conversion of metadata
+ * instances to/from plain bytes, enumerates events described by metadata
+ * instance (with their positions inside of the source) and, optionally,
+ * provides path to the file corresponding to the source ID that will be used
+ * to invalidate cached entries when source file is modified.
+ * */
+template<typename EventIDT,
+         typename MetadataT,
+         typename SourceIDT>
+struct iTMetadataSerializer {
+    sV_METADATA_IMPORT_SECT_TRAITS(EventIDT, MetadataT, SourceIDT);
+    /// Event identifiers with their offsets inside of the source.
+    typedef std::vector< std::pair<EventID, uint64_t> > EventsLocations;
+
+    virtual ~iTMetadataSerializer() {}
+
+    /// (IF) Has to append serialized metadata to given buffer.
+    virtual void serialize( const Metadata &, std::vector<uint8_t> & ) const = 0;
+
+    /// (IF) Has to allocate new metadata instance from serialized data.
+    virtual Metadata * deserialize( const uint8_t *, size_t ) const = 0;
+
+    /// (IF) Has to list events (and their in-source offsets) described by
+    /// metadata instance.
+    virtual void locate_events( const Metadata &, EventsLocations & ) const = 0;
+
+    /// Has to return path of file corresponding to source. Modification time
+    /// and size of this file will be used for cache invalidation. Default
+    /// implementation returns empty string that disables the validation.
+    virtual std::string source_path( const SourceID & ) const { return ""; }
+};  // struct iTMetadataSerializer
+
+namespace aux {
+
+/// Header of mapped metadata index file.
+struct MMapMetadataIndexHeader {
+    char magic[8];
+    uint32_t version,
+             eventIDSize,
+             sourceIDSize,
+             reserved;
+    uint64_t nSources,
+             nEntries;
+};
+
+/// Index file entry: event ID mapped to source ID and in-source offset.
+template<typename EventIDT, typename SourceIDT>
+struct MMapMetadataIndexEntry {
+    EventIDT eid;
+    SourceIDT sid;
+    uint64_t offset;
+};
+
+/// Index file source description: source ID, its validation attributes,
+/// location of serialized metadata and indexing cursor (if any).
+template<typename EventIDT, typename SourceIDT>
+struct MMapMetadataSourceEntry {
+    SourceIDT sid;
+    int64_t mtime;
+    uint64_t size,
+             mdOffset,
+             mdLength,
+             hasCursor,
+             cursorOffset;
+    EventIDT cursorEventID;
+};
+
+}  // namespace aux
+
+/**@class MMapMetadataStore
+ * @brief Persistent metadata store based on memory-mapped index file.
+ *
+ * Keeps two files: the index (`<prefix>.idx`) and the serialized metadata
+ * heap (`<prefix>.mdat`). The index contains table of known sources and
+ * array of (event ID, source ID, offset) entries sorted by event ID. It is
+ * mapped into memory on first access, so the look-up of source for certain
+ * event or events range is a binary search over mapped pages without
+ * reading the whole file.
+ *
+ * Metadata instances are deserialized on demand and owned by store. Source
+ * entry becomes invalid once the modification time or size of the file
+ * returned by serializer's `source_path()` differs from recorded ones; such
+ * entries are erased causing metadata re-extraction by metadata type.
+ * Instances of erased (or replaced) entries may still be referenced by
+ * invokers, so they are kept alive until `release_invalidated()` is called
+ * or the store is destroyed.
+ *
+ * New entries are accumulated in memory and the index is re-written (and
+ * re-mapped) upon next event query, explicit `flush()` or destruction.
+ * Metadata heap is append-only; space of erased entries is not reclaimed.
+ *
+ * Store also keeps indexing cursors of growing sources (see
+ * ITResumableStore). Source having a cursor is not invalidated when its
+ * file grows, so only the new tail has to be indexed.
+ *
+ * Store is thread-safe. Queries are performed under shared lock while the
+ * index is synchronized and involved sources are already validated (and
+ * metadata instance is deserialized); otherwise, as well as for
+ * modifications, the exclusive lock is taken.
+ *
+ * Event and source ID types have to be trivially copyable and comparable
+ * with `operator<`.
+ * */
+template<typename EventIDT,
+         typename MetadataT,
+         typename SourceIDT>
+class MMapMetadataStore :
+            public ITEventQueryableStore<EventIDT, MetadataT, SourceIDT>,
+            public ITRangeQueryableStore<EventIDT, MetadataT, SourceIDT>,
+            public ITResumableStore<EventIDT, MetadataT, SourceIDT> {
+public:
+    sV_METADATA_IMPORT_SECT_TRAITS(EventIDT, MetadataT, SourceIDT);
+    typedef iTMetadataSerializer<EventID, Metadata, SourceID> Serializer;
+    typedef aux::MMapMetadataIndexHeader IndexHeader;
+    typedef aux::MMapMetadataIndexEntry<EventID, SourceID> IndexEntry;
+    typedef aux::MMapMetadataSourceEntry<EventID, SourceID> SourceEntry;
+    typedef MMapMetadataStore<EventID, Metadata, SourceID> Self;
+
+    static_assert( std::is_trivially_copyable<EventID>::value
+                && std::is_trivially_copyable<SourceID>::value,
+                "Event and source IDs have to be trivially copyable." );
+    static_assert( alignof(IndexEntry) <= alignof(uint64_t)
+                && alignof(SourceEntry) <= alignof(uint64_t),
+                "Unsupported alignment of event or source ID type." );
+
+    static constexpr uint32_t formatVersion = 2;
+private:
+    const std::string _idxPath,
+                      _mdatPath;
+    const Serializer & _serializer;
+    bool _isOpen,
+         _isDirty;
+    int _mdatFD;
+    /// Mapped index file.
+    void * _idxMap;
+    size_t _idxMapLength;
+    const IndexEntry * _entries;
+    size_t _nEntries;
+    /// Known (cached) sources.
+    std::map<SourceID, SourceEntry> _sources;
+    /// Sources verified against their files within this session.
+    std::set<SourceID> _validated;
+    /// Sources whose entries in mapped index are obsolete.
+    std::set<SourceID> _obsoleteMapped;
+    /// Index entries to be written.
+    std::vector<IndexEntry> _pending;
+    /// Deserialized metadata instances (owned).
+    std::map<SourceID, Metadata *> _cache;
+    /// Instances of invalidated entries, pending release (owned).
+    std::list<Metadata *> _invalidated;
+    mutable aux::SharedMutex _mtx;
+
+    /// Lazy initialization and caching is performed from const query
+    /// methods.
+    Self & _lazy() const { return const_cast<Self &>(*this); }
+protected:
+    void _open();
+    void _unmap_index();
+    void _map_index();
+    /// Writes index file with current sources and entries and re-maps it.
+    void _write_index();
+    /// Returns true if source file was not changed since its metadata was
+    /// stored.
+    bool _is_up_to_date( const SourceEntry & ) const;
+    /// Checks the source once per session, erasing the obsolete entries.
+    /// Returns false if source is unknown or obsolete.
+    bool _validate( const SourceID & );
+    /// Makes sure that index reflects all the changes.
+    void _sync() { if(!_isOpen) _open(); if(_isDirty) _write_index(); }
+    /// Returns true if index may be queried under shared lock.
+    bool _is_synced() const { return _isOpen && !_isDirty; }
+    /// Returns true if entries of source may be used. Unverified source is
+    /// validated if `self` is given (exclusive lock held), otherwise `retry`
+    /// is set.
+    bool _is_usable( const SourceID & sid, Self * self, bool & retry ) const {
+        if( _validated.count( sid ) ) return true;
+        if( !self ) { retry = true; return false; }
+        return self->_validate( sid );
+    }
+
+    // Implementations of public methods invoked with lock held.
+    Metadata * _get_metadata( const SourceID & );
+    void _erase_metadata( const SourceID & );
+    bool _source_location( const EventID &, SourceID &, uint64_t & offset,
+                           Self * self, bool & retry ) const;
+    bool _collect_subranges( const EventID & from, const EventID & to,
+                             std::list<SubrangeMarkup> &,
+                             Self * self, bool & retry ) const;
+public:
+    /// Store will use `<pathPrefix>.idx` and `<pathPrefix>.mdat` files. No
+    /// file is opened until first access.
+    MMapMetadataStore( const std::string & pathPrefix,
+                       const Serializer & serializer ) :
+                _idxPath( pathPrefix + ".idx" ),
+                _mdatPath( pathPrefix + ".mdat" ),
+                _serializer( serializer ),
+                _isOpen(false), _isDirty(false),
+                _mdatFD(-1),
+                _idxMap(nullptr), _idxMapLength(0),
+                _entries(nullptr), _nEntries(0) {}
+
+    virtual ~MMapMetadataStore();
+
+    /// Writes pending changes to index file.
+    void flush() {
+        aux::ExclusiveLock l(_mtx);
+        if(_isOpen && _isDirty) _write_index();
+    }
+
+    /// Deletes metadata instances of erased or replaced entries. Invoker
+    /// must guarantee that none of them is used anymore. Returns number of
+    /// deleted instances.
+    size_t release_invalidated() {
+        aux::ExclusiveLock l(_mtx);
+        size_t n = _invalidated.size();
+        for( auto mdPtr : _invalidated ) {
+            delete mdPtr;
+        }
+        _invalidated.clear();
+        return n;
+    }
+
+    /// Number of known sources.
+    size_t n_sources() const {
+        aux::ExclusiveLock l(_mtx);
+        if(!_isOpen) _lazy()._open();
+        return _sources.size();
+    }
+
+    virtual Metadata * get_metadata_for( const SourceID & ) const override;
+    virtual void put_metadata( const SourceID &, const Metadata & ) override;
+    virtual void erase_metadata_for( const SourceID & ) override;
+    virtual bool source_id_for( const EventID &, SourceID & ) const override;
+    virtual bool source_location_for( const EventID &,
+                                      SourceID &,
+                                      uint64_t & offset ) const override;
+    virtual void collect_source_ids_for_range(
+                                const EventID & from,
+                                const EventID & to,
+                                std::list<SubrangeMarkup> & ) const override;
+    virtual bool get_cursor_for( const SourceID &,
+                                 IndexingCursor & ) const override;
+    virtual void put_cursor( const SourceID &,
+                             const IndexingCursor & ) override;
+};  // class MMapMetadataStore
+
+template<typename EventIDT, typename MetadataT, typename SourceIDT>
+constexpr uint32_t MMapMetadataStore<EventIDT, MetadataT, SourceIDT>::formatVersion;
+
+template<typename EventIDT, typename MetadataT, typename SourceIDT>
+MMapMetadataStore<EventIDT, MetadataT, SourceIDT>::~MMapMetadataStore() {
+    try {
+        flush();
+    } catch( std::exception & e ) {
+        sV_loge( "Failed to write metadata index \"%s\": %s\n",
+                 _idxPath.c_str(), e.what() );
+    }
+    _unmap_index();
+    if( _mdatFD >= 0 ) {
+        close( _mdatFD );
+    }
+    for( auto & p : _cache ) {
+        delete p.second;
+    }
+    release_invalidated();
+}
+
+template<typename EventIDT, typename MetadataT, typename SourceIDT> void
+MMapMetadataStore<EventIDT, MetadataT, SourceIDT>::_open() {
+    _mdatFD = open( _mdatPath.c_str(), O_RDWR | O_CREAT, 0644 );
+    if( _mdatFD < 0 ) {
+        emraise( thirdParty, "Unable to open metadata file \"%s\": %s.",
+                 _mdatPath.c_str(), strerror(errno) );
+    }
+    _isOpen = true;
+    _map_index();
+}
+
+template<typename EventIDT, typename MetadataT, typename SourceIDT> void
+MMapMetadataStore<EventIDT, MetadataT, SourceIDT>::_unmap_index() {
+    if( _idxMap ) {
+        munmap( _idxMap, _idxMapLength );
+    }
+    _idxMap = nullptr;
+    _idxMapLength = 0;
+    _entries = nullptr;
+    _nEntries = 0;
+}
+
+template<typename EventIDT, typename MetadataT, typename SourceIDT> void
+MMapMetadataStore<EventIDT, MetadataT, SourceIDT>::_map_index() {
+    _unmap_index();
+    _sources.clear();
+    int fd = open( _idxPath.c_str(), O_RDONLY );
+    if( fd < 0 ) {
+        if( ENOENT != errno ) {
+            sV_logw( "Unable to open metadata index \"%s\": %s. Index will "
+                     "be re-created.\n", _idxPath.c_str(), strerror(errno) );
+        }
+        return;
+    }
+    struct stat st;
+    if( fstat( fd, &st ) || (size_t) st.st_size < sizeof(IndexHeader) ) {
+        close( fd );
+        sV_logw( "Metadata index \"%s\" is truncated. Index will be "
+                 "re-created.\n", _idxPath.c_str() );
+        return;
+    }
+    _idxMapLength = st.st_size;
+    _idxMap = mmap( nullptr, _idxMapLength, PROT_READ, MAP_SHARED, fd, 0 );
+    close( fd );
+    if( MAP_FAILED == _idxMap ) {
+        _idxMap = nullptr;
+        emraise( thirdParty, "Unable to map metadata index \"%s\": %s.",
+                 _idxPath.c_str(), strerror(errno) );
+    }
+    const IndexHeader & h = *reinterpret_cast<const IndexHeader *>(_idxMap);
+    if( strncmp( h.magic, "sVMDIDX", sizeof(h.magic) )
+     || formatVersion != h.version
+     || sizeof(EventID) != h.eventIDSize
+     || sizeof(SourceID) != h.sourceIDSize
+     || _idxMapLength != sizeof(IndexHeader) + h.nSources*sizeof(SourceEntry)
+                                             + h.nEntries*sizeof(IndexEntry) ) {
+        sV_logw( "Metadata index \"%s\" is incompatible or corrupted. Index "
+                 "will be re-created.\n", _idxPath.c_str() );
+        _unmap_index();
+        _isDirty = true;
+        return;
+    }
+    const SourceEntry * srcs = reinterpret_cast<const SourceEntry *>(&h + 1);
+    for( size_t i = 0; i < h.nSources; ++i ) {
+        _sources.emplace( srcs[i].sid, srcs[i] );
+    }
+    _entries = reinterpret_cast<const IndexEntry *>(srcs + h.nSources);
+    _nEntries = h.nEntries;
+    sV_log3( "Metadata index \"%s\" mapped: %zu sources, %zu events.\n",
+             _idxPath.c_str(), _sources.size(), _nEntries );
+}
+
+template<typename EventIDT, typename MetadataT, typename SourceIDT> void
+MMapMetadataStore<EventIDT, MetadataT, SourceIDT>::_write_index() {
+    std::vector<IndexEntry> entries;
+    entries.reserve( _nEntries + _pending.size() );
+    for( size_t i = 0; i < _nEntries; ++i ) {
+        const IndexEntry & e = _entries[i];
+        if( !_obsoleteMapped.count( e.sid ) && _sources.count( e.sid ) ) {
+            entries.push_back( e );
+        }
+    }
+    entries.insert( entries.end(), _pending.begin(), _pending.end() );
+    std::stable_sort( entries.begin(), entries.end(),
+            []( const IndexEntry & a, const IndexEntry & b ) {
+                return a.eid < b.eid; } );
+
+    IndexHeader h;
+    memset( &h, 0, sizeof(h) );
+    strncpy( h.magic, "sVMDIDX", sizeof(h.magic) );
+    h.version = formatVersion;
+    h.eventIDSize = sizeof(EventID);
+    h.sourceIDSize = sizeof(SourceID);
+    h.nSources = _sources.size();
+    h.nEntries = entries.size();
+    std::vector<SourceEntry> srcs;
+    srcs.reserve( _sources.size() );
+    for( const auto & p : _sources ) {
+        srcs.push_back( p.second );
+    }
+
+    const std::string tmpPath = _idxPath + ".tmp";
+    int fd = open( tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+    if( fd < 0 ) {
+        emraise( thirdParty, "Unable to write metadata index \"%s\": %s.",
+                 tmpPath.c_str(), strerror(errno) );
+    }
+    const std::pair<const void *, size_t> chunks[] = {
+            { &h, sizeof(h) },
+            { srcs.data(), srcs.size()*sizeof(SourceEntry) },
+            { entries.data(), entries.size()*sizeof(IndexEntry) } };
+    for( const auto & c : chunks ) {
+        const char * p = static_cast<const char *>(c.first);
+        for( size_t left = c.second; left; ) {
+            ssize_t n = write( fd, p, left );
+            if( n < 0 ) {
+                if( EINTR == errno ) continue;
+                close( fd );
+                emraise( thirdParty, "Unable to write metadata index "
+                         "\"%s\": %s.", tmpPath.c_str(), strerror(errno) );
+            }
+            p += n;
+            left -= n;
+        }
+    }
+    close( fd );
+    if( rename( tmpPath.c_str(), _idxPath.c_str() ) ) {
+        emraise( thirdParty, "Unable to replace metadata index \"%s\": %s.",
+                 _idxPath.c_str(), strerror(errno) );
+    }
+    _pending.clear();
+    _obsoleteMapped.clear();
+    _isDirty = false;
+    // Re-mapping reloads sources table just written.
+    _map_index();
+}
+
+template<typename EventIDT, typename MetadataT, typename SourceIDT> bool
+MMapMetadataStore<EventIDT, MetadataT, SourceIDT>::_is_up_to_date(
+                                        const SourceEntry & se ) const {
+    const std::string path = _serializer.source_path( se.sid );
+    if( path.empty() ) {
+        return true;
+    }
+    struct stat st;
+    if( stat( path.c_str(), &st ) ) {
+        return false;
+    }
+    if( se.size == (uint64_t) st.st_size
+     && se.mtime == (int64_t) st.st_mtim.tv_sec*1000000000LL
+                             + st.st_mtim.tv_nsec ) {
+        return true;
+    }
+    // Growing source with indexing cursor remains valid: its tail is to be
+    // appended incrementally.
+    return se.hasCursor && se.cursorOffset <= (uint64_t) st.st_size
+                        && se.size <= (uint64_t) st.st_size;
+}
+
+template<typename EventIDT, typename MetadataT, typename SourceIDT> bool
+MMapMetadataStore<EventIDT, MetadataT, SourceIDT>::_validate(
+                                        const SourceID & sid ) {
+    if( _validated.count( sid ) ) {
+        return true;
+    }
+    auto it = _sources.find( sid );
+    if( _sources.end() == it ) {
+        return false;
+    }
+    if( !_is_up_to_date( it->second ) ) {
+        sV_log2( "Cached metadata for source \"%s\" is outdated.\n",
+                 _serializer.source_path( sid ).c_str() );
+        _erase_metadata( sid );
+        return false;
+    }
+    _validated.insert( sid );
+    return true;
+}
+
+template<typename EventIDT, typename MetadataT, typename SourceIDT> MetadataT *
+MMapMetadataStore<EventIDT, MetadataT, SourceIDT>::_get_metadata(
+                                        const SourceID & sid ) {
+    if( !_isOpen ) _open();
+    if( !_validate( sid ) ) {
+        return nullptr;
+    }
+    auto cit = _cache.find( sid );
+    if( _cache.end() != cit ) {
+        return cit->second;
+    }
+    const SourceEntry & se = _sources.find( sid )->second;
+    std::vector<uint8_t> buf( se.mdLength );
+    ssize_t n = pread( _mdatFD, buf.data(), buf.size(), se.mdOffset );
+    if( n < 0 || (size_t) n != buf.size() ) {
+        sV_logw( "Unable to read cached metadata from \"%s\". Entry will "
+                 "be discarded.\n", _mdatPath.c_str() );
+        _erase_metadata( sid );
+        return nullptr;
+    }
+    Metadata * mdPtr = _serializer.deserialize( buf.data(), buf.size() );
+    _cache[sid] = mdPtr;
+    return mdPtr;
+}
+
+template<typename EventIDT, typename MetadataT, typename SourceIDT> MetadataT *
+MMapMetadataStore<EventIDT, MetadataT, SourceIDT>::get_metadata_for(
+                                        const SourceID & sid ) const {
+    {
+        aux::SharedLock l(_mtx);
+        if( _isOpen && _validated.count( sid ) ) {
+            auto cit = _cache.find( sid );
+            if( _cache.end() != cit ) {
+                return cit->second;
+            }
+        }
+    }
+    aux::ExclusiveLock l(_mtx);
+    return _lazy()._get_metadata( sid );
+}
+
+template<typename EventIDT, typename MetadataT, typename SourceIDT> void
+MMapMetadataStore<EventIDT, MetadataT, SourceIDT>::put_metadata(
+                                        const SourceID & sid,
+                                        const Metadata & md ) {
+    aux::ExclusiveLock l(_mtx);
+    if( !_isOpen ) _open();
+    // Keep the instance if it is the one owned by store (updated in place).
+    Metadata * ownMdPtr = nullptr;
+    auto cit = _cache.find( sid );
+    if( _cache.end() != cit && &md == cit->second ) {
+        ownMdPtr = cit->second;
+        _cache.erase( cit );
+    }
+    if( _sources.count( sid ) ) {
+        _erase_metadata( sid );
+    }
+    if( ownMdPtr ) {
+        _cache[sid] = ownMdPtr;
+    }
+    std::vector<uint8_t> buf;
+    _serializer.serialize( md, buf );
+    off_t offset = lseek( _mdatFD, 0, SEEK_END );
+    if( offset < 0 ) {
+        emraise( thirdParty, "Unable to seek metadata file \"%s\": %s.",
+                 _mdatPath.c_str(), strerror(errno) );
+    }
+    for( size_t written = 0; written < buf.size(); ) {
+        ssize_t n = write( _mdatFD, buf.data() + written, buf.size() - written );
+        if( n < 0 ) {
+            if( EINTR == errno ) continue;
+            emraise( thirdParty, "Unable to write metadata file \"%s\": %s.",
+                     _mdatPath.c_str(), strerror(errno) );
+        }
+        written += n;
+    }
+    SourceEntry se;
+    memset( &se, 0, sizeof(se) );
+    se.sid = sid;
+    se.mdOffset = offset;
+    se.mdLength = buf.size();
+    const std::string path = _serializer.source_path( sid );
+    struct stat st;
+    if( !path.empty() && !stat( path.c_str(), &st ) ) {
+        se.size = st.st_size;
+        se.mtime = (int64_t) st.st_mtim.tv_sec*1000000000LL + st.st_mtim.tv_nsec;
+    }
+    _sources[sid] = se;
+    _validated.insert( sid );
+
+    typename Serializer::EventsLocations locs;
+    _serializer.locate_events( md, locs );
+    _pending.reserve( _pending.size() + locs.size() );
+    for( const auto & l : locs ) {
+        IndexEntry e;
+        memset( &e, 0, sizeof(e) );
+        e.eid = l.first;
+        e.sid = sid;
+        e.offset = l.second;
+        _pending.push_back( e );
+    }
+    _isDirty = true;
+}
+
+template<typename EventIDT, typename MetadataT, typename SourceIDT> void
+MMapMetadataStore<EventIDT, MetadataT, SourceIDT>::erase_metadata_for(
+                                        const SourceID & sid ) {
+    aux::ExclusiveLock l(_mtx);
+    _erase_metadata( sid );
+}
+
+template<typename EventIDT, typename MetadataT, typename SourceIDT> void
+MMapMetadataStore<EventIDT, MetadataT, SourceIDT>::_erase_metadata(
+                                        const SourceID & sid ) {
+    if( !_isOpen ) _open();
+    if( !_sources.erase( sid ) ) {
+        return;
+    }
+    _validated.erase( sid );
+    auto cit = _cache.find( sid );
+    if( _cache.end() != cit ) {
+        // Invoker may still refer to the instance.
+        _invalidated.push_back( cit->second );
+        _cache.erase( cit );
+    }
+    _pending.erase( std::remove_if( _pending.begin(), _pending.end(),
+                        [&sid]( const IndexEntry & e ) {
+                            return !(e.sid < sid) && !(sid < e.sid); } ),
+                    _pending.end() );
+    _obsoleteMapped.insert( sid );
+    _isDirty = true;
+}
+
+template<typename EventIDT, typename MetadataT, typename SourceIDT> bool
+MMapMetadataStore<EventIDT, MetadataT, SourceIDT>::_source_location(
+                                        const EventID & eid,
+                                        SourceID & sid,
+                                        uint64_t & offset,
+                                        Self * self,
+                                        bool & retry ) const {
+    const IndexEntry * end = _entries + _nEntries;
+    const IndexEntry * it = std::lower_bound( _entries, end, eid,
+            []( const IndexEntry & e, const EventID & id ) {
+                return e.eid < id; } );
+    for( ; it != end && !(eid < it->eid); ++it ) {
+        if( _is_usable( it->sid, self, retry ) ) {
+            sid = it->sid;
+            offset = it->offset;
+            return true;
+        }
+        if( retry ) {
+            return false;
+        }
+        // Entries were invalidated; the mapping remains untouched until
+        // next synchronization, so iteration is safe.
+    }
+    return false;
+}
+
+template<typename EventIDT, typename MetadataT, typename SourceIDT> bool
+MMapMetadataStore<EventIDT, MetadataT, SourceIDT>::source_location_for(
+                                        const EventID & eid,
+                                        SourceID & sid,
+                                        uint64_t & offset ) const {
+    bool retry = false;
+    {
+        aux::SharedLock l(_mtx);
+        if( _is_synced() ) {
+            bool found = _source_location( eid, sid, offset, nullptr, retry );
+            if( !retry ) {
+                return found;
+            }
+        }
+    }
+    // Index has to be written or sources have to be validated.
+    aux::ExclusiveLock l(_mtx);
+    Self & self = _lazy();
+    self._sync();
+    return _source_location( eid, sid, offset, &self, retry );
+}
+
+template<typename EventIDT, typename MetadataT, typename SourceIDT> bool
+MMapMetadataStore<EventIDT, MetadataT, SourceIDT>::source_id_for(
+                                        const EventID & eid,
+                                        SourceID & sid ) const {
+    uint64_t offset;
+    return source_location_for( eid, sid, offset );
+}
+
+template<typename EventIDT, typename MetadataT, typename SourceIDT> bool
+MMapMetadataStore<EventIDT, MetadataT, SourceIDT>::_collect_subranges(
+                                        const EventID & from,
+                                        const EventID & to,
+                                        std::list<SubrangeMarkup> & output,
+                                        Self * self,
+                                        bool & retry ) const {
+    const IndexEntry * end = _entries + _nEntries;
+    const IndexEntry * it = std::lower_bound( _entries, end, from,
+            []( const IndexEntry & e, const EventID & id ) {
+                return e.eid < id; } );
+    // Sub-ranges are emitted in order of their first events.
+    std::map<SourceID, SubrangeMarkup *> bySource;
+    std::set<SourceID> obsolete;
+    for( ; it != end && !(to < it->eid); ++it ) {
+        auto sit = bySource.find( it->sid );
+        if( bySource.end() != sit ) {
+            sit->second->to = it->eid;
+            continue;
+        }
+        if( obsolete.count( it->sid ) ) {
+            continue;
+        }
+        if( !_is_usable( it->sid, self, retry ) ) {
+            if( retry ) {
+                return false;
+            }
+            obsolete.insert( it->sid );
+            continue;
+        }
+        output.push_back( SubrangeMarkup{ it->eid, it->eid, it->sid,
+                                          nullptr, nullptr } );
+        bySource.emplace( it->sid, &output.back() );
+    }
+    return true;
+}
+
+template<typename EventIDT, typename MetadataT, typename SourceIDT> void
+MMapMetadataStore<EventIDT, MetadataT, SourceIDT>::collect_source_ids_for_range(
+                                        const EventID & from,
+                                        const EventID & to,
+                                        std::list<SubrangeMarkup> & output ) const {
+    std::list<SubrangeMarkup> found;
+    bool retry = false;
+    {
+        aux::SharedLock l(_mtx);
+        if( _is_synced()
+         && _collect_subranges( from, to, found, nullptr, retry ) ) {
+            output.splice( output.end(), found );
+            return;
+        }
+    }
+    found.clear();
+    aux::ExclusiveLock l(_mtx);
+    Self & self = _lazy();
+    self._sync();
+    _collect_subranges( from, to, found, &self, retry );
+    output.splice( output.end(), found );
+}
+
+template<typename EventIDT, typename MetadataT, typename SourceIDT> bool
+MMapMetadataStore<EventIDT, MetadataT, SourceIDT>::get_cursor_for(
+                                        const SourceID & sid,
+                                        IndexingCursor & cursor ) const {
+    aux::ExclusiveLock l(_mtx);
+    if( !_isOpen ) _lazy()._open();
+    auto it = _sources.find( sid );
+    if( _sources.end() == it || !it->second.hasCursor ) {
+        return false;
+    }
+    cursor.offset = it->second.cursorOffset;
+    cursor.lastEventID = it->second.cursorEventID;
+    return true;
+}
+
+template<typename EventIDT, typename MetadataT, typename SourceIDT> void
+MMapMetadataStore<EventIDT, MetadataT, SourceIDT>::put_cursor(
+                                        const SourceID & sid,
+                                        const IndexingCursor & cursor ) {
+    aux::ExclusiveLock l(_mtx);
+    if( !_isOpen ) _open();
+    auto it = _sources.find( sid );
+    if( _sources.end() == it ) {
+        emraise( notFound, "Metadata store \"%s\" has no entry for source "
+                 "\"%s\" to put the indexing cursor.", _idxPath.c_str(),
+                 _serializer.source_path( sid ).c_str() );
+    }
+    it->second.hasCursor = 1;
+    it->second.cursorOffset = cursor.offset;
+    it->second.cursorEventID = cursor.lastEventID;
+    _isDirty = true;
+}
+
+}  // namespace sV
+
+# endif  // H_STROMA_V_METADATA_MMAP_STORE_H
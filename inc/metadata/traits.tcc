@@ -32,6 +32,7 @@ namespace aux {
 template<typename EventIDT,
          typename MetadataT,
          typename SourceIDT> struct RangeReadingMarkupEntry;
+template<typename EventIDT> struct IndexingCursor;
 }  // namespace aux
 template<typename T> class MetadataDictionary;
 template<typename EventIDT, typename MetadataT, typename SourceIDT> class iSectionalEventSource;
@@ -43,6 +44,7 @@ template<typename EventIDT, typename MetadataT, typename SourceIDT> struct ITDis
 template<typename EventIDT, typename MetadataT, typename SourceIDT> struct ITEventQueryableStore;
 template<typename EventIDT, typename MetadataT, typename SourceIDT> struct ITRangeQueryableStore;
 template<typename EventIDT, typename MetadataT, typename SourceIDT> struct ITSetQueryableStore;
+template<typename EventIDT, typename MetadataT, typename SourceIDT> struct ITResumableStore;
 /**???
  * Generic MetadataTypeTraits<> template used for sectioned source.
  */
@@ -66,11 +68,13 @@ public:
     /* Induced store interfaces */
     typedef aux::RangeReadingMarkupEntry<EventID, Metadata, SourceID>
             SubrangeMarkup;
+    typedef aux::IndexingCursor<EventID>                            IndexingCursor;
     typedef ITMetadataStore<EventID, Metadata, SourceID>            iMetadataStore;
     typedef ITDisposableSourceManager<EventID, Metadata, SourceID>  iDisposableSourceManager;
     typedef ITEventQueryableStore<EventID, Metadata, SourceID>      iEventQueryableStore;
     typedef ITRangeQueryableStore<EventID, Metadata, SourceID>      iRangeQueryableStore;
     typedef ITSetQueryableStore<EventID, Metadata, SourceID>        iSetQueryableStore;
+    typedef ITResumableStore<EventID, Metadata, SourceID>           iResumableStore;
 
     # define sV_METADATA_IMPORT_SECT_TRAITS( EIDT, MDTT, SIDT )             \
     /* Basic types */                                                       \
@@ -84,6 +88,7 @@ public:
     typedef typename Traits::iEventSource iEventSource;                     \
     typedef typename Traits::iMetadataStore iMetadataStore;                 \
     typedef typename Traits::SubrangeMarkup SubrangeMarkup;                 \
+    typedef typename Traits::IndexingCursor IndexingCursor;                 \
     /* ... */
 
 private:
@@ -44,6 +44,28 @@ template<typename EventIDT>
         class MetadataDictionary;
 
 namespace aux {
+
+/// Recursive FNV-1a hash step (C++11 constexpr has to be a single return).
+constexpr uint32_t
+fnv1a_32( const char * s, uint32_t h = 2166136261u ) {
+    return *s ? fnv1a_32( s + 1, (h ^ uint8_t(*s))*16777619u ) : h;
+}
+
+/// Folds 32-bit hash into 16-bit metadata type index. Zero is reserved for
+/// types that were not registered yet, so it is shifted to 1.
+constexpr MetadataTypeIndex
+fold_metadata_type_id( uint32_t h ) {
+    return ((h >> 16) ^ (h & 0xffff)) ? ((h >> 16) ^ (h & 0xffff)) : 1;
+}
+
+/// Returns stable metadata type index computed from the type name. May be
+/// evaluated at compile time, e.g. to switch over persisted metadata blobs.
+/// Collisions are detected by MetadataDictionary upon registration.
+constexpr MetadataTypeIndex
+metadata_type_id( const char * typeName ) {
+    return fold_metadata_type_id( fnv1a_32( typeName ) );
+}
+
 /**@class iMetadataTypeBase
  * @brief Base for metadata templates.
  *
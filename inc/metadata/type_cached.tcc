@@ -29,6 +29,16 @@
 # include "analysis/evSource_bulk.tcc"
 # include "store.tcc"
 # include "batch_handle.tcc"
+# include "shared_mutex.hpp"
+
+# include <atomic>
+# include <condition_variable>
+# include <deque>
+# include <exception>
+# include <functional>
+# include <mutex>
+# include <thread>
+# include <vector>
 
 namespace sV {
 
@@ -46,6 +56,14 @@ class BatchEventsHandle;
  * This class implements common (re)caching logic for physical data source(s)
  * keeping metadata and events. This is a top-level interface, mostly
  * interesting for practiacal usage.
+ *
+ * Lists of associated stores are guarded by readers-writer lock, so metadata
+ * may be acquired and events may be queried (see batch_handle()) from
+ * multiple threads provided the stores themselves are thread-safe (e.g.
+ * iTIntervalIndexedStore). Caching of metadata and indexing cursors (i.e.
+ * stores modification) is performed under exclusive lock, so it is never
+ * concurrent with look-ups and queries. Adding or removing stores while
+ * range or list reading sequences are alive is not supported.
  */
 template<typename EventIDT,
          typename MetadataT,
@@ -63,12 +81,16 @@ private:
     std::list<typename Traits::iEventQueryableStore *> _singleEventQueryables;
     std::list<typename Traits::iRangeQueryableStore *> _rangeQueryables;
     std::list<typename Traits::iSetQueryableStore *> _setQueryables;
+    std::list<typename Traits::iResumableStore *> _resumables;
+    /// Guards the stores lists above.
+    mutable aux::SharedMutex _storesMtx;
 
     /// Handle for querying events. May change its state after being retreived.
     mutable aux::BatchEventsHandle<EventID, Metadata, SourceID> _batchHandle;
 
     /// Aux method adding particular store instance into appropriate list.
     void _put_store( iMetadataStore * basePtr ) {
+        aux::ExclusiveLock l(_storesMtx);
         _mdStores.push_back( basePtr );
         # define M_sV_store_put( tname, lname ) {                           \
             auto ptr = dynamic_cast<typename Traits:: tname *>(basePtr);    \
@@ -77,20 +99,42 @@ private:
         M_sV_store_put( iEventQueryableStore, _singleEventQueryables )
         M_sV_store_put( iRangeQueryableStore, _rangeQueryables )
         M_sV_store_put( iSetQueryableStore, _setQueryables )
+        M_sV_store_put( iResumableStore, _resumables )
         # undef M_sV_store_put
     }
 
     /// Aux method removing particular store instance into appropriate list.
     void _remove_store( iMetadataStore * basePtr ) {
-        # define M_sV_store_put( tname, lname ) {                           \
-            auto ptr = dynamic_cast<typename Traits:: tname *>(basePtr);    \
-            if( ptr ) { lname.remove(ptr); } }
-        M_sV_store_put( iDisposableSourceManager, _dspSrcMngrs )
-        M_sV_store_put( iEventQueryableStore, _singleEventQueryables )
-        M_sV_store_put( iRangeQueryableStore, _rangeQueryables )
-        M_sV_store_put( iSetQueryableStore, _setQueryables )
-        # undef M_sV_store_put
-        _mdStores.remove( basePtr );
+        {
+            aux::ExclusiveLock l(_storesMtx);
+            # define M_sV_store_put( tname, lname ) {                       \
+                auto ptr = dynamic_cast<typename Traits:: tname *>(basePtr);\
+                if( ptr ) { lname.remove(ptr); } }
+            M_sV_store_put( iDisposableSourceManager, _dspSrcMngrs )
+            M_sV_store_put( iEventQueryableStore, _singleEventQueryables )
+            M_sV_store_put( iRangeQueryableStore, _rangeQueryables )
+            M_sV_store_put( iSetQueryableStore, _setQueryables )
+            M_sV_store_put( iResumableStore, _resumables )
+            # undef M_sV_store_put
+            _mdStores.remove( basePtr );
+        }
+        // Pool locks stores list by itself, so it is not locked here.
+        auto mngrPtr = dynamic_cast<typename Traits::iDisposableSourceManager *>(basePtr);
+        if( mngrPtr ) {
+            _batchHandle.sources_pool().forget( mngrPtr );
+        }
+    }
+
+    /// Returns true if type has associated stores.
+    bool _has_stores() const {
+        aux::SharedLock l(_storesMtx);
+        return !_mdStores.empty();
+    }
+
+    /// Caches metadata in associated stores.
+    void _cache( const SourceID & sid, const Metadata & md ) {
+        aux::ExclusiveLock l(_storesMtx);
+        _V_cache_metadata( sid, md, _mdStores );
     }
 protected:
     /// Tries to find metadata instance for given source ID.
@@ -131,6 +175,18 @@ protected:
     virtual bool _V_append_metadata( iEventSource & s,
                                      Metadata & md ) const = 0;
 
+    /// Appends metadata with events located after given cursor position,
+    /// moving the cursor to the new end. Meant for sources still being
+    /// written: implementation has to scan only the new tail. Cursor is
+    /// zero-initialized when resumable stores have no cursor for source.
+    /// Default implementation ignores cursor and forwards call to
+    /// `_V_append_metadata()`.
+    virtual bool _V_append_metadata_incrementally( iEventSource & s,
+                                                   Metadata & md,
+                                                   IndexingCursor & ) const {
+        return _V_append_metadata( s, md );
+    }
+
     /// (IF) This method has to implement saving of the metadata at specific
     /// storaging instance(s). It may to operate with one particular store or
     /// distribute metadata parts among available stores provided at third
@@ -174,8 +230,14 @@ public:
     /// ID and writes pointer to newly allocated metadata instance.
     bool extract_metadata( const SourceID * sidPtr,
                            iEventSource & s,
-                           Metadata *& mdPtrRef ) const
-        { return _V_extract_metadata( sidPtr, s, mdPtrRef, _mdStores ); }
+                           Metadata *& mdPtrRef ) const {
+        std::list<iMetadataStore *> stores;
+        {
+            aux::SharedLock l(_storesMtx);
+            stores = _mdStores;
+        }
+        return _V_extract_metadata( sidPtr, s, mdPtrRef, stores );
+    }
 
     /// Merges metadata information from multiple instances into one.
     Metadata * merge_metadata(
@@ -193,6 +255,39 @@ public:
     /// with associated metadata store instance(s).
     virtual Metadata & acquire_metadata_for( iEventSource & s );
 
+    /// Incrementally appends metadata of (growing) source, starting from
+    /// the cursor saved in resumable stores. Appended metadata and moved
+    /// cursor are then cached.
+    virtual bool update_metadata( iEventSource & s, Metadata & md );
+
+    /// Updates cached metadata of source with given ID, acquiring the source
+    /// from manager. Returns false if source has no cached metadata. Handy
+    /// to be invoked by aux::FilesWatcher callback.
+    virtual bool update_metadata_for( const SourceID & sid,
+                        typename Traits::iDisposableSourceManager & mngr );
+
+    /// Callback type for prewarm() progress reporting: number of processed
+    /// sources and total number of sources to process.
+    typedef std::function<void(size_t, size_t)> PrewarmProgressCallback;
+
+    /// Extracts metadata for sources which have no metadata in associated
+    /// stores yet, using up to nThreads concurrent workers (hardware
+    /// concurrency if zero). Sources are acquired from and freed by given
+    /// manager (these calls are serialized). Each extracted instance is
+    /// handed over to `_V_cache_metadata()` by the invoking thread as soon
+    /// as it becomes ready, so stores need not to be thread-safe while
+    /// `_V_extract_metadata()` has to be (it is given an empty stores list
+    /// here). Once handed over, instance is owned the same way as the one
+    /// cached by `acquire_metadata_for()` (i.e. as descendant and its stores
+    /// define); instances that were not handed over because of failure are
+    /// deleted. First failure (of worker, caching or progress callback)
+    /// stops the workers and is rethrown once they are joined. Returns
+    /// number of cached instances.
+    virtual size_t prewarm( const std::list<SourceID> & sids,
+                            typename Traits::iDisposableSourceManager & mngr,
+                            size_t nThreads=0,
+                            PrewarmProgressCallback progress=nullptr );
+
     /// Returns interim object incapsulating acquizition events from specific
     /// source instances.
     virtual aux::BatchEventsHandle<EventID, Metadata, SourceID> &
@@ -215,6 +310,7 @@ template<typename EventIDT,
 iTCachedMetadataType<EventIDT,
                     MetadataT,
                     SourceIDT>::_look_up_for( const SourceID & sid ) const {
+    aux::SharedLock l(_storesMtx);
     if( _mdStores.empty() ) {
         sV_logw( "No stores associated with type \"%s\" (id:%#0x, ptr:%p) "
                  "while tried to retrieve metadata info for source.\n",
@@ -250,7 +346,8 @@ iTCachedMetadataType<EventIDT, MetadataT, SourceIDT>::acquire_metadata_for(
             iEventSource & s ) {
     const SourceID * sidPtr = s.id_ptr();
     Metadata * metadataPtr = nullptr;
-    if( ! _mdStores.empty() ) {
+    const bool hasStores = _has_stores();
+    if( hasStores ) {
         if( sidPtr ) {
             metadataPtr = _look_up_for( *sidPtr );
         } else {
@@ -276,8 +373,8 @@ iTCachedMetadataType<EventIDT, MetadataT, SourceIDT>::acquire_metadata_for(
                      "source \"%s\" (%p).", s.textual_id().c_str(), &s );
         }
         sV_log2( "Metadata extracted for source %p.\n", &s );
-        if( sidPtr && !_mdStores.empty() ) {
-            _V_cache_metadata( *sidPtr, *metadataPtr, _mdStores );  //< TODO?
+        if( sidPtr && hasStores ) {
+            _cache( *sidPtr, *metadataPtr );
         } else {
             sV_logw( "Metadata for source \"%s\" (%p) can not be stored since "
                 "either the ID for source is not set, or no reentrant indexes "
@@ -287,11 +384,221 @@ iTCachedMetadataType<EventIDT, MetadataT, SourceIDT>::acquire_metadata_for(
         }
     }
     if( !is_complete( *metadataPtr ) ) {
-        append_metadata( s, *metadataPtr );
+        update_metadata( s, *metadataPtr );
     }
     return *metadataPtr;
 }
 
+template<typename EventIDT,
+         typename MetadataT,
+         typename SourceIDT> bool
+iTCachedMetadataType<EventIDT, MetadataT, SourceIDT>::update_metadata(
+                                iEventSource & s,
+                                Metadata & md ) {
+    const SourceID * sidPtr = s.id_ptr();
+    IndexingCursor cursor = IndexingCursor();
+    if( sidPtr ) {
+        aux::SharedLock l(_storesMtx);
+        for( auto storePtr : _resumables ) {
+            if( storePtr->get_cursor_for( *sidPtr, cursor ) ) {
+                break;
+            }
+        }
+    }
+    const uint64_t prevOffset = cursor.offset;
+    if( !_V_append_metadata_incrementally( s, md, cursor ) ) {
+        return false;
+    }
+    sV_log3( "Metadata for source \"%s\" (%p) appended from offset %zu "
+             "to %zu.\n", s.textual_id().c_str(), &s,
+             (size_t) prevOffset, (size_t) cursor.offset );
+    if( sidPtr ) {
+        aux::ExclusiveLock l(_storesMtx);
+        if( !_mdStores.empty() ) {
+            _V_cache_metadata( *sidPtr, md, _mdStores );
+        }
+        for( auto storePtr : _resumables ) {
+            storePtr->put_cursor( *sidPtr, cursor );
+        }
+    }
+    return true;
+}
+
+template<typename EventIDT,
+         typename MetadataT,
+         typename SourceIDT> bool
+iTCachedMetadataType<EventIDT, MetadataT, SourceIDT>::update_metadata_for(
+                    const SourceID & sid,
+                    typename Traits::iDisposableSourceManager & mngr ) {
+    Metadata * mdPtr = _look_up_for( sid );
+    if( !mdPtr ) {
+        return false;
+    }
+    iEventSource * srcPtr = mngr.source( sid );
+    if( !srcPtr ) {
+        emraise( notFound, "Manager %p did not provide source for metadata "
+                 "update.", &mngr );
+    }
+    bool result;
+    try {
+        result = update_metadata( *srcPtr, *mdPtr );
+    } catch( ... ) {
+        mngr.free_source( srcPtr );
+        throw;
+    }
+    mngr.free_source( srcPtr );
+    return result;
+}
+
+template<typename EventIDT,
+         typename MetadataT,
+         typename SourceIDT> size_t
+iTCachedMetadataType<EventIDT, MetadataT, SourceIDT>::prewarm(
+                    const std::list<SourceID> & sids_,
+                    typename Traits::iDisposableSourceManager & mngr,
+                    size_t nThreads,
+                    PrewarmProgressCallback progress ) {
+    if( !_has_stores() ) {
+        emraise( badState, "Metadata type \"%s\" (id:%#x, ptr:%p) has no "
+                 "associated stores to cache extracted metadata.",
+                 this->name().c_str(), (int) this->type_index(), this );
+    }
+    // Only sources having no cached metadata are of interest.
+    std::vector<SourceID> sids;
+    for( const auto & sid : sids_ ) {
+        if( !_look_up_for( sid ) ) {
+            sids.push_back( sid );
+        }
+    }
+    if( sids.empty() ) {
+        return 0;
+    }
+    if( !nThreads ) {
+        nThreads = std::max( 1u, std::thread::hardware_concurrency() );
+    }
+    nThreads = std::min( nThreads, sids.size() );
+    sV_log2( "Extracting metadata of type \"%s\" for %zu sources with %zu "
+             "threads.\n", this->name().c_str(), sids.size(), nThreads );
+
+    // Extracted instances not handed over for caching yet.
+    std::vector<Metadata *> results( sids.size(), nullptr );
+    std::deque<size_t> ready;
+    std::atomic<size_t> next(0);
+    std::atomic<bool> failed(false);
+    std::exception_ptr error;
+    std::mutex mngrMtx,
+               readyMtx;
+    std::condition_variable readyCV;
+
+    auto worker = [&]() {
+        for( size_t n = next++; n < sids.size() && !failed; n = next++ ) {
+            Metadata * mdPtr = nullptr;
+            iEventSource * srcPtr = nullptr;
+            try {
+                {
+                    std::lock_guard<std::mutex> l(mngrMtx);
+                    srcPtr = mngr.source( sids[n] );
+                }
+                if( !srcPtr ) {
+                    emraise( notFound, "Manager %p did not provide source "
+                             "for metadata extraction.", &mngr );
+                }
+                bool ok = _V_extract_metadata( &(sids[n]), *srcPtr, mdPtr,
+                                               std::list<iMetadataStore *>() );
+                {
+                    std::lock_guard<std::mutex> l(mngrMtx);
+                    iEventSource * p = srcPtr;
+                    srcPtr = nullptr;
+                    mngr.free_source( p );
+                }
+                if( !ok || !mdPtr ) {
+                    emraise( thirdParty, "Unable to extract metadata for "
+                             "source #%zu of %zu.", n, sids.size() );
+                }
+            } catch( ... ) {
+                if( srcPtr ) {
+                    std::lock_guard<std::mutex> l(mngrMtx);
+                    mngr.free_source( srcPtr );
+                }
+                delete mdPtr;
+                std::lock_guard<std::mutex> l(readyMtx);
+                if( !failed ) {
+                    error = std::current_exception();
+                    failed = true;
+                }
+                readyCV.notify_one();
+                return;
+            }
+            std::lock_guard<std::mutex> l(readyMtx);
+            results[n] = mdPtr;
+            ready.push_back( n );
+            readyCV.notify_one();
+        }
+    };
+    // Joins the workers on leaving the scope; if invoking thread leaves it
+    // by exception, workers are stopped first.
+    struct JoinGuard {
+        std::vector<std::thread> & threads;
+        std::atomic<bool> & stop;
+        bool leftNormally;
+        ~JoinGuard() {
+            if( !leftNormally ) {
+                stop = true;
+            }
+            for( auto & t : threads ) {
+                t.join();
+            }
+        }
+    };
+    std::vector<std::thread> workers;
+    std::exception_ptr mainError;
+    size_t nDone = 0;
+    try {
+        JoinGuard guard{ workers, failed, false };
+        for( size_t i = 0; i < nThreads; ++i ) {
+            workers.emplace_back( worker );
+        }
+        // Cache results as they come.
+        while( nDone < sids.size() ) {
+            size_t n;
+            Metadata * mdPtr;
+            {
+                std::unique_lock<std::mutex> l(readyMtx);
+                readyCV.wait( l, [&]{ return failed || !ready.empty(); } );
+                if( ready.empty() ) {
+                    break;  // failed
+                }
+                n = ready.front();
+                ready.pop_front();
+                // Considered to be handed over even if caching fails.
+                mdPtr = results[n];
+                results[n] = nullptr;
+            }
+            _cache( sids[n], *mdPtr );
+            ++nDone;
+            if( progress ) {
+                progress( nDone, sids.size() );
+            }
+        }
+        guard.leftNormally = true;
+    } catch( ... ) {
+        mainError = std::current_exception();
+    }
+    // Workers are joined here.
+    for( auto mdPtr : results ) {
+        delete mdPtr;
+    }
+    if( mainError ) {
+        std::rethrow_exception( mainError );
+    }
+    if( error ) {
+        std::rethrow_exception( error );
+    }
+    sV_log2( "Metadata of type \"%s\" extracted for %zu sources.\n",
+             this->name().c_str(), nDone );
+    return nDone;
+}
+
 template<typename EventIDT,
          typename MetadataT,
          typename SourceIDT>
@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2016 Renat R. Dusaev <crank@qcrypt.org>
+ * Author: Renat R. Dusaev <crank@qcrypt.org>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+# ifndef H_STROMA_V_NET_MESSAGE_UNPACKER_H
+# define H_STROMA_V_NET_MESSAGE_UNPACKER_H
+
+# include "sV_config.h"
+
+# if defined(RPC_PROTOCOLS)
+
+# include <map>
+# include <vector>
+
+# include "uevent.hpp"
+# include "decompr/iDecompressor.hpp"
+
+namespace sV {
+namespace net {
+
+/**@class iMessageUnpacker
+ * @brief Interfacing class dispatching content of serialized
+ * MulticastMessage instances.
+ *
+ * Deserializes the MulticastMessage and forwards its content to
+ * _V_treat_event() and _V_treat_sender_status() methods. Deflated buckets
+ * are decompressed with decompressor of matching method (see
+ * add_decompressor()) and each event of bucket is then forwarded to
+ * _V_treat_event(). Decompressor for UNCOMPRESSED buckets is set by
+ * default.
+ *
+ * Since the uncompressed length is taken from the wire, buckets declaring
+ * more than maxDecomprBufferLength bytes are dropped.
+ *
+ * Shared by receiving counterparts of network transports (multicast,
+ * stream).
+ * */
+class iMessageUnpacker {
+public:
+    typedef ::sV::events::MulticastMessage Message;
+    typedef ::sV::events::DeflatedBucketMetaInfo_CompressionMethod CompressionMethod;
+private:
+    Message _reentrantMessageInstance;
+    ::sV::events::Bucket _reentrantBucket;
+    std::vector<uint8_t> _decomprBuffer;
+    /// Used when sender did not provide the uncompressed length.
+    size_t _defaultDecomprBufferLength;
+    /// Upper limit for decompression buffer.
+    size_t _maxDecomprBufferLength;
+    /// Decompressors indexed by compression method (owned).
+    std::map<int, iDecompressor *> _decompressors;
+    /// Codec advertised by sender in last status message.
+    CompressionMethod _senderComprMethod;
+
+    /// Decompresses bucket and forwards events to _V_treat_event().
+    bool _treat_deflated_bucket( const ::sV::events::DeflatedBucket & );
+protected:
+    iMessageUnpacker( size_t defaultDecomprBufferLength=1024*1024,
+                      size_t maxDecomprBufferLength=64*1024*1024 );
+
+    /// Called for each received event (either plain or unpacked from bucket).
+    virtual bool _V_treat_event( const ::sV::events::Event & );
+
+    /// Called on sender status message received.
+    virtual bool _V_treat_sender_status( const Message::SenderStatusMessage & ) {
+        return true; }
+public:
+    virtual ~iMessageUnpacker();
+
+    /// Deserializes message and dispatches its content. Returns false if
+    /// one of the treatment methods asked to interrupt receiving.
+    bool unpack_message( const unsigned char * msg, size_t length );
+
+    /// Sets decompressor to be used for buckets of its compression method.
+    /// Unpacker takes ownership; previously set decompressor of the same
+    /// method is deleted.
+    void add_decompressor( iDecompressor * );
+
+    /// Returns codec advertised by sender (UNCOMPRESSED until first status
+    /// message is received).
+    CompressionMethod sender_compression_method() const {
+        return _senderComprMethod; }
+};  // class iMessageUnpacker
+
+}  // namespace net
+}  // namespace sV
+
+# endif  // defined(RPC_PROTOCOLS)
+# endif  // H_STROMA_V_NET_MESSAGE_UNPACKER_H
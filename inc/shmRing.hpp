@@ -0,0 +1,183 @@
+/*
+ * Copyright (c) 2016 Renat R. Dusaev <crank@qcrypt.org>
+ * Author: Renat R. Dusaev <crank@qcrypt.org>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+# ifndef H_STROMA_V_SHARED_MEMORY_EVENT_RING_H
+# define H_STROMA_V_SHARED_MEMORY_EVENT_RING_H
+
+# include "sV_config.h"
+
+# if defined(RPC_PROTOCOLS)
+
+# include <atomic>
+# include <string>
+
+# include "uevent.hpp"
+
+# if ATOMIC_LLONG_LOCK_FREE != 2
+# error "Shared memory event ring requires lock-free 64-bit atomics."
+# endif
+
+namespace sV {
+namespace net {
+
+namespace aux {
+
+/**@brief Shared memory event ring segment header.
+ *
+ * Located at the beginning of the mapped segment and followed by the data
+ * area. Positions are monotonically increasing byte counters; actual offset
+ * within data area is obtained as position modulo capacity.
+ *
+ * Producer updates positions in a seqlock-like manner: reservedPos is set
+ * before writing the record and writePos after. Consumer is guaranteed that
+ * record it just read was not overwritten while reading if reservedPos did
+ * not outrun its reading position by more than capacity.
+ * */
+struct ShmEventRingHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t capacity;
+    std::atomic<uint64_t> reservedPos;
+    std::atomic<uint64_t> writePos;
+    std::atomic<uint64_t> nextSeqNo;
+    /// One of MulticastMessage.SenderStatusMessage.SenderStatus values.
+    std::atomic<uint32_t> producerStatus;
+};
+
+/**@brief Record header preceeding each serialized event in data area.
+ *
+ * Records are aligned by header size. When record does not fit the rest
+ * of the data area, producer writes wrapping marker (length equal to
+ * wrapMarker) and continues from the beginning.
+ * */
+struct ShmEventRecordHeader {
+    enum : uint32_t { wrapMarker = 0xffffffff };
+    uint64_t seqNo;
+    uint32_t length;
+    uint32_t reserved;
+};
+
+}  // namespace aux
+
+/**@class ShmEventRingProducer
+ * @brief Writing side of the shared memory event ring.
+ *
+ * Creates a named segment in `/dev/shm` and writes serialized events into
+ * it, each tagged with sequence number. Producer never waits for consumers:
+ * the oldest records are simply overwritten.
+ * */
+class ShmEventRingProducer {
+private:
+    const std::string _path;
+    int _fd;
+    size_t _mappingLength;
+    aux::ShmEventRingHeader * _header;
+    uint8_t * _data;
+    bool _unlinkOnClose;
+    size_t _nDropped;
+public:
+    /**@brief Creates (or re-creates) the segment.
+     *
+     * Segment of previous producer is never truncated as consumers may
+     * still have it mapped: it is marked as QUENCHING and replaced by the
+     * new one, created under temporary name and renamed into place.
+     *
+     * @param name segment name (file name within `/dev/shm`);
+     * @param capacity data area length in bytes (rounded up);
+     * @param unlinkOnClose whether to remove segment name on destruction.
+     * */
+    ShmEventRingProducer( const std::string & name,
+                          size_t capacity,
+                          bool unlinkOnClose=true );
+    ~ShmEventRingProducer();
+
+    /// Serializes event directly into the ring. Returns false if event is
+    /// too large to be stored (more than half of capacity).
+    bool push_event( const ::sV::events::Event & );
+
+    /// Sets status visible to consumers (e.g. QUENCHING on finish).
+    void status( ::sV::events::MulticastMessage_SenderStatusMessage_SenderStatus );
+
+    size_t capacity() const { return _header->capacity; }
+    uint64_t n_written() const { return _header->nextSeqNo; }
+    size_t n_dropped() const { return _nDropped; }
+    const std::string & path() const { return _path; }
+};  // class ShmEventRingProducer
+
+/**@class ShmEventRingConsumer
+ * @brief Reading side of the shared memory event ring.
+ *
+ * Maps the segment read-only and parses events in place. Attaching and
+ * reading does not affect the producer in any way. Consumer that fell
+ * behind by more than ring capacity detects the overrun and skips ahead to
+ * the most recent record; number of lost events is then deduced from
+ * sequence numbers.
+ * */
+class ShmEventRingConsumer {
+public:
+    enum ReadResult {
+        ok,         ///< event was read
+        empty,      ///< no new events for now
+        quenched,   ///< producer finished and all events are read
+    };
+private:
+    const std::string _path;
+    int _fd;
+    size_t _mappingLength;
+    const aux::ShmEventRingHeader * _header;
+    const uint8_t * _data;
+    uint64_t _readPos;
+    uint64_t _expectedSeqNo;
+    bool _seqNoKnown;
+    size_t _nRead,
+           _nOverruns,
+           _nSkipped,
+           _nCorrupted;
+
+    /// Moves reading position to the producer's current one.
+    void _skip_ahead();
+public:
+    /// Attaches to existing segment. Reading starts from the most recent
+    /// position (events written before attaching are not read).
+    ShmEventRingConsumer( const std::string & name );
+    ~ShmEventRingConsumer();
+
+    /// Parses next event into given instance.
+    ReadResult read_event( ::sV::events::Event & );
+
+    /// Returns true if producer has set QUENCHING status.
+    bool producer_quenched() const;
+
+    size_t n_read() const { return _nRead; }
+    /// Number of times consumer fell behind the producer.
+    size_t n_overruns() const { return _nOverruns; }
+    /// Number of events lost (deduced from sequence numbers).
+    size_t n_skipped() const { return _nSkipped; }
+    /// Number of records failed to be parsed.
+    size_t n_corrupted() const { return _nCorrupted; }
+};  // class ShmEventRingConsumer
+
+}  // namespace net
+}  // namespace sV
+
+# endif  // defined(RPC_PROTOCOLS)
+# endif  // H_STROMA_V_SHARED_MEMORY_EVENT_RING_H
@@ -0,0 +1,204 @@
+/*
+ * Copyright (c) 2016 Renat R. Dusaev <crank@qcrypt.org>
+ * Author: Renat R. Dusaev <crank@qcrypt.org>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+# ifndef H_STROMA_V_EVENT_STREAM_RECEIVER_H
+# define H_STROMA_V_EVENT_STREAM_RECEIVER_H
+
+# include "sV_config.h"
+
+# if defined(RPC_PROTOCOLS)
+
+# include <vector>
+# include <boost/asio.hpp>
+# include <boost/bind.hpp>
+
+# include <goo_exception.hpp>
+
+# include "app/app.h"
+# include "msgUnpacker.hpp"
+# include "streamTransport.hpp"
+
+namespace sV {
+namespace net {
+
+/**@class iTStreamEventReceiver
+ * @brief Interface class providing stream (TCP or Unix domain socket)
+ * receiver of serialized MulticastMessage objects.
+ *
+ * Intended to be complementary with iTStreamEventSender class. Mirrors
+ * the iMulticastEventReceiver API: incoming messages are forwarded to
+ * _V_treat_incoming_message() which unpacks them by default (see
+ * iMessageUnpacker).
+ *
+ * Messages can be received either asynchroneously, by I/O service (see
+ * _start_async_receive()), or synchroneously, one by one, with
+ * receive_message().
+ *
+ * @tparam ProtocolT boost::asio stream protocol (ip::tcp or
+ * local::stream_protocol)
+ * */
+template<typename ProtocolT>
+class iTStreamEventReceiver : public iMessageUnpacker {
+public:
+    typedef iMessageUnpacker::Message Message;
+    typedef ProtocolT Protocol;
+    typedef typename Protocol::socket Socket;
+    typedef typename Protocol::endpoint Endpoint;
+private:
+    Socket _socket;
+    uint8_t _header[StreamFrame::headerLength];
+    std::vector<uint8_t> _body;
+    const size_t _maxFrameLength;
+    size_t _acceptedMessages,
+           _declinedMessages;
+    bool _isConnected;
+
+    /// Checks frame length from header and prepares body buffer.
+    bool _prepare_body() {
+        uint32_t length = StreamFrame::decode_length( _header );
+        if( length > _maxFrameLength ) {
+            sV_loge( "Stream receiver: frame of %u bytes exceeds limit of "
+                     "%zu bytes. Disconnecting.\n", length, _maxFrameLength );
+            disconnect();
+            return false;
+        }
+        _body.resize( length );
+        return true;
+    }
+    void _on_error( const boost::system::error_code & ec ) {
+        if( boost::asio::error::eof == ec ) {
+            sV_log2( "Stream receiver: sender closed connection.\n" );
+        } else if( boost::asio::error::operation_aborted != ec ) {
+            sV_loge( "Stream receiver: %s.\n", ec.message().c_str() );
+        }
+        disconnect();
+    }
+
+    void _handle_header( const boost::system::error_code & ec, size_t ) {
+        if( ec ) { _on_error( ec ); return; }
+        if( !_prepare_body() ) return;
+        boost::asio::async_read( _socket, boost::asio::buffer(_body),
+            boost::bind( &iTStreamEventReceiver::_handle_body, this,
+                         boost::asio::placeholders::error,
+                         boost::asio::placeholders::bytes_transferred ) );
+    }
+    void _handle_body( const boost::system::error_code & ec, size_t ) {
+        if( ec ) { _on_error( ec ); return; }
+        if( treat_incoming_message( _body.data(), _body.size() ) ) {
+            _start_async_receive();
+        }
+    }
+protected:
+    /**@brief Stream receiver interface constructor.
+     *
+     * Connects to sender immediately. Raises thirdParty exception on
+     * connection failure.
+     *
+     * @param ioService a boost I/O service instance;
+     * @param ep endpoint sender listens at;
+     * @param maxFrameLength maximal length of single serialized message.
+     * */
+    iTStreamEventReceiver( boost::asio::io_service & ioService,
+                           const Endpoint & ep,
+                           size_t maxFrameLength=64*1024*1024 ) :
+                iMessageUnpacker(),
+                _socket( ioService ),
+                _maxFrameLength( maxFrameLength ),
+                _acceptedMessages(0),
+                _declinedMessages(0),
+                _isConnected(false) {
+        try {
+            _socket.connect( ep );
+        } catch( const std::exception & e ) {
+            emraise( thirdParty, "While connecting stream receiver: %s.",
+                e.what() );
+        }
+        _isConnected = true;
+    }
+
+    /// Starts asynchroneous receiving loop (handled by I/O service).
+    void _start_async_receive() {
+        boost::asio::async_read( _socket,
+            boost::asio::buffer( _header, StreamFrame::headerLength ),
+            boost::bind( &iTStreamEventReceiver::_handle_header, this,
+                         boost::asio::placeholders::error,
+                         boost::asio::placeholders::bytes_transferred ) );
+    }
+
+    /**@brief Interface function that is called on message received.
+     *
+     * Should return false, when receiving should be interrupt. Default
+     * implementation unpacks the message.
+     * */
+    virtual bool _V_treat_incoming_message( const unsigned char * msg,
+                                            size_t length ) {
+        return unpack_message( msg, length ); }
+public:
+    virtual ~iTStreamEventReceiver() {
+        disconnect();
+    }
+
+    /// Reads single message synchroneously and treats it. Returns false on
+    /// disconnection or if treatment routine asked to stop.
+    bool receive_message() {
+        if( !_isConnected ) {
+            return false;
+        }
+        boost::system::error_code ec;
+        boost::asio::read( _socket,
+                boost::asio::buffer( _header, StreamFrame::headerLength ), ec );
+        if( ec ) { _on_error( ec ); return false; }
+        if( !_prepare_body() ) return false;
+        boost::asio::read( _socket, boost::asio::buffer(_body), ec );
+        if( ec ) { _on_error( ec ); return false; }
+        return treat_incoming_message( _body.data(), _body.size() );
+    }
+
+    /// Returns false on treatment failure.
+    bool treat_incoming_message( const unsigned char * msg, size_t length ) {
+        if( _V_treat_incoming_message(msg, length) ) {
+            ++_acceptedMessages;
+            return true;
+        } else {
+            ++_declinedMessages;
+            return false;
+        }
+    }
+
+    /// Closes the connection.
+    void disconnect() {
+        boost::system::error_code ec;
+        _socket.close( ec );
+        _isConnected = false;
+    }
+
+    bool is_connected() const { return _isConnected; }
+    size_t n_accepted_messages() const { return _acceptedMessages; }
+    size_t n_declined_messages() const { return _declinedMessages; }
+};  // class iTStreamEventReceiver
+
+}  // namespace net
+}  // namespace sV
+
+# endif  // defined(RPC_PROTOCOLS)
+
+# endif  // H_STROMA_V_EVENT_STREAM_RECEIVER_H
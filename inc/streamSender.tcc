@@ -0,0 +1,418 @@
+/*
+ * Copyright (c) 2016 Renat R. Dusaev <crank@qcrypt.org>
+ * Author: Renat R. Dusaev <crank@qcrypt.org>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+# ifndef H_STROMA_V_EVENT_STREAM_SENDER_H
+# define H_STROMA_V_EVENT_STREAM_SENDER_H
+
+# include "sV_config.h"
+
+# if defined(RPC_PROTOCOLS)
+
+# include <array>
+# include <condition_variable>
+# include <deque>
+# include <mutex>
+# include <set>
+# include <boost/asio.hpp>
+# include <boost/atomic.hpp>
+# include <boost/bind.hpp>
+# include <boost/thread.hpp>
+
+# include "app/app.h"
+# include "streamTransport.hpp"
+
+namespace sV {
+namespace net {
+
+namespace aux {
+
+/**@class StreamFanOutHub
+ * @brief Shared state of stream sender: acceptor and subscribers sessions.
+ *
+ * All the sessions-related activity is serialized by strand, so the hub
+ * may be used with io_service run by arbitrary number of threads. Hub owns
+ * the sessions while sessions refer to hub by weak pointer only, so the
+ * pending session handlers neither prolong hub lifetime nor refer to deleted
+ * instance. Sessions still being connected after sender gave up on waiting
+ * for them are closed with abort().
+ * */
+template<typename ProtocolT>
+class StreamFanOutHub : public std::enable_shared_from_this<StreamFanOutHub<ProtocolT> > {
+public:
+    typedef ProtocolT Protocol;
+    typedef typename Protocol::socket Socket;
+    typedef typename Protocol::acceptor Acceptor;
+    typedef typename Protocol::endpoint Endpoint;
+
+    /// Single subscriber connection with bounded send queue.
+    class Session : public std::enable_shared_from_this<Session> {
+    private:
+        std::weak_ptr<StreamFanOutHub> _hub;
+        Socket _socket;
+        std::deque<StreamFramePtr> _queue;
+        bool _writing;
+
+        void _write_next( StreamFanOutHub & hub ) {
+            _writing = true;
+            const StreamFrame & f = *_queue.front();
+            std::array<boost::asio::const_buffer, 2> bufs = {{
+                    boost::asio::buffer( f.header, StreamFrame::headerLength ),
+                    boost::asio::buffer( f.body ) }};
+            boost::asio::async_write( _socket, bufs, hub._strand.wrap(
+                    boost::bind( &Session::_handle_write, this->shared_from_this(),
+                                 boost::asio::placeholders::error ) ) );
+        }
+        void _handle_write( const boost::system::error_code & ec ) {
+            _writing = false;
+            std::shared_ptr<StreamFanOutHub> hub = _hub.lock();
+            if( !hub ) {
+                // Hub is gone; nothing to report to.
+                return;
+            }
+            if( ec ) {
+                if( _socket.is_open()
+                 && boost::asio::error::operation_aborted != ec ) {
+                    sV_log2( "Stream subscriber %p disconnected: %s.\n",
+                             this, ec.message().c_str() );
+                }
+                hub->_drop( this->shared_from_this() );
+                return;
+            }
+            ++(hub->_nFramesSent);
+            _queue.pop_front();
+            if( !_queue.empty() ) {
+                _write_next( *hub );
+            } else if( hub->_quenching ) {
+                hub->_drop( this->shared_from_this() );
+            }
+        }
+    public:
+        Session( std::weak_ptr<StreamFanOutHub> hub,
+                 boost::asio::io_service & ios ) :
+                    _hub(hub), _socket(ios), _writing(false) {}
+        Socket & socket() { return _socket; }
+        bool is_idle() const { return !_writing && _queue.empty(); }
+        /// Returns false if queue is full (slow consumer). Invoked by hub.
+        bool enqueue( StreamFanOutHub & hub, StreamFramePtr f ) {
+            if( _queue.size() >= hub._clientQueueLength ) {
+                return false;
+            }
+            _queue.push_back( f );
+            if( !_writing ) {
+                _write_next( hub );
+            }
+            return true;
+        }
+        void close() {
+            boost::system::error_code ec;
+            _socket.close( ec );
+        }
+    };  // class Session
+
+    typedef std::shared_ptr<Session> SessionPtr;
+private:
+    boost::asio::io_service & _ioServiceRef;
+    boost::asio::io_service::strand _strand;
+    Acceptor _acceptor;
+    std::set<SessionPtr> _sessions;
+    const size_t _clientQueueLength;
+    /// Frame sent to each newly-connected subscriber first (sender status).
+    StreamFramePtr _greeting;
+    bool _quenching;
+
+    std::mutex _drainedMtx;
+    std::condition_variable _drainedCV;
+    bool _drained;
+
+    boost::atomic<size_t> _nClients,
+                          _nAccepted,
+                          _nSlowDropped,
+                          _nFramesSent;
+
+    void _start_accept() {
+        SessionPtr s = std::make_shared<Session>(
+                std::weak_ptr<StreamFanOutHub>( this->shared_from_this() ),
+                _ioServiceRef );
+        _acceptor.async_accept( s->socket(), _strand.wrap(
+                boost::bind( &StreamFanOutHub::_handle_accept,
+                             this->shared_from_this(), s,
+                             boost::asio::placeholders::error ) ) );
+    }
+    void _handle_accept( SessionPtr s, const boost::system::error_code & ec ) {
+        if( ec ) {
+            if( boost::asio::error::operation_aborted != ec ) {
+                sV_loge( "Stream sender failed to accept connection: %s.\n",
+                         ec.message().c_str() );
+            }
+            return;
+        }
+        if( _quenching ) {
+            s->close();
+            return;
+        }
+        _sessions.insert( s );
+        ++_nAccepted;
+        _nClients = _sessions.size();
+        if( _greeting ) {
+            s->enqueue( *this, _greeting );
+        }
+        sV_log2( "Stream sender accepted new subscriber (%zu total).\n",
+                 _sessions.size() );
+        _start_accept();
+    }
+    void _fan_out( StreamFramePtr f ) {
+        for( auto it = _sessions.begin(); _sessions.end() != it; ) {
+            if( !(*it)->enqueue( *this, f ) ) {
+                sV_logw( "Stream subscriber %p can not keep up with sender "
+                         "(%zu frames queued); disconnecting.\n",
+                         it->get(), _clientQueueLength );
+                (*it)->close();
+                ++_nSlowDropped;
+                it = _sessions.erase( it );
+            } else {
+                ++it;
+            }
+        }
+        _nClients = _sessions.size();
+    }
+    void _drop( SessionPtr s ) {
+        s->close();
+        _sessions.erase( s );
+        _nClients = _sessions.size();
+        _check_drained();
+    }
+    void _quench( StreamFramePtr farewell ) {
+        _quenching = true;
+        boost::system::error_code ec;
+        _acceptor.close( ec );
+        if( farewell ) {
+            _fan_out( farewell );
+        }
+        for( auto it = _sessions.begin(); _sessions.end() != it; ) {
+            if( (*it)->is_idle() ) {
+                (*it)->close();
+                it = _sessions.erase( it );
+            } else {
+                ++it;
+            }
+        }
+        _nClients = _sessions.size();
+        _check_drained();
+    }
+    void _abort() {
+        for( auto & s : _sessions ) {
+            s->close();
+        }
+        _sessions.clear();
+        _nClients = 0;
+        _check_drained();
+    }
+    void _check_drained() {
+        if( _quenching && _sessions.empty() ) {
+            std::lock_guard<std::mutex> l(_drainedMtx);
+            _drained = true;
+            _drainedCV.notify_all();
+        }
+    }
+public:
+    StreamFanOutHub( boost::asio::io_service & ios,
+                     const Endpoint & ep,
+                     size_t clientQueueLength ) :
+            _ioServiceRef(ios),
+            _strand(ios),
+            _acceptor(ios),
+            _clientQueueLength(clientQueueLength),
+            _quenching(false),
+            _drained(false),
+            _nClients(0), _nAccepted(0), _nSlowDropped(0), _nFramesSent(0) {
+        prepare_listening_endpoint( ep );
+        _acceptor.open( ep.protocol() );
+        _acceptor.set_option( typename Acceptor::reuse_address(true) );
+        _acceptor.bind( ep );
+        _acceptor.listen();
+    }
+
+    /// Has to be invoked once hub is owned by shared pointer.
+    void start() {
+        _strand.post( boost::bind( &StreamFanOutHub::_start_accept,
+                                   this->shared_from_this() ) );
+    }
+    /// Sets the status frame sent to newly-connected subscribers.
+    void greeting( StreamFramePtr f ) {
+        std::shared_ptr<StreamFanOutHub> self = this->shared_from_this();
+        _strand.post( [self, f]() { self->_greeting = f; } );
+    }
+    /// Schedules sending of the frame to all the subscribers.
+    void post( StreamFramePtr f ) {
+        _strand.post( boost::bind( &StreamFanOutHub::_fan_out,
+                                   this->shared_from_this(), f ) );
+    }
+    /// Sends farewell frame, stops accepting and waits for subscribers queues
+    /// to drain for not longer than given number of milliseconds.
+    bool quench( StreamFramePtr farewell, size_t timeoutMs ) {
+        _strand.post( boost::bind( &StreamFanOutHub::_quench,
+                                   this->shared_from_this(), farewell ) );
+        std::unique_lock<std::mutex> l(_drainedMtx);
+        return _drainedCV.wait_for( l, std::chrono::milliseconds(timeoutMs),
+                                    [this]{ return _drained; } );
+    }
+
+    /// Closes connections of all the remaining subscribers. Pending writes
+    /// are cancelled.
+    void abort() {
+        _strand.post( boost::bind( &StreamFanOutHub::_abort,
+                                   this->shared_from_this() ) );
+    }
+
+    size_t n_clients() const { return _nClients; }
+    size_t n_accepted() const { return _nAccepted; }
+    size_t n_slow_dropped() const { return _nSlowDropped; }
+    size_t n_frames_sent() const { return _nFramesSent; }
+};  // class StreamFanOutHub
+
+}  // namespace aux
+
+/**@class iTStreamEventSender
+ * @brief Interface class providing reliable stream (TCP or Unix domain
+ * socket) sender of serialized MulticastMessage objects.
+ *
+ * Mirrors iMulticastEventSender API. Listens at given endpoint and sends
+ * each message to all connected subscribers. Message is serialized only
+ * once, into shared length-prefixed frame (see StreamFrame), that is then
+ * put into per-subscriber bounded send queue. Subscribers whose queue
+ * overflows are considered to be slow consumers and are disconnected to
+ * not to stall the others.
+ *
+ * Newly-connected subscriber first receives the OPERATING status message
+ * carrying the compression method; QUENCHING status is sent to all
+ * subscribers on destruction.
+ *
+ * @tparam ProtocolT boost::asio stream protocol (ip::tcp or
+ * local::stream_protocol)
+ * */
+template<typename ProtocolT>
+class iTStreamEventSender {
+public:
+    typedef ::sV::events::MulticastMessage Message;
+    typedef ::sV::events::DeflatedBucketMetaInfo_CompressionMethod CompressionMethod;
+    typedef ProtocolT Protocol;
+    typedef typename Protocol::endpoint Endpoint;
+    typedef aux::StreamFanOutHub<Protocol> Hub;
+private:
+    boost::asio::io_service & _ioServiceRef;
+    std::shared_ptr<Hub> _hub;
+    CompressionMethod _comprMethod;
+    boost::asio::io_service::work * _sendingWorkPtr;
+    boost::thread * _thread;
+    size_t _quenchTimeoutMs;
+
+    StreamFramePtr _status_frame(
+            ::sV::events::MulticastMessage_SenderStatusMessage_SenderStatus st ) const {
+        Message m;
+        m.mutable_status()->set_senderstatus( st );
+        m.mutable_status()->set_comprmethod( _comprMethod );
+        return StreamFrame::make( m );
+    }
+protected:
+    /**@brief Stream sender interface constructor.
+     *
+     * Binds the listening socket immediately and starts accepting
+     * subscribers in separate thread running the given I/O service.
+     *
+     * @param ioService a boost I/O service instance;
+     * @param ep endpoint to listen at;
+     * @param clientQueueLength max number of frames pending for single
+     *        subscriber before it will be considered as slow consumer.
+     * */
+    iTStreamEventSender( boost::asio::io_service & ioService,
+                         const Endpoint & ep,
+                         size_t clientQueueLength=1024 ) :
+            _ioServiceRef( ioService ),
+            _hub( std::make_shared<Hub>( ioService, ep, clientQueueLength ) ),
+            _comprMethod( ::sV::events::DeflatedBucketMetaInfo_CompressionMethod_UNCOMPRESSED ),
+            _sendingWorkPtr( new boost::asio::io_service::work(ioService) ),
+            _thread( nullptr ),
+            _quenchTimeoutMs( 5000 ) {
+        _hub->greeting( _status_frame(
+                ::sV::events::MulticastMessage_SenderStatusMessage_SenderStatus::
+                MulticastMessage_SenderStatusMessage_SenderStatus_OPERATING ) );
+        _hub->start();
+        _thread = new boost::thread( boost::bind(&boost::asio::io_service::run,
+                                                 &_ioServiceRef) );
+    }
+public:
+    virtual ~iTStreamEventSender() {
+        if( !_hub->quench( _status_frame(
+                ::sV::events::MulticastMessage_SenderStatusMessage_SenderStatus::
+                MulticastMessage_SenderStatusMessage_SenderStatus_QUENCHING ),
+                _quenchTimeoutMs ) ) {
+            sV_logw( "Stream sender: %zu subscriber(s) did not receive all "
+                     "the pending messages within %zu msec.\n",
+                     _hub->n_clients(), _quenchTimeoutMs );
+            // Stuck subscribers would otherwise keep I/O service busy.
+            _hub->abort();
+        }
+        delete _sendingWorkPtr;
+        if( _thread ) {
+            if( !_thread->try_join_for( boost::chrono::milliseconds(_quenchTimeoutMs) ) ) {
+                // I/O service is shared and still has other work to do.
+                _thread->detach();
+            }
+            delete _thread;
+        }
+    }
+
+    /// Serializes message and schedules its sending to all the subscribers.
+    /// Thread-safe; returns immediately.
+    void send_message( const Message & msg ) {
+        _hub->post( StreamFrame::make( msg ) );
+    }
+
+    /// Codec advertised to subscribers within status messages.
+    CompressionMethod compression_method() const { return _comprMethod; }
+    /// Sets the codec to be advertised for newly-connected subscribers.
+    void compression_method( CompressionMethod m ) {
+        _comprMethod = m;
+        _hub->greeting( _status_frame(
+                ::sV::events::MulticastMessage_SenderStatusMessage_SenderStatus::
+                MulticastMessage_SenderStatusMessage_SenderStatus_OPERATING ) );
+    }
+
+    /// Sets time (msec) to wait for subscribers queues drain on destruction.
+    void quench_timeout( size_t ms ) { _quenchTimeoutMs = ms; }
+
+    /// Number of currently connected subscribers.
+    size_t n_clients() const { return _hub->n_clients(); }
+    /// Total number of subscribers accepted.
+    size_t n_accepted() const { return _hub->n_accepted(); }
+    /// Number of subscribers disconnected due to send queue overflow.
+    size_t n_slow_dropped() const { return _hub->n_slow_dropped(); }
+    /// Number of frames written (sum over all subscribers).
+    size_t n_frames_sent() const { return _hub->n_frames_sent(); }
+};  // class iTStreamEventSender
+
+}  // namespace net
+}  // namespace sV
+
+# endif  // defined(RPC_PROTOCOLS)
+
+# endif  // H_STROMA_V_EVENT_STREAM_SENDER_H
@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2016 Renat R. Dusaev <crank@qcrypt.org>
+ * Author: Renat R. Dusaev <crank@qcrypt.org>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+# ifndef H_STROMA_V_STREAM_TRANSPORT_H
+# define H_STROMA_V_STREAM_TRANSPORT_H
+
+# include "sV_config.h"
+
+# if defined(RPC_PROTOCOLS)
+
+# include <boost/asio.hpp>
+# include <memory>
+# include <vector>
+# include <string>
+# include <unistd.h>
+
+# include "uevent.hpp"
+
+namespace sV {
+namespace net {
+
+/**@brief Serialized message prefixed with its length.
+ *
+ * Stream transport uses simple length-prefixed framing: each message is
+ * preceded by 32-bit unsigned integer of serialized message length in
+ * network (big-endian) byte order. Header and body are kept separately to
+ * be written by single scatter/gather operation.
+ *
+ * Frames are immutable once constructed and are shared among the send
+ * queues of all the subscribers.
+ * */
+struct StreamFrame {
+    enum { headerLength = 4 };
+    uint8_t header[headerLength];
+    std::vector<uint8_t> body;
+
+    /// Serializes given message into new frame.
+    static std::shared_ptr<const StreamFrame> make(
+                            const ::sV::events::MulticastMessage & );
+    /// Encodes frame length into header.
+    static void encode_length( uint32_t, uint8_t * );
+    /// Decodes frame length from header.
+    static uint32_t decode_length( const uint8_t * );
+};
+
+typedef std::shared_ptr<const StreamFrame> StreamFramePtr;
+
+/**@brief Parsed stream endpoint address.
+ *
+ * Addresses are given in URI-like form:
+ *  - `tcp://<address>:<port>` for TCP/IP socket;
+ *  - `unix://<path>` for Unix domain (local) socket.
+ * */
+struct StreamEndpointAddress {
+    enum Kind { tcp, local } kind;
+    std::string host;
+    int port;
+    std::string path;
+
+    /// Parses the address string. Raises badParameter on malformed string.
+    static StreamEndpointAddress parse( const std::string & );
+};
+
+/// Builds boost::asio endpoint of certain protocol from parsed address.
+template<typename ProtocolT> typename ProtocolT::endpoint
+make_stream_endpoint( const StreamEndpointAddress & );
+
+/// Prepares endpoint to be bound by listening socket (no-op for TCP).
+inline void
+prepare_listening_endpoint( const boost::asio::ip::tcp::endpoint & ) {}
+
+template<> inline boost::asio::ip::tcp::endpoint
+make_stream_endpoint<boost::asio::ip::tcp>( const StreamEndpointAddress & a ) {
+    return boost::asio::ip::tcp::endpoint(
+                boost::asio::ip::address::from_string( a.host ), a.port );
+}
+
+# ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+template<> inline boost::asio::local::stream_protocol::endpoint
+make_stream_endpoint<boost::asio::local::stream_protocol>(
+                                        const StreamEndpointAddress & a ) {
+    return boost::asio::local::stream_protocol::endpoint( a.path );
+}
+
+/// Removes stale socket file left by previous (possibly crashed) sender.
+inline void
+prepare_listening_endpoint( const boost::asio::local::stream_protocol::endpoint & ep ) {
+    ::unlink( ep.path().c_str() );
+}
+# endif  // BOOST_ASIO_HAS_LOCAL_SOCKETS
+
+}  // namespace net
+}  // namespace sV
+
+# endif  // defined(RPC_PROTOCOLS)
+# endif  // H_STROMA_V_STREAM_TRANSPORT_H
@@ -44,6 +44,8 @@
 
 //# define NO_WORKARAOUND_TWICE_TRANSFORM_BUG
 
+# include <algorithm>
+
 namespace sV {
 namespace alignment {
 
@@ -62,7 +64,8 @@ DetectorsSet::_emplace( const std::string & famName,
     if( id.byNumber.major ) {
         _byUniqueID.emplace( id.wholenum, placementPtr );
         _majorIds.emplace( placementPtr, id.byNumber.major );
-        
+        _dispatchTableValid = false;
+
     } else {
         sV_logw( "Couldn't determine ID for detector %s:%s. "
                      "It won't be included into hits dispatching receivers.\n",
@@ -106,6 +109,8 @@ DetectorsSet::construct_detector( const DetectorPlacement & placement ) {
     // After that, detector/constructor names aren't available
     // in placement.
     newPlacement.set_detector_instance( constructedDetectorPtr );
+    goo::app<mixins::AlignmentApplication>()
+            .detectors()._dispatchTableValid = false;
 
     if( constructedDetectorPtr->is_compound() ) {
         auto namesList = constructedDetectorPtr->compound().detectors_nameslist();
@@ -246,6 +251,34 @@ DetectorsSet::reset_hits() {
     return doUpdate;
 }
 
+void
+DetectorsSet::_build_dispatch_table() {
+    AFR_DetMjNo maxMajor = 0;
+    for( auto it = _majorIds.begin(); _majorIds.end() != it; ++it ) {
+        maxMajor = std::max( maxMajor, it->second );
+    }
+    _dispatchTable.assign( _majorIds.empty() ? 0 : size_t(maxMajor) + 1,
+                           DispatchEntry{ nullptr, nullptr, nullptr } );
+    for( auto it = _byUniqueID.begin(); _byUniqueID.end() != it; ++it ) {
+        AFR_UniqueDetectorID id( it->first );
+        DispatchEntry & e = _dispatchTable[id.byNumber.major];
+        e.placement = it->second;
+        if( !it->second->is_detector_constructed() ) {
+            continue;
+        }
+        iDetector & detector = *(it->second->detector());
+        if( detector.is_receptive() ) {
+            e.receptive = &(detector.receptive());
+            if( detector.is_drawable() ) {
+                e.drawable = &(detector.drawable());
+            }
+        }
+    }
+    _dispatchTableValid = true;
+    sV_log3( "Hits dispatching table of %zu entries built for %zu detectors.\n",
+             _dispatchTable.size(), _byUniqueID.size() );
+}
+
 /** Iterates through all the detectors known to this set. If particular detector
  * class was inherited from receptive instance, the hit setter method
  * ReceptiveDetector::hit() will be invoked with appropriate hit instance.
@@ -254,16 +287,28 @@ DetectorsSet::reset_hits() {
  * DrawableDetector::draw_hit() method will be invoked. If this method
  * returns true for at least one detector instance, the DetectorsSet::dispatch_hits()
  * will also return true at the end of the loop.
+ *
+ * Detectors are looked up by major number in dense table built upon first
+ * dispatching after the set of detectors was changed.
+ *
+ * With drawHits=false no DrawableDetector::draw_hit() is invoked at all, so
+ * hits may be dispatched without ROOT graphics/TEve being initialized.
  */ bool
-DetectorsSet::dispatch_hits( const ::sV::events::Displayable & msg ) {
+DetectorsSet::dispatch_hits( const ::sV::events::Displayable & msg,
+                             bool drawHits ) {
+    if( !_dispatchTableValid ) {
+        _build_dispatch_table();
+    }
     bool doUpdate = false;
     AFR_UniqueDetectorID cDetID{0};
     size_t nDrawn = 0;
+    const DispatchEntry * const table = _dispatchTable.data();
+    const size_t tableSize = _dispatchTable.size();
     for( uint32_t i = 0; i < (uint32_t) msg.summaries_size(); ++i ) {
         const ::sV::events::DetectorSummary & cDetSummary = msg.summaries( i );
         cDetID.wholenum = cDetSummary.detectorid();
-        auto it = _byUniqueID.find( cDetID.wholenum );
-        if( _byUniqueID.end() == it ) {
+        if( cDetID.byNumber.major >= tableSize
+         || !table[cDetID.byNumber.major].placement ) {
             sV_loge( "Event display couldn't find detector instance "
                      "with unique ID 0x%x (%s). Summary won't be displayed.\n",
                      (int) cDetID.wholenum,
@@ -271,21 +316,23 @@ DetectorsSet::dispatch_hits( const ::sV::events::Displayable & msg ) {
                 );
             continue;
         }
-        DetectorPlacement & placement_ = *(it->second);
-        iDetector & detector = *placement_.detector();
-        if( !detector.is_receptive() ) {
+        const DispatchEntry & entry = table[cDetID.byNumber.major];
+        if( !entry.receptive ) {
+            const iDetector * detectorPtr =
+                        entry.placement->is_detector_constructed()
+                        ? entry.placement->detector() : nullptr;
             sV_loge( "Detector with unique ID %d (%s:%s) is not receptive. "
                      "Skipping it.\n",
                      (int) cDetID.wholenum,
-                     detector.family_name().c_str(),
-                     detector.detector_name().c_str()
+                     detectorPtr ? detectorPtr->family_name().c_str() : "?",
+                     detectorPtr ? detectorPtr->detector_name().c_str() : "?"
                 );
             continue;
         }
         // Set new hit and mark it for re-drawing, if need.
-        if( detector.receptive().common_summary( cDetSummary ) 
-         && detector.is_drawable() ) {
-            if( detector.drawable().draw_hit() ) {
+        if( entry.receptive->common_summary( cDetSummary )
+         && drawHits && entry.drawable ) {
+            if( entry.drawable->draw_hit() ) {
                 ++nDrawn;
                 doUpdate = true;
             }
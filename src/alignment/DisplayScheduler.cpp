@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2016 Renat R. Dusaev <crank@qcrypt.org>
+ * Author: Renat R. Dusaev <crank@qcrypt.org>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+# include "alignment/DisplayScheduler.hpp"
+
+# ifdef ALIGNMENT_ROUTINES
+
+# include "alignment/DetectorsSet.hpp"
+
+# include <goo_exception.hpp>
+
+namespace sV {
+namespace alignment {
+
+DisplayScheduler::DisplayScheduler( DetectorsSet & ds,
+                                    double frameRate,
+                                    Policy policy,
+                                    size_t maxMerged ) :
+            _detectors(ds),
+            _policy(policy),
+            _nextFrame( Clock::now() ),
+            _maxMerged( maxMerged ? maxMerged : 1 ),
+            _pending( latest == policy ? 1 : _maxMerged ),
+            _pendingHead(0),
+            _nPending(0),
+            _taken( _pending.size() ),
+            _nSubmitted(0),
+            _nCoalesced(0),
+            _nDropped(0),
+            _nFrames(0) {
+    frame_rate( frameRate );
+}
+
+void
+DisplayScheduler::frame_rate( double fps ) {
+    if( !(fps > 0) ) {
+        emraise( badParameter, "Non-positive display frame rate %e.", fps );
+    }
+    _framePeriod = std::chrono::duration_cast<Clock::duration>(
+                            std::chrono::duration<double>( 1./fps ) );
+}
+
+double
+DisplayScheduler::frame_rate() const {
+    return 1./std::chrono::duration<double>( _framePeriod ).count();
+}
+
+void
+DisplayScheduler::submit( const Displayable & msg ) {
+    ++_nSubmitted;
+    std::lock_guard<std::mutex> l(_mtx);
+    const size_t nSlots = _pending.size();
+    if( _nPending ) {
+        ++_nCoalesced;
+    }
+    if( _nPending == nSlots ) {
+        // Ring is full: the eldest event is overwritten.
+        if( merge == _policy ) {
+            ++_nDropped;
+        }
+        _pending[_pendingHead].CopyFrom( msg );
+        _pendingHead = (_pendingHead + 1) % nSlots;
+        return;
+    }
+    _pending[(_pendingHead + _nPending) % nSlots].CopyFrom( msg );
+    ++_nPending;
+}
+
+bool
+DisplayScheduler::_take_pending() {
+    size_t head, n;
+    {
+        std::lock_guard<std::mutex> l(_mtx);
+        if( !_nPending ) {
+            return false;
+        }
+        _pending.swap( _taken );
+        head = _pendingHead;
+        n = _nPending;
+        _pendingHead = _nPending = 0;
+    }
+    const size_t nSlots = _taken.size();
+    _current.Swap( &(_taken[head]) );
+    for( size_t k = 1; k < n; ++k ) {
+        _current.MergeFrom( _taken[(head + k) % nSlots] );
+    }
+    return true;
+}
+
+bool
+DisplayScheduler::render() {
+    if( !_take_pending() ) {
+        return false;
+    }
+    ++_nFrames;
+    bool doUpdate = _detectors.reset_hits();
+    doUpdate |= _detectors.dispatch_hits( _current );
+    return doUpdate;
+}
+
+bool
+DisplayScheduler::render_if_due() {
+    const Clock::time_point now = Clock::now();
+    if( now < _nextFrame ) {
+        return false;
+    }
+    // Keep the phase unless we are behind for more than a frame.
+    _nextFrame += _framePeriod;
+    if( _nextFrame < now ) {
+        _nextFrame = now + _framePeriod;
+    }
+    return render();
+}
+
+}  // namespace alignment
+}  // namespace sV
+
+# endif  // ALIGNMENT_ROUTINES
+
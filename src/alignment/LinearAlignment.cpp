@@ -0,0 +1,357 @@
+/*
+ * Copyright (c) 2016 Renat R. Dusaev <crank@qcrypt.org>
+ * Author: Renat R. Dusaev <crank@qcrypt.org>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+# include "alignment/LinearAlignment.hpp"
+
+# ifdef ALIGNMENT_ROUTINES
+
+# include <boost/property_tree/ptree.hpp>
+
+# include <cmath>
+# include <limits>
+
+namespace sV {
+namespace alignment {
+
+namespace {
+
+LinearTrackFitter::Model
+model_from_parameters( const TrackingGroupFactory::PTree & pt ) {
+    const std::string m = pt.get<std::string>( "model", "straight" );
+    LinearTrackFitter::Model model = LinearTrackFitter::straight;
+    if( "parabolic" == m ) {
+        model = LinearTrackFitter::parabolic;
+    } else if( "straight" != m ) {
+        emraise( badParameter, "Unknown track model \"%s\" for linear "
+                 "alignment (\"straight\" or \"parabolic\" expected).",
+                 m.c_str() );
+    }
+    return model;
+}
+
+bool
+best_only_from_parameters( const TrackingGroupFactory::PTree & pt ) {
+    const std::string c = pt.get<std::string>( "candidates", "best" );
+    if( "all" != c && "best" != c ) {
+        emraise( badParameter, "Unknown candidates selection \"%s\" for "
+                 "linear alignment (\"best\" or \"all\" expected).",
+                 c.c_str() );
+    }
+    return "best" == c;
+}
+
+/// Cholesky decomposition of symmetric N x N matrix (in place, lower
+/// triangle is used). Returns false if matrix is not (numerically)
+/// positive-definite.
+bool
+cholesky_decompose( std::vector<double> & M, size_t N ) {
+    double maxDiag = 0;
+    for( size_t i = 0; i < N; ++i ) {
+        maxDiag = std::max( maxDiag, M[i*N + i] );
+    }
+    const double eps = 1e-12*maxDiag;
+    for( size_t j = 0; j < N; ++j ) {
+        double d = M[j*N + j];
+        for( size_t k = 0; k < j; ++k ) {
+            d -= M[j*N + k]*M[j*N + k];
+        }
+        if( !(d > eps) ) {
+            return false;
+        }
+        d = std::sqrt(d);
+        M[j*N + j] = d;
+        for( size_t i = j + 1; i < N; ++i ) {
+            double s = M[i*N + j];
+            for( size_t k = 0; k < j; ++k ) {
+                s -= M[i*N + k]*M[j*N + k];
+            }
+            M[i*N + j] = s/d;
+        }
+    }
+    return true;
+}
+
+/// Solves L L^T x = b in place, for decomposed matrix.
+void
+cholesky_solve( const std::vector<double> & L, size_t N, double * x ) {
+    for( size_t i = 0; i < N; ++i ) {
+        for( size_t k = 0; k < i; ++k ) {
+            x[i] -= L[i*N + k]*x[k];
+        }
+        x[i] /= L[i*N + i];
+    }
+    for( size_t i = N; i-- > 0; ) {
+        for( size_t k = i + 1; k < N; ++k ) {
+            x[i] -= L[k*N + i]*x[k];
+        }
+        x[i] /= L[i*N + i];
+    }
+}
+
+}  // anonymous namespace
+
+LinearAlignmentGroup::LinearAlignmentGroup( const std::string & name_,
+                                            const PTree & pt ) :
+            TrackingGroup( name_ ),
+            _fitter( model_from_parameters(pt) ),
+            _resolution( pt.get<float>( "resolution", 1. ) ),
+            _maxChi2NDF( pt.get<float>( "maxChi2NDF", 0. ) ),
+            _maxCombinations( pt.get<size_t>( "maxCombinations", 64 ) ),
+            _batchSize( pt.get<size_t>( "batchSize", 4096 ) ),
+            _bestOnly( best_only_from_parameters(pt) ),
+            _eventOffsets( 1, 0 ),
+            _nEvents(0), _nCandidates(0), _nAccepted(0) {
+    if( !(_resolution > 0) ) {
+        emraise( badParameter, "Non-positive hits resolution %e set for "
+                 "tracking group \"%s\".", _resolution, name() );
+    }
+    auto fixedTree = pt.get_child_optional( "fixed" );
+    if( fixedTree ) {
+        for( PTree::const_iterator it = fixedTree->begin();
+             fixedTree->end() != it; ++it ) {
+            _fixedNames.push_back( it->second.get_value<std::string>() );
+        }
+    }
+}
+
+void
+LinearAlignmentGroup::_V_reconstruct_event() {
+    ++_nEvents;
+    if( LinearTrackFitter::add_group_combinations( *this, _batch,
+                                        _resolution, _maxCombinations ) ) {
+        _eventOffsets.push_back( _batch.n_candidates() );
+    }
+    if( _batch.n_candidates() >= _batchSize ) {
+        _flush();
+    }
+}
+
+void
+LinearAlignmentGroup::_flush() {
+    if( _nHits.empty() ) {
+        const size_t nV = _volumes.size();
+        _nHits.assign( nV, 0 );
+        for( uint8_t proj = 0; proj < 2; ++proj ) {
+            _C[proj].assign( nV*nV, 0. );
+            _b[proj].assign( nV, 0. );
+            _sumResiduals[proj].assign( nV, 0. );
+        }
+    }
+    if( !_batch.n_candidates() ) {
+        return;
+    }
+    _fitter.fit( _batch, _results );
+    _nCandidates += _batch.n_candidates();
+    for( size_t e = 0; e + 1 < _eventOffsets.size(); ++e ) {
+        size_t best = _eventOffsets[e + 1];
+        for( size_t c = _eventOffsets[e]; c < _eventOffsets[e + 1]; ++c ) {
+            if( !_is_acceptable( c ) ) {
+                continue;
+            }
+            if( !_bestOnly ) {
+                ++_nAccepted;
+                _accumulate( c );
+            } else if( best == _eventOffsets[e + 1]
+                    || _results.chi2[c]*_results.ndf[best]
+                     < _results.chi2[best]*_results.ndf[c] ) {
+                best = c;
+            }
+        }
+        if( _bestOnly && best != _eventOffsets[e + 1] ) {
+            ++_nAccepted;
+            _accumulate( best );
+        }
+    }
+    _batch.clear();
+    _eventOffsets.assign( 1, 0 );
+}
+
+bool
+LinearAlignmentGroup::_is_acceptable( size_t c ) const {
+    if( !_results.valid[c] || !_results.ndf[c] ) {
+        return false;
+    }
+    return !( _maxChi2NDF > 0
+           && _results.chi2[c] > _maxChi2NDF*_results.ndf[c] );
+}
+
+void
+LinearAlignmentGroup::_accumulate( size_t c ) {
+    const uint8_t np = _results.nParameters;
+    const size_t from = _batch.offsets[c],
+                 n = _batch.offsets[c + 1] - from,
+                 nV = _nHits.size();
+    const double zRef = _results.zRef[c];
+    _a.resize( n*np );
+    _va.resize( n*np );
+    for( size_t i = 0; i < n; ++i ) {
+        const double dz = _batch.z[from + i] - zRef;
+        double p = 1.;
+        for( uint8_t k = 0; k < np; ++k ) {
+            _a[i*np + k] = p;
+            p *= dz;
+        }
+        assert( _batch.sources[from + i] < nV );
+        ++_nHits[_batch.sources[from + i]];
+    }
+    for( uint8_t proj = 0; proj < 2; ++proj ) {
+        const float * V = _results.covariance_of( c, proj ),
+                    * w = (proj ? _batch.wy.data() : _batch.wx.data()) + from;
+        double * C = _C[proj].data(),
+               * b = _b[proj].data();
+        for( size_t i = 0; i < n; ++i ) {
+            for( uint8_t k = 0; k < np; ++k ) {
+                double s = 0;
+                for( uint8_t l = 0; l < np; ++l ) {
+                    s += V[k*np + l]*_a[i*np + l];
+                }
+                _va[i*np + k] = s;
+            }
+        }
+        for( size_t i = 0; i < n; ++i ) {
+            const uint32_t ki = _batch.sources[from + i];
+            const double r = _results.residuals[2*(from + i) + proj];
+            C[ki*nV + ki] += w[i];
+            b[ki] += w[i]*r;
+            _sumResiduals[proj][ki] += r;
+            for( size_t j = 0; j < n; ++j ) {
+                double aVa = 0;
+                for( uint8_t k = 0; k < np; ++k ) {
+                    aVa += _a[i*np + k]*_va[j*np + k];
+                }
+                C[ki*nV + _batch.sources[from + j]] -= w[i]*w[j]*aVa;
+            }
+        }
+    }
+}
+
+std::vector<LinearAlignmentGroup::Correction>
+LinearAlignmentGroup::solve() {
+    _flush();
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    const size_t nV = _volumes.size();
+    std::vector<Correction> res;
+    res.reserve( nV );
+    // Resolve reference members.
+    std::vector<bool> isFixed( nV, false );
+    size_t nFixed = 0;
+    if( _fixedNames.empty() ) {
+        for( size_t k = 0; k < nV && k < _fitter.model(); ++k ) {
+            isFixed[k] = true;
+            ++nFixed;
+        }
+    } else {
+        for( const auto & fixedName : _fixedNames ) {
+            size_t k = 0;
+            for( auto volPtr : _volumes ) {
+                if( fixedName == placement( volPtr ).detector_name() ) {
+                    break;
+                }
+                ++k;
+            }
+            if( k == nV ) {
+                sV_logw( "Tracking group \"%s\" has no member \"%s\" to be "
+                         "fixed for alignment.\n", name(), fixedName.c_str() );
+                continue;
+            }
+            if( !isFixed[k] ) {
+                isFixed[k] = true;
+                ++nFixed;
+            }
+        }
+    }
+    if( nFixed < _fitter.model() ) {
+        sV_logw( "Tracking group \"%s\" has %zu fixed member(s) while %d are "
+                 "required to eliminate global degrees of freedom.\n",
+                 name(), nFixed, (int) _fitter.model() );
+    }
+    // Fill per-member summary and collect free members.
+    std::vector<size_t> freeIdx;
+    {
+        size_t k = 0;
+        for( auto volPtr : _volumes ) {
+            Correction corr;
+            corr.placement = &placement( volPtr );
+            corr.fixed = isFixed[k];
+            corr.nHits = _nHits.empty() ? 0 : _nHits[k];
+            corr.determined = corr.fixed;
+            for( uint8_t proj = 0; proj < 2; ++proj ) {
+                corr.shift[proj] = corr.fixed ? 0. : nan;
+                corr.error[proj] = corr.fixed ? 0. : nan;
+                corr.meanResidual[proj] = corr.nHits
+                            ? _sumResiduals[proj][k]/corr.nHits : nan;
+            }
+            if( !corr.fixed && corr.nHits ) {
+                freeIdx.push_back( k );
+            }
+            res.push_back( corr );
+            ++k;
+        }
+    }
+    const size_t nF = freeIdx.size();
+    if( !nF ) {
+        return res;
+    }
+    std::vector<double> M( nF*nF ), x( nF ), e( nF );
+    for( uint8_t proj = 0; proj < 2; ++proj ) {
+        for( size_t i = 0; i < nF; ++i ) {
+            for( size_t j = 0; j < nF; ++j ) {
+                M[i*nF + j] = _C[proj][freeIdx[i]*nV + freeIdx[j]];
+            }
+            x[i] = _b[proj][freeIdx[i]];
+        }
+        if( !cholesky_decompose( M, nF ) ) {
+            sV_loge( "Alignment normal equations of tracking group \"%s\" "
+                     "are degenerate (projection %c); consider fixing more "
+                     "members.\n", name(), proj ? 'y' : 'x' );
+            for( size_t i = 0; i < nF; ++i ) {
+                res[freeIdx[i]].determined = false;
+            }
+            return res;
+        }
+        cholesky_solve( M, nF, x.data() );
+        for( size_t i = 0; i < nF; ++i ) {
+            // Diagonal of inverse matrix gives the shifts variances.
+            std::fill( e.begin(), e.end(), 0. );
+            e[i] = 1.;
+            cholesky_solve( M, nF, e.data() );
+            Correction & corr = res[freeIdx[i]];
+            // Measured positions are biased by x, so placement has to be
+            // moved backwards.
+            corr.shift[proj] = -x[i];
+            corr.error[proj] = std::sqrt( e[i] );
+            corr.determined = true;
+        }
+    }
+    sV_log2( "Tracking group \"%s\": %zu events, %zu of %zu track candidates "
+             "accepted, %zu member(s) aligned.\n", name(), _nEvents,
+             _nAccepted, _nCandidates, nF );
+    return res;
+}
+
+StromaV_REGISTER_TRACKING_ALGORITHM( "linearAlignment", LinearAlignmentGroup )
+
+}  // namespace alignment
+}  // namespace sV
+
+# endif  // ALIGNMENT_ROUTINES
+
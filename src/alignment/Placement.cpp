@@ -25,6 +25,7 @@
 # ifdef ALIGNMENT_ROUTINES
 
 # include <cstring>
+# include <cmath>
 # include <goo_exception.hpp>
 
 namespace sV {
@@ -34,6 +35,7 @@ DetectorPlacement::DetectorPlacement( const std::string & ctrName,
                                       const std::string & dtrName ) : _isConstructed(false) {
     bzero( &_position, sizeof(_position) );
     bzero( &_rotation, sizeof(_rotation) );
+    _update_affine();
     _detector.constructorInfo = new ConstructorInfo;
     _detector.constructorInfo->constructorName = strdup( ctrName.c_str() );
     _detector.constructorInfo->detectorName    = strdup( dtrName.c_str() );
@@ -60,6 +62,7 @@ DetectorPlacement::rotation( const Rotation & rot ) {
         emraise( badState, "Detector is already constructed at this placement." )
     }
     _rotation = rot;
+    _update_affine();
 }
 
 void
@@ -68,6 +71,60 @@ DetectorPlacement::position( const Position & pos ) {
         emraise( badState, "Detector is already constructed at this placement." )
     }
     _position = pos;
+    _update_affine();
+}
+
+void
+DetectorPlacement::_update_affine() {
+    const double d2r = M_PI/180.;
+    const double cx = cos(_rotation.byName.x*d2r), sx = sin(_rotation.byName.x*d2r),
+                 cy = cos(_rotation.byName.y*d2r), sy = sin(_rotation.byName.y*d2r),
+                 cz = cos(_rotation.byName.z*d2r), sz = sin(_rotation.byName.z*d2r);
+    // R = Rz*Ry*Rx
+    const double R[3][3] = {
+        { cz*cy, cz*sy*sx - sz*cx, cz*sy*cx + sz*sx },
+        { sz*cy, sz*sy*sx + cz*cx, sz*sy*cx - cz*sx },
+        {   -sy,            cy*sx,            cy*cx }
+    };
+    // The matrix is composed locally and then copied: GCC 12 at -O2 was
+    // seen to lose the in-place stores, dropping calls of this method from
+    // position() and rotation().
+    AffineMatrix a;
+    for( uint8_t i = 0; i < 3; ++i ) {
+        for( uint8_t j = 0; j < 3; ++j ) {
+            a[i][j] = R[i][j];
+        }
+        a[i][3] = _position.r[i];
+    }
+    memcpy( _affine, a, sizeof(AffineMatrix) );
+}
+
+void
+DetectorPlacement::to_global_n( const float * __restrict__ lx,
+                                const float * __restrict__ ly,
+                                const float * __restrict__ lz,
+                                size_t n,
+                                float * __restrict__ gx,
+                                float * __restrict__ gy,
+                                float * __restrict__ gz ) const {
+    // Local copies let compiler know coefficients are not aliased by
+    // outputs.
+    const float a00 = _affine[0][0], a01 = _affine[0][1], a02 = _affine[0][2], a03 = _affine[0][3],
+                a10 = _affine[1][0], a11 = _affine[1][1], a12 = _affine[1][2], a13 = _affine[1][3],
+                a20 = _affine[2][0], a21 = _affine[2][1], a22 = _affine[2][2], a23 = _affine[2][3];
+    if( lz ) {
+        for( size_t k = 0; k < n; ++k ) {
+            gx[k] = a00*lx[k] + a01*ly[k] + a02*lz[k] + a03;
+            gy[k] = a10*lx[k] + a11*ly[k] + a12*lz[k] + a13;
+            gz[k] = a20*lx[k] + a21*ly[k] + a22*lz[k] + a23;
+        }
+    } else {
+        for( size_t k = 0; k < n; ++k ) {
+            gx[k] = a00*lx[k] + a01*ly[k] + a03;
+            gy[k] = a10*lx[k] + a11*ly[k] + a13;
+            gz[k] = a20*lx[k] + a21*ly[k] + a23;
+        }
+    }
 }
 
 }  // namespace alignment
@@ -32,7 +32,8 @@ namespace alignment {
 ReceptiveDetector::ReceptiveDetector( const std::string & fn,
                                       const std::string & dn ) :
         iDetector(fn, dn, false, true, false ),
-        _summary( nullptr ) {}
+        _summary( nullptr ),
+        _unpackEagerly( false ) {}
 
 }  // namespace alignment
 }  // namespace sV
@@ -0,0 +1,359 @@
+/*
+ * Copyright (c) 2016 Renat R. Dusaev <crank@qcrypt.org>
+ * Author: Renat R. Dusaev <crank@qcrypt.org>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+# include "alignment/TrackFitter.hpp"
+
+# ifdef ALIGNMENT_ROUTINES
+
+# include "alignment/TrackingGroup.hpp"
+
+# include <cmath>
+# include <limits>
+# include <algorithm>
+# include <utility>
+
+/* When enabled, batch fitting routines are compiled for several instruction
+ * sets and proper one is chosen at load time, so the generic library build
+ * still employs AVX2/AVX-512 wide lanes where available. */
+# if defined(TRACK_FITTER_CLONES) && defined(__x86_64__) \
+  && defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 6
+#   define sV_TRACK_FITTER_KERNEL \
+        __attribute__(( target_clones("avx512f", "avx2", "default") ))
+# else
+#   define sV_TRACK_FITTER_KERNEL
+# endif
+/* Routines called by the cloned batch loop have to be inlined into each
+ * clone to be compiled for its instruction set. */
+# define sV_TRACK_FITTER_INLINE inline __attribute__(( always_inline ))
+
+namespace sV {
+namespace alignment {
+
+namespace {
+
+typedef LinearTrackFitter LTF;
+
+/// Accumulates weighted moments S[k] = sum(w*dz^k), k < 2*NP - 1, and
+/// T[k] = sum(w*v*dz^k), k < NP, where dz = z - zRef. Lanes are independent,
+/// so the main loop is vectorizable without re-association of sums.
+template<unsigned NP> sV_TRACK_FITTER_INLINE void
+accumulate_moments( const float * __restrict__ z,
+                    const float * __restrict__ v,
+                    const float * __restrict__ w,
+                    size_t n, double zRef,
+                    double * S, double * T ) {
+    const unsigned NS = 2*NP - 1;
+    double aS[NS][LTF::nLanes] = {{0}},
+           aT[NP][LTF::nLanes] = {{0}};
+    size_t i = 0;
+    for( ; i + LTF::nLanes <= n; i += LTF::nLanes ) {
+        for( size_t l = 0; l < LTF::nLanes; ++l ) {
+            const double dz = z[i + l] - zRef,
+                         ww = w[i + l],
+                         wv = ww*v[i + l];
+            double p = 1.;
+            for( unsigned k = 0; k < NS; ++k ) {
+                aS[k][l] += ww*p;
+                if( k < NP ) {
+                    aT[k][l] += wv*p;
+                }
+                p *= dz;
+            }
+        }
+    }
+    for( ; i < n; ++i ) {
+        const double dz = z[i] - zRef,
+                     ww = w[i],
+                     wv = ww*v[i];
+        double p = 1.;
+        for( unsigned k = 0; k < NS; ++k ) {
+            aS[k][0] += ww*p;
+            if( k < NP ) {
+                aT[k][0] += wv*p;
+            }
+            p *= dz;
+        }
+    }
+    for( unsigned k = 0; k < NS; ++k ) {
+        S[k] = 0;
+        for( size_t l = 0; l < LTF::nLanes; ++l ) S[k] += aS[k][l];
+    }
+    for( unsigned k = 0; k < NP; ++k ) {
+        T[k] = 0;
+        for( size_t l = 0; l < LTF::nLanes; ++l ) T[k] += aT[k][l];
+    }
+}
+
+/// Inverts NP x NP normal matrix A[i][j] = S[i+j] by Gauss-Jordan
+/// elimination. Returns false for (nearly) degenerate matrix.
+template<unsigned NP> sV_TRACK_FITTER_INLINE bool
+invert_normal_matrix( const double * S, double inv[NP][NP] ) {
+    double a[NP][2*NP];
+    double scale = 0;
+    for( unsigned i = 0; i < NP; ++i ) {
+        for( unsigned j = 0; j < NP; ++j ) {
+            a[i][j] = S[i + j];
+            a[i][NP + j] = (i == j ? 1. : 0.);
+        }
+        scale = std::max( scale, std::fabs(a[i][i]) );
+    }
+    const double eps = 1e-12*scale;
+    for( unsigned c = 0; c < NP; ++c ) {
+        unsigned piv = c;
+        for( unsigned r = c + 1; r < NP; ++r ) {
+            if( std::fabs(a[r][c]) > std::fabs(a[piv][c]) ) piv = r;
+        }
+        if( !(std::fabs(a[piv][c]) > eps) ) {
+            return false;
+        }
+        if( piv != c ) {
+            for( unsigned j = 0; j < 2*NP; ++j ) std::swap( a[c][j], a[piv][j] );
+        }
+        const double d = 1./a[c][c];
+        for( unsigned j = 0; j < 2*NP; ++j ) a[c][j] *= d;
+        for( unsigned r = 0; r < NP; ++r ) {
+            if( r == c ) continue;
+            const double f = a[r][c];
+            for( unsigned j = 0; j < 2*NP; ++j ) a[r][j] -= f*a[c][j];
+        }
+    }
+    for( unsigned i = 0; i < NP; ++i ) {
+        for( unsigned j = 0; j < NP; ++j ) {
+            inv[i][j] = a[i][NP + j];
+        }
+    }
+    return true;
+}
+
+/// Computes residuals (written with given stride) and returns chi^2.
+template<unsigned NP> sV_TRACK_FITTER_INLINE double
+residuals_and_chi2( const float * __restrict__ z,
+                    const float * __restrict__ v,
+                    const float * __restrict__ w,
+                    size_t n, double zRef,
+                    const double * p,
+                    float * __restrict__ res, size_t stride ) {
+    double aChi2[LTF::nLanes] = {0};
+    size_t i = 0;
+    for( ; i + LTF::nLanes <= n; i += LTF::nLanes ) {
+        for( size_t l = 0; l < LTF::nLanes; ++l ) {
+            const double dz = z[i + l] - zRef;
+            double f = p[NP - 1];
+            for( unsigned k = NP - 1; k > 0; --k ) {
+                f = f*dz + p[k - 1];
+            }
+            const double r = v[i + l] - f;
+            res[(i + l)*stride] = r;
+            aChi2[l] += w[i + l]*r*r;
+        }
+    }
+    for( ; i < n; ++i ) {
+        const double dz = z[i] - zRef;
+        double f = p[NP - 1];
+        for( unsigned k = NP - 1; k > 0; --k ) {
+            f = f*dz + p[k - 1];
+        }
+        const double r = v[i] - f;
+        res[i*stride] = r;
+        aChi2[0] += w[i]*r*r;
+    }
+    double chi2 = 0;
+    for( size_t l = 0; l < LTF::nLanes; ++l ) chi2 += aChi2[l];
+    return chi2;
+}
+
+/// Fits single projection of a candidate. Returns false on degenerate
+/// system.
+template<unsigned NP> sV_TRACK_FITTER_INLINE bool
+fit_projection( const float * z, const float * v, const float * w,
+                size_t n, double zRef,
+                float * params, float * cov,
+                float * res, double & chi2 ) {
+    double S[2*NP - 1], T[NP], inv[NP][NP], p[NP];
+    accumulate_moments<NP>( z, v, w, n, zRef, S, T );
+    if( !invert_normal_matrix<NP>( S, inv ) ) {
+        return false;
+    }
+    for( unsigned i = 0; i < NP; ++i ) {
+        p[i] = 0;
+        for( unsigned j = 0; j < NP; ++j ) {
+            p[i] += inv[i][j]*T[j];
+            cov[i*NP + j] = inv[i][j];
+        }
+        params[i] = p[i];
+    }
+    chi2 = residuals_and_chi2<NP>( z, v, w, n, zRef, p, res, 2 );
+    return true;
+}
+
+template<unsigned NP> sV_TRACK_FITTER_KERNEL void
+fit_batch( const LTF::HitsBatch & b, LTF::Results & r ) {
+    const size_t nC = b.n_candidates();
+    for( size_t c = 0; c < nC; ++c ) {
+        const size_t from = b.offsets[c],
+                     n = b.offsets[c + 1] - from;
+        if( n < NP ) {
+            continue;  // left invalid
+        }
+        const float * z = b.z.data() + from;
+        double zRef = 0;
+        for( size_t i = 0; i < n; ++i ) zRef += z[i];
+        zRef /= n;
+        double chi2x, chi2y;
+        bool ok = fit_projection<NP>( z, b.x.data() + from, b.wx.data() + from,
+                                      n, zRef,
+                                      r.parameters.data() + 2*c*NP,
+                                      r.covariances.data() + 2*c*NP*NP,
+                                      r.residuals.data() + 2*from, chi2x )
+               && fit_projection<NP>( z, b.y.data() + from, b.wy.data() + from,
+                                      n, zRef,
+                                      r.parameters.data() + (2*c + 1)*NP,
+                                      r.covariances.data() + (2*c + 1)*NP*NP,
+                                      r.residuals.data() + 2*from + 1, chi2y );
+        if( !ok ) {
+            continue;
+        }
+        r.zRef[c] = zRef;
+        r.chi2[c] = chi2x + chi2y;
+        r.ndf[c] = 2*(n - NP);
+        r.valid[c] = 1;
+    }
+}
+
+}  // anonymous namespace
+
+void
+LinearTrackFitter::HitsBatch::clear() {
+    x.clear(); y.clear(); z.clear();
+    wx.clear(); wy.clear();
+    sources.clear();
+    offsets.assign( 1, 0 );
+}
+
+void
+LinearTrackFitter::fit( const HitsBatch & b, Results & r ) const {
+    const size_t nC = b.n_candidates();
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+    r.nParameters = _model;
+    r.zRef.assign( nC, nan );
+    r.parameters.assign( 2*nC*_model, nan );
+    r.covariances.assign( 2*nC*_model*_model, nan );
+    r.chi2.assign( nC, nan );
+    r.ndf.assign( nC, 0 );
+    r.residuals.assign( 2*b.n_hits(), nan );
+    r.valid.assign( nC, 0 );
+    if( straight == _model ) {
+        fit_batch<2>( b, r );
+    } else if( parabolic == _model ) {
+        fit_batch<3>( b, r );
+    } else {
+        emraise( badParameter, "Unknown track fitting model %d.", (int) _model );
+    }
+}
+
+size_t
+LinearTrackFitter::add_group_combinations( const TrackingGroup & group,
+                                           HitsBatch & b,
+                                           float resolution,
+                                           size_t maxCombinations ) {
+    // Hits of each contributing volume in global frame.
+    std::vector< std::vector<float> > hits;
+    // Index of each contributing volume within the group.
+    std::vector<uint32_t> sources;
+    uint32_t volIdx = 0;
+    for( auto vIt = group.volumes().begin();
+         group.volumes().end() != vIt; ++vIt, ++volIdx ) {
+        const TrackingGroup::Volume * volPtr = *vIt;
+        const DetectorPlacement & pl = group.placement( volPtr );
+        // Denormalized local coordinates of points, one array per dimension.
+        std::vector<float> local[3];
+        const uint8_t nDims = volPtr->n_dimensions();
+        if( 2 == nDims ) {
+            const TrackReceptiveVolume<2> & v = volPtr->as<2>();
+            if( v.sets().empty() ) continue;
+            const auto ps = v.sets().front();
+            float * x[2];
+            for( uint8_t d = 0; d < 2; ++d ) {
+                local[d].assign( ps.coordinates(d).begin(), ps.coordinates(d).end() );
+                x[d] = local[d].data();
+            }
+            v.denorm_n( x, ps.size() );
+        } else {
+            const TrackReceptiveVolume<3> & v = volPtr->as<3>();
+            if( v.sets().empty() ) continue;
+            const auto ps = v.sets().front();
+            float * x[3];
+            for( uint8_t d = 0; d < 3; ++d ) {
+                local[d].assign( ps.coordinates(d).begin(), ps.coordinates(d).end() );
+                x[d] = local[d].data();
+            }
+            v.denorm_n( x, ps.size() );
+        }
+        const size_t nPts = local[0].size();
+        std::vector<float> global[3];
+        for( uint8_t d = 0; d < 3; ++d ) {
+            global[d].resize( nPts );
+        }
+        pl.to_global_n( local[0].data(), local[1].data(),
+                        3 == nDims ? local[2].data() : nullptr,
+                        nPts,
+                        global[0].data(), global[1].data(), global[2].data() );
+        std::vector<float> vHits( 3*nPts );
+        for( size_t n = 0; n < nPts; ++n ) {
+            for( uint8_t i = 0; i < 3; ++i ) {
+                vHits[3*n + i] = global[i][n];
+            }
+        }
+        if( !vHits.empty() ) {
+            hits.push_back( std::move(vHits) );
+            sources.push_back( volIdx );
+        }
+    }
+    if( hits.empty() || !maxCombinations ) {
+        return 0;
+    }
+    const float w = 1./(resolution*resolution);
+    // Enumerate combinations with mixed-radix counter.
+    std::vector<size_t> idx( hits.size(), 0 );
+    size_t nAdded = 0;
+    do {
+        for( size_t v = 0; v < hits.size(); ++v ) {
+            const float * h = hits[v].data() + 3*idx[v];
+            b.add_hit( h[0], h[1], h[2], w, w, sources[v] );
+        }
+        b.close_candidate();
+        ++nAdded;
+        size_t v = 0;
+        for( ; v < hits.size(); ++v ) {
+            if( ++idx[v] < hits[v].size()/3 ) break;
+            idx[v] = 0;
+        }
+        if( v == hits.size() ) break;
+    } while( nAdded < maxCombinations );
+    return nAdded;
+}
+
+}  // namespace alignment
+}  // namespace sV
+
+# endif  // ALIGNMENT_ROUTINES
+
@@ -24,6 +24,7 @@
 
 # ifdef ALIGNMENT_ROUTINES
 
+# include "alignment/ReceptiveDetector.hpp"
 # include "app/abstract.hpp"
 # include <boost/property_tree/ptree.hpp>
 
@@ -89,6 +90,11 @@ TrackingGroup::include( const Placement & pl ) {
         return;
     }
 
+    // Groups sharing this detector may be reconstructed concurrently, so
+    // its summary must not be lazily unpacked by reconstruction threads.
+    // TODO: keep const validity!
+    const_cast<iDetector*>(iDetPtr)->receptive().unpack_eagerly( true );
+
     _volumes.push_back( atvPtr );
     _pl2vol.emplace( &pl, atvPtr );
     _vol2pl.emplace( atvPtr, &pl );
@@ -0,0 +1,213 @@
+/*
+ * Copyright (c) 2016 Renat R. Dusaev <crank@qcrypt.org>
+ * Author: Renat R. Dusaev <crank@qcrypt.org>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+# include "alignment/TrackingScheduler.hpp"
+
+# ifdef ALIGNMENT_ROUTINES
+
+# include "alignment/TrackingGroup.hpp"
+
+# include <cassert>
+
+namespace sV {
+namespace alignment {
+
+TrackingScheduler::TrackingScheduler( size_t nWorkers ) :
+            _nRemaining(0),
+            _stop(false) {
+    _workers.reserve( nWorkers );
+    for( size_t i = 0; i < nWorkers; ++i ) {
+        _workers.emplace_back( &TrackingScheduler::_worker_loop, this );
+    }
+}
+
+TrackingScheduler::~TrackingScheduler() {
+    {
+        std::lock_guard<std::mutex> l(_mtx);
+        _stop = true;
+    }
+    _cv.notify_all();
+    for( auto & w : _workers ) {
+        w.join();
+    }
+}
+
+size_t
+TrackingScheduler::_index_of( const TrackingGroup * grpPtr ) const {
+    auto it = _indexes.find( grpPtr );
+    if( _indexes.end() == it ) {
+        emraise( notFound, "Tracking group %p is not scheduled.", grpPtr );
+    }
+    return it->second;
+}
+
+void
+TrackingScheduler::add_group( TrackingGroup * grpPtr ) {
+    assert( grpPtr );
+    if( !_indexes.emplace( grpPtr, _nodes.size() ).second ) {
+        emraise( nonUniq, "Tracking group \"%s\" is already scheduled.",
+                 grpPtr->name() );
+    }
+    _nodes.push_back( Node{ grpPtr, {}, 0, 0, false } );
+}
+
+void
+TrackingScheduler::add_dependency( const TrackingGroup * dependent,
+                                   const TrackingGroup * prerequisite ) {
+    size_t dIdx = _index_of( dependent ),
+           pIdx = _index_of( prerequisite );
+    _nodes[pIdx].dependents.push_back( dIdx );
+    ++_nodes[dIdx].nPrerequisites;
+    try {
+        _check_acyclic();
+    } catch( ... ) {
+        // Roll back the edge, so scheduler remains usable.
+        _nodes[pIdx].dependents.pop_back();
+        --_nodes[dIdx].nPrerequisites;
+        throw;
+    }
+}
+
+void
+TrackingScheduler::_check_acyclic() const {
+    // Kahn's algorithm: all nodes have to be eventually released.
+    std::vector<size_t> nPending( _nodes.size() );
+    std::vector<size_t> stack;
+    for( size_t i = 0; i < _nodes.size(); ++i ) {
+        if( !(nPending[i] = _nodes[i].nPrerequisites) ) {
+            stack.push_back( i );
+        }
+    }
+    size_t nReleased = 0;
+    while( !stack.empty() ) {
+        size_t i = stack.back();
+        stack.pop_back();
+        ++nReleased;
+        for( size_t d : _nodes[i].dependents ) {
+            if( !--nPending[d] ) {
+                stack.push_back( d );
+            }
+        }
+    }
+    if( nReleased != _nodes.size() ) {
+        emraise( badArchitect, "Tracking groups dependencies are cyclic "
+                 "(%zu of %zu groups can not be scheduled).",
+                 _nodes.size() - nReleased, _nodes.size() );
+    }
+}
+
+void
+TrackingScheduler::_execute( size_t idx ) {
+    bool failed = false;
+    try {
+        _nodes[idx].group->reconstruct_event();
+    } catch( ... ) {
+        failed = true;
+        std::lock_guard<std::mutex> l(_mtx);
+        if( !_error ) {
+            _error = std::current_exception();
+        }
+    }
+    std::lock_guard<std::mutex> l(_mtx);
+    _complete( idx, failed );
+}
+
+void
+TrackingScheduler::_complete( size_t idx, bool failed ) {
+    // Cancelled nodes are released without execution, so whole dependent
+    // subgraph is eventually completed.
+    std::vector<size_t> done( 1, idx );
+    while( !done.empty() ) {
+        size_t i = done.back();
+        done.pop_back();
+        --_nRemaining;
+        for( size_t d : _nodes[i].dependents ) {
+            if( failed || _nodes[i].cancelled ) {
+                _nodes[d].cancelled = true;
+            }
+            if( !--_nodes[d].nPending ) {
+                if( _nodes[d].cancelled ) {
+                    done.push_back( d );
+                } else {
+                    _ready.push_back( d );
+                }
+            }
+        }
+        failed = false;
+    }
+    _cv.notify_all();
+}
+
+void
+TrackingScheduler::_worker_loop() {
+    std::unique_lock<std::mutex> l(_mtx);
+    for(;;) {
+        _cv.wait( l, [this]{ return _stop || !_ready.empty(); } );
+        if( _stop ) {
+            return;
+        }
+        size_t idx = _ready.front();
+        _ready.pop_front();
+        l.unlock();
+        _execute( idx );
+        l.lock();
+    }
+}
+
+void
+TrackingScheduler::reconstruct_event() {
+    std::unique_lock<std::mutex> l(_mtx);
+    assert( !_nRemaining );
+    _error = nullptr;
+    _nRemaining = _nodes.size();
+    for( size_t i = 0; i < _nodes.size(); ++i ) {
+        _nodes[i].nPending = _nodes[i].nPrerequisites;
+        _nodes[i].cancelled = false;
+        if( !_nodes[i].nPending ) {
+            _ready.push_back( i );
+        }
+    }
+    _cv.notify_all();
+    // Calling thread takes its share of work until everything is done.
+    while( _nRemaining ) {
+        if( _ready.empty() ) {
+            _cv.wait( l );
+            continue;
+        }
+        size_t idx = _ready.front();
+        _ready.pop_front();
+        l.unlock();
+        _execute( idx );
+        l.lock();
+    }
+    if( _error ) {
+        std::exception_ptr e = _error;
+        _error = nullptr;
+        std::rethrow_exception( e );
+    }
+}
+
+}  // namespace alignment
+}  // namespace sV
+
+# endif  // ALIGNMENT_ROUTINES
+
@@ -92,9 +92,9 @@ void
 test_pointset( FILE * outstream,
                const size_t nSets,
                const size_t nPointsInStorage ) {
-    aux::TrackReceptiveVolume<2> trv2d;
+    TrackReceptiveVolume<2> trv2d( nPointsInStorage );
     trv2d.n_sets( nSets );
-    aux::AbstractTrackReceptiveVolume & interfaceRef = trv2d;
+    AbstractTrackReceptiveVolume & interfaceRef = trv2d;
 
     float *** sequence = new float ** [nSets];
     for( size_t i = 0; i < nSets; ++i ) {
@@ -111,38 +111,40 @@ test_pointset( FILE * outstream,
             sequence[i][n][1] = rand()/double(RAND_MAX);
             // /////////////
             interfaceRef.as<2>().update_point(
-                        aux::TrackReceptiveVolume<2>::LocalCoordinates
+                        TrackReceptiveVolume<2>::LocalCoordinates
                         { 0., sequence[i][n][0], sequence[i][n][1]} );
             // /////////////
         }
 
         // Ensure, this set is filled as expected:
-        const aux::TrackReceptiveVolume<2>::PointSet & ps = interfaceRef.as<2>().most_recent_set();
+        const TrackReceptiveVolume<2>::PointSet ps = interfaceRef.as<2>().most_recent_set();
         fprintf( outstream, "New set: %zu - 1 == %zu:\n", nPoints, ps.size() );
         assert( nPoints - 1 == ps.size() );
         size_t n = 1;
         for( auto it  = ps.rbegin();
                   it != ps.rend(); ++it, ++n ) {
             fprintf( outstream, "%zu : %f <-> %f ; %f <-> %f\n", n,
-                    (*it)->r[0], sequence[i][n][0],
-                    (*it)->r[1], sequence[i][n][1] );
-            assert( (*it)->r[0] == sequence[i][n][0] );
-            assert( (*it)->r[1] == sequence[i][n][1] );
+                    it->r[0], sequence[i][n][0],
+                    it->r[1], sequence[i][n][1] );
+            assert( it->r[0] == sequence[i][n][0] );
+            assert( it->r[1] == sequence[i][n][1] );
         }
     }
 
     // Check last 100 sets:
     size_t i = nSets - 1;
-    for( auto it = interfaceRef.as<2>().sets().begin(); it != interfaceRef.as<2>().sets().end(); ++it, --i ) {
-        const aux::TrackReceptiveVolume<2>::PointSet & psRef = **it;
+    const TrackReceptiveVolume<2>::SetsStack sets = interfaceRef.as<2>().sets();
+    assert( sets.size() == nSets );
+    for( auto it = sets.begin(); it != sets.end(); ++it, --i ) {
+        const TrackReceptiveVolume<2>::PointSet psRef = *it;
         size_t n = 1;
         for( auto pIt = psRef.rbegin(); pIt != psRef.rend(); ++pIt, ++n ) {
             fprintf( outstream, "%zu (check) : %f <-> %f ; %f <-> %f\n", n,
-                    (*pIt)->r[0], sequence[i][n][0],
-                    (*pIt)->r[1], sequence[i][n][1] );
-            assert( (*pIt)->r[0] == sequence[i][n][0] );
-            assert( (*pIt)->r[1] == sequence[i][n][1] );
-            //printf( "%zu %f %f\n", i, (*pIt)->r[0], sequence[i][n][0] );
+                    pIt->r[0], sequence[i][n][0],
+                    pIt->r[1], sequence[i][n][1] );
+            assert( pIt->r[0] == sequence[i][n][0] );
+            assert( pIt->r[1] == sequence[i][n][1] );
+            //printf( "%zu %f %f\n", i, pIt->r[0], sequence[i][n][0] );
             delete [] sequence[i][n];
         }
         delete [] sequence[i];
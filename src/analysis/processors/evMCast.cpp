@@ -25,7 +25,11 @@
 # if defined(RPC_PROTOCOLS) && defined(ANALYSIS_ROUTINES)
 
 # include "analysis/processors/evMCast.hpp"
+# include "compr/DummyCompressor.hpp"
+# include "detector_ids.hpp"
 # include <boost/bind.hpp>
+# include <boost/algorithm/string.hpp>
+# include <google/protobuf/io/coded_stream.h>
 
 namespace sV {
 namespace dprocessors {
@@ -38,7 +42,7 @@ namespace aux {
 EventPipelineStorage::EventPipelineStorage( const std::string & pn,
                                             size_t queueLength ) :
             AnalysisPipeline::iEventProcessor( pn ),
-            _nProcessed(0), _queue(queueLength) {
+            _nProcessed(0), _nDropped(0), _queue(queueLength) {
 }
 
 EventPipelineStorage::~EventPipelineStorage() {
@@ -52,42 +56,207 @@ EventPipelineStorage::_V_process_event( Event * eventPtr ) {
 bool
 EventPipelineStorage::_push_event_to_queue( const Event & event ) {
     std::lock_guard<std::mutex> lock( _queueMutex );
+    _V_on_push( event, _queue.full() ? &_queue.back() : nullptr );
+    if( _queue.full() ) {
+        ++_nDropped;
+    }
     _queue.push_front();  // now back points to newly-created
     _queue.front().CopyFrom( event );
     ++_nProcessed;
     return true;
 }
+
+// DetectorSummarySelector implementation
+////////////////////////////////////////
+
+bool
+DetectorSummarySelector::matches( const ::sV::events::DetectorSummary & ds ) const {
+    if( !_majors.empty() ) {
+        AFR_UniqueDetectorID id( ds.detectorid() );
+        if( _majors.end() == _majors.find( id.byNumber.major ) ) {
+            return false;
+        }
+    }
+    if( !_payloadTypes.empty() ) {
+        const std::string & url = ds.summarydata().type_url();
+        size_t slashPos = url.rfind( '/' );
+        if( _payloadTypes.end() == _payloadTypes.find(
+                std::string::npos == slashPos ? url : url.substr(slashPos + 1) ) ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t
+DetectorSummarySelector::select( const Event & src, Event & dst ) const {
+    dst.Clear();
+    size_t n = 0;
+    for( const auto & ds : src.displayableinfo().summaries() ) {
+        if( matches( ds ) ) {
+            dst.mutable_displayableinfo()->add_summaries()->CopyFrom( ds );
+            ++n;
+        }
+    }
+    return n;
+}
+
+DetectorSummarySelector
+DetectorSummarySelector::parse( const std::string & expr ) {
+    DetectorSummarySelector sel;
+    std::vector<std::string> criteria, values;
+    boost::split( criteria, expr, boost::is_any_of(";") );
+    for( const auto & criterion : criteria ) {
+        if( criterion.empty() ) continue;
+        size_t eqPos = criterion.find( '=' );
+        if( std::string::npos == eqPos ) {
+            emraise( badParameter, "Malformed summary selector criterion "
+                     "\"%s\" (expected key=value[,value...]).",
+                     criterion.c_str() );
+        }
+        const std::string key = criterion.substr( 0, eqPos );
+        boost::split( values, criterion.substr( eqPos + 1 ), boost::is_any_of(",") );
+        for( const auto & v : values ) {
+            if( v.empty() ) continue;
+            if( "detectors" == key ) {
+                sel.add_major( ::sV::aux::iDetectorIndex::self().mj_code( v.c_str() ) );
+            } else if( "payload" == key ) {
+                sel.add_payload_type( v );
+            } else {
+                emraise( badParameter, "Unknown summary selector criterion "
+                         "\"%s\".", key.c_str() );
+            }
+        }
+    }
+    return sel;
+}
+
 }  // namespace aux
 
 
 // EventMulticaster
 //////////////////
 
+constexpr size_t EventMulticaster::maxBucketLength;
+
 EventMulticaster::EventMulticaster( const std::string & pn,
                                     const boost::asio::ip::address & multicastAddress,
                                     size_t queueLength,
                                     int portNo,
                                     boost::asio::io_service * ioServicePtr,
-                                    size_t sendingBufferSize ) :
+                                    size_t sendingBufferSize,
+                                    iCompressor * compressor,
+                                    size_t bucketNEvents ) :
             net::iMulticastEventSender(
                                 *(ioServicePtr ? ioServicePtr : new boost::asio::io_service()),
-                                multicastAddress, portNo, sendingBufferSize ),
+                                multicastAddress, portNo, sendingBufferSize,
+                                !ioServicePtr ),
             aux::EventPipelineStorage( pn, queueLength ),
             _ioServicePtr( &(net::iMulticastEventSender::socket().get_io_service()) ),
-            _ownIOService(!ioServicePtr) {
+            _compressor(compressor),
+            _bucketNEvents(bucketNEvents),
+            _queuedBytes(0),
+            _nBucketsSent(0),
+            _sendFullStream(true) {
+    if( _do_bucketing() ) {
+        if( _bucketNEvents > queueLength ) {
+            emraise( badParameter, "Bucket size (%zu events) exceeds queue "
+                "capacity (%zu events).", _bucketNEvents, queueLength );
+        }
+        compression_method( _compressor->compr_method() );
+        _uncomprBuffer.resize( sendingBufferSize );
+        _comprBuffer.resize( sendingBufferSize );
+    }
 }
 
 EventMulticaster::~EventMulticaster() {
-    if( _ioServicePtr && _ownIOService ) {
-        delete _ioServicePtr;
+    {
+        // Let the sending chain finish while this instance is still
+        // complete (handlers invoke its virtual methods), then flush
+        // remaining events synchroneously as message buffer is not used by
+        // asynchroneous sending anymore.
+        std::unique_lock<std::mutex> sLock(sending_mutex());
+        _wait_for_pending_send( sLock );
+        if( _do_bucketing() ) {
+            std::lock_guard<std::mutex> qLock(_queueMutex);
+            while( !is_empty() ) {
+                _pack_bucket( _bucketNEvents );
+                send_message( _reentrantMessageKeeper, true );
+            }
+        }
+    }
+    _finish_transmission();
+    for( auto & ch : _channels ) {
+        delete ch.multicaster;
+    }
+    if( _compressor ) {
+        delete _compressor;
+    }
+}
+
+size_t
+EventMulticaster::_bucket_entry_length( const Event & e ) {
+    const size_t l = e.ByteSize();
+    // Field tag (1 byte for repeated events field) and length prefix.
+    return 1 + ::google::protobuf::io::CodedOutputStream::VarintSize32( l ) + l;
+}
+
+void
+EventMulticaster::_V_on_push( const Event & newEvent, const Event * overwritten ) {
+    if( !_do_bucketing() ) return;
+    _queuedBytes += _bucket_entry_length( newEvent );
+    if( overwritten ) {
+        _queuedBytes -= _bucket_entry_length( *overwritten );
     }
 }
 
+bool
+EventMulticaster::_bucket_is_due() const {
+    return events_queue().size() >= _bucketNEvents
+        || _queuedBytes >= maxBucketLength;
+}
+
 bool
 EventMulticaster::_V_do_continue_transmission() const {
+    if( _do_bucketing() ) {
+        return _bucket_is_due();
+    }
     return !events_queue().empty();
 }
 
+void
+EventMulticaster::_pack_bucket( size_t n ) {
+    _reentrantBucket.Clear();
+    size_t bucketLength = 0;
+    for( ; n && !is_empty(); --n ) {
+        const size_t entryLength = _bucket_entry_length( events_queue().back() );
+        if( bucketLength && bucketLength + entryLength > maxBucketLength ) {
+            break;
+        }
+        bucketLength += entryLength;
+        _queuedBytes -= entryLength;
+        _reentrantBucket.add_events()->Swap( &(events_queue().back()) );
+        events_queue().pop_back();
+    }
+    size_t bucketSize = _reentrantBucket.ByteSize();
+    if( bucketSize > _uncomprBuffer.size() ) {
+        _uncomprBuffer.resize( bucketSize );
+        // Some codecs may produce output slightly larger than input on
+        // non-compressible data.
+        _comprBuffer.resize( bucketSize + bucketSize/16 + 64 );
+    }
+    _reentrantBucket.SerializeWithCachedSizesToArray( _uncomprBuffer.data() );
+    size_t comprSize = _compressor->compress_series(
+                                _uncomprBuffer.data(), bucketSize,
+                                _comprBuffer.data(), _comprBuffer.size() );
+    _reentrantMessageKeeper.Clear();
+    auto dbPtr = _reentrantMessageKeeper.mutable_deflatedbucket();
+    dbPtr->mutable_metainfo()->set_comprmethod( _compressor->compr_method() );
+    dbPtr->mutable_metainfo()->set_uncompressedlength( bucketSize );
+    dbPtr->set_deflatedcontent( _comprBuffer.data(), comprSize );
+    ++_nBucketsSent;
+}
+
 void
 EventMulticaster::_V_send_next_message() {
     // Note: this method can be invoked either by event-treatment method,
@@ -97,7 +266,12 @@ EventMulticaster::_V_send_next_message() {
     // Sometimes evaluation meets the empty queue here because
     // of sending thread have sent last event in queue and treatment
     // thread comes here meeting empty queue.
-    if( !is_empty() ) {
+    if( _do_bucketing() ) {
+        if( _bucket_is_due() ) {
+            _pack_bucket( _bucketNEvents );
+            send_message( _reentrantMessageKeeper );
+        }
+    } else if( !is_empty() ) {
         _reentrantMessageKeeper.Clear();
         _reentrantMessageKeeper.mutable_event()->CopyFrom( events_queue().front() );
         send_message( _reentrantMessageKeeper );
@@ -105,21 +279,50 @@ EventMulticaster::_V_send_next_message() {
     }
 }
 
+void
+EventMulticaster::add_channel( const aux::DetectorSummarySelector & sel,
+                               EventMulticaster * mc ) {
+    assert( mc && mc != this );
+    _channels.push_back( Channel{ sel, mc } );
+}
+
 bool
 EventMulticaster::_V_process_event( Event * eventPtr ) {
-    bool insertionResult = aux::EventPipelineStorage::_V_process_event( eventPtr );
-    sending_mutex().lock();
-    if( !net::iMulticastEventSender::is_operating() ) {
-        _V_send_next_message();
+    bool insertionResult = true;
+    if( _sendFullStream ) {
+        insertionResult = aux::EventPipelineStorage::_V_process_event( eventPtr );
+        sending_mutex().lock();
+        if( !net::iMulticastEventSender::is_operating() ) {
+            _V_send_next_message();
+        }
+        sending_mutex().unlock();
+    }
+    for( auto & ch : _channels ) {
+        if( ch.selector.select( *eventPtr, _reentrantChannelEvent ) ) {
+            ch.multicaster->process_event( &_reentrantChannelEvent );
+        }
     }
-    sending_mutex().unlock();
     return insertionResult;
 }
 
 void
 EventMulticaster::_V_print_brief_summary( std::ostream & os ) const {
     os << ESC_CLRGREEN "Event multicasting processor" ESC_CLRCLEAR ":" << std::endl
-       << "  number of events processed . : " << n_processed() << std::endl;
+       << "  number of events processed . : " << n_processed() << std::endl
+       << "  events dropped from queue .. : " << n_dropped() << std::endl;
+    if( _compressor ) {
+        os << "  compression method ......... : "
+           << events::DeflatedBucketMetaInfo_CompressionMethod_Name(
+                                        _compressor->compr_method() ) << std::endl
+           << "  buckets sent ............... : " << n_buckets_sent() << std::endl;
+    }
+    if( !_channels.empty() ) {
+        os << "  channels ................... : " << _channels.size() << std::endl;
+        for( const auto & ch : _channels ) {
+            os << "    " << ch.multicaster->processor_name() << " : "
+               << ch.multicaster->n_processed() << " events" << std::endl;
+        }
+    }
     // TODO: ... other stuff
 }
 
@@ -136,11 +339,50 @@ StromaV_DEFINE_CONFIG_ARGUMENTS {
         ("multicast.storage-capacity",
             po::value<size_t>()->default_value(500),
             "Event to be stored. Defines the capacitance of last read events.")
+        ("multicast.bucket-events",
+            po::value<size_t>()->default_value(0),
+            "Number of events to be packed in single compressed bucket. Zero "
+            "disables bucketing: events will be sent one by one.")
+        ("multicast.compression",
+            po::value<std::string>()->default_value("UNCOMPRESSED"),
+            "Compression method used for buckets (see "
+            "DeflatedBucketMetaInfo.CompressionMethod). Takes effect only when "
+            "multicast.bucket-events is non-zero.")
+        ("multicast.channel",
+            po::value<std::vector<std::string>>(),
+            "Additional channel publishing only selected detector summaries, "
+            "in form <address>:<port>/<selector>, where selector is "
+            "semicolon-separated list of criteria: "
+            "detectors=<name>[,<name>...] and/or payload=<type>[,<type>...]. "
+            "May be given multiple times.")
+        ("multicast.full-stream",
+            po::value<bool>()->default_value(true),
+            "Whether to send entire events to the main multicast group.")
         ;
     }
     return multicastP;
 }
 StromaV_DEFINE_DATA_PROCESSOR( EventMulticaster ) {
+    iCompressor * compressor = nullptr;
+    size_t bucketNEvents = goo::app<sV::AbstractApplication>()
+                                .cfg_option<size_t>("multicast.bucket-events");
+    if( bucketNEvents ) {
+        const std::string comprName = goo::app<sV::AbstractApplication>()
+                                .cfg_option<std::string>("multicast.compression");
+        events::CompressionMethod m;
+        if( !events::DeflatedBucketMetaInfo_CompressionMethod_Parse( comprName, &m ) ) {
+            emraise( badParameter, "Unknown compression method: \"%s\".",
+                     comprName.c_str() );
+        }
+        switch( m ) {
+            case events::DeflatedBucketMetaInfo_CompressionMethod_UNCOMPRESSED :
+                compressor = new DummyCompressor();
+                break;
+            default:
+                emraise( noSuchKey, "No compressor implemented for method "
+                         "\"%s\".", comprName.c_str() );
+        };
+    }
     auto p = new EventMulticaster(
             "multicast",
             boost::asio::ip::address::from_string(
@@ -148,8 +390,30 @@ StromaV_DEFINE_DATA_PROCESSOR( EventMulticaster ) {
             ),
             goo::app<sV::AbstractApplication>().cfg_option<size_t>("multicast.storage-capacity"),
             goo::app<sV::AbstractApplication>().cfg_option<int>("multicast.port"),
-            goo::app<sV::AbstractApplication>().boost_io_service_ptr()
+            goo::app<sV::AbstractApplication>().boost_io_service_ptr(),
+            1024*1024,
+            compressor,
+            bucketNEvents
         );
+    AbstractApplication & app = goo::app<sV::AbstractApplication>();
+    if( app.co().count("multicast.channel") ) {
+        for( const auto & chSpec : app.cfg_option<std::vector<std::string>>("multicast.channel") ) {
+            size_t slashPos = chSpec.find( '/' ),
+                   colonPos = chSpec.rfind( ':', slashPos );
+            if( std::string::npos == slashPos || std::string::npos == colonPos ) {
+                emraise( badParameter, "Malformed multicast channel "
+                         "specification: \"%s\".", chSpec.c_str() );
+            }
+            auto sel = aux::DetectorSummarySelector::parse( chSpec.substr( slashPos + 1 ) );
+            p->add_channel( sel, new EventMulticaster(
+                    "multicast:" + chSpec.substr( 0, slashPos ),
+                    boost::asio::ip::address::from_string( chSpec.substr( 0, colonPos ) ),
+                    app.cfg_option<size_t>("multicast.storage-capacity"),
+                    std::stoi( chSpec.substr( colonPos + 1, slashPos - colonPos - 1 ) ),
+                    app.boost_io_service_ptr() ) );
+        }
+    }
+    p->send_full_stream( app.cfg_option<bool>("multicast.full-stream") );
     //io_service.run();
     return p;
 } StromaV_REGISTER_DATA_PROCESSOR(
@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) 2016 Renat R. Dusaev <crank@qcrypt.org>
+ * Author: Renat R. Dusaev <crank@qcrypt.org>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+# include "sV_config.h"
+
+# if defined(RPC_PROTOCOLS) && defined(ANALYSIS_ROUTINES)
+
+# include "analysis/processors/evShmRing.hpp"
+
+# include <goo_ansi_escseq.h>
+
+# include <chrono>
+# include <thread>
+
+namespace sV {
+namespace dprocessors {
+
+// ShmRingWriter
+///////////////
+
+ShmRingWriter::ShmRingWriter( const std::string & pn,
+                              const std::string & segmentName,
+                              size_t capacity ) :
+            AnalysisPipeline::iEventProcessor( pn ),
+            net::ShmEventRingProducer( segmentName, capacity ) {
+}
+
+bool
+ShmRingWriter::_V_process_event( Event * eventPtr ) {
+    push_event( *eventPtr );
+    return true;
+}
+
+void
+ShmRingWriter::_V_print_brief_summary( std::ostream & os ) const {
+    os << ESC_CLRGREEN "Shared memory ring writer" ESC_CLRCLEAR ":" << std::endl
+       << "  segment .................... : " << path() << std::endl
+       << "  number of events written ... : " << n_written() << std::endl
+       << "  events dropped (too large) . : " << n_dropped() << std::endl;
+}
+
+// ShmRingEventSource
+////////////////////
+
+ShmRingEventSource::ShmRingEventSource( const std::string & segmentName,
+                                        size_t pollIntervalUSec,
+                                        size_t idleTimeoutMSec ) :
+            AnalysisPipeline::iEventSequence( 0x0 ),
+            net::ShmEventRingConsumer( segmentName ),
+            _isGood( false ),
+            _pollIntervalUSec( pollIntervalUSec ),
+            _idleTimeoutMSec( idleTimeoutMSec ) {
+}
+
+void
+ShmRingEventSource::_fetch() {
+    auto idleSince = std::chrono::steady_clock::now();
+    for(;;) {
+        switch( read_event( _reentrantEvent ) ) {
+            case ok :
+                _isGood = true;
+                return;
+            case quenched :
+                sV_log2( "Shared memory ring producer quenched.\n" );
+                _isGood = false;
+                return;
+            case empty :
+                break;
+        };
+        if( _idleTimeoutMSec
+         && std::chrono::steady_clock::now() - idleSince
+                        > std::chrono::milliseconds(_idleTimeoutMSec) ) {
+            sV_logw( "No events in shared memory ring for %zu msec; "
+                     "finishing.\n", _idleTimeoutMSec );
+            _isGood = false;
+            return;
+        }
+        std::this_thread::sleep_for( std::chrono::microseconds(_pollIntervalUSec) );
+    }
+}
+
+void
+ShmRingEventSource::_V_next_event( Event *& ePtr ) {
+    _fetch();
+    ePtr = &_reentrantEvent;
+}
+
+ShmRingEventSource::Event *
+ShmRingEventSource::_V_initialize_reading() {
+    _fetch();
+    return &_reentrantEvent;
+}
+
+void
+ShmRingEventSource::_V_print_brief_summary( std::ostream & os ) const {
+    os << ESC_CLRGREEN "Shared memory ring source" ESC_CLRCLEAR ":" << std::endl
+       << "  events read ................ : " << n_read() << std::endl
+       << "  overruns ................... : " << n_overruns() << std::endl
+       << "  events skipped ............. : " << n_skipped() << std::endl
+       << "  corrupted records .......... : " << n_corrupted() << std::endl;
+}
+
+// Register processor and data source:
+StromaV_DEFINE_CONFIG_ARGUMENTS {
+    po::options_description shmP( "Shared memory event ring" );
+    { shmP.add_options()
+        ("shm-ring.name",
+            po::value<std::string>()->default_value("sV-events"),
+            "Name of shared memory segment (within /dev/shm) to write "
+            "events to." )
+        ("shm-ring.capacity.MB",
+            po::value<size_t>()->default_value(64),
+            "Capacity of shared memory ring.")
+        ("shm-ring.poll-interval.us",
+            po::value<size_t>()->default_value(100),
+            "Polling interval of \"shm-ring\" data source when ring is "
+            "empty.")
+        ("shm-ring.idle-timeout.ms",
+            po::value<size_t>()->default_value(0),
+            "Data source stops reading when no events appear within this "
+            "time. Zero means to wait for producer to quench.")
+        ;
+    }
+    return shmP;
+}
+StromaV_DEFINE_DATA_PROCESSOR( ShmRingWriter ) {
+    AbstractApplication & app = goo::app<sV::AbstractApplication>();
+    return new ShmRingWriter( "shm-ring",
+                app.cfg_option<std::string>("shm-ring.name"),
+                1024*1024*app.cfg_option<size_t>("shm-ring.capacity.MB") );
+} StromaV_REGISTER_DATA_PROCESSOR(
+    ShmRingWriter,
+    "shm-ring",
+    "Publishes events into shared memory ring for same-host consumers." )
+
+StromaV_DEFINE_DATA_SOURCE_FMT_CONSTRUCTOR( ShmRingEventSource ) {
+    AbstractApplication & app = goo::app<sV::AbstractApplication>();
+    return new ShmRingEventSource(
+                app.cfg_option<std::string>("input-file"),
+                app.cfg_option<size_t>("shm-ring.poll-interval.us"),
+                app.cfg_option<size_t>("shm-ring.idle-timeout.ms") );
+} StromaV_REGISTER_DATA_SOURCE_FMT_CONSTRUCTOR(
+    ShmRingEventSource,
+    "shm-ring",
+    "Reads events from shared memory ring; input file has to be the "
+    "segment name." )
+
+}  // namespace dprocessors
+}  // namespace sV
+
+# endif  // defined(RPC_PROTOCOLS) && defined(ANALYSIS_ROUTINES)
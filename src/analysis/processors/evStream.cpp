@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2016 Renat R. Dusaev <crank@qcrypt.org>
+ * Author: Renat R. Dusaev <crank@qcrypt.org>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+# include "sV_config.h"
+
+# if defined(RPC_PROTOCOLS) && defined(ANALYSIS_ROUTINES)
+
+# include "analysis/processors/evStream.hpp"
+
+namespace sV {
+namespace dprocessors {
+
+// Register processor and data source:
+StromaV_DEFINE_CONFIG_ARGUMENTS {
+    po::options_description streamP( "Streaming (TCP/Unix socket)" );
+    { streamP.add_options()
+        ("stream.endpoint",
+            po::value<std::string>()->default_value("tcp://127.0.0.1:30002"),
+            "Endpoint to listen at: tcp://<address>:<port> or unix://<path>." )
+        ("stream.client-queue-length",
+            po::value<size_t>()->default_value(1024),
+            "Number of messages pending for single subscriber before it will "
+            "be disconnected as a slow consumer.")
+        ("stream.max-frame-length.KB",
+            po::value<size_t>()->default_value(64*1024),
+            "Maximal length of single message accepted by \"stream\" data "
+            "source.")
+        ;
+    }
+    return streamP;
+}
+StromaV_DEFINE_DATA_PROCESSOR( EventStreamer ) {
+    AbstractApplication & app = goo::app<sV::AbstractApplication>();
+    auto addr = net::StreamEndpointAddress::parse(
+                                app.cfg_option<std::string>("stream.endpoint") );
+    size_t queueLength = app.cfg_option<size_t>("stream.client-queue-length");
+    if( net::StreamEndpointAddress::tcp == addr.kind ) {
+        return new EventStreamer<boost::asio::ip::tcp>( "stream",
+                    *app.boost_io_service_ptr(),
+                    net::make_stream_endpoint<boost::asio::ip::tcp>( addr ),
+                    queueLength );
+    }
+    # ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+    return new EventStreamer<boost::asio::local::stream_protocol>( "stream",
+                    *app.boost_io_service_ptr(),
+                    net::make_stream_endpoint<boost::asio::local::stream_protocol>( addr ),
+                    queueLength );
+    # else
+    emraise( badParameter, "Unix domain sockets are not supported." );
+    # endif
+} StromaV_REGISTER_DATA_PROCESSOR(
+    EventStreamer,
+    "stream",
+    "Reliable event streaming via TCP or Unix domain socket." )
+
+StromaV_DEFINE_DATA_SOURCE_FMT_CONSTRUCTOR( StreamEventSource ) {
+    AbstractApplication & app = goo::app<sV::AbstractApplication>();
+    auto addr = net::StreamEndpointAddress::parse(
+                                app.cfg_option<std::string>("input-file") );
+    size_t maxFrameLength = 1024*app.cfg_option<size_t>("stream.max-frame-length.KB");
+    if( net::StreamEndpointAddress::tcp == addr.kind ) {
+        return new StreamEventSource<boost::asio::ip::tcp>(
+                    *app.boost_io_service_ptr(),
+                    net::make_stream_endpoint<boost::asio::ip::tcp>( addr ),
+                    maxFrameLength );
+    }
+    # ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+    return new StreamEventSource<boost::asio::local::stream_protocol>(
+                    *app.boost_io_service_ptr(),
+                    net::make_stream_endpoint<boost::asio::local::stream_protocol>( addr ),
+                    maxFrameLength );
+    # else
+    emraise( badParameter, "Unix domain sockets are not supported." );
+    # endif
+} StromaV_REGISTER_DATA_SOURCE_FMT_CONSTRUCTOR(
+    StreamEventSource,
+    "stream",
+    "Reads events from stream sender; input file has to be given as "
+    "tcp://<address>:<port> or unix://<path>." )
+
+}  // namespace sV
+}  // namespace dprocessors
+
+# endif  // defined(RPC_PROTOCOLS) && defined(ANALYSIS_ROUTINES)
@@ -42,15 +42,102 @@
 # include "alignment/DetCtrDict.hpp"
 # include "alignment/DetectorsSet.hpp"
 # include "alignment/TrackingGroup.hpp"
+# include "alignment/TrackingScheduler.hpp"
+
+# include <fstream>
+# include <thread>
+# include <algorithm>
+# include <unordered_set>
+# include <sstream>
+# include <iomanip>
+# include <limits>
+# include <cctype>
 
 namespace sV {
 namespace mixins {
 
+namespace {
+
+// Minimal scanning of (valid) JSON text used to patch values in place.
+
+size_t
+skip_json_ws( const std::string & text, size_t pos ) {
+    while( pos < text.size() && isspace( (unsigned char) text[pos] ) ) {
+        ++pos;
+    }
+    return pos;
+}
+
+// Returns position right after the value started at pos.
+size_t
+skip_json_value( const std::string & text, size_t pos ) {
+    size_t depth = 0;
+    for( ; pos < text.size(); ++pos ) {
+        const char c = text[pos];
+        if( '"' == c ) {
+            for( ++pos; pos < text.size() && '"' != text[pos]; ++pos ) {
+                if( '\\' == text[pos] ) {
+                    ++pos;
+                }
+            }
+            if( !depth ) {
+                return pos + 1;
+            }
+        } else if( '{' == c || '[' == c ) {
+            ++depth;
+        } else if( '}' == c || ']' == c ) {
+            if( !depth ) {
+                return pos;
+            }
+            if( !--depth ) {
+                return pos + 1;
+            }
+        } else if( !depth && ( ',' == c || isspace( (unsigned char) c ) ) ) {
+            return pos;
+        }
+    }
+    return pos;
+}
+
+// For object started at objPos returns position of the member's value or
+// npos if there is no such member.
+size_t
+find_json_member( const std::string & text, size_t objPos,
+                  const std::string & key ) {
+    if( objPos >= text.size() || '{' != text[objPos] ) {
+        return std::string::npos;
+    }
+    size_t pos = skip_json_ws( text, objPos + 1 );
+    while( pos < text.size() && '"' == text[pos] ) {
+        const size_t keyEnd = skip_json_value( text, pos );
+        const bool found = !text.compare( pos + 1, keyEnd - pos - 2, key );
+        pos = skip_json_ws( text, skip_json_ws( text, keyEnd ) + 1 );  // ':'
+        if( found ) {
+            return pos;
+        }
+        pos = skip_json_ws( text, skip_json_value( text, pos ) );
+        if( pos < text.size() && ',' == text[pos] ) {
+            pos = skip_json_ws( text, pos + 1 );
+        }
+    }
+    return std::string::npos;
+}
+
+struct TextPatch {
+    size_t begin, end;
+    std::string text;
+};
+
+}  // anonymous namespace
+
 AlignmentApplication::AlignmentApplication( po::variables_map * vmPtr ) :
         AbstractApplication( vmPtr ),
-        _detectorsSet(nullptr) {}
+        _detectorsSet(nullptr),
+        _trackingScheduler(nullptr),
+        _nTrackingThreads(-1) {}
 
 AlignmentApplication::~AlignmentApplication() {
+    delete _trackingScheduler;
     for( auto it = _trackingGroups.begin(); _trackingGroups.end() != it; ++it ) {
         alignment::TrackingGroupFactory::delete_drawable_tracking_group( it->second );
     }
@@ -91,8 +178,17 @@ AlignmentApplication::_parse_groups( boost::property_tree::ptree & rootPT ) {
                  "Tracking group members have to be unique.", it->first.c_str() );
             }
             detectorsToPlace.insert( DECLTYPE(detectorsToPlace)::value_type( groupPtr, detectorNames ) );
+            // Optional list of groups to be reconstructed before this one:
+            auto afterTree = it->second.get_child_optional( "after" );
+            if( afterTree ) {
+                for( PTree::const_iterator aIt = afterTree->begin();
+                     afterTree->end() != aIt; ++aIt ) {
+                    groupPtr->add_prerequisite( aIt->second.get_value<std::string>() );
+                }
+            }
         }
     }
+    _nTrackingThreads = rootPT.get<int>( "trackingThreads", _nTrackingThreads );
     return detectorsToPlace;
 }
 
@@ -112,6 +208,108 @@ AlignmentApplication::_parse_experimental_layout_settings(
     placements = _get_placements( rootPT );
 }
 
+void
+AlignmentApplication::load_layout( const std::string & layoutFilePath ) {
+    std::ifstream ifs( layoutFilePath );
+    if( !ifs ) {
+        emraise( ioError, "Unable to open experimental layout file \"%s\".",
+                 layoutFilePath.c_str() );
+    }
+    std::list<alignment::DetectorPlacement> placements;
+    TrackingMembersNames trackingMembersNames;
+    _parse_experimental_layout_settings( ifs, placements, trackingMembersNames );
+    for( const auto & placement : placements ) {
+        alignment::DetectorsSet::construct_detector( placement );
+    }
+    for( auto it = trackingMembersNames.begin();
+         trackingMembersNames.end() != it; ++it ) {
+        for( const auto & detName : it->second ) {
+            it->first->include( detectors().placement( detName ) );
+        }
+    }
+    sV_log2( "Experimental layout \"%s\" loaded: %zu detector(s), "
+             "%zu tracking group(s).\n", layoutFilePath.c_str(),
+             detectors().placements_list().size(), _trackingGroups.size() );
+}
+
+void
+AlignmentApplication::write_corrected_layout(
+                                        const std::string & layoutFilePath,
+                                        const std::string & outputFilePath,
+                                        const Shifts & shifts ) {
+    std::string text;
+    {
+        std::ifstream ifs( layoutFilePath );
+        if( !ifs ) {
+            emraise( ioError, "Unable to open experimental layout file \"%s\".",
+                     layoutFilePath.c_str() );
+        }
+        std::stringstream ss;
+        ss << ifs.rdbuf();
+        text = ss.str();
+    }
+    {
+        // Validates the layout, so the text may be scanned below without
+        // further syntax checks.
+        std::istringstream iss( text );
+        boost::property_tree::ptree rootPT;
+        boost::property_tree::read_json( iss, rootPT );
+    }
+    // Only the position values are substituted within the original text:
+    // property tree would write all the values as strings (and lose
+    // formatting).
+    std::vector<TextPatch> patches;
+    size_t detsPos = find_json_member( text, skip_json_ws( text, 0 ),
+                                       "detectors" );
+    if( std::string::npos != detsPos ) {
+        for( auto it = shifts.begin(); shifts.end() != it; ++it ) {
+            size_t pos = find_json_member( text, detsPos, it->first );
+            if( std::string::npos == pos ) {
+                continue;
+            }
+            pos = find_json_member( text, pos, "position" );
+            if( std::string::npos == pos || '[' != text[pos] ) {
+                emraise( malformedArguments, "Detector \"%s\" has no position "
+                         "array in layout \"%s\".", it->first.c_str(),
+                         layoutFilePath.c_str() );
+            }
+            ++pos;
+            for( uint8_t posElIdx = 0; posElIdx < 2; ++posElIdx ) {
+                pos = skip_json_ws( text, pos );
+                const size_t end = skip_json_value( text, pos );
+                if( end == pos || ']' == text[pos] ) {
+                    break;
+                }
+                std::ostringstream oss;
+                oss << std::setprecision( std::numeric_limits<double>::digits10 )
+                    << std::stod( text.substr( pos, end - pos ) )
+                       + it->second[posElIdx];
+                patches.push_back( TextPatch{ pos, end, oss.str() } );
+                pos = skip_json_ws( text, end );
+                if( pos >= text.size() || ',' != text[pos++] ) {
+                    break;
+                }
+            }
+        }
+    }
+    std::sort( patches.begin(), patches.end(),
+               []( const TextPatch & a, const TextPatch & b ) {
+                   return a.begin < b.begin; } );
+    std::ofstream ofs( outputFilePath );
+    if( !ofs ) {
+        emraise( ioError, "Unable to open file \"%s\" for writing.",
+                 outputFilePath.c_str() );
+    }
+    size_t written = 0;
+    for( const auto & patch : patches ) {
+        ofs << text.substr( written, patch.begin - written ) << patch.text;
+        written = patch.end;
+    }
+    ofs << text.substr( written );
+    sV_log1( "Corrected layout written to \"%s\" (%zu detector(s) "
+             "shifted).\n", outputFilePath.c_str(), shifts.size() );
+}
+
 void
 AlignmentApplication::print_ptree( boost::property_tree::ptree const & pt,
                           std::ostream & oStream ) {
@@ -139,6 +337,64 @@ AlignmentApplication::detectors() {
     return *_detectorsSet;
 }
 
+alignment::TrackingScheduler &
+AlignmentApplication::tracking_scheduler() {
+    if( _trackingScheduler ) {
+        return *_trackingScheduler;
+    }
+    size_t nWorkers;
+    if( _nTrackingThreads < 0 ) {
+        // Calling thread also performs reconstruction.
+        size_t nHW = std::max( 1u, std::thread::hardware_concurrency() );
+        nWorkers = std::min( nHW, _trackingGroups.size() );
+        nWorkers = nWorkers ? nWorkers - 1 : 0;
+    } else {
+        nWorkers = _nTrackingThreads;
+    }
+    auto sch = new alignment::TrackingScheduler( nWorkers );
+    try {
+        for( auto it = _trackingGroups.begin(); _trackingGroups.end() != it; ++it ) {
+            sch->add_group( it->second );
+        }
+        for( auto it = _trackingGroups.begin(); _trackingGroups.end() != it; ++it ) {
+            for( const auto & prName : it->second->prerequisites() ) {
+                auto prIt = _trackingGroups.find( prName );
+                if( _trackingGroups.end() == prIt ) {
+                    emraise( notFound, "Tracking group \"%s\" has to be "
+                             "reconstructed after unknown group \"%s\".",
+                             it->first.c_str(), prName.c_str() );
+                }
+                sch->add_dependency( it->second, prIt->second );
+            }
+        }
+    } catch( ... ) {
+        delete sch;
+        throw;
+    }
+    sV_log2( "Tracking scheduler of %zu groups with %zu worker thread(s) "
+             "built.\n", sch->n_groups(), sch->n_workers() );
+    return *(_trackingScheduler = sch);
+}
+
+void
+AlignmentApplication::open_new_sets() {
+    std::unordered_set<const alignment::AbstractTrackReceptiveVolume *> opened;
+    for( auto it = _trackingGroups.begin(); _trackingGroups.end() != it; ++it ) {
+        for( auto volPtr : it->second->volumes() ) {
+            if( opened.insert( volPtr ).second ) {
+                // TODO: keep const validity!
+                const_cast<alignment::AbstractTrackReceptiveVolume *>(volPtr)
+                        ->open_new_set();
+            }
+        }
+    }
+}
+
+void
+AlignmentApplication::reconstruct_tracks() {
+    tracking_scheduler().reconstruct_event();
+}
+
 std::list<alignment::DetectorPlacement>
 AlignmentApplication::_get_placements( boost::property_tree::ptree & rootPT ) {
     std::list<alignment::DetectorPlacement> placements;
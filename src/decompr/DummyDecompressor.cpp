@@ -23,6 +23,10 @@
 # include "decompr/DummyDecompressor.hpp"
 # ifdef RPC_PROTOCOLS
 
+# include <goo_exception.hpp>
+
+# include <cstring>
+
 namespace sV {
 
 DummyDecompressor::DummyDecompressor() :
@@ -31,8 +35,13 @@ DummyDecompressor::DummyDecompressor() :
 }
 
 size_t DummyDecompressor::_V_decompress_series(uint8_t * uncomprBuf,
-            size_t /*lenUncomprBuf*/, uint8_t * comprBuf,
+            size_t lenUncomprBuf, uint8_t * comprBuf,
             size_t lenComprBuf) const {
+    if( lenComprBuf > lenUncomprBuf ) {
+        emraise( overflow, "Destination buffer of %zu bytes is insufficient "
+                 "for %zu bytes of uncompressed series.",
+                 lenUncomprBuf, lenComprBuf );
+    }
     memcpy( uncomprBuf, comprBuf, lenComprBuf);
     // _V_decompress_series() should return real length of decompressed series
     // (not lenUncomprBuf, because lenUncomprBuf is a allocated memory for
@@ -23,6 +23,8 @@
 # include "decompr/iDecompressor.hpp"
 # ifdef RPC_PROTOCOLS
 
+# include <goo_exception.hpp>
+
 namespace sV {
 
 iDecompressor::iDecompressor( events::CompressionMethod comprMethod) :
@@ -35,8 +37,13 @@ iDecompressor::~iDecompressor() {
 size_t iDecompressor::decompress_series(uint8_t * uncomprBuf,
             size_t lenUncomprBuf, uint8_t * comprBuf,
             size_t lenComprBuf) const {
-    return _V_decompress_series( uncomprBuf, lenUncomprBuf, comprBuf,
-                    lenComprBuf);
+    size_t realLen = _V_decompress_series( uncomprBuf, lenUncomprBuf,
+                                           comprBuf, lenComprBuf );
+    if( realLen > lenUncomprBuf ) {
+        emraise( overflow, "Decompressor %p reported %zu bytes written into "
+                 "buffer of %zu bytes.", this, realLen, lenUncomprBuf );
+    }
+    return realLen;
 }
 
 }  // namespace sV
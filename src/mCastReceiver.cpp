@@ -49,9 +49,12 @@ iMulticastEventReceiver::iMulticastEventReceiver( boost::asio::io_service & ioSe
                                 const boost::asio::ip::address & multicastAddress,
                                 int portNo,
                                 size_t bufferLength ) :
+        iMessageUnpacker(bufferLength),
         _udpSocket(ioService),
         _dataReentrantBufferPtr(nullptr),
-        _dataReentrantBufferLength(bufferLength) {
+        _dataReentrantBufferLength(bufferLength),
+        _acceptedMessages(0),
+        _declinedMessages(0) {
     _reallocate_reentrant_buffer( bufferLength );
     // Create the socket so that multiple may be bound to the same address.
     boost::asio::ip::udp::endpoint listenEndpoint(
@@ -83,18 +86,17 @@ iMulticastEventReceiver::~iMulticastEventReceiver() {
     }
 }
 
+bool
+iMulticastEventReceiver::_V_treat_incoming_message( const unsigned char * msg,
+                                                    size_t length ) {
+    return unpack_message( msg, length );
+}
+
 void iMulticastEventReceiver::_handle_receive( const boost::system::error_code& error,
                                       size_t nBytesRecvd ) {
     assert( _dataReentrantBufferPtr && _dataReentrantBufferLength );
     bool doRenewConnection = true;
     if( !error || nBytesRecvd > _dataReentrantBufferLength ) {
-        //// Try to deserialize MulticastMessage here and invoke
-        //// interface functions.
-        //if( !_reentrantMessageInstance.ParseFromArray(
-        //            _dataReentrantBufferPtr, nBytesRecvd ) ) {
-        //    sV_loge( "Got deserialization error of message %d bytes size.\n",
-        //                 (int) nBytesRecvd );
-        //}
         if( nBytesRecvd ) {
             sV_log3( "iMulticastEventReceiver: got a message of %zu bytes length.\n" );
             doRenewConnection = treat_incoming_message( _dataReentrantBufferPtr, nBytesRecvd );
@@ -30,14 +30,19 @@
 namespace sV {
 namespace net {
 
+constexpr size_t iMulticastEventSender::maxDatagramLength;
+
 iMulticastEventSender::iMulticastEventSender( boost::asio::io_service & ioService,
                             const boost::asio::ip::address & multicastAddress,
                             int portNo,
-                            size_t sendingBufferSize ) :
+                            size_t sendingBufferSize,
+                            bool ownIOService ) :
+                    _ownedIOService( ownIOService ? &ioService : nullptr ),
                     _udpEndpoint(multicastAddress, portNo),
                     _socket(ioService, _udpEndpoint.protocol()),
                     _serializedMessagePtr(nullptr),
                     _serializedMessageLength(0),
+                    _comprMethod( ::sV::events::DeflatedBucketMetaInfo_CompressionMethod_UNCOMPRESSED ),
                     _isOperating(false),
                     _sendingWorkPtr( nullptr ),
                     _thread( nullptr ),
@@ -46,21 +51,38 @@ iMulticastEventSender::iMulticastEventSender( boost::asio::io_service & ioServic
 }
 
 iMulticastEventSender::~iMulticastEventSender() {
-    if( _sendingWorkPtr ) {
+    _finish_transmission();
+    if( _serializedMessagePtr ) {
+        delete [] _serializedMessagePtr;
+    }
+}
+
+void
+iMulticastEventSender::_finish_transmission() {
+    if( !_sendingWorkPtr ) {
+        return;
+    }
+    {
+        std::unique_lock<std::mutex> lock( _sendingMutex );
+        // Status message is serialized into the same buffer.
+        _wait_for_pending_send( lock );
         # if 0
         _socket.shutdown(boost::asio::ip::tcp::socket::shutdown_send); // TODO: is it a correct way?
         // No, that's not correct. See:
         // http://stackoverflow.com/questions/10118943/getting-transport-endpoint-is-not-connected-in-udp-socket-programming-in-c
         # endif
-        _reentrantStatusMessage.mutable_status()->set_senderstatus(
+        send_message( _status_message(
                 ::sV::events::MulticastMessage_SenderStatusMessage_SenderStatus::
                 MulticastMessage_SenderStatusMessage_SenderStatus_QUENCHING
-            );
-        send_message( _reentrantStatusMessage, true );
+            ), true );
         delete _sendingWorkPtr;
+        _sendingWorkPtr = nullptr;
     }
-    if( _serializedMessagePtr ) {
-        delete [] _serializedMessagePtr;
+    if( _ownedIOService && _thread ) {
+        // No work left for owned service => run() returns.
+        _thread->join();
+        delete _thread;
+        _thread = nullptr;
     }
 }
 
@@ -71,22 +93,39 @@ iMulticastEventSender::_setup_transmission() {
     _thread = new boost::thread( boost::bind(&boost::asio::io_service::run, &_ioServiceRef) );
     _sendingWorkPtr = new boost::asio::io_service::work(_ioServiceRef);
     // initialize multicasting message.
-    _reentrantStatusMessage.Clear();
-    _reentrantStatusMessage.mutable_status()->set_senderstatus(
-            ::sV::events::MulticastMessage_SenderStatusMessage_SenderStatus::
-            MulticastMessage_SenderStatusMessage_SenderStatus_OPERATING
-        );
+    _status_message( ::sV::events::MulticastMessage_SenderStatusMessage_SenderStatus::
+                     MulticastMessage_SenderStatusMessage_SenderStatus_OPERATING );
     //_sendingMutex.unlock();  // XXX
-    // Send initial message.
-    send_message( _reentrantStatusMessage );
+    // Send initial message synchroneously as the invoker is about to
+    // serialize its own message into the same buffer.
+    send_message( _reentrantStatusMessage, true );
+}
+
+iMulticastEventSender::Message &
+iMulticastEventSender::_status_message(
+            ::sV::events::MulticastMessage_SenderStatusMessage_SenderStatus st ) {
+    _reentrantStatusMessage.Clear();
+    auto statusPtr = _reentrantStatusMessage.mutable_status();
+    statusPtr->set_senderstatus( st );
+    statusPtr->set_comprmethod( _comprMethod );
+    return _reentrantStatusMessage;
 }
 
 void
-iMulticastEventSender::_serialize_message_to_send( const Message & msg ) {
-    //msg.SerializeToArray( _serializedMessagePtr, _serializedMessageLength );
+iMulticastEventSender::_serialize_message_to_send( const Message & msg,
+                                                   size_t serializedLength ) {
+    if( serializedLength > _serializedMessageLength ) {
+        _resize_sending_buffer( serializedLength );
+    }
     msg.SerializeWithCachedSizesToArray( _serializedMessagePtr );
 }
 
+void
+iMulticastEventSender::_wait_for_pending_send( std::unique_lock<std::mutex> & lock ) {
+    assert( lock.owns_lock() );
+    _sendingDone.wait( lock, [this]{ return !_isOperating; } );
+}
+
 void
 iMulticastEventSender::_resize_sending_buffer( size_t newSize ) {
     assert( newSize );
@@ -106,6 +145,7 @@ iMulticastEventSender::_handle_send_to( const boost::system::error_code& error )
         _V_send_next_message();
     }
     sending_mutex().unlock();
+    _sendingDone.notify_all();
 }
 
 /** Locks the sending mutex which can be unlocked either by sending
@@ -120,9 +160,20 @@ iMulticastEventSender::send_message( const Message & msg, bool sync ) {
     if( !_thread ) {
         _setup_transmission();
     }
-    _isOperating = true;
     size_t serializedLength = msg.ByteSize();
-    _serialize_message_to_send( msg );
+    if( serializedLength > maxDatagramLength ) {
+        sV_loge( "Message of %zu bytes exceeds datagram limit (%zu bytes) "
+                 "and will be dropped.\n", serializedLength, maxDatagramLength );
+        if( !sync ) {
+            // Keep the transmission chain going.
+            _isOperating = true;
+            _ioServiceRef.post( boost::bind( &iMulticastEventSender::_handle_send_to,
+                                this, boost::system::error_code() ) );
+        }
+        return;
+    }
+    _isOperating = true;
+    _serialize_message_to_send( msg, serializedLength );
     sV_log3( "Sending a message of %zu bytes length.\n", serializedLength );
     if( !sync ) {
         _socket.async_send_to(
@@ -132,6 +183,7 @@ iMulticastEventSender::send_message( const Message & msg, bool sync ) {
     } else {
         _socket.send_to(
             boost::asio::buffer(_serializedMessagePtr, serializedLength), _udpEndpoint );
+        _isOperating = false;
     }
 }
 
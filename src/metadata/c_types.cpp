@@ -22,29 +22,8 @@
 
 # include "metadata/dictionary.tcc"
 
-# include <climits>
-
-static std::unordered_set<sV_MetadataTypeIndex> * _static_mdTypeIds = nullptr;
-
 sV_MetadataTypeIndex
-sV_generate_metadata_type_id( void * /*_this*/ ) {
-    typedef std::remove_pointer<decltype(_static_mdTypeIds)>::type
-            IDsContainer;
-    if( !_static_mdTypeIds ) {
-        _static_mdTypeIds = new IDsContainer();
-    }
-    IDsContainer & ids = *_static_mdTypeIds;
-    sV_MetadataTypeIndex idCandidate;
-    uint16_t nSense = USHRT_MAX;
-    do {
-        idCandidate = double(USHRT_MAX)*(double(rand())/RAND_MAX);
-        //XXX
-        //std::cout << "New type ID generated:" << idCandidate << std::endl;
-        nSense--;
-    } while( ids.end() != ids.find(idCandidate) && nSense );
-    if( !nSense ) {
-        emraise( overflow, "Can not generate unique metadata type ID." );
-    }
-    return idCandidate;
+sV_metadata_type_id_for_name( const char * typeName ) {
+    return sV::aux::metadata_type_id( typeName );
 }
 
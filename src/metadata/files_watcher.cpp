@@ -0,0 +1,179 @@
+/*
+ * Copyright (c) 2016 Renat R. Dusaev <crank@qcrypt.org>
+ * Author: Renat R. Dusaev <crank@qcrypt.org>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+# include "metadata/files_watcher.hpp"
+# include "app/app.h"
+
+# include <goo_exception.hpp>
+
+# include <cerrno>
+# include <chrono>
+# include <cstring>
+# include <map>
+
+# include <poll.h>
+# include <sys/inotify.h>
+# include <unistd.h>
+
+namespace sV {
+namespace aux {
+
+FilesWatcher::FilesWatcher( Callback cb, unsigned int quietIntervalMs ) :
+            _callback(cb),
+            _quietIntervalMs(quietIntervalMs),
+            _stop(false),
+            _thread(nullptr) {
+    _inotifyFD = inotify_init1( IN_NONBLOCK | IN_CLOEXEC );
+    if( _inotifyFD < 0 ) {
+        emraise( thirdParty, "Unable to initialize inotify: %s.",
+                 strerror(errno) );
+    }
+    if( pipe( _wakeFDs ) ) {
+        close( _inotifyFD );
+        emraise( thirdParty, "Unable to create pipe: %s.", strerror(errno) );
+    }
+}
+
+FilesWatcher::~FilesWatcher() {
+    stop();
+    close( _wakeFDs[0] );
+    close( _wakeFDs[1] );
+    close( _inotifyFD );
+}
+
+void
+FilesWatcher::watch( const std::string & path ) {
+    int wd = inotify_add_watch( _inotifyFD, path.c_str(),
+                                IN_MODIFY | IN_CLOSE_WRITE );
+    if( wd < 0 ) {
+        emraise( thirdParty, "Unable to watch file \"%s\": %s.",
+                 path.c_str(), strerror(errno) );
+    }
+    std::lock_guard<std::mutex> l(_mtx);
+    _paths[wd] = path;
+}
+
+void
+FilesWatcher::unwatch( const std::string & path ) {
+    std::lock_guard<std::mutex> l(_mtx);
+    for( auto it = _paths.begin(); _paths.end() != it; ++it ) {
+        if( it->second == path ) {
+            inotify_rm_watch( _inotifyFD, it->first );
+            _paths.erase( it );
+            return;
+        }
+    }
+}
+
+void
+FilesWatcher::start() {
+    if( _thread ) {
+        return;
+    }
+    _stop = false;
+    _thread = new std::thread( &FilesWatcher::_loop, this );
+}
+
+void
+FilesWatcher::stop() {
+    if( !_thread ) {
+        return;
+    }
+    _stop = true;
+    char c = 0;
+    if( write( _wakeFDs[1], &c, 1 ) < 0 ) {
+        sV_logw( "Unable to wake files watcher thread: %s.\n",
+                 strerror(errno) );
+    }
+    _thread->join();
+    delete _thread;
+    _thread = nullptr;
+    // Drain the wake-up pipe.
+    struct pollfd pfd = { _wakeFDs[0], POLLIN, 0 };
+    while( poll( &pfd, 1, 0 ) > 0 && read( _wakeFDs[0], &c, 1 ) > 0 ) {}
+}
+
+void
+FilesWatcher::_loop() {
+    typedef std::chrono::steady_clock Clock;
+    // Paths modified, with time of first unreported modification.
+    std::map<std::string, Clock::time_point> pending;
+    alignas(struct inotify_event) char buf[4096];
+    const auto quiet = std::chrono::milliseconds( _quietIntervalMs );
+    while( !_stop ) {
+        int timeoutMs = -1;
+        if( !pending.empty() ) {
+            auto oldest = Clock::time_point::max();
+            for( const auto & p : pending ) {
+                oldest = std::min( oldest, p.second );
+            }
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                                    oldest + quiet - Clock::now() ).count();
+            timeoutMs = left > 0 ? (int) left : 0;
+        }
+        struct pollfd pfds[2] = { { _inotifyFD, POLLIN, 0 },
+                                  { _wakeFDs[0], POLLIN, 0 } };
+        int rc = poll( pfds, 2, timeoutMs );
+        if( rc < 0 ) {
+            if( EINTR == errno ) continue;
+            sV_loge( "Files watcher poll() failure: %s.\n", strerror(errno) );
+            return;
+        }
+        if( _stop ) {
+            break;
+        }
+        if( pfds[0].revents & POLLIN ) {
+            ssize_t len;
+            while( (len = read( _inotifyFD, buf, sizeof(buf) )) > 0 ) {
+                std::lock_guard<std::mutex> l(_mtx);
+                for( char * p = buf; p < buf + len; ) {
+                    auto ev = reinterpret_cast<struct inotify_event *>(p);
+                    auto it = _paths.find( ev->wd );
+                    // Further modifications do not postpone the report.
+                    if( _paths.end() != it ) {
+                        pending.emplace( it->second, Clock::now() );
+                    }
+                    p += sizeof(struct inotify_event) + ev->len;
+                }
+            }
+        }
+        // Report files modified at least quiet interval ago.
+        const auto now = Clock::now();
+        for( auto it = pending.begin(); pending.end() != it; ) {
+            if( now - it->second >= quiet ) {
+                const std::string path = it->first;
+                it = pending.erase( it );
+                try {
+                    _callback( path );
+                } catch( std::exception & e ) {
+                    sV_loge( "Files watcher callback failed for \"%s\": %s\n",
+                             path.c_str(), e.what() );
+                }
+            } else {
+                ++it;
+            }
+        }
+    }
+}
+
+}  // namespace aux
+}  // namespace sV
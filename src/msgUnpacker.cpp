@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 2016 Renat R. Dusaev <crank@qcrypt.org>
+ * Author: Renat R. Dusaev <crank@qcrypt.org>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+# include "sV_config.h"
+
+# if defined(RPC_PROTOCOLS)
+
+# include "msgUnpacker.hpp"
+# include "decompr/DummyDecompressor.hpp"
+# include "app/app.h"
+
+# include <goo_exception.hpp>
+
+# include <algorithm>
+
+namespace sV {
+namespace net {
+
+iMessageUnpacker::iMessageUnpacker( size_t defaultDecomprBufferLength,
+                                    size_t maxDecomprBufferLength ) :
+        _defaultDecomprBufferLength( std::min( defaultDecomprBufferLength,
+                                               maxDecomprBufferLength ) ),
+        _maxDecomprBufferLength( maxDecomprBufferLength ),
+        _senderComprMethod( ::sV::events::DeflatedBucketMetaInfo_CompressionMethod_UNCOMPRESSED ) {
+    add_decompressor( new DummyDecompressor() );
+}
+
+iMessageUnpacker::~iMessageUnpacker() {
+    for( auto & p : _decompressors ) {
+        delete p.second;
+    }
+}
+
+void
+iMessageUnpacker::add_decompressor( iDecompressor * dcmp ) {
+    assert( dcmp );
+    auto ir = _decompressors.emplace( (int) dcmp->compr_method(), dcmp );
+    if( !ir.second && ir.first->second != dcmp ) {
+        sV_log3( "Decompressor for method %s replaced.\n",
+            ::sV::events::DeflatedBucketMetaInfo_CompressionMethod_Name(
+                                            dcmp->compr_method() ).c_str() );
+        delete ir.first->second;
+        ir.first->second = dcmp;
+    }
+}
+
+bool
+iMessageUnpacker::_V_treat_event( const ::sV::events::Event & ) {
+    emraise( badState, "Receiver %p does not override event treatment "
+        "method.", this );
+}
+
+bool
+iMessageUnpacker::_treat_deflated_bucket(
+                                const ::sV::events::DeflatedBucket & db ) {
+    auto it = _decompressors.find( (int) db.metainfo().comprmethod() );
+    if( _decompressors.end() == it ) {
+        sV_loge( "No decompressor set for method %s. Bucket dropped.\n",
+            ::sV::events::DeflatedBucketMetaInfo_CompressionMethod_Name(
+                                    db.metainfo().comprmethod() ).c_str() );
+        return true;  // keep listening
+    }
+    const std::string & content = db.deflatedcontent();
+    size_t uncomprLen = db.metainfo().uncompressedlength();
+    if( ::sV::events::DeflatedBucketMetaInfo_CompressionMethod_UNCOMPRESSED
+                                        == db.metainfo().comprmethod() ) {
+        // Content is copied as is, whatever sender declares.
+        uncomprLen = content.size();
+    } else if( !uncomprLen ) {
+        uncomprLen = std::min( _maxDecomprBufferLength,
+                    std::max( _defaultDecomprBufferLength, 4*content.size() ) );
+    }
+    if( uncomprLen > _maxDecomprBufferLength ) {
+        sV_loge( "Bucket of %zu uncompressed bytes exceeds limit of %zu "
+                 "bytes. Bucket dropped.\n", uncomprLen, _maxDecomprBufferLength );
+        return true;
+    }
+    if( _decomprBuffer.size() < uncomprLen ) {
+        _decomprBuffer.resize( uncomprLen );
+    }
+    size_t realLen;
+    try {
+        realLen = it->second->decompress_series(
+                _decomprBuffer.data(), _decomprBuffer.size(),
+                (uint8_t *) const_cast<char *>(content.data()), content.size() );
+    } catch( goo::Exception & e ) {
+        sV_loge( "Failed to decompress bucket of %zu bytes (error code %d). "
+                 "Bucket dropped.\n", content.size(), (int) e.code() );
+        return true;
+    }
+    if( !_reentrantBucket.ParseFromArray( _decomprBuffer.data(), realLen ) ) {
+        sV_loge( "Failed to deserialize bucket of %zu bytes.\n", realLen );
+        return true;
+    }
+    for( const auto & event : _reentrantBucket.events() ) {
+        if( !_V_treat_event( event ) ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool
+iMessageUnpacker::unpack_message( const unsigned char * msg,
+                                  size_t length ) {
+    if( !_reentrantMessageInstance.ParseFromArray( msg, length ) ) {
+        sV_loge( "Got deserialization error of message %zu bytes size.\n",
+                 length );
+        return true;
+    }
+    switch( _reentrantMessageInstance.Payload_case() ) {
+        case Message::kEvent :
+            return _V_treat_event( _reentrantMessageInstance.event() );
+        case Message::kStatus :
+            _senderComprMethod = _reentrantMessageInstance.status().comprmethod();
+            return _V_treat_sender_status( _reentrantMessageInstance.status() );
+        case Message::kDeflatedBucket :
+            return _treat_deflated_bucket( _reentrantMessageInstance.deflatedbucket() );
+        default:
+            sV_logw( "Got multicast message with no payload.\n" );
+    };
+    return true;
+}
+
+}  // namespace net
+}  // namespace sV
+
+# endif  // defined(RPC_PROTOCOLS)
@@ -0,0 +1,340 @@
+/*
+ * Copyright (c) 2016 Renat R. Dusaev <crank@qcrypt.org>
+ * Author: Renat R. Dusaev <crank@qcrypt.org>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+# include "shmRing.hpp"
+
+# if defined(RPC_PROTOCOLS)
+
+# include "app/app.h"
+
+# include <goo_exception.hpp>
+
+# include <cerrno>
+# include <cstring>
+# include <new>
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <unistd.h>
+
+namespace sV {
+namespace net {
+
+namespace {
+const uint32_t gShmRingMagic = 0x5356524e,  // "SVRN"
+               gShmRingVersion = 1;
+const size_t gRecordHeaderLength = sizeof(aux::ShmEventRecordHeader),
+             gDataOffset = 64;  // keeps data area cache line-aligned
+
+static_assert( sizeof(aux::ShmEventRingHeader) <= gDataOffset,
+               "Ring header does not fit into reserved space." );
+
+inline uint64_t
+aligned_record_length( size_t payloadLength ) {
+    return (gRecordHeaderLength + payloadLength + gRecordHeaderLength - 1)
+         / gRecordHeaderLength * gRecordHeaderLength;
+}
+
+inline std::string
+shm_path( const std::string & name ) {
+    if( name.empty() || std::string::npos != name.find('/') ) {
+        emraise( badParameter, "Bad shared memory segment name: \"%s\".",
+                 name.c_str() );
+    }
+    return "/dev/shm/" + name;
+}
+
+/// Sets QUENCHING status of ring already existing at given path, if any, so
+/// its consumers would know that producer has gone. Segment itself is kept
+/// intact since consumers may still have it mapped.
+void
+quench_existing_segment( const std::string & path ) {
+    int fd = ::open( path.c_str(), O_RDWR );
+    if( fd < 0 ) {
+        return;
+    }
+    struct stat st;
+    if( !::fstat( fd, &st ) && (size_t) st.st_size >= gDataOffset ) {
+        void * p = ::mmap( nullptr, gDataOffset, PROT_READ | PROT_WRITE,
+                           MAP_SHARED, fd, 0 );
+        if( MAP_FAILED != p ) {
+            auto hdr = reinterpret_cast<aux::ShmEventRingHeader *>(p);
+            if( gShmRingMagic == hdr->magic && gShmRingVersion == hdr->version ) {
+                hdr->producerStatus.store(
+                    ::sV::events::MulticastMessage_SenderStatusMessage_SenderStatus_QUENCHING,
+                    std::memory_order_release );
+            }
+            ::munmap( p, gDataOffset );
+        }
+    }
+    ::close( fd );
+}
+}  // anonymous namespace
+
+//
+// Producer
+
+ShmEventRingProducer::ShmEventRingProducer( const std::string & name,
+                                            size_t capacity,
+                                            bool unlinkOnClose ) :
+                _path( shm_path(name) ),
+                _fd(-1),
+                _mappingLength(0),
+                _header(nullptr),
+                _data(nullptr),
+                _unlinkOnClose(unlinkOnClose),
+                _nDropped(0) {
+    capacity = aligned_record_length( capacity ) - gRecordHeaderLength;
+    if( capacity < 4*gRecordHeaderLength ) {
+        emraise( badParameter, "Shared memory ring capacity is too small: "
+                 "%zu bytes.", capacity );
+    }
+    _mappingLength = gDataOffset + capacity;
+    // Segment left by previous producer may still be mapped by consumers,
+    // so it must not be truncated: new segment is prepared under temporary
+    // name and then atomically renamed into place.
+    const std::string tmpPath = _path + ".tmp." + std::to_string( ::getpid() );
+    _fd = ::open( tmpPath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644 );
+    if( _fd < 0 ) {
+        emraise( thirdParty, "Unable to create shared memory segment "
+                 "\"%s\": %s.", tmpPath.c_str(), strerror(errno) );
+    }
+    if( ::ftruncate( _fd, _mappingLength ) ) {
+        int err = errno;
+        ::close( _fd );
+        ::unlink( tmpPath.c_str() );
+        emraise( thirdParty, "Unable to allocate %zu bytes for shared memory "
+                 "segment \"%s\": %s.", _mappingLength, tmpPath.c_str(),
+                 strerror(err) );
+    }
+    void * p = ::mmap( nullptr, _mappingLength, PROT_READ | PROT_WRITE,
+                       MAP_SHARED, _fd, 0 );
+    if( MAP_FAILED == p ) {
+        int err = errno;
+        ::close( _fd );
+        ::unlink( tmpPath.c_str() );
+        emraise( thirdParty, "Unable to map shared memory segment \"%s\": "
+                 "%s.", tmpPath.c_str(), strerror(err) );
+    }
+    _header = new (p) aux::ShmEventRingHeader;
+    _data = reinterpret_cast<uint8_t *>(p) + gDataOffset;
+    _header->capacity = capacity;
+    _header->reservedPos.store( 0 );
+    _header->writePos.store( 0 );
+    _header->nextSeqNo.store( 0 );
+    _header->producerStatus.store(
+            ::sV::events::MulticastMessage_SenderStatusMessage_SenderStatus_OPERATING );
+    _header->version = gShmRingVersion;
+    // Magic number is written at last, marking segment as initialized.
+    std::atomic_thread_fence( std::memory_order_release );
+    _header->magic = gShmRingMagic;
+    quench_existing_segment( _path );
+    if( ::rename( tmpPath.c_str(), _path.c_str() ) ) {
+        int err = errno;
+        ::munmap( p, _mappingLength );
+        ::close( _fd );
+        ::unlink( tmpPath.c_str() );
+        emraise( thirdParty, "Unable to publish shared memory segment "
+                 "\"%s\": %s.", _path.c_str(), strerror(err) );
+    }
+    sV_log2( "Shared memory event ring of %zu bytes created at \"%s\".\n",
+             capacity, _path.c_str() );
+}
+
+ShmEventRingProducer::~ShmEventRingProducer() {
+    if( _header ) {
+        status( ::sV::events::MulticastMessage_SenderStatusMessage_SenderStatus_QUENCHING );
+        ::munmap( _header, _mappingLength );
+    }
+    if( _fd >= 0 ) {
+        // Name may already refer to segment of another producer.
+        struct stat own, named;
+        if( _unlinkOnClose
+         && !::fstat( _fd, &own ) && !::stat( _path.c_str(), &named )
+         && own.st_dev == named.st_dev && own.st_ino == named.st_ino ) {
+            ::unlink( _path.c_str() );
+        }
+        ::close( _fd );
+    }
+}
+
+void
+ShmEventRingProducer::status(
+            ::sV::events::MulticastMessage_SenderStatusMessage_SenderStatus st ) {
+    _header->producerStatus.store( st, std::memory_order_release );
+}
+
+bool
+ShmEventRingProducer::push_event( const ::sV::events::Event & event ) {
+    const uint64_t cap = _header->capacity;
+    const size_t length = event.ByteSize();
+    const uint64_t recLength = aligned_record_length( length );
+    if( recLength > cap/2 ) {
+        sV_logw( "Event of %zu bytes does not fit the shared memory ring of "
+                 "%zu bytes; dropped.\n", length, (size_t) cap );
+        ++_nDropped;
+        return false;
+    }
+    uint64_t pos = _header->writePos.load( std::memory_order_relaxed );
+    uint64_t offset = pos % cap;
+    const uint64_t tail = cap - offset;
+    // Reserve the region (including wrapping gap) before touching it.
+    const uint64_t newPos = pos + (tail < recLength ? tail : 0) + recLength;
+    _header->reservedPos.store( newPos, std::memory_order_relaxed );
+    std::atomic_thread_fence( std::memory_order_release );
+    if( tail < recLength ) {
+        // Write wrapping marker and continue from beginning.
+        auto wrapHdr = reinterpret_cast<aux::ShmEventRecordHeader *>(_data + offset);
+        wrapHdr->length = aux::ShmEventRecordHeader::wrapMarker;
+        offset = 0;
+    }
+    auto hdr = reinterpret_cast<aux::ShmEventRecordHeader *>(_data + offset);
+    hdr->seqNo = _header->nextSeqNo.load( std::memory_order_relaxed );
+    hdr->length = length;
+    event.SerializeWithCachedSizesToArray( _data + offset + gRecordHeaderLength );
+    _header->nextSeqNo.store( hdr->seqNo + 1, std::memory_order_relaxed );
+    _header->writePos.store( newPos, std::memory_order_release );
+    return true;
+}
+
+//
+// Consumer
+
+ShmEventRingConsumer::ShmEventRingConsumer( const std::string & name ) :
+                _path( shm_path(name) ),
+                _fd(-1),
+                _mappingLength(0),
+                _header(nullptr),
+                _data(nullptr),
+                _readPos(0),
+                _expectedSeqNo(0),
+                _seqNoKnown(false),
+                _nRead(0), _nOverruns(0), _nSkipped(0), _nCorrupted(0) {
+    _fd = ::open( _path.c_str(), O_RDONLY );
+    if( _fd < 0 ) {
+        emraise( notFound, "Unable to open shared memory segment \"%s\": %s.",
+                 _path.c_str(), strerror(errno) );
+    }
+    struct stat st;
+    if( ::fstat( _fd, &st ) || (size_t) st.st_size <= gDataOffset ) {
+        ::close( _fd );
+        emraise( badState, "Shared memory segment \"%s\" is not initialized.",
+                 _path.c_str() );
+    }
+    _mappingLength = st.st_size;
+    void * p = ::mmap( nullptr, _mappingLength, PROT_READ, MAP_SHARED, _fd, 0 );
+    if( MAP_FAILED == p ) {
+        ::close( _fd );
+        emraise( thirdParty, "Unable to map shared memory segment \"%s\": "
+                 "%s.", _path.c_str(), strerror(errno) );
+    }
+    _header = reinterpret_cast<const aux::ShmEventRingHeader *>(p);
+    _data = reinterpret_cast<const uint8_t *>(p) + gDataOffset;
+    std::atomic_thread_fence( std::memory_order_acquire );
+    if( gShmRingMagic != _header->magic
+     || gShmRingVersion != _header->version
+     || gDataOffset + _header->capacity != _mappingLength ) {
+        ::munmap( p, _mappingLength );
+        ::close( _fd );
+        emraise( badState, "\"%s\" is not a (compatible) shared memory event "
+                 "ring.", _path.c_str() );
+    }
+    _readPos = _header->writePos.load( std::memory_order_acquire );
+}
+
+ShmEventRingConsumer::~ShmEventRingConsumer() {
+    if( _header ) {
+        ::munmap( const_cast<aux::ShmEventRingHeader *>(_header), _mappingLength );
+    }
+    if( _fd >= 0 ) {
+        ::close( _fd );
+    }
+}
+
+bool
+ShmEventRingConsumer::producer_quenched() const {
+    return ::sV::events::MulticastMessage_SenderStatusMessage_SenderStatus_QUENCHING
+        == _header->producerStatus.load( std::memory_order_acquire );
+}
+
+void
+ShmEventRingConsumer::_skip_ahead() {
+    ++_nOverruns;
+    _readPos = _header->writePos.load( std::memory_order_acquire );
+}
+
+ShmEventRingConsumer::ReadResult
+ShmEventRingConsumer::read_event( ::sV::events::Event & event ) {
+    const uint64_t cap = _header->capacity;
+    for(;;) {
+        // Status has to be checked before position to not to miss events
+        // written just before quenching.
+        bool quenching = producer_quenched();
+        const uint64_t writePos = _header->writePos.load( std::memory_order_acquire );
+        if( writePos == _readPos ) {
+            return quenching ? quenched : empty;
+        }
+        if( writePos - _readPos > cap ) {
+            _skip_ahead();
+            continue;
+        }
+        uint64_t offset = _readPos % cap;
+        auto hdr = reinterpret_cast<const aux::ShmEventRecordHeader *>(_data + offset);
+        const uint64_t seqNo = hdr->seqNo;
+        const uint32_t length = hdr->length;
+        bool wrap = (aux::ShmEventRecordHeader::wrapMarker == length),
+             parsed = false;
+        if( !wrap && length <= cap - offset - gRecordHeaderLength ) {
+            parsed = event.ParseFromArray( _data + offset + gRecordHeaderLength,
+                                           length );
+        }
+        // Validate that record was not overwritten while being read.
+        std::atomic_thread_fence( std::memory_order_acquire );
+        if( _header->reservedPos.load( std::memory_order_relaxed ) - _readPos > cap ) {
+            _skip_ahead();
+            continue;
+        }
+        if( wrap ) {
+            _readPos += cap - offset;
+            continue;
+        }
+        _readPos += aligned_record_length( length );
+        if( _seqNoKnown && seqNo > _expectedSeqNo ) {
+            _nSkipped += seqNo - _expectedSeqNo;
+        }
+        _expectedSeqNo = seqNo + 1;
+        _seqNoKnown = true;
+        if( !parsed ) {
+            ++_nCorrupted;
+            sV_loge( "Unable to parse event #%llu of %u bytes from shared "
+                     "memory ring.\n", (unsigned long long) seqNo, length );
+            continue;
+        }
+        ++_nRead;
+        return ok;
+    }
+}
+
+}  // namespace net
+}  // namespace sV
+
+# endif  // defined(RPC_PROTOCOLS)
@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2016 Renat R. Dusaev <crank@qcrypt.org>
+ * Author: Renat R. Dusaev <crank@qcrypt.org>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+# include "streamTransport.hpp"
+
+# if defined(RPC_PROTOCOLS)
+
+# include <goo_exception.hpp>
+
+# include <limits>
+
+namespace sV {
+namespace net {
+
+void
+StreamFrame::encode_length( uint32_t l, uint8_t * h ) {
+    h[0] = (l >> 24) & 0xff;
+    h[1] = (l >> 16) & 0xff;
+    h[2] = (l >>  8) & 0xff;
+    h[3] =  l        & 0xff;
+}
+
+uint32_t
+StreamFrame::decode_length( const uint8_t * h ) {
+    return (uint32_t(h[0]) << 24)
+         | (uint32_t(h[1]) << 16)
+         | (uint32_t(h[2]) <<  8)
+         |  uint32_t(h[3]);
+}
+
+StreamFramePtr
+StreamFrame::make( const ::sV::events::MulticastMessage & msg ) {
+    size_t length = msg.ByteSize();
+    if( length > std::numeric_limits<uint32_t>::max() ) {
+        emraise( overflow, "Message of %zu bytes can not be framed.", length );
+    }
+    std::shared_ptr<StreamFrame> f = std::make_shared<StreamFrame>();
+    encode_length( length, f->header );
+    f->body.resize( length );
+    msg.SerializeWithCachedSizesToArray( f->body.data() );
+    return f;
+}
+
+StreamEndpointAddress
+StreamEndpointAddress::parse( const std::string & s ) {
+    StreamEndpointAddress a;
+    a.port = 0;
+    const std::string tcpPrefix = "tcp://",
+                      unixPrefix = "unix://";
+    if( !s.compare( 0, tcpPrefix.size(), tcpPrefix ) ) {
+        a.kind = tcp;
+        std::string hp = s.substr( tcpPrefix.size() );
+        size_t colonPos = hp.rfind( ':' );
+        if( std::string::npos == colonPos || colonPos + 1 == hp.size() ) {
+            emraise( badParameter, "Port number is not specified in "
+                "stream endpoint address \"%s\".", s.c_str() );
+        }
+        a.host = hp.substr( 0, colonPos );
+        try {
+            a.port = std::stoi( hp.substr( colonPos + 1 ) );
+        } catch( std::exception & ) {
+            emraise( badParameter, "Bad port number in stream endpoint "
+                "address \"%s\".", s.c_str() );
+        }
+    } else if( !s.compare( 0, unixPrefix.size(), unixPrefix ) ) {
+        a.kind = local;
+        a.path = s.substr( unixPrefix.size() );
+        if( a.path.empty() ) {
+            emraise( badParameter, "Empty socket path in stream endpoint "
+                "address \"%s\".", s.c_str() );
+        }
+    } else {
+        emraise( badParameter, "Unknown stream endpoint address scheme: "
+            "\"%s\" (expected tcp:// or unix://).", s.c_str() );
+    }
+    return a;
+}
+
+}  // namespace net
+}  // namespace sV
+
+# endif  // defined(RPC_PROTOCOLS)